@@ -350,6 +350,7 @@ static void ffmpeg_cleanup(int ret)
 
     av_freep(&print_graphs_file);
     av_freep(&print_graphs_format);
+    av_freep(&sched_stats_file);
 
     av_freep(&input_files);
     av_freep(&output_files);
@@ -893,6 +894,9 @@ static int transcode(Scheduler *sch)
 
     atomic_store(&transcode_init_done, 1);
 
+    if (sched_stats_file)
+        sch_enable_wait_timing(sch);
+
     ret = sch_start(sch);
     if (ret < 0)
         return ret;
@@ -916,10 +920,16 @@ static int transcode(Scheduler *sch)
 
         /* dump report by using the output first video and audio streams */
         print_report(0, timer_start, cur_time, transcode_ts);
+
+        if (sched_stats_file)
+            print_sched_stats(sch, input_files, nb_input_files);
     }
 
     ret = sch_stop(sch, &transcode_ts);
 
+    if (sched_stats_file)
+        print_sched_stats(sch, input_files, nb_input_files);
+
     /* write the trailer if needed */
     for (int i = 0; i < nb_output_files; i++) {
         int err = of_write_trailer(output_files[i]);
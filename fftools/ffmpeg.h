@@ -427,6 +427,9 @@ typedef struct FilterGraph {
 
     const char      *graph_desc;
     struct AVBPrint graph_print_buf;
+    // prefix number of the ids used for this graph by the last
+    // -print_graphs dump, -1 if it has not been printed
+    atomic_int       graph_print_id;
 } FilterGraph;
 
 enum DecoderFlags {
@@ -784,10 +787,12 @@ extern float max_error_rate;
 extern char *filter_nbthreads;
 extern int filter_complex_nbthreads;
 extern int filter_buffered_frames;
+extern int filter_pipeline_threads;
 extern int vstats_version;
 extern int print_graphs;
 extern char *print_graphs_file;
 extern char *print_graphs_format;
+extern char *sched_stats_file;
 extern int auto_conversion_filters;
 
 extern const AVIOInterruptCB int_cb;
@@ -325,6 +325,13 @@ static void sub2video_copy_rect(uint8_t *dst, int dst_linesize, int w, int h,
     }
 }
 
+/* With pipeline threads the graph runs by itself, pushing would wait for it
+ * to become idle after every frame and keep the stages from overlapping. */
+static int buffersrc_push_flag(void)
+{
+    return filter_pipeline_threads > 0 ? 0 : AV_BUFFERSRC_FLAG_PUSH;
+}
+
 static void sub2video_push_ref(InputFilterPriv *ifp, int64_t pts)
 {
     AVFrame *frame = ifp->sub2video.frame;
@@ -334,7 +341,7 @@ static void sub2video_push_ref(InputFilterPriv *ifp, int64_t pts)
     ifp->sub2video.last_pts = frame->pts = pts;
     ret = av_buffersrc_add_frame_flags(ifp->ifilter.filter, frame,
                                        AV_BUFFERSRC_FLAG_KEEP_REF |
-                                       AV_BUFFERSRC_FLAG_PUSH);
+                                       buffersrc_push_flag());
     if (ret != AVERROR_EOF && ret < 0)
         av_log(ifp->ifilter.graph, AV_LOG_WARNING,
                "Error while add the frame to buffer source(%s).\n",
@@ -1118,6 +1125,7 @@ int fg_create(FilterGraph **pfg, char **graph_desc, Scheduler *sch,
 
     fg->class       = &fg_class;
     fg->graph_desc  = *graph_desc;
+    atomic_init(&fg->graph_print_id, -1);
     fgp->disable_conversions = !auto_conversion_filters;
     fgp->nb_threads          = -1;
     fgp->sch                 = sch;
@@ -2114,6 +2122,12 @@ static int configure_filtergraph(FilterGraph *fg, FilterGraphThread *fgt)
             return ret;
     }
 
+    if (filter_pipeline_threads) {
+        ret = av_opt_set_int(fgt->graph, "pipeline_threads", filter_pipeline_threads, 0);
+        if (ret < 0)
+            return ret;
+    }
+
     hw_device = hw_device_for_filter();
 
     ret = graph_parse(fg, fgt->graph, graph_desc, &inputs, &outputs, hw_device);
@@ -3014,7 +3028,7 @@ static int send_eof(FilterGraphThread *fgt, InputFilter *ifilter,
         pts = av_rescale_q_rnd(pts, tb, ifp->time_base,
                                AV_ROUND_NEAR_INF | AV_ROUND_PASS_MINMAX);
 
-        ret = av_buffersrc_close(ifilter->filter, pts, AV_BUFFERSRC_FLAG_PUSH);
+        ret = av_buffersrc_close(ifilter->filter, pts, buffersrc_push_flag());
         if (ret < 0)
             return ret;
     } else {
@@ -3222,7 +3236,7 @@ static int send_frame(FilterGraph *fg, FilterGraphThread *fgt,
     fd->wallclock[LATENCY_PROBE_FILTER_PRE] = av_gettime_relative();
 
     ret = av_buffersrc_add_frame_flags(ifilter->filter, frame,
-                                       AV_BUFFERSRC_FLAG_PUSH);
+                                       buffersrc_push_flag());
     if (ret < 0) {
         av_frame_unref(frame);
         if (ret != AVERROR_EOF)
@@ -76,10 +76,12 @@ float max_error_rate  = 2.0/3;
 char *filter_nbthreads;
 int filter_complex_nbthreads = 0;
 int filter_buffered_frames = 0;
+int filter_pipeline_threads = 0;
 int vstats_version = 2;
 int print_graphs = 0;
 char *print_graphs_file = NULL;
 char *print_graphs_format = NULL;
+char *sched_stats_file = NULL;
 int auto_conversion_filters = 1;
 int64_t stats_period = 500000;
 
@@ -97,6 +99,9 @@ typedef struct GlobalOptionsContext {
 
     char          **filtergraphs;
     int          nb_filtergraphs;
+
+    size_t          sched_mem_budget;
+    size_t          sched_queue_mem_budget;
 } GlobalOptionsContext;
 
 static void uninit_options(OptionsContext *o)
@@ -717,6 +722,25 @@ static int opt_sdp_file(void *optctx, const char *opt, const char *arg)
     return sch_sdp_filename(go->sch, arg);
 }
 
+static int opt_sched_mem_budget(void *optctx, const char *opt, const char *arg)
+{
+    GlobalOptionsContext *go = optctx;
+    double num;
+    int ret;
+
+    ret = parse_number(opt, arg, OPT_TYPE_INT64, 0, SIZE_MAX, &num);
+    if (ret < 0)
+        return ret;
+
+    if (!strcmp(opt, "sched_queue_mem_budget"))
+        go->sched_queue_mem_budget = num;
+    else
+        go->sched_mem_budget       = num;
+
+    sch_set_mem_budget(go->sch, go->sched_mem_budget, go->sched_queue_mem_budget);
+    return 0;
+}
+
 #if CONFIG_VAAPI
 static int opt_vaapi_device(void *optctx, const char *opt, const char *arg)
 {
@@ -1813,9 +1837,18 @@ const OptionDef options[] = {
     { "filter_threads",         OPT_TYPE_FUNC, OPT_FUNC_ARG | OPT_EXPERT,
         { .func_arg = opt_filter_threads },
         "number of non-complex filter threads" },
+    { "sched_mem_budget",       OPT_TYPE_FUNC, OPT_FUNC_ARG | OPT_EXPERT,
+        { .func_arg = opt_sched_mem_budget },
+        "maximum size of the data queued between transcoding components", "size" },
+    { "sched_queue_mem_budget", OPT_TYPE_FUNC, OPT_FUNC_ARG | OPT_EXPERT,
+        { .func_arg = opt_sched_mem_budget },
+        "maximum size of the data in each queue between transcoding components", "size" },
     { "filter_buffered_frames", OPT_TYPE_INT, OPT_EXPERT,
         { &filter_buffered_frames },
         "maximum number of buffered frames in a filter graph" },
+    { "filter_pipeline_threads", OPT_TYPE_INT, OPT_EXPERT,
+        { &filter_pipeline_threads },
+        "number of threads running the filters of a filter graph in parallel" },
 #if FFMPEG_OPT_FILTER_SCRIPT
     { "filter_script",          OPT_TYPE_STRING, OPT_PERSTREAM | OPT_EXPERT | OPT_OUTPUT,
         { .off = OFFSET(filter_scripts) },
@@ -1850,6 +1883,9 @@ const OptionDef options[] = {
     { "print_graphs_format", OPT_TYPE_STRING, 0,
         { &print_graphs_format },
       "set the output printing format (available formats are: default, compact, csv, flat, ini, json, xml, mermaid, mermaidhtml)", "format" },
+    { "sched_stats_file", OPT_TYPE_STRING, OPT_EXPERT,
+        { &sched_stats_file },
+        "periodically write per-component throughput and blocking statistics as JSON to the specified file", "filename" },
     { "auto_conversion_filters", OPT_TYPE_BOOL, OPT_EXPERT,
         { &auto_conversion_filters },
         "enable automatic conversion filters globally" },
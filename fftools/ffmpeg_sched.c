@@ -60,6 +60,20 @@ typedef struct SchWaiter {
     int                 choked_next;
 } SchWaiter;
 
+typedef struct SchTaskStats {
+    // items received from upstream / sent downstream
+    atomic_uint_least64_t nb_in;
+    atomic_uint_least64_t nb_out;
+    // time in microseconds spent in the scheduler waiting for input / for
+    // downstream (or the schedule) to accept output
+    atomic_int_least64_t  time_wait_in;
+    atomic_int_least64_t  time_wait_out;
+
+    // set by the task thread on start/exit
+    atomic_int_least64_t  time_start;
+    atomic_int_least64_t  time_end;
+} SchTaskStats;
+
 typedef struct SchTask {
     Scheduler          *parent;
     SchedulerNode       node;
@@ -69,8 +83,17 @@ typedef struct SchTask {
 
     pthread_t           thread;
     int                 thread_running;
+
+    SchTaskStats        stats;
 } SchTask;
 
+/**
+ * State of a call from a task into the scheduler, see call_enter().
+ */
+typedef struct SchCall {
+    int64_t             start;
+} SchCall;
+
 typedef struct SchDecOutput {
     SchedulerNode      *dst;
     uint8_t            *dst_finished;
@@ -309,6 +332,19 @@ struct Scheduler {
     pthread_mutex_t     schedule_lock;
 
     atomic_int_least64_t last_dts;
+
+    /* Memory budgets for data held by the scheduler, in bytes; 0 for no
+     * limit. See sch_set_mem_budget(). */
+    size_t              mem_budget;
+    size_t              queue_mem_budget;
+
+    // measure the time tasks spend waiting, see sch_enable_wait_timing()
+    int                 wait_timing;
+    // size of the data currently held in all thread queues and pre-muxing
+    // queues, updated by the queues themselves
+    atomic_size_t       queued_bytes;
+    // written under schedule_lock
+    atomic_int          over_budget;
 };
 
 /**
@@ -369,6 +405,45 @@ static void waiter_uninit(SchWaiter *w)
     pthread_cond_destroy(&w->cond);
 }
 
+static void schedule_update_locked(Scheduler *sch);
+
+/**
+ * Must be called by a task on entry to a scheduler function that may block
+ * waiting for other tasks; must be paired with call_leave().
+ */
+static void call_enter(SchTask *task, SchCall *c)
+{
+    c->start = task->parent->wait_timing ? av_gettime_relative() : 0;
+}
+
+/**
+ * @param output 1 if the call was sending output, 0 if receiving input
+ * @param ret    result of the call, an item was transferred if >= 0
+ */
+static void call_leave(SchTask *task, SchCall *c, int output, int ret)
+{
+    Scheduler    *sch = task->parent;
+    SchTaskStats *st = &task->stats;
+
+    if (sch->wait_timing) {
+        int64_t waited = av_gettime_relative() - c->start;
+        atomic_fetch_add_explicit(output ? &st->time_wait_out : &st->time_wait_in,
+                                  waited, memory_order_relaxed);
+    }
+    if (ret >= 0)
+        atomic_fetch_add_explicit(output ? &st->nb_out : &st->nb_in,
+                                  1, memory_order_relaxed);
+
+    // taking an item out of a queue may have brought the queued data back
+    // within the memory budget, in which case the sources must be unchoked
+    if (!output && ret >= 0 && atomic_load(&sch->over_budget) &&
+        atomic_load(&sch->queued_bytes) <= sch->mem_budget) {
+        pthread_mutex_lock(&sch->schedule_lock);
+        schedule_update_locked(sch);
+        pthread_mutex_unlock(&sch->schedule_lock);
+    }
+}
+
 static int queue_alloc(ThreadQueue **ptq, unsigned nb_streams, unsigned queue_size,
                        enum QueueType type)
 {
@@ -391,7 +466,8 @@ static int queue_alloc(ThreadQueue **ptq, unsigned nb_streams, unsigned queue_si
     }
 
     tq = tq_alloc(nb_streams, queue_size,
-                  (type == QUEUE_PACKETS) ? THREAD_QUEUE_PACKETS : THREAD_QUEUE_FRAMES);
+                  (type == QUEUE_PACKETS) ? THREAD_QUEUE_PACKETS : THREAD_QUEUE_FRAMES,
+                  0);
     if (!tq)
         return AVERROR(ENOMEM);
 
@@ -653,6 +729,19 @@ int sch_sdp_filename(Scheduler *sch, const char *sdp_filename)
     return sch->sdp_filename ? 0 : AVERROR(ENOMEM);
 }
 
+void sch_set_mem_budget(Scheduler *sch, size_t total, size_t per_queue)
+{
+    av_assert0(sch->state == SCH_STATE_UNINIT);
+    sch->mem_budget       = total;
+    sch->queue_mem_budget = per_queue;
+}
+
+void sch_enable_wait_timing(Scheduler *sch)
+{
+    av_assert0(sch->state == SCH_STATE_UNINIT);
+    sch->wait_timing = 1;
+}
+
 static const AVClass sch_mux_class = {
     .class_name                = "SchMux",
     .version                   = LIBAVUTIL_VERSION_INT,
@@ -1132,7 +1221,7 @@ int sch_connect(Scheduler *sch, SchedulerNode src, SchedulerNode dst)
     return 0;
 }
 
-static int mux_task_start(SchMux *mux)
+static int mux_task_start(Scheduler *sch, SchMux *mux)
 {
     int ret = 0;
 
@@ -1173,6 +1262,8 @@ static int mux_task_start(SchMux *mux)
             av_assert0(ret >= 0);
 
             if (pkt) {
+                atomic_fetch_sub(&sch->queued_bytes, pkt->size);
+
                 if (!ms->init_eof)
                     ret = tq_send(mux->queue, min_stream, pkt);
                 av_packet_free(&pkt);
@@ -1194,6 +1285,72 @@ static int mux_task_start(SchMux *mux)
     return 0;
 }
 
+int sch_get_stats(Scheduler *sch, enum SchedulerNodeType type, unsigned idx,
+                  SchedulerNodeStats *stats)
+{
+    const SchTaskStats *st;
+    ThreadQueue *tq = NULL;
+    size_t queue_size = 0;
+    int64_t start, end;
+    SchTask *task;
+
+    switch (type) {
+    case SCH_NODE_TYPE_DEMUX:
+        if (idx >= sch->nb_demux)
+            return AVERROR(ENOENT);
+        task       = &sch->demux[idx].task;
+        break;
+    case SCH_NODE_TYPE_DEC:
+        if (idx >= sch->nb_dec)
+            return AVERROR(ENOENT);
+        task       = &sch->dec[idx].task;
+        tq         = sch->dec[idx].queue;
+        queue_size = DEFAULT_PACKET_THREAD_QUEUE_SIZE;
+        break;
+    case SCH_NODE_TYPE_FILTER_IN:
+        if (idx >= sch->nb_filters)
+            return AVERROR(ENOENT);
+        task       = &sch->filters[idx].task;
+        tq         = sch->filters[idx].queue;
+        queue_size = DEFAULT_FRAME_THREAD_QUEUE_SIZE;
+        break;
+    case SCH_NODE_TYPE_ENC:
+        if (idx >= sch->nb_enc)
+            return AVERROR(ENOENT);
+        task       = &sch->enc[idx].task;
+        tq         = sch->enc[idx].queue;
+        queue_size = DEFAULT_FRAME_THREAD_QUEUE_SIZE;
+        break;
+    case SCH_NODE_TYPE_MUX:
+        if (idx >= sch->nb_mux)
+            return AVERROR(ENOENT);
+        task       = &sch->mux[idx].task;
+        tq         = sch->mux[idx].queue;
+        queue_size = sch->mux[idx].queue_size > 0 ? sch->mux[idx].queue_size :
+                     DEFAULT_PACKET_THREAD_QUEUE_SIZE;
+        break;
+    default:
+        return AVERROR(EINVAL);
+    }
+
+    st    = &task->stats;
+    start = atomic_load(&st->time_start);
+    end   = atomic_load(&st->time_end);
+
+    *stats = (SchedulerNodeStats){
+        .opaque         = task->func_arg,
+        .nb_in          = atomic_load(&st->nb_in),
+        .nb_out         = atomic_load(&st->nb_out),
+        .time_total     = !start ? 0 : (end ? end : av_gettime_relative()) - start,
+        .time_wait_in   = atomic_load(&st->time_wait_in),
+        .time_wait_out  = atomic_load(&st->time_wait_out),
+        .queue_size     = tq ? queue_size       : 0,
+        .queue_max      = tq ? tq_max_queued(tq) : 0,
+    };
+
+    return 0;
+}
+
 int print_sdp(const char *filename);
 
 static int mux_init(Scheduler *sch, SchMux *mux)
@@ -1219,12 +1376,12 @@ static int mux_init(Scheduler *sch, SchMux *mux)
         /* SDP is written only after all the muxers are ready, so now we
          * start ALL the threads */
         for (unsigned i = 0; i < sch->nb_mux; i++) {
-            ret = mux_task_start(&sch->mux[i]);
+            ret = mux_task_start(sch, &sch->mux[i]);
             if (ret < 0)
                 return ret;
         }
     } else {
-        ret = mux_task_start(mux);
+        ret = mux_task_start(sch, mux);
         if (ret < 0)
             return ret;
     }
@@ -1409,10 +1566,11 @@ static void choke_demux(const Scheduler *sch, int demux_id, int choked)
     }
 }
 
+// Total size of the data currently held in the scheduler's queues.
 static void schedule_update_locked(Scheduler *sch)
 {
     int64_t dts;
-    int have_unchoked = 0;
+    int have_unchoked = 0, over_budget = 0, budget_changed = 0;
 
     // on termination request all waiters are choked,
     // we are not to unchoke them
@@ -1423,6 +1581,21 @@ static void schedule_update_locked(Scheduler *sch)
 
     atomic_store(&sch->last_dts, progressing_dts(sch, 0));
 
+    // when over the memory budget, all sources are choked until the queued
+    // data drains, except those that have not produced anything yet and may
+    // be needed to initialize a muxer; see call_leave() for the wakeup
+    if (sch->mem_budget) {
+        size_t bytes = atomic_load(&sch->queued_bytes);
+        over_budget  = bytes > sch->mem_budget;
+
+        budget_changed = over_budget != atomic_load(&sch->over_budget);
+        if (budget_changed)
+            av_log(sch, AV_LOG_DEBUG, "%zu bytes queued, %s memory budget\n",
+                   bytes, over_budget ? "exceeding" : "within");
+
+        atomic_store(&sch->over_budget, over_budget);
+    }
+
     // initialize our internal state
     for (unsigned type = 0; type < 2; type++)
         for (unsigned i = 0; i < (type ? sch->nb_filters : sch->nb_demux); i++) {
@@ -1442,6 +1615,8 @@ static void schedule_update_locked(Scheduler *sch)
             // and not too far ahead of the trailing stream
             if (ms->source_finished)
                 continue;
+            if (over_budget && ms->last_dts != AV_NOPTS_VALUE)
+                continue;
             if (dts == AV_NOPTS_VALUE && ms->last_dts != AV_NOPTS_VALUE)
                 continue;
             if (dts != AV_NOPTS_VALUE && ms->last_dts - dts >= SCHEDULE_TOLERANCE)
@@ -1465,8 +1640,9 @@ static void schedule_update_locked(Scheduler *sch)
         }
     }
 
-    // make sure to unchoke at least one source, if still available
-    for (unsigned type = 0; !have_unchoked && type < 2; type++)
+    // make sure to unchoke at least one source, if still available; not
+    // needed when over budget, as the queued data is still being consumed
+    for (unsigned type = 0; !have_unchoked && !over_budget && type < 2; type++)
         for (unsigned i = 0; i < (type ? sch->nb_filters : sch->nb_demux); i++) {
             int exited = type ? sch->filters[i].task_exited : sch->demux[i].task_exited;
             SchWaiter *w = type ? &sch->filters[i].waiter : &sch->demux[i].waiter;
@@ -1480,11 +1656,13 @@ static void schedule_update_locked(Scheduler *sch)
     for (unsigned type = 0; type < 2; type++) {
         for (unsigned i = 0; i < (type ? sch->nb_filters : sch->nb_demux); i++) {
             SchWaiter *w = type ? &sch->filters[i].waiter : &sch->demux[i].waiter;
-            if (w->choked_prev != w->choked_next) {
+            if (w->choked_prev != w->choked_next)
                 waiter_set(w, w->choked_next);
-                if (!type)
-                    choke_demux(sch, i, w->choked_next);
-            }
+            // a choked demuxer normally also freezes its downstream queues,
+            // but when over budget those must keep draining
+            if (!type && (w->choked_prev != w->choked_next ||
+                          (budget_changed && !sch->demux[i].task_exited)))
+                choke_demux(sch, i, w->choked_next && !over_budget);
         }
     }
 
@@ -1727,6 +1905,28 @@ int sch_start(Scheduler *sch)
     av_assert0(sch->state == SCH_STATE_UNINIT);
     sch->state = SCH_STATE_STARTED;
 
+    if (sch->mem_budget) {
+        for (unsigned i = 0; i < sch->nb_dec; i++)
+            tq_set_total_bytes(sch->dec[i].queue, &sch->queued_bytes);
+        for (unsigned i = 0; i < sch->nb_enc; i++)
+            tq_set_total_bytes(sch->enc[i].queue, &sch->queued_bytes);
+        for (unsigned i = 0; i < sch->nb_filters; i++)
+            tq_set_total_bytes(sch->filters[i].queue, &sch->queued_bytes);
+        for (unsigned i = 0; i < sch->nb_mux; i++)
+            tq_set_total_bytes(sch->mux[i].queue, &sch->queued_bytes);
+    }
+
+    if (sch->queue_mem_budget) {
+        for (unsigned i = 0; i < sch->nb_dec; i++)
+            tq_set_max_bytes(sch->dec[i].queue, sch->queue_mem_budget);
+        for (unsigned i = 0; i < sch->nb_enc; i++)
+            tq_set_max_bytes(sch->enc[i].queue, sch->queue_mem_budget);
+        for (unsigned i = 0; i < sch->nb_filters; i++)
+            tq_set_max_bytes(sch->filters[i].queue, sch->queue_mem_budget);
+        for (unsigned i = 0; i < sch->nb_mux; i++)
+            tq_set_max_bytes(sch->mux[i].queue, sch->queue_mem_budget);
+    }
+
     for (unsigned i = 0; i < sch->nb_mux; i++) {
         SchMux *mux = &sch->mux[i];
 
@@ -1948,7 +2148,8 @@ static int send_to_enc(Scheduler *sch, SchEnc *enc, AVFrame *frame)
            send_to_enc_thread(sch, enc, frame);
 }
 
-static int mux_queue_packet(SchMux *mux, SchMuxStream *ms, AVPacket *pkt)
+static int mux_queue_packet(Scheduler *sch, SchMux *mux, SchMuxStream *ms,
+                            AVPacket *pkt)
 {
     PreMuxQueue *q = &ms->pre_mux_queue;
     AVPacket *tmp_pkt = NULL;
@@ -1978,6 +2179,7 @@ static int mux_queue_packet(SchMux *mux, SchMuxStream *ms, AVPacket *pkt)
 
         av_packet_move_ref(tmp_pkt, pkt);
         q->data_size += tmp_pkt->size;
+        atomic_fetch_add(&sch->queued_bytes, tmp_pkt->size);
     }
     av_fifo_write(q->fifo, &tmp_pkt, 1);
 
@@ -2001,7 +2203,7 @@ static int send_to_mux(Scheduler *sch, SchMux *mux, unsigned stream_idx,
         pthread_mutex_lock(&sch->mux_ready_lock);
 
         if (!atomic_load(&mux->mux_started)) {
-            int ret = mux_queue_packet(mux, ms, pkt);
+            int ret = mux_queue_packet(sch, mux, ms, pkt);
             queued = ret < 0 ? ret : 1;
         }
 
@@ -2154,15 +2356,11 @@ static int demux_flush(Scheduler *sch, SchDemux *d, AVPacket *pkt)
     return 0;
 }
 
-int sch_demux_send(Scheduler *sch, unsigned demux_idx, AVPacket *pkt,
-                   unsigned flags)
+static int demux_send(Scheduler *sch, SchDemux *d, AVPacket *pkt,
+                      unsigned flags)
 {
-    SchDemux *d;
     int terminate;
 
-    av_assert0(demux_idx < sch->nb_demux);
-    d = &sch->demux[demux_idx];
-
     terminate = waiter_wait(sch, &d->waiter);
     if (terminate)
         return AVERROR_EXIT;
@@ -2176,6 +2374,23 @@ int sch_demux_send(Scheduler *sch, unsigned demux_idx, AVPacket *pkt,
     return demux_send_for_stream(sch, d, &d->streams[pkt->stream_index], pkt, flags);
 }
 
+int sch_demux_send(Scheduler *sch, unsigned demux_idx, AVPacket *pkt,
+                   unsigned flags)
+{
+    SchDemux *d;
+    SchCall call;
+    int ret;
+
+    av_assert0(demux_idx < sch->nb_demux);
+    d = &sch->demux[demux_idx];
+
+    call_enter(&d->task, &call);
+    ret = demux_send(sch, d, pkt, flags);
+    call_leave(&d->task, &call, 1, ret);
+
+    return ret;
+}
+
 static int demux_done(Scheduler *sch, unsigned demux_idx)
 {
     SchDemux *d = &sch->demux[demux_idx];
@@ -2201,12 +2416,16 @@ static int demux_done(Scheduler *sch, unsigned demux_idx)
 int sch_mux_receive(Scheduler *sch, unsigned mux_idx, AVPacket *pkt)
 {
     SchMux *mux;
+    SchCall call;
     int ret, stream_idx;
 
     av_assert0(mux_idx < sch->nb_mux);
     mux = &sch->mux[mux_idx];
 
+    call_enter(&mux->task, &call);
     ret = tq_receive(mux->queue, &stream_idx, pkt);
+    call_leave(&mux->task, &call, 0, ret);
+
     pkt->stream_index = stream_idx;
     return ret;
 }
@@ -2234,6 +2453,8 @@ int sch_mux_sub_heartbeat(Scheduler *sch, unsigned mux_idx, unsigned stream_idx,
 {
     SchMux       *mux;
     SchMuxStream *ms;
+    SchCall     call;
+    int ret = 0;
 
     av_assert0(mux_idx < sch->nb_mux);
     mux = &sch->mux[mux_idx];
@@ -2241,18 +2462,22 @@ int sch_mux_sub_heartbeat(Scheduler *sch, unsigned mux_idx, unsigned stream_idx,
     av_assert0(stream_idx < mux->nb_streams);
     ms = &mux->streams[stream_idx];
 
+    call_enter(&mux->task, &call);
+
     for (unsigned i = 0; i < ms->nb_sub_heartbeat_dst; i++) {
         SchDec *dst = &sch->dec[ms->sub_heartbeat_dst[i]];
-        int ret;
 
         ret = av_packet_copy_props(mux->sub_heartbeat_pkt, pkt);
         if (ret < 0)
-            return ret;
+            break;
 
         tq_send(dst->queue, 0, mux->sub_heartbeat_pkt);
     }
 
-    return 0;
+    // heartbeats are not counted as output
+    call_leave(&mux->task, &call, 1, -1);
+
+    return ret;
 }
 
 static int mux_done(Scheduler *sch, unsigned mux_idx)
@@ -2285,6 +2510,7 @@ static int mux_done(Scheduler *sch, unsigned mux_idx)
 int sch_dec_receive(Scheduler *sch, unsigned dec_idx, AVPacket *pkt)
 {
     SchDec *dec;
+    SchCall call;
     int ret, dummy;
 
     av_assert0(dec_idx < sch->nb_dec);
@@ -2300,7 +2526,9 @@ int sch_dec_receive(Scheduler *sch, unsigned dec_idx, AVPacket *pkt)
         dec->expect_end_ts = 0;
     }
 
+    call_enter(&dec->task, &call);
     ret = tq_receive(dec->queue, &dummy, pkt);
+    call_leave(&dec->task, &call, 0, ret);
     av_assert0(dummy <= 0);
 
     // got a flush packet, on the next call to this function the decoder
@@ -2364,20 +2592,12 @@ finish:
     return AVERROR_EOF;
 }
 
-int sch_dec_send(Scheduler *sch, unsigned dec_idx,
-                 unsigned out_idx, AVFrame *frame)
+static int dec_send(Scheduler *sch, SchDec *dec, SchDecOutput *o,
+                    AVFrame *frame)
 {
-    SchDec *dec;
-    SchDecOutput *o;
     int ret;
     unsigned nb_done = 0;
 
-    av_assert0(dec_idx < sch->nb_dec);
-    dec = &sch->dec[dec_idx];
-
-    av_assert0(out_idx < dec->nb_outputs);
-    o = &dec->outputs[out_idx];
-
     for (unsigned i = 0; i < o->nb_dst; i++) {
         uint8_t *finished = &o->dst_finished[i];
         AVFrame *to_send  = frame;
@@ -2408,6 +2628,25 @@ int sch_dec_send(Scheduler *sch, unsigned dec_idx,
     return (nb_done == o->nb_dst) ? AVERROR_EOF : 0;
 }
 
+int sch_dec_send(Scheduler *sch, unsigned dec_idx,
+                 unsigned out_idx, AVFrame *frame)
+{
+    SchDec *dec;
+    SchCall call;
+    int ret;
+
+    av_assert0(dec_idx < sch->nb_dec);
+    dec = &sch->dec[dec_idx];
+
+    av_assert0(out_idx < dec->nb_outputs);
+
+    call_enter(&dec->task, &call);
+    ret = dec_send(sch, dec, &dec->outputs[out_idx], frame);
+    call_leave(&dec->task, &call, 1, ret);
+
+    return ret;
+}
+
 static int dec_done(Scheduler *sch, unsigned dec_idx)
 {
     SchDec *dec = &sch->dec[dec_idx];
@@ -2436,12 +2675,15 @@ static int dec_done(Scheduler *sch, unsigned dec_idx)
 int sch_enc_receive(Scheduler *sch, unsigned enc_idx, AVFrame *frame)
 {
     SchEnc *enc;
+    SchCall call;
     int ret, dummy;
 
     av_assert0(enc_idx < sch->nb_enc);
     enc = &sch->enc[enc_idx];
 
+    call_enter(&enc->task, &call);
     ret = tq_receive(enc->queue, &dummy, frame);
+    call_leave(&enc->task, &call, 0, ret);
     av_assert0(dummy <= 0);
 
     return ret;
@@ -2477,14 +2719,10 @@ finish:
     return AVERROR_EOF;
 }
 
-int sch_enc_send(Scheduler *sch, unsigned enc_idx, AVPacket *pkt)
+static int enc_send(Scheduler *sch, SchEnc *enc, AVPacket *pkt)
 {
-    SchEnc *enc;
     int ret;
 
-    av_assert0(enc_idx < sch->nb_enc);
-    enc = &sch->enc[enc_idx];
-
     for (unsigned i = 0; i < enc->nb_dst; i++) {
         uint8_t *finished = &enc->dst_finished[i];
         AVPacket *to_send = pkt;
@@ -2510,6 +2748,22 @@ int sch_enc_send(Scheduler *sch, unsigned enc_idx, AVPacket *pkt)
     return 0;
 }
 
+int sch_enc_send(Scheduler *sch, unsigned enc_idx, AVPacket *pkt)
+{
+    SchEnc *enc;
+    SchCall call;
+    int ret;
+
+    av_assert0(enc_idx < sch->nb_enc);
+    enc = &sch->enc[enc_idx];
+
+    call_enter(&enc->task, &call);
+    ret = enc_send(sch, enc, pkt);
+    call_leave(&enc->task, &call, 1, ret);
+
+    return ret;
+}
+
 static int enc_done(Scheduler *sch, unsigned enc_idx)
 {
     SchEnc *enc = &sch->enc[enc_idx];
@@ -2526,15 +2780,9 @@ static int enc_done(Scheduler *sch, unsigned enc_idx)
     return ret;
 }
 
-int sch_filter_receive(Scheduler *sch, unsigned fg_idx,
-                       unsigned *in_idx, AVFrame *frame)
+static int filter_receive(Scheduler *sch, SchFilterGraph *fg,
+                          unsigned *in_idx, AVFrame *frame)
 {
-    SchFilterGraph *fg;
-
-    av_assert0(fg_idx < sch->nb_filters);
-    fg = &sch->filters[fg_idx];
-
-    av_assert0(*in_idx <= fg->nb_inputs);
 
     // update scheduling to account for desired input stream, if it changed
     //
@@ -2570,6 +2818,25 @@ int sch_filter_receive(Scheduler *sch, unsigned fg_idx,
     }
 }
 
+int sch_filter_receive(Scheduler *sch, unsigned fg_idx,
+                       unsigned *in_idx, AVFrame *frame)
+{
+    SchFilterGraph *fg;
+    SchCall call;
+    int ret;
+
+    av_assert0(fg_idx < sch->nb_filters);
+    fg = &sch->filters[fg_idx];
+
+    av_assert0(*in_idx <= fg->nb_inputs);
+
+    call_enter(&fg->task, &call);
+    ret = filter_receive(sch, fg, in_idx, frame);
+    call_leave(&fg->task, &call, 0, ret);
+
+    return ret;
+}
+
 void sch_filter_receive_finish(Scheduler *sch, unsigned fg_idx, unsigned in_idx)
 {
     SchFilterGraph *fg;
@@ -2601,6 +2868,7 @@ int sch_filter_send(Scheduler *sch, unsigned fg_idx, unsigned out_idx, AVFrame *
 {
     SchFilterGraph *fg;
     SchedulerNode  dst;
+    SchCall       call;
     int ret;
 
     av_assert0(fg_idx < sch->nb_filters);
@@ -2609,6 +2877,8 @@ int sch_filter_send(Scheduler *sch, unsigned fg_idx, unsigned out_idx, AVFrame *
     av_assert0(out_idx < fg->nb_outputs);
     dst = fg->outputs[out_idx].dst;
 
+    call_enter(&fg->task, &call);
+
     if (dst.type == SCH_NODE_TYPE_ENC) {
         ret = send_to_enc(sch, &sch->enc[dst.idx], frame);
         if (ret == AVERROR_EOF)
@@ -2618,6 +2888,9 @@ int sch_filter_send(Scheduler *sch, unsigned fg_idx, unsigned out_idx, AVFrame *
         if (ret == AVERROR_EOF)
             send_to_filter(sch, &sch->filters[dst.idx], dst.idx_stream, NULL);
     }
+
+    call_leave(&fg->task, &call, 1, frame ? ret : -1);
+
     return ret;
 }
 
@@ -2691,11 +2964,15 @@ static void *task_wrapper(void *arg)
     int ret;
     int err = 0;
 
+    atomic_store(&task->stats.time_start, av_gettime_relative());
+
     ret = task->func(task->func_arg);
     if (ret < 0)
         av_log(task->func_arg, AV_LOG_ERROR,
                "Task finished with error code: %d (%s)\n", ret, av_err2str(ret));
 
+    atomic_store(&task->stats.time_end, av_gettime_relative());
+
     err = task_cleanup(sch, task->node);
     ret = err_merge(ret, err);
 
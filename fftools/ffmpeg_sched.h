@@ -149,6 +149,82 @@ int sch_stop(Scheduler *sch, int64_t *finish_ts);
  */
 int sch_wait(Scheduler *sch, uint64_t timeout_us, int64_t *transcode_ts);
 
+/**
+ * Limit the amount of memory used by data (packets and frames) waiting in the
+ * scheduler's queues, measured in bytes of the referenced buffers.
+ *
+ * When the total budget is exceeded, sources (demuxers and the decoders they
+ * feed, as well as filtergraphs without inputs) are choked, except for those
+ * feeding the output streams that are furthest behind, until the queued data
+ * is drained below the budget. The per-queue budget makes senders block on an
+ * individual queue holding too much data, in addition to its limit on the
+ * number of items.
+ *
+ * Both budgets are soft limits; a single item is always allowed through, no
+ * matter its size.
+ *
+ * Must be called before sch_start().
+ *
+ * @param total maximum size of all queued data; 0 means no limit
+ * @param per_queue maximum size of the data in any single queue; 0 means no
+ *                  limit
+ */
+void sch_set_mem_budget(Scheduler *sch, size_t total, size_t per_queue);
+
+/**
+ * Measure how long tasks spend blocked in the scheduler, reported as
+ * time_wait_in/time_wait_out by sch_get_stats(). This reads the clock twice
+ * per transferred item, so it is off by default.
+ *
+ * Must be called before sch_start().
+ */
+void sch_enable_wait_timing(Scheduler *sch);
+
+typedef struct SchedulerNodeStats {
+    /**
+     * The context that was passed to sch_add_*() when creating the node.
+     */
+    const void *opaque;
+
+    /**
+     * Number of packets/frames received from upstream and sent downstream.
+     */
+    uint64_t    nb_in;
+    uint64_t    nb_out;
+
+    /**
+     * Time in microseconds the node's task has been running, and how much of
+     * that it spent blocked waiting for input and for its outputs (or the
+     * choking logic) to accept more data. The rest is spent doing actual work.
+     * The wait times are only measured after sch_enable_wait_timing().
+     */
+    int64_t     time_total;
+    int64_t     time_wait_in;
+    int64_t     time_wait_out;
+
+    /**
+     * Input queue capacity and the maximum number of items that have been
+     * queued at once; 0 for nodes without an input queue (demuxers).
+     */
+    size_t      queue_size;
+    size_t      queue_max;
+} SchedulerNodeStats;
+
+/**
+ * Retrieve statistics for a node. May be called from any thread while
+ * transcoding is running.
+ *
+ * @param type one of SCH_NODE_TYPE_DEMUX, SCH_NODE_TYPE_DEC,
+ *             SCH_NODE_TYPE_FILTER_IN, SCH_NODE_TYPE_ENC, SCH_NODE_TYPE_MUX
+ * @param idx  index of the node among nodes of the given type
+ *
+ * @retval 0 success
+ * @retval AVERROR(ENOENT) there is no such node; may be used to enumerate
+ *         all nodes of a type
+ */
+int sch_get_stats(Scheduler *sch, enum SchedulerNodeType type, unsigned idx,
+                  SchedulerNodeStats *stats);
+
 /**
  * Add a demuxer to the scheduler.
  *
@@ -23,6 +23,8 @@
  * output writers for filtergraph details
  */
 
+#include <errno.h>
+#include <stdio.h>
 #include <string.h>
 #include <stdatomic.h>
 
@@ -30,6 +32,7 @@
 
 #include "fftools/ffmpeg.h"
 #include "fftools/ffmpeg_mux.h"
+#include "fftools/ffmpeg_sched.h"
 
 #include "libavutil/avassert.h"
 #include "libavutil/avstring.h"
@@ -119,6 +122,18 @@ static const AVTextFormatSection sections[] = {
     [SECTION_ID_ENCODER]         = { SECTION_ID_ENCODER, "encoder", AV_TEXTFORMAT_SECTION_FLAG_IS_SHAPE | AV_TEXTFORMAT_SECTION_PRINT_TAGS | AV_TEXTFORMAT_SECTION_FLAG_HAS_LINKS, { -1 }, .id_key = "id", .src_id_key = "id", .dest_id_key = "dest_id" },
 };
 
+typedef enum {
+    SECTION_ID_SCHED_ROOT,
+    SECTION_ID_SCHED_NODES,
+    SECTION_ID_SCHED_NODE,
+} SchedSectionID;
+
+static const AVTextFormatSection sched_sections[] = {
+    [SECTION_ID_SCHED_ROOT]  = { SECTION_ID_SCHED_ROOT, "root", AV_TEXTFORMAT_SECTION_FLAG_IS_WRAPPER, { SECTION_ID_SCHED_NODES, -1 } },
+    [SECTION_ID_SCHED_NODES] = { SECTION_ID_SCHED_NODES, "scheduler_nodes", AV_TEXTFORMAT_SECTION_FLAG_IS_ARRAY, { SECTION_ID_SCHED_NODE, -1 } },
+    [SECTION_ID_SCHED_NODE]  = { SECTION_ID_SCHED_NODE, "scheduler_node", 0, { -1 } },
+};
+
 typedef struct GraphPrintContext {
     AVTextFormatContext *tfc;
     AVTextWriterContext *wctx;
@@ -974,6 +989,7 @@ int print_filtergraph(FilterGraph *fg, AVFilterGraph *graph)
     av_bprint_clear(target_buf);
 
     print_filtergraph_single(gpc, fg, graph);
+    atomic_store(&fg->graph_print_id, gpc->id_prefix_num);
 
     if (gpc->is_diagram) {
         avtext_print_section_footer(tfc); // SECTION_ID_FILTERGRAPH
@@ -1070,6 +1086,166 @@ cleanup:
     return ret;
 }
 
+static void print_sched_node(AVTextFormatContext *tfc, AVBPrint *buf, const char *type,
+                             const SchedulerNodeStats *st)
+{
+    const AVClass *class = *(const AVClass * const *)st->opaque;
+    int64_t busy = st->time_total - st->time_wait_in - st->time_wait_out;
+
+    avtext_print_section_header(tfc, NULL, SECTION_ID_SCHED_NODE);
+
+    print_str("type", type);
+    print_str("id", buf->str);
+    if (class && class->item_name)
+        print_str("name", class->item_name((void *)st->opaque));
+
+    print_int("nb_in",             st->nb_in);
+    print_int("nb_out",            st->nb_out);
+    print_int("time_total_us",     st->time_total);
+    print_int("time_busy_us",      FFMAX(busy, 0));
+    print_int("time_wait_in_us",   st->time_wait_in);
+    print_int("time_wait_out_us",  st->time_wait_out);
+
+    if (st->queue_size) {
+        print_int("queue_size",   st->queue_size);
+        print_int("queue_max",    st->queue_max);
+    }
+
+    avtext_print_section_footer(tfc); // SECTION_ID_SCHED_NODE
+}
+
+static int print_sched_stats_priv(AVTextFormatContext *tfc, Scheduler *sch,
+                                  InputFile **ifiles, int nb_ifiles)
+{
+    SchedulerNodeStats st;
+    AVBPrint buf;
+
+    av_bprint_init(&buf, 0, AV_BPRINT_SIZE_UNLIMITED);
+
+    avtext_print_section_header(tfc, NULL, SECTION_ID_SCHED_ROOT);
+    avtext_print_section_header(tfc, NULL, SECTION_ID_SCHED_NODES);
+
+    // the ids are the same as those used for the corresponding sections by
+    // print_streams(), so the statistics can be matched to the graph output
+    for (unsigned i = 0; sch_get_stats(sch, SCH_NODE_TYPE_DEMUX, i, &st) >= 0; i++) {
+        const InputFile *ifile = st.opaque;
+
+        av_bprint_clear(&buf);
+        av_bprintf(&buf, "Input_%d", ifile->index);
+        print_sched_node(tfc, &buf, "demuxer", &st);
+    }
+
+    for (unsigned i = 0; sch_get_stats(sch, SCH_NODE_TYPE_DEC, i, &st) >= 0; i++) {
+        av_bprint_clear(&buf);
+
+        for (int n = 0; n < nb_ifiles && !buf.len; n++)
+            for (int j = 0; j < ifiles[n]->nb_streams; j++)
+                if (ifiles[n]->streams[j]->decoder == st.opaque) {
+                    av_bprintf(&buf, "in_%d_%d", n, j);
+                    break;
+                }
+        // standalone decoders are not associated with any input stream
+        if (!buf.len)
+            av_bprintf(&buf, "dec_%u", i);
+
+        print_sched_node(tfc, &buf, "decoder", &st);
+    }
+
+    for (unsigned i = 0; sch_get_stats(sch, SCH_NODE_TYPE_FILTER_IN, i, &st) >= 0; i++) {
+        const FilterGraph *fg = st.opaque;
+        int print_id          = atomic_load(&fg->graph_print_id);
+
+        av_bprint_clear(&buf);
+        // use the id of the graph's -print_graphs section when there is one;
+        // otherwise simple filtergraphs all have index -1, so name them
+        if (print_id >= 0)
+            av_bprintf(&buf, "Graph_%d_%d", print_id, fg->index);
+        else if (fg->index >= 0)
+            av_bprintf(&buf, "Graph_%d", fg->index);
+        else
+            av_bprintf(&buf, "Graph_%s", fg->class->item_name((void *)fg));
+        print_sched_node(tfc, &buf, "filtergraph", &st);
+    }
+
+    for (unsigned i = 0; sch_get_stats(sch, SCH_NODE_TYPE_ENC, i, &st) >= 0; i++) {
+        const OutputStream *ost = st.opaque;
+
+        av_bprint_clear(&buf);
+        av_bprintf(&buf, "out__%d_%d", ost->file->index, ost->index);
+        print_sched_node(tfc, &buf, "encoder", &st);
+    }
+
+    for (unsigned i = 0; sch_get_stats(sch, SCH_NODE_TYPE_MUX, i, &st) >= 0; i++) {
+        const OutputFile *of = st.opaque;
+
+        av_bprint_clear(&buf);
+        av_bprintf(&buf, "Output_%d", of->index);
+        print_sched_node(tfc, &buf, "muxer", &st);
+    }
+
+    avtext_print_section_footer(tfc); // SECTION_ID_SCHED_NODES
+    avtext_print_section_footer(tfc); // SECTION_ID_SCHED_ROOT
+
+    av_bprint_finalize(&buf, NULL);
+
+    return 0;
+}
+
+int print_sched_stats(Scheduler *sch, InputFile **ifiles, int nb_ifiles)
+{
+    AVTextFormatContext *tfc = NULL;
+    AVTextWriterContext *wctx = NULL;
+    AVTextFormatOptions tf_options = { .show_optional_fields = -1 };
+    char *tmp_file = NULL;
+    int ret;
+
+    if (!strcmp(sched_stats_file, "-"))
+        ret = avtextwriter_create_stdout(&wctx);
+    else {
+        /* The file is rewritten periodically, so write the new contents next
+         * to it and rename over it; readers never see a partial file. */
+        tmp_file = av_asprintf("%s.tmp", sched_stats_file);
+        if (!tmp_file)
+            return AVERROR(ENOMEM);
+        ret = avtextwriter_create_file(&wctx, tmp_file);
+    }
+    if (ret < 0) {
+        av_log(NULL, AV_LOG_ERROR, "Failed to open scheduler statistics file, \"%s\": %s\n",
+               tmp_file ? tmp_file : sched_stats_file, av_err2str(ret));
+        goto fail;
+    }
+
+    ret = avtext_context_open(&tfc, avtext_get_formatter_by_name("json"), wctx, NULL,
+                              sched_sections, FF_ARRAY_ELEMS(sched_sections), tf_options, NULL);
+    if (ret < 0) {
+        avtextwriter_context_close(&wctx);
+        goto fail;
+    }
+
+    ret = print_sched_stats_priv(tfc, sch, ifiles, nb_ifiles);
+
+    avtext_context_close(&tfc);
+    avtextwriter_context_close(&wctx);
+
+    if (tmp_file && ret >= 0) {
+#ifdef _WIN32
+        /* rename() does not replace an existing file on Windows */
+        remove(sched_stats_file);
+#endif
+        if (rename(tmp_file, sched_stats_file) < 0) {
+            ret = AVERROR(errno);
+            av_log(NULL, AV_LOG_ERROR, "Failed to rename \"%s\" to \"%s\": %s\n",
+                   tmp_file, sched_stats_file, av_err2str(ret));
+        }
+    }
+
+fail:
+    if (tmp_file && ret < 0)
+        remove(tmp_file);
+    av_free(tmp_file);
+    return ret;
+}
+
 int print_filtergraphs(FilterGraph **graphs, int nb_graphs, InputFile **ifiles, int nb_ifiles, OutputFile **ofiles, int nb_ofiles)
 {
     int ret = print_filtergraphs_priv(graphs, nb_graphs, ifiles, nb_ifiles, ofiles, nb_ofiles);
@@ -27,4 +27,10 @@ int print_filtergraphs(FilterGraph **graphs, int nb_graphs, InputFile **ifiles,
 
 int print_filtergraph(FilterGraph *fg, AVFilterGraph *graph);
 
+/**
+ * Write per-node scheduler statistics (see sch_get_stats()) as JSON to
+ * sched_stats_file, replacing its previous contents.
+ */
+int print_sched_stats(Scheduler *sch, InputFile **ifiles, int nb_ifiles);
+
 #endif /* FFTOOLS_GRAPH_GRAPHPRINT_H */
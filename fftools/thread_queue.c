@@ -16,15 +16,15 @@
  * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
  */
 
+#include <stdatomic.h>
 #include <stdint.h>
-#include <string.h>
 
 #include "libavutil/avassert.h"
 #include "libavutil/container_fifo.h"
 #include "libavutil/error.h"
 #include "libavutil/fifo.h"
 #include "libavutil/frame.h"
-#include "libavutil/intreadwrite.h"
+#include "libavutil/macros.h"
 #include "libavutil/mem.h"
 #include "libavutil/thread.h"
 
@@ -37,20 +37,121 @@ enum {
     FINISHED_RECV = (1 << 1),
 };
 
+/**
+ * A slot in the lock-free ring. seq is the ring position for which the slot
+ * may be written next, or that position + 1 after it has been written and
+ * may be read.
+ */
+typedef struct RingSlot {
+    atomic_uint_least64_t seq;
+    unsigned              stream_idx;
+    void                 *obj;
+} RingSlot;
+
 struct ThreadQueue {
-    int             choked;
-    int              *finished;
+    atomic_int      choked;
+    atomic_int     *finished;
     unsigned int    nb_streams;
 
     enum ThreadQueueType type;
 
+    // mutex-protected FIFO, used with THREAD_QUEUE_FLAG_LOCKED
     AVContainerFifo *fifo;
     AVFifo          *fifo_stream_index;
 
+    // bounded lock-free multi-producer ring, used otherwise
+    RingSlot             *ring;
+    size_t             nb_ring;
+    atomic_uint_least64_t write_pos;
+    atomic_uint_least64_t read_pos;
+    // number of threads sleeping on cond, only used with the ring;
+    // the lock is only taken when a thread needs to sleep or wake others
+    atomic_uint           nb_waiters;
+    // per-stream number of items reserved or published in the ring and not
+    // yet popped; EOF is only reported for a stream once this drops to zero,
+    // so that an item still being written can not be overtaken by its EOF
+    atomic_size_t        *nb_pending;
+
+    // largest number of items seen queued after a send
+    atomic_size_t         max_queued;
+
+    // size of the data referenced by the queued items and its limit
+    atomic_size_t         bytes_queued;
+    size_t                max_bytes;
+    // optional counter shared with other queues, see tq_set_total_bytes()
+    atomic_size_t        *total_bytes;
+
     pthread_mutex_t lock;
     pthread_cond_t  cond;
 };
 
+static void obj_free(const ThreadQueue *tq, void **obj)
+{
+    if (tq->type == THREAD_QUEUE_FRAMES)
+        av_frame_free((AVFrame**)obj);
+    else
+        av_packet_free((AVPacket**)obj);
+}
+
+static void obj_move(const ThreadQueue *tq, void *dst, void *src)
+{
+    if (tq->type == THREAD_QUEUE_FRAMES)
+        av_frame_move_ref(dst, src);
+    else
+        av_packet_move_ref(dst, src);
+}
+
+static void obj_unref(const ThreadQueue *tq, void *obj)
+{
+    if (tq->type == THREAD_QUEUE_FRAMES)
+        av_frame_unref(obj);
+    else
+        av_packet_unref(obj);
+}
+
+static size_t obj_size(const ThreadQueue *tq, const void *obj)
+{
+    size_t size = 0;
+
+    if (tq->type == THREAD_QUEUE_FRAMES) {
+        const AVFrame *frame = obj;
+
+        for (int i = 0; i < FF_ARRAY_ELEMS(frame->buf) && frame->buf[i]; i++)
+            size += frame->buf[i]->size;
+        for (int i = 0; i < frame->nb_extended_buf; i++)
+            size += frame->extended_buf[i]->size;
+    } else {
+        const AVPacket *pkt = obj;
+
+        size = pkt->buf ? pkt->buf->size : pkt->size;
+    }
+
+    return size;
+}
+
+static void bytes_add(ThreadQueue *tq, size_t size)
+{
+    atomic_fetch_add(&tq->bytes_queued, size);
+    if (tq->total_bytes)
+        atomic_fetch_add(tq->total_bytes, size);
+}
+
+static void bytes_sub(ThreadQueue *tq, size_t size)
+{
+    atomic_fetch_sub(&tq->bytes_queued, size);
+    if (tq->total_bytes)
+        atomic_fetch_sub(tq->total_bytes, size);
+}
+
+/**
+ * @return 1 if another item may be sent without exceeding the byte limit
+ */
+static int bytes_can_write(ThreadQueue *tq, int empty)
+{
+    return !tq->max_bytes || empty ||
+           atomic_load(&tq->bytes_queued) < tq->max_bytes;
+}
+
 void tq_free(ThreadQueue **ptq)
 {
     ThreadQueue *tq = *ptq;
@@ -61,6 +162,11 @@ void tq_free(ThreadQueue **ptq)
     av_container_fifo_free(&tq->fifo);
     av_fifo_freep2(&tq->fifo_stream_index);
 
+    for (size_t i = 0; tq->ring && i < tq->nb_ring; i++)
+        obj_free(tq, &tq->ring[i].obj);
+    av_freep(&tq->ring);
+    av_freep(&tq->nb_pending);
+
     av_freep(&tq->finished);
 
     pthread_cond_destroy(&tq->cond);
@@ -70,7 +176,7 @@ void tq_free(ThreadQueue **ptq)
 }
 
 ThreadQueue *tq_alloc(unsigned int nb_streams, size_t queue_size,
-                      enum ThreadQueueType type)
+                      enum ThreadQueueType type, unsigned flags)
 {
     ThreadQueue *tq;
     int ret;
@@ -95,18 +201,50 @@ ThreadQueue *tq_alloc(unsigned int nb_streams, size_t queue_size,
     tq->finished = av_calloc(nb_streams, sizeof(*tq->finished));
     if (!tq->finished)
         goto fail;
+    for (unsigned int i = 0; i < nb_streams; i++)
+        atomic_init(&tq->finished[i], 0);
     tq->nb_streams = nb_streams;
 
     tq->type = type;
 
-    tq->fifo = (type == THREAD_QUEUE_FRAMES) ?
-               av_container_fifo_alloc_avframe(0) : av_container_fifo_alloc_avpacket(0);
-    if (!tq->fifo)
-        goto fail;
+    atomic_init(&tq->choked,     0);
+    atomic_init(&tq->write_pos,  0);
+    atomic_init(&tq->read_pos,   0);
+    atomic_init(&tq->nb_waiters, 0);
+    atomic_init(&tq->max_queued, 0);
+    atomic_init(&tq->bytes_queued, 0);
+
+    if (flags & THREAD_QUEUE_FLAG_LOCKED) {
+        tq->fifo = (type == THREAD_QUEUE_FRAMES) ?
+                   av_container_fifo_alloc_avframe(0) : av_container_fifo_alloc_avpacket(0);
+        if (!tq->fifo)
+            goto fail;
+
+        tq->fifo_stream_index = av_fifo_alloc2(queue_size, sizeof(unsigned), 0);
+        if (!tq->fifo_stream_index)
+            goto fail;
 
-    tq->fifo_stream_index = av_fifo_alloc2(queue_size, sizeof(unsigned), 0);
-    if (!tq->fifo_stream_index)
+        return tq;
+    }
+
+    tq->ring       = av_calloc(queue_size, sizeof(*tq->ring));
+    tq->nb_pending = av_calloc(nb_streams, sizeof(*tq->nb_pending));
+    if (!tq->ring || !tq->nb_pending)
         goto fail;
+    tq->nb_ring = queue_size;
+
+    for (unsigned int i = 0; i < nb_streams; i++)
+        atomic_init(&tq->nb_pending[i], 0);
+
+    for (size_t i = 0; i < queue_size; i++) {
+        RingSlot *slot = &tq->ring[i];
+
+        atomic_init(&slot->seq, i);
+        slot->obj = (type == THREAD_QUEUE_FRAMES) ?
+                    (void*)av_frame_alloc() : (void*)av_packet_alloc();
+        if (!slot->obj)
+            goto fail;
+    }
 
     return tq;
 fail:
@@ -114,28 +252,202 @@ fail:
     return NULL;
 }
 
-int tq_send(ThreadQueue *tq, unsigned int stream_idx, void *data)
+static void update_max_queued(ThreadQueue *tq, size_t queued)
 {
-    int *finished;
-    int ret;
+    size_t max = atomic_load_explicit(&tq->max_queued, memory_order_relaxed);
 
-    av_assert0(stream_idx < tq->nb_streams);
-    finished = &tq->finished[stream_idx];
+    while (queued > max &&
+           !atomic_compare_exchange_weak_explicit(&tq->max_queued, &max, queued,
+                                                  memory_order_relaxed,
+                                                  memory_order_relaxed))
+        ;
+}
+
+/**
+ * Wake up all threads sleeping in wait_ring(). Must be called after every
+ * change of the queue state that a sleeping thread might be waiting for.
+ */
+static void wake_ring(ThreadQueue *tq)
+{
+    // pairs with the fence in wait_ring(): either the waiter sees our state
+    // change, or we see it registered as a waiter
+    atomic_thread_fence(memory_order_seq_cst);
+
+    if (!atomic_load_explicit(&tq->nb_waiters, memory_order_relaxed))
+        return;
+
+    pthread_mutex_lock(&tq->lock);
+    pthread_cond_broadcast(&tq->cond);
+    pthread_mutex_unlock(&tq->lock);
+}
+
+static void wait_ring(ThreadQueue *tq, int (*ready)(ThreadQueue *tq, unsigned idx),
+                      unsigned idx)
+{
+    pthread_mutex_lock(&tq->lock);
+
+    atomic_fetch_add(&tq->nb_waiters, 1);
+    atomic_thread_fence(memory_order_seq_cst);
+
+    while (!ready(tq, idx))
+        pthread_cond_wait(&tq->cond, &tq->lock);
+
+    atomic_fetch_sub(&tq->nb_waiters, 1);
+
+    pthread_mutex_unlock(&tq->lock);
+}
+
+static int ring_push(ThreadQueue *tq, unsigned int stream_idx, void *data)
+{
+    uint64_t pos = atomic_load_explicit(&tq->write_pos, memory_order_relaxed);
+    RingSlot *slot;
+
+    while (1) {
+        uint64_t seq;
+
+        slot = &tq->ring[pos % tq->nb_ring];
+        seq  = atomic_load_explicit(&slot->seq, memory_order_acquire);
+
+        if (seq == pos) {
+            if (atomic_compare_exchange_weak_explicit(&tq->write_pos, &pos, pos + 1,
+                                                      memory_order_relaxed,
+                                                      memory_order_relaxed))
+                break;
+        } else if (seq < pos) {
+            // the slot still holds an item from the previous lap - full
+            return AVERROR(EAGAIN);
+        } else
+            pos = atomic_load_explicit(&tq->write_pos, memory_order_relaxed);
+    }
+
+    slot->stream_idx = stream_idx;
+    obj_move(tq, slot->obj, data);
+
+    atomic_store_explicit(&slot->seq, pos + 1, memory_order_release);
+
+    return 0;
+}
+
+static int ring_pop(ThreadQueue *tq, unsigned int *stream_idx, void *data)
+{
+    uint64_t pos = atomic_load_explicit(&tq->read_pos, memory_order_relaxed);
+    RingSlot *slot;
+
+    while (1) {
+        uint64_t seq;
+
+        slot = &tq->ring[pos % tq->nb_ring];
+        seq  = atomic_load_explicit(&slot->seq, memory_order_acquire);
+
+        if (seq == pos + 1) {
+            if (atomic_compare_exchange_weak_explicit(&tq->read_pos, &pos, pos + 1,
+                                                      memory_order_relaxed,
+                                                      memory_order_relaxed))
+                break;
+        } else if (seq <= pos) {
+            // the slot has not been written yet - empty
+            return AVERROR(EAGAIN);
+        } else
+            pos = atomic_load_explicit(&tq->read_pos, memory_order_relaxed);
+    }
+
+    *stream_idx = slot->stream_idx;
+    obj_move(tq, data, slot->obj);
+
+    atomic_store_explicit(&slot->seq, pos + tq->nb_ring, memory_order_release);
+
+    return 0;
+}
+
+static int ring_can_write(ThreadQueue *tq)
+{
+    uint64_t pos = atomic_load(&tq->write_pos);
+    return atomic_load(&tq->ring[pos % tq->nb_ring].seq) >= pos;
+}
+
+static int ring_can_read(ThreadQueue *tq)
+{
+    uint64_t pos = atomic_load(&tq->read_pos);
+    return atomic_load(&tq->ring[pos % tq->nb_ring].seq) > pos;
+}
+
+static int ring_bytes_can_write(ThreadQueue *tq)
+{
+    return bytes_can_write(tq, atomic_load(&tq->write_pos) ==
+                               atomic_load(&tq->read_pos));
+}
+
+static int send_ready(ThreadQueue *tq, unsigned stream_idx)
+{
+    return (atomic_load(&tq->finished[stream_idx]) & FINISHED_RECV) ||
+           (ring_can_write(tq) && ring_bytes_can_write(tq));
+}
+
+static int send_ring(ThreadQueue *tq, unsigned int stream_idx, void *data)
+{
+    atomic_int *finished = &tq->finished[stream_idx];
+
+    if (atomic_load(finished) & FINISHED_SEND)
+        return AVERROR(EINVAL);
+
+    while (1) {
+        size_t size;
+        int ret;
+
+        if (atomic_load(finished) & FINISHED_RECV) {
+            atomic_fetch_or(finished, FINISHED_SEND);
+            return AVERROR_EOF;
+        }
+
+        if (!ring_bytes_can_write(tq)) {
+            wait_ring(tq, send_ready, stream_idx);
+            continue;
+        }
+
+        // account for the data before it becomes visible to the receiver,
+        // which subtracts it again
+        size = obj_size(tq, data);
+        bytes_add(tq, size);
+        atomic_fetch_add(&tq->nb_pending[stream_idx], 1);
+
+        ret = ring_push(tq, stream_idx, data);
+        if (ret >= 0) {
+            wake_ring(tq);
+            update_max_queued(tq, atomic_load(&tq->write_pos) -
+                                  atomic_load(&tq->read_pos));
+            return 0;
+        }
+
+        atomic_fetch_sub(&tq->nb_pending[stream_idx], 1);
+        bytes_sub(tq, size);
+
+        wait_ring(tq, send_ready, stream_idx);
+    }
+}
+
+static int send_locked(ThreadQueue *tq, unsigned int stream_idx, void *data)
+{
+    atomic_int *finished = &tq->finished[stream_idx];
+    int ret;
 
     pthread_mutex_lock(&tq->lock);
 
-    if (*finished & FINISHED_SEND) {
+    if (atomic_load(finished) & FINISHED_SEND) {
         ret = AVERROR(EINVAL);
         goto finish;
     }
 
-    while (!(*finished & FINISHED_RECV) && !av_fifo_can_write(tq->fifo_stream_index))
+    while (!(atomic_load(finished) & FINISHED_RECV) &&
+           (!av_fifo_can_write(tq->fifo_stream_index) ||
+            !bytes_can_write(tq, !av_fifo_can_read(tq->fifo_stream_index))))
         pthread_cond_wait(&tq->cond, &tq->lock);
 
-    if (*finished & FINISHED_RECV) {
+    if (atomic_load(finished) & FINISHED_RECV) {
         ret = AVERROR_EOF;
-        *finished |= FINISHED_SEND;
+        atomic_fetch_or(finished, FINISHED_SEND);
     } else {
+        size_t size = obj_size(tq, data);
+
         ret = av_fifo_write(tq->fifo_stream_index, &stream_idx, 1);
         if (ret < 0)
             goto finish;
@@ -144,6 +456,10 @@ int tq_send(ThreadQueue *tq, unsigned int stream_idx, void *data)
         if (ret < 0)
             goto finish;
 
+        bytes_add(tq, size);
+
+        update_max_queued(tq, av_fifo_can_read(tq->fifo_stream_index));
+
         pthread_cond_broadcast(&tq->cond);
     }
 
@@ -153,12 +469,122 @@ finish:
     return ret;
 }
 
-static int receive_locked(ThreadQueue *tq, int *stream_idx,
-                          void *data)
+int tq_send(ThreadQueue *tq, unsigned int stream_idx, void *data)
+{
+    av_assert0(stream_idx < tq->nb_streams);
+
+    return tq->ring ? send_ring  (tq, stream_idx, data) :
+                      send_locked(tq, stream_idx, data);
+}
+
+/**
+ * @return 1 if all items sent on the stream have been received
+ */
+static int stream_drained(ThreadQueue *tq, unsigned int stream_idx)
+{
+    return !tq->nb_pending || !atomic_load(&tq->nb_pending[stream_idx]);
+}
+
+/**
+ * Return EOF for the first stream that was finished by the sender, but not yet
+ * by the receiver, and has no items left in the queue.
+ *
+ * @return AVERROR_EOF with *stream_idx set, AVERROR_EOF with *stream_idx
+ *         untouched if all streams are finished, AVERROR(EAGAIN) otherwise
+ */
+static int receive_eof(ThreadQueue *tq, int *stream_idx)
 {
     unsigned int nb_finished = 0;
 
-    if (tq->choked)
+    for (unsigned int i = 0; i < tq->nb_streams; i++) {
+        int finished = atomic_load(&tq->finished[i]);
+
+        if (!finished)
+            continue;
+
+        /* return EOF to the consumer at most once for each stream */
+        if (!(finished & FINISHED_RECV)) {
+            if (!stream_drained(tq, i))
+                continue;
+            atomic_fetch_or(&tq->finished[i], FINISHED_RECV);
+            *stream_idx   = i;
+            return AVERROR_EOF;
+        }
+
+        nb_finished++;
+    }
+
+    return nb_finished == tq->nb_streams ? AVERROR_EOF : AVERROR(EAGAIN);
+}
+
+static int receive_ready(ThreadQueue *tq, unsigned dummy)
+{
+    unsigned int nb_finished = 0;
+
+    if (atomic_load(&tq->choked))
+        return 0;
+
+    if (ring_can_read(tq))
+        return 1;
+
+    for (unsigned int i = 0; i < tq->nb_streams; i++) {
+        int finished = atomic_load(&tq->finished[i]);
+
+        if (finished && !(finished & FINISHED_RECV) && stream_drained(tq, i))
+            return 1;
+        nb_finished += finished && stream_drained(tq, i);
+    }
+
+    return nb_finished == tq->nb_streams;
+}
+
+static int receive_ring(ThreadQueue *tq, int *stream_idx, void *data)
+{
+    while (1) {
+        int ret;
+
+        if (!atomic_load(&tq->choked)) {
+            int eof_pending = 0;
+
+            // the sender sets FINISHED_SEND after pushing its last item, so
+            // items must be checked for again once an EOF is seen
+            for (int retry = 0; retry < 2; retry++) {
+                unsigned idx;
+
+                while (ring_pop(tq, &idx, data) >= 0) {
+                    bytes_sub(tq, obj_size(tq, data));
+                    atomic_fetch_sub(&tq->nb_pending[idx], 1);
+                    wake_ring(tq);
+
+                    if (atomic_load(&tq->finished[idx]) & FINISHED_RECV) {
+                        obj_unref(tq, data);
+                        continue;
+                    }
+
+                    *stream_idx = idx;
+                    return 0;
+                }
+
+                if (retry || !receive_ready(tq, 0))
+                    break;
+                eof_pending = 1;
+            }
+
+            if (eof_pending) {
+                ret = receive_eof(tq, stream_idx);
+                if (ret != AVERROR(EAGAIN))
+                    return ret;
+            }
+        }
+
+        wait_ring(tq, receive_ready, 0);
+    }
+}
+
+static int receive_locked(ThreadQueue *tq, int *stream_idx,
+                          void *data)
+{
+    if (atomic_load(&tq->choked))
         return AVERROR(EAGAIN);
 
     while (av_container_fifo_read(tq->fifo, data, 0) >= 0) {
@@ -167,9 +593,10 @@ static int receive_locked(ThreadQueue *tq, int *stream_idx,
 
         ret = av_fifo_read(tq->fifo_stream_index, &idx, 1);
         av_assert0(ret >= 0);
-        if (tq->finished[idx] & FINISHED_RECV) {
-            (tq->type == THREAD_QUEUE_FRAMES) ?
-            av_frame_unref(data) : av_packet_unref(data);
+
+        bytes_sub(tq, obj_size(tq, data));
+        if (atomic_load(&tq->finished[idx]) & FINISHED_RECV) {
+            obj_unref(tq, data);
             continue;
         }
 
@@ -177,21 +604,7 @@ static int receive_locked(ThreadQueue *tq, int *stream_idx,
         return 0;
     }
 
-    for (unsigned int i = 0; i < tq->nb_streams; i++) {
-        if (!tq->finished[i])
-            continue;
-
-        /* return EOF to the consumer at most once for each stream */
-        if (!(tq->finished[i] & FINISHED_RECV)) {
-            tq->finished[i] |= FINISHED_RECV;
-            *stream_idx   = i;
-            return AVERROR_EOF;
-        }
-
-        nb_finished++;
-    }
-
-    return nb_finished == tq->nb_streams ? AVERROR_EOF : AVERROR(EAGAIN);
+    return receive_eof(tq, stream_idx);
 }
 
 int tq_receive(ThreadQueue *tq, int *stream_idx, void *data)
@@ -200,6 +613,9 @@ int tq_receive(ThreadQueue *tq, int *stream_idx, void *data)
 
     *stream_idx = -1;
 
+    if (tq->ring)
+        return receive_ring(tq, stream_idx, data);
+
     pthread_mutex_lock(&tq->lock);
 
     while (1) {
@@ -233,8 +649,8 @@ void tq_send_finish(ThreadQueue *tq, unsigned int stream_idx)
     /* mark the stream as send-finished;
      * next time the consumer thread tries to read this stream it will get
      * an EOF and recv-finished flag will be set */
-    tq->finished[stream_idx] |= FINISHED_SEND;
-    tq->choked = 0;
+    atomic_fetch_or(&tq->finished[stream_idx], FINISHED_SEND);
+    atomic_store(&tq->choked, 0);
     pthread_cond_broadcast(&tq->cond);
 
     pthread_mutex_unlock(&tq->lock);
@@ -249,7 +665,7 @@ void tq_receive_finish(ThreadQueue *tq, unsigned int stream_idx)
     /* mark the stream as recv-finished;
      * next time the producer thread tries to send for this stream, it will
      * get an EOF and send-finished flag will be set */
-    tq->finished[stream_idx] |= FINISHED_RECV;
+    atomic_fetch_or(&tq->finished[stream_idx], FINISHED_RECV);
     pthread_cond_broadcast(&tq->cond);
 
     pthread_mutex_unlock(&tq->lock);
@@ -259,10 +675,29 @@ void tq_choke(ThreadQueue *tq, int choked)
 {
     pthread_mutex_lock(&tq->lock);
 
-    int prev_choked = tq->choked;
-    tq->choked = choked;
+    int prev_choked = atomic_exchange(&tq->choked, choked);
     if (choked != prev_choked)
         pthread_cond_broadcast(&tq->cond);
 
     pthread_mutex_unlock(&tq->lock);
 }
+
+void tq_set_max_bytes(ThreadQueue *tq, size_t max_bytes)
+{
+    tq->max_bytes = max_bytes;
+}
+
+void tq_set_total_bytes(ThreadQueue *tq, atomic_size_t *total_bytes)
+{
+    tq->total_bytes = total_bytes;
+}
+
+size_t tq_max_queued(ThreadQueue *tq)
+{
+    return atomic_load(&tq->max_queued);
+}
+
+size_t tq_bytes_queued(ThreadQueue *tq)
+{
+    return atomic_load(&tq->bytes_queued);
+}
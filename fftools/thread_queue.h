@@ -19,6 +19,7 @@
 #ifndef FFTOOLS_THREAD_QUEUE_H
 #define FFTOOLS_THREAD_QUEUE_H
 
+#include <stdatomic.h>
 #include <string.h>
 
 enum ThreadQueueType {
@@ -26,6 +27,15 @@ enum ThreadQueueType {
     THREAD_QUEUE_PACKETS,
 };
 
+enum ThreadQueueFlags {
+    /**
+     * Protect the queue with a mutex on every operation, rather than using
+     * a lock-free ring buffer that only takes the mutex when a thread needs
+     * to sleep because the queue is empty or full.
+     */
+    THREAD_QUEUE_FLAG_LOCKED = (1 << 0),
+};
+
 typedef struct ThreadQueue ThreadQueue;
 
 /**
@@ -35,9 +45,10 @@ typedef struct ThreadQueue ThreadQueue;
  *                   maintained
  * @param queue_size number of items that can be stored in the queue without
  *                   blocking
+ * @param flags a combination of ThreadQueueFlags
  */
 ThreadQueue *tq_alloc(unsigned int nb_streams, size_t queue_size,
-                      enum ThreadQueueType type);
+                      enum ThreadQueueType type, unsigned flags);
 void         tq_free(ThreadQueue **tq);
 
 /**
@@ -87,4 +98,37 @@ int tq_receive(ThreadQueue *tq, int *stream_idx, void *data);
  */
 void tq_receive_finish(ThreadQueue *tq, unsigned int stream_idx);
 
+/**
+ * Limit the amount of data the queue may hold, in bytes of the buffers
+ * referenced by the queued items. Senders will block while the limit is
+ * exceeded, unless the queue is empty, so a single item larger than the limit
+ * can still be sent.
+ *
+ * Must be called before the queue is used.
+ *
+ * @param max_bytes maximum number of bytes; 0 means no limit
+ */
+void tq_set_max_bytes(ThreadQueue *tq, size_t max_bytes);
+
+/**
+ * Also account the data entering and leaving this queue in an external
+ * counter, which may be shared between several queues to track their total
+ * size without walking them.
+ *
+ * Must be called before the queue is used.
+ */
+void tq_set_total_bytes(ThreadQueue *tq, atomic_size_t *total_bytes);
+
+/**
+ * @return the largest number of items that were stored in the queue at once
+ *         so far
+ */
+size_t tq_max_queued(ThreadQueue *tq);
+
+/**
+ * @return the total size of the buffers referenced by the items currently
+ *         stored in the queue
+ */
+size_t tq_bytes_queued(ThreadQueue *tq);
+
 #endif // FFTOOLS_THREAD_QUEUE_H
@@ -1583,6 +1583,7 @@ typedef struct AVCodecContext {
     int thread_type;
 #define FF_THREAD_FRAME   1 ///< Decode more than one frame at once
 #define FF_THREAD_SLICE   2 ///< Decode more than one part of a single frame at once
+#define FF_THREAD_GOP     4 ///< Encode runs of whole GOPs in parallel with separate encoder instances
 
     /**
      * Which multithreading methods are in use by the codec.
@@ -1942,6 +1943,30 @@ typedef struct AVCodecContext {
      * - decoding: Set by libavcodec
      */
     enum AVAlphaMode alpha_mode;
+
+    /**
+     * Time in microseconds for which idle slice threads busy-wait for new
+     * jobs before going to sleep. 0 (the default) makes them sleep
+     * immediately.
+     * - encoding/decoding: Set by user before avcodec_open2().
+     */
+    int thread_spin;
+
+    /**
+     * Number of consecutive jobs claimed by a slice thread at once, 0 to
+     * choose automatically. The default is 1.
+     * - encoding/decoding: Set by user before avcodec_open2().
+     */
+    int thread_job_chunk;
+
+    /**
+     * CPUs to run the slice threads on, as a list of CPU numbers and ranges
+     * such as "0-3,8", or "nodeN" for the CPUs of NUMA node N. NULL (the
+     * default) means no restriction.
+     * - encoding/decoding: Set by user before avcodec_open2(), access only
+     *   through AVOptions.
+     */
+    char *thread_affinity;
 } AVCodecContext;
 
 /**
@@ -87,6 +87,14 @@
  * encoders do.
  */
 #define FF_CODEC_CAP_EOF_FLUSH              (1 << 10)
+/**
+ * The encoder can encode independent runs of frames with separate instances
+ * whose output can be concatenated, see FF_THREAD_GOP. Every instance must
+ * start with a keyframe and produce timestamps continuing the ones of the
+ * previous run. Only valid together with AV_CODEC_CAP_DELAY, since the
+ * packets are returned several GOPs after their input frames.
+ */
+#define FF_CODEC_CAP_GOP_THREADS            (1 << 11)
 
 /**
  * FFCodec.codec_tags termination value
@@ -20,8 +20,10 @@
 
 #include "config.h"
 
+#include <stdatomic.h>
 #include <stdbool.h>
 
+#include "libavutil/macros.h"
 #include "libavutil/mem.h"
 #include "libavutil/thread.h"
 
@@ -43,27 +45,46 @@
 
 #endif //!HAVE_THREADS
 
-typedef struct ThreadInfo {
-    FFExecutor *e;
-    ExecutorThread thread;
-} ThreadInfo;
-
 typedef struct Queue {
     FFTask *head;
     FFTask *tail;
 } Queue;
 
+/*
+ * Every worker thread owns a set of queues, one for each priority. New tasks
+ * are distributed among the workers in a round-robin fashion. A worker runs the
+ * tasks from its own queues first, and steals from the queues of other workers
+ * when a priority level is empty locally, so that there is no single lock all
+ * the threads contend for.
+ */
+typedef struct ThreadInfo {
+    FFExecutor *e;
+    ExecutorThread thread;
+
+    AVMutex lock;
+    Queue *q;
+    // number of tasks in q, so that empty queues can be skipped without locking
+    atomic_int nb_tasks;
+} ThreadInfo;
+
 struct FFExecutor {
     FFTaskCallbacks cb;
     int thread_count;
     bool recursive;
 
     ThreadInfo *threads;
+    int nb_threads_init;
     uint8_t *local_contexts;
 
+    // only used for sleeping and waking up idle workers
     AVMutex lock;
     AVCond cond;
-    int die;
+    atomic_int die;
+    atomic_int nb_sleeping;
+
+    // total number of queued tasks
+    atomic_int nb_tasks;
+    atomic_uint next;
 
     Queue *q;
 };
@@ -89,20 +110,40 @@ static void add_task(Queue *q, FFTask *t)
         q->tail = q->tail->next = t;
 }
 
-static int run_one_task(FFExecutor *e, void *lc)
+static FFTask *take_task(FFExecutor *e, ThreadInfo *ti, const int priority)
+{
+    FFTask *t;
+
+    if (!atomic_load_explicit(&ti->nb_tasks, memory_order_relaxed))
+        return NULL;
+
+    if (e->thread_count > 0)
+        ff_mutex_lock(&ti->lock);
+    t = remove_task(ti->q + priority);
+    if (t) {
+        atomic_fetch_sub(&ti->nb_tasks, 1);
+        atomic_fetch_sub(&e->nb_tasks, 1);
+    }
+    if (e->thread_count > 0)
+        ff_mutex_unlock(&ti->lock);
+
+    return t;
+}
+
+static int run_one_task(FFExecutor *e, ThreadInfo *ti, void *lc)
 {
     FFTaskCallbacks *cb = &e->cb;
+    const int nb_queues = FFMAX(e->thread_count, 1);
+    const int self      = ti - e->threads;
     FFTask *t = NULL;
 
+    // the highest priority task anywhere wins over a local one
     for (int i = 0; i < e->cb.priorities && !t; i++)
-        t = remove_task(e->q + i);
+        for (int j = 0; j < nb_queues && !t; j++)
+            t = take_task(e, e->threads + (self + j) % nb_queues, i);
 
     if (t) {
-        if (e->thread_count > 0)
-            ff_mutex_unlock(&e->lock);
         cb->run(t, lc, cb->user_data);
-        if (e->thread_count > 0)
-            ff_mutex_lock(&e->lock);
         return 1;
     }
     return 0;
@@ -115,16 +156,20 @@ static void *executor_worker_task(void *data)
     FFExecutor *e  = ti->e;
     void *lc       = e->local_contexts + (ti - e->threads) * e->cb.local_context_size;
 
-    ff_mutex_lock(&e->lock);
-    while (1) {
-        if (e->die) break;
+    while (!atomic_load(&e->die)) {
+        if (run_one_task(e, ti, lc))
+            continue;
 
-        if (!run_one_task(e, lc)) {
-            //no task in one loop
+        //no task in one loop
+        ff_mutex_lock(&e->lock);
+        // pairs with the nb_tasks/nb_sleeping accesses in ff_executor_execute():
+        // either we see the new task, or the submitter sees us sleeping
+        atomic_fetch_add(&e->nb_sleeping, 1);
+        if (!atomic_load(&e->nb_tasks) && !atomic_load(&e->die))
             ff_cond_wait(&e->cond, &e->lock);
-        }
+        atomic_fetch_sub(&e->nb_sleeping, 1);
+        ff_mutex_unlock(&e->lock);
     }
-    ff_mutex_unlock(&e->lock);
     return NULL;
 }
 #endif
@@ -134,7 +179,7 @@ static av_cold void executor_free(FFExecutor *e, const int has_lock, const int h
     if (e->thread_count) {
         //signal die
         ff_mutex_lock(&e->lock);
-        e->die = 1;
+        atomic_store(&e->die, 1);
         ff_cond_broadcast(&e->cond);
         ff_mutex_unlock(&e->lock);
 
@@ -146,6 +191,9 @@ static av_cold void executor_free(FFExecutor *e, const int has_lock, const int h
     if (has_lock)
         ff_mutex_destroy(&e->lock);
 
+    for (int i = 0; i < e->nb_threads_init; i++)
+        ff_mutex_destroy(&e->threads[i].lock);
+
     av_free(e->threads);
     av_free(e->q);
     av_free(e->local_contexts);
@@ -165,11 +213,16 @@ av_cold FFExecutor* ff_executor_alloc(const FFTaskCallbacks *cb, int thread_coun
         return NULL;
     e->cb = *cb;
 
+    atomic_init(&e->die,         0);
+    atomic_init(&e->nb_sleeping, 0);
+    atomic_init(&e->nb_tasks,    0);
+    atomic_init(&e->next,        0);
+
     e->local_contexts = av_calloc(FFMAX(thread_count, 1), e->cb.local_context_size);
     if (!e->local_contexts)
         goto free_executor;
 
-    e->q = av_calloc(e->cb.priorities, sizeof(Queue));
+    e->q = av_calloc(FFMAX(thread_count, 1) * e->cb.priorities, sizeof(Queue));
     if (!e->q)
         goto free_executor;
 
@@ -177,6 +230,13 @@ av_cold FFExecutor* ff_executor_alloc(const FFTaskCallbacks *cb, int thread_coun
     if (!e->threads)
         goto free_executor;
 
+    for (int i = 0; i < FFMAX(thread_count, 1); i++) {
+        ThreadInfo *ti = e->threads + i;
+        ti->e = e;
+        ti->q = e->q + i * e->cb.priorities;
+        atomic_init(&ti->nb_tasks, 0);
+    }
+
     if (!thread_count)
         return e;
 
@@ -186,9 +246,12 @@ av_cold FFExecutor* ff_executor_alloc(const FFTaskCallbacks *cb, int thread_coun
     if (!has_lock || !has_cond)
         goto free_executor;
 
+    for (/* nothing */; e->nb_threads_init < thread_count; e->nb_threads_init++)
+        if (ff_mutex_init(&e->threads[e->nb_threads_init].lock, NULL))
+            goto free_executor;
+
     for (/* nothing */; e->thread_count < thread_count; e->thread_count++) {
         ThreadInfo *ti = e->threads + e->thread_count;
-        ti->e = e;
         if (executor_thread_create(&ti->thread, NULL, executor_worker_task, ti))
             goto free_executor;
     }
@@ -212,11 +275,21 @@ av_cold void ff_executor_free(FFExecutor **executor)
 
 void ff_executor_execute(FFExecutor *e, FFTask *t)
 {
-    if (e->thread_count)
+    if (t) {
+        ThreadInfo *ti = e->threads;
+
+        if (e->thread_count) {
+            ti = e->threads + atomic_fetch_add_explicit(&e->next, 1, memory_order_relaxed) % e->thread_count;
+            ff_mutex_lock(&ti->lock);
+        }
+        add_task(ti->q + t->priority % e->cb.priorities, t);
+        atomic_fetch_add(&ti->nb_tasks, 1);
+        atomic_fetch_add(&e->nb_tasks, 1);
+        if (e->thread_count)
+            ff_mutex_unlock(&ti->lock);
+    }
+    if (e->thread_count && (!t || atomic_load(&e->nb_sleeping))) {
         ff_mutex_lock(&e->lock);
-    if (t)
-        add_task(e->q + t->priority % e->cb.priorities, t);
-    if (e->thread_count) {
         ff_cond_signal(&e->cond);
         ff_mutex_unlock(&e->lock);
     }
@@ -226,7 +299,7 @@ void ff_executor_execute(FFExecutor *e, FFTask *t)
             return;
         e->recursive = true;
         // We are running in a single-threaded environment, so we must handle all tasks ourselves
-        while (run_one_task(e, e->local_contexts))
+        while (run_one_task(e, e->threads, e->local_contexts))
             /* nothing */;
         e->recursive = false;
     }
@@ -24,14 +24,18 @@
 
 #include "libavutil/avassert.h"
 #include "libavutil/cpu.h"
+#include "libavutil/dict.h"
+#include "libavutil/intreadwrite.h"
 #include "libavutil/mem.h"
 #include "libavutil/opt.h"
 #include "libavutil/thread.h"
 #include "avcodec.h"
 #include "avcodec_internal.h"
+#include "codec_internal.h"
 #include "codec_par.h"
 #include "encode.h"
 #include "internal.h"
+#include "packet_internal.h"
 #include "pthread_internal.h"
 
 #define MAX_THREADS 64
@@ -49,6 +53,22 @@ typedef struct{
     int       got_packet;
 } Task;
 
+/**
+ * A run of consecutive input frames encoded by a fresh encoder instance
+ * in GOP mode.
+ */
+typedef struct GopChunk {
+    AVFrame  **frames;
+    int        nb_frames;
+    int64_t    first_frame;  ///< index of frames[0] in the whole input
+    double     qscale;       ///< constant quantizer to encode with, 0 for none
+    int64_t    nb_bits;      ///< size of the output
+    double     qscale_bits;  ///< sum of the packet sizes weighted by their qscale
+    PacketList packets;
+    int        return_code;
+    int        finished;
+} GopChunk;
+
 typedef struct{
     AVCodecContext *parent_avctx;
 
@@ -67,6 +87,20 @@ typedef struct{
 
     pthread_t worker[MAX_THREADS];
     atomic_int exit;
+
+    /* In GOP mode, task indices refer to chunks instead of tasks. */
+    int gop_mode;
+    int chunk_size;
+    GopChunk chunks[BUFFER_SIZE];
+    AVCodecParameters *par;
+    int64_t nb_frames_in;
+    /* packets of finished chunks, in output order */
+    PacketList out_packets;
+    /* chunk level rate control, see gop_update_rc() */
+    int     rc_enabled;
+    double  rc_qscale;  ///< quantizer for the next chunk, 0 if not known yet
+    int64_t rc_bits;    ///< size of the chunks finished so far
+    int64_t rc_frames;  ///< number of frames in the chunks finished so far
 } ThreadContext;
 
 #define OFF(member) offsetof(ThreadContext, member)
@@ -117,16 +151,229 @@ end:
     return NULL;
 }
 
+static int open_thread_avctx(const AVCodecContext *avctx,
+                             const AVCodecParameters *par, AVDictionary **options,
+                             AVCodecContext **pthread_avctx)
+{
+    AVCodecContext *thread_avctx;
+    int ret;
+
+    thread_avctx = avcodec_alloc_context3(avctx->codec);
+    if (!thread_avctx)
+        return AVERROR(ENOMEM);
+
+    ret = avcodec_parameters_to_context(thread_avctx, par);
+    if (ret < 0)
+        goto fail;
+
+    ret = av_opt_copy(thread_avctx, avctx);
+    if (ret < 0)
+        goto fail;
+    if (avctx->codec->priv_class) {
+        ret = av_opt_copy(thread_avctx->priv_data, avctx->priv_data);
+        if (ret < 0)
+            goto fail;
+    }
+    thread_avctx->thread_count = 1;
+    thread_avctx->active_thread_type &= ~FF_THREAD_FRAME;
+
+#define DUP_MATRIX(m)                                                       \
+    if (avctx->m) {                                                         \
+        thread_avctx->m = av_memdup(avctx->m, 64 * sizeof(*avctx->m));      \
+        if (!thread_avctx->m) {                                             \
+            ret = AVERROR(ENOMEM);                                          \
+            goto fail;                                                      \
+        }                                                                   \
+    }
+    DUP_MATRIX(intra_matrix);
+    DUP_MATRIX(chroma_intra_matrix);
+    DUP_MATRIX(inter_matrix);
+
+#undef DUP_MATRIX
+
+    thread_avctx->opaque            = avctx->opaque;
+    thread_avctx->get_encode_buffer = avctx->get_encode_buffer;
+    thread_avctx->execute           = avctx->execute;
+    thread_avctx->execute2          = avctx->execute2;
+    thread_avctx->stats_in          = avctx->stats_in;
+
+    ret = avcodec_open2(thread_avctx, avctx->codec, options);
+    if (ret < 0)
+        goto fail;
+
+    *pthread_avctx = thread_avctx;
+    return 0;
+fail:
+    avcodec_free_context(&thread_avctx);
+    return ret;
+}
+
+/* Encode a chunk from start to end, so that it can be concatenated with
+ * the output of the previous chunk. */
+static int gop_encode_chunk(ThreadContext *c, GopChunk *chunk)
+{
+    AVCodecContext *avctx = NULL;
+    AVDictionary *opts = NULL;
+    AVPacket *pkt;
+    int64_t tc;
+    int ret;
+
+    pkt = av_packet_alloc();
+    if (!pkt)
+        return AVERROR(ENOMEM);
+
+    if (chunk->qscale > 0) {
+        ret = av_dict_set(&opts, "flags", "+qscale", 0);
+        if (ret < 0)
+            goto end;
+        for (int i = 0; i < chunk->nb_frames; i++)
+            chunk->frames[i]->quality = lrint(chunk->qscale * FF_QP2LAMBDA);
+    }
+
+    ret = open_thread_avctx(c->parent_avctx, c->par, &opts, &avctx);
+    if (ret < 0)
+        goto end;
+
+    /* keep GOP timecodes counting across chunks */
+    if (av_opt_get_int(avctx->priv_data, "timecode_frame_start", 0, &tc) >= 0 && tc >= 0)
+        av_opt_set_int(avctx->priv_data, "timecode_frame_start", tc + chunk->first_frame, 0);
+
+    for (int i = 0; i <= chunk->nb_frames; i++) {
+        ret = avcodec_send_frame(avctx, i < chunk->nb_frames ? chunk->frames[i] : NULL);
+        if (ret < 0)
+            goto end;
+
+        while ((ret = avcodec_receive_packet(avctx, pkt)) >= 0) {
+            const uint8_t *sd = av_packet_get_side_data(pkt, AV_PKT_DATA_QUALITY_STATS, NULL);
+
+            chunk->nb_bits += 8 * pkt->size;
+            if (sd)
+                chunk->qscale_bits += 8.0 * pkt->size * AV_RL32(sd) / FF_QP2LAMBDA;
+            ret = avpriv_packet_list_put(&chunk->packets, pkt, NULL, 0);
+            if (ret < 0)
+                goto end;
+        }
+        if (ret != AVERROR(EAGAIN) && ret != AVERROR_EOF)
+            goto end;
+    }
+    ret = 0;
+
+end:
+    for (int i = 0; i < chunk->nb_frames; i++)
+        av_frame_unref(chunk->frames[i]);
+    av_packet_free(&pkt);
+    av_dict_free(&opts);
+    avcodec_free_context(&avctx);
+    return ret;
+}
+
+static void * attribute_align_arg gop_worker(void *v)
+{
+    ThreadContext *c = v;
+
+    while (!atomic_load(&c->exit)) {
+        GopChunk *chunk;
+        int ret;
+
+        pthread_mutex_lock(&c->task_fifo_mutex);
+        while (c->next_task_index == c->task_index || atomic_load(&c->exit)) {
+            if (atomic_load(&c->exit)) {
+                pthread_mutex_unlock(&c->task_fifo_mutex);
+                return NULL;
+            }
+            pthread_cond_wait(&c->task_fifo_cond, &c->task_fifo_mutex);
+        }
+        chunk              = &c->chunks[c->next_task_index];
+        c->next_task_index = (c->next_task_index + 1) % c->max_tasks;
+        pthread_mutex_unlock(&c->task_fifo_mutex);
+
+        ret = gop_encode_chunk(c, chunk);
+
+        pthread_mutex_lock(&c->finished_task_mutex);
+        chunk->return_code = ret;
+        chunk->finished    = 1;
+        pthread_cond_signal(&c->finished_task_cond);
+        pthread_mutex_unlock(&c->finished_task_mutex);
+    }
+
+    return NULL;
+}
+
+static av_cold int gop_thread_init(AVCodecContext *avctx)
+{
+    ThreadContext *c = avctx->internal->frame_thread_encoder;
+    int nb_threads = avctx->thread_count;
+    int ret;
+
+    /* count the running threads, so that only those are joined on failure */
+    avctx->thread_count = 0;
+
+    c->gop_mode   = 1;
+    c->chunk_size = FFMAX(avctx->gop_size, 1);
+    c->rc_enabled = avctx->bit_rate > 0 && !avctx->rc_max_rate &&
+                    !(avctx->flags & AV_CODEC_FLAG_QSCALE);
+
+    c->par = avcodec_parameters_alloc();
+    if (!c->par)
+        return AVERROR(ENOMEM);
+
+    ret = avcodec_parameters_from_context(c->par, avctx);
+    if (ret < 0)
+        return ret;
+
+    for (unsigned i = 0; i < c->max_tasks; i++) {
+        GopChunk *chunk = &c->chunks[i];
+
+        chunk->frames = av_calloc(c->chunk_size, sizeof(*chunk->frames));
+        if (!chunk->frames)
+            return AVERROR(ENOMEM);
+        for (int j = 0; j < c->chunk_size; j++) {
+            chunk->frames[j] = av_frame_alloc();
+            if (!chunk->frames[j])
+                return AVERROR(ENOMEM);
+        }
+    }
+
+    for (int i = 0; i < nb_threads; i++) {
+        ret = pthread_create(&c->worker[i], NULL, gop_worker, c);
+        if (ret)
+            return AVERROR(ret);
+        avctx->thread_count++;
+    }
+
+    avctx->active_thread_type = FF_THREAD_GOP;
+
+    return 0;
+}
+
+static int use_gop_threads(AVCodecContext *avctx)
+{
+    if (!(avctx->thread_type & FF_THREAD_GOP) ||
+        !(ffcodec(avctx->codec)->caps_internal & FF_CODEC_CAP_GOP_THREADS))
+        return 0;
+    av_assert0(avctx->codec->capabilities & AV_CODEC_CAP_DELAY);
+
+    if (avctx->flags & (AV_CODEC_FLAG_PASS1 | AV_CODEC_FLAG_PASS2)) {
+        av_log(avctx, AV_LOG_WARNING,
+               "GOP threading is not supported with two-pass encoding\n");
+        return 0;
+    }
+
+    return 1;
+}
+
 av_cold int ff_frame_thread_encoder_init(AVCodecContext *avctx)
 {
     int i=0;
     ThreadContext *c;
     AVCodecContext *thread_avctx = NULL;
     AVCodecParameters *par = NULL;
+    int gop_mode = use_gop_threads(avctx);
     int ret;
 
-    if(   !(avctx->thread_type & FF_THREAD_FRAME)
-       || !(avctx->codec->capabilities & AV_CODEC_CAP_FRAME_THREADS))
+    if(   !gop_mode
+       && (   !(avctx->thread_type & FF_THREAD_FRAME)
+           || !(avctx->codec->capabilities & AV_CODEC_CAP_FRAME_THREADS)))
         return 0;
 
     if(   !avctx->thread_count
@@ -188,6 +435,16 @@ av_cold int ff_frame_thread_encoder_init(AVCodecContext *avctx)
     atomic_init(&c->exit, 0);
 
     c->max_tasks = avctx->thread_count + 2;
+
+    if (gop_mode) {
+        ret = gop_thread_init(avctx);
+        if (ret < 0) {
+            av_log(avctx, AV_LOG_ERROR, "ff_frame_thread_encoder_init failed\n");
+            ff_frame_thread_encoder_free(avctx);
+        }
+        return ret;
+    }
+
     for (unsigned j = 0; j < c->max_tasks; j++) {
         if (!(c->tasks[j].indata  = av_frame_alloc()) ||
             !(c->tasks[j].outdata = av_packet_alloc())) {
@@ -207,48 +464,7 @@ av_cold int ff_frame_thread_encoder_init(AVCodecContext *avctx)
         goto fail;
 
     for(i=0; i<avctx->thread_count ; i++){
-        thread_avctx = avcodec_alloc_context3(avctx->codec);
-        if (!thread_avctx) {
-            ret = AVERROR(ENOMEM);
-            goto fail;
-        }
-
-        ret = avcodec_parameters_to_context(thread_avctx, par);
-        if (ret < 0)
-            goto fail;
-
-        ret = av_opt_copy(thread_avctx, avctx);
-        if (ret < 0)
-            goto fail;
-        if (avctx->codec->priv_class) {
-            ret = av_opt_copy(thread_avctx->priv_data, avctx->priv_data);
-            if (ret < 0)
-                goto fail;
-        }
-        thread_avctx->thread_count = 1;
-        thread_avctx->active_thread_type &= ~FF_THREAD_FRAME;
-
-#define DUP_MATRIX(m)                                                       \
-        if (avctx->m) {                                                     \
-            thread_avctx->m = av_memdup(avctx->m, 64 * sizeof(*avctx->m));  \
-            if (!thread_avctx->m) {                                         \
-                ret = AVERROR(ENOMEM);                                      \
-                goto fail;                                                  \
-            }                                                               \
-        }
-        DUP_MATRIX(intra_matrix);
-        DUP_MATRIX(chroma_intra_matrix);
-        DUP_MATRIX(inter_matrix);
-
-#undef DUP_MATRIX
-
-        thread_avctx->opaque            = avctx->opaque;
-        thread_avctx->get_encode_buffer = avctx->get_encode_buffer;
-        thread_avctx->execute           = avctx->execute;
-        thread_avctx->execute2          = avctx->execute2;
-        thread_avctx->stats_in          = avctx->stats_in;
-
-        if ((ret = avcodec_open2(thread_avctx, avctx->codec, NULL)) < 0)
+        if ((ret = open_thread_avctx(avctx, par, NULL, &thread_avctx)) < 0)
             goto fail;
         av_assert0(!thread_avctx->internal->frame_thread_encoder);
         thread_avctx->internal->frame_thread_encoder = c;
@@ -294,10 +510,141 @@ av_cold void ff_frame_thread_encoder_free(AVCodecContext *avctx)
         av_packet_free(&c->tasks[i].outdata);
     }
 
+    for (unsigned i = 0; i < c->max_tasks; i++) {
+        GopChunk *chunk = &c->chunks[i];
+
+        for (int j = 0; chunk->frames && j < c->chunk_size; j++)
+            av_frame_free(&chunk->frames[j]);
+        av_freep(&chunk->frames);
+        avpriv_packet_list_free(&chunk->packets);
+    }
+    avpriv_packet_list_free(&c->out_packets);
+    avcodec_parameters_free(&c->par);
+
     ff_pthread_free(c, thread_ctx_offsets);
     av_freep(&avctx->internal->frame_thread_encoder);
 }
 
+static void gop_submit_chunk(ThreadContext *c)
+{
+    GopChunk *chunk = &c->chunks[c->task_index];
+
+    chunk->qscale      = c->rc_qscale;
+    chunk->nb_bits     = 0;
+    chunk->qscale_bits = 0;
+
+    pthread_mutex_lock(&c->task_fifo_mutex);
+    c->task_index = (c->task_index + 1) % c->max_tasks;
+    pthread_cond_signal(&c->task_fifo_cond);
+    pthread_mutex_unlock(&c->task_fifo_mutex);
+}
+
+/**
+ * The rate control of an encoder instance starts from scratch for every
+ * chunk and cannot settle within the few frames of a GOP, which makes it
+ * overshoot the target bitrate severalfold. So only the first chunks are
+ * encoded with it; the later ones use a constant quantizer derived from the
+ * finished chunks, assuming that the size is inversely proportional to the
+ * quantizer, and corrected for the deviation from the target so far.
+ */
+static void gop_update_rc(ThreadContext *c, const GopChunk *chunk)
+{
+    const AVCodecContext *avctx = c->parent_avctx;
+    AVRational fps = avctx->framerate.num > 0 ? avctx->framerate :
+                                                av_inv_q(avctx->time_base);
+    double target, wanted, achieved, qscale;
+    /* spread the deviation over the chunks that can still react to it */
+    int horizon = c->chunk_size * (avctx->thread_count + 2);
+
+    if (!chunk->nb_bits || !chunk->nb_frames || chunk->qscale_bits <= 0)
+        return;
+
+    c->rc_bits   += chunk->nb_bits;
+    c->rc_frames += chunk->nb_frames;
+
+    target   = avctx->bit_rate / av_q2d(fps);
+    wanted   = target + (target * c->rc_frames - c->rc_bits) / horizon;
+    wanted   = av_clipd(wanted, 0.5 * target, 2.0 * target);
+    achieved = (double)chunk->nb_bits / chunk->nb_frames;
+    qscale   = chunk->qscale_bits / chunk->nb_bits * achieved / wanted;
+
+    c->rc_qscale = av_clipd(qscale, FFMAX(avctx->qmin, 1), FFMAX(avctx->qmax, 1));
+}
+
+/* Move the packets of the oldest chunk to the output, waiting for it to be
+ * finished if wait is set. Returns 1 if a chunk was collected. */
+static int gop_collect_chunk(ThreadContext *c, int wait)
+{
+    GopChunk *chunk = &c->chunks[c->finished_task_index];
+    int ret;
+
+    if (c->finished_task_index == c->task_index)
+        return 0;
+
+    pthread_mutex_lock(&c->finished_task_mutex);
+    while (wait && !chunk->finished)
+        pthread_cond_wait(&c->finished_task_cond, &c->finished_task_mutex);
+    pthread_mutex_unlock(&c->finished_task_mutex);
+    if (!chunk->finished)
+        return 0;
+
+    if (chunk->packets.head) {
+        if (c->out_packets.tail)
+            c->out_packets.tail->next = chunk->packets.head;
+        else
+            c->out_packets.head = chunk->packets.head;
+        c->out_packets.tail = chunk->packets.tail;
+        chunk->packets.head = chunk->packets.tail = NULL;
+    }
+
+    if (c->rc_enabled)
+        gop_update_rc(c, chunk);
+
+    ret = chunk->return_code;
+    chunk->finished  = 0;
+    chunk->nb_frames = 0;
+    c->finished_task_index = (c->finished_task_index + 1) % c->max_tasks;
+
+    return ret < 0 ? ret : 1;
+}
+
+static int gop_encode_frame(AVCodecContext *avctx, AVPacket *pkt,
+                            AVFrame *frame, int *got_packet_ptr)
+{
+    ThreadContext *c = avctx->internal->frame_thread_encoder;
+    GopChunk *chunk  = &c->chunks[c->task_index];
+    int ret;
+
+    if (frame) {
+        if (!chunk->nb_frames)
+            chunk->first_frame = c->nb_frames_in;
+        av_frame_move_ref(chunk->frames[chunk->nb_frames++], frame);
+        c->nb_frames_in++;
+
+        if (chunk->nb_frames == c->chunk_size)
+            gop_submit_chunk(c);
+    } else if (chunk->nb_frames) {
+        gop_submit_chunk(c);
+    }
+
+    /* collect what is done, and wait if all threads have a chunk queued */
+    do {
+        unsigned queued = (c->task_index - c->finished_task_index + c->max_tasks) % c->max_tasks;
+        int wait = queued > avctx->thread_count || (!frame && !c->out_packets.head);
+
+        ret = gop_collect_chunk(c, wait);
+        if (ret < 0)
+            return ret;
+    } while (ret > 0);
+
+    if (c->out_packets.head) {
+        avpriv_packet_list_get(&c->out_packets, pkt);
+        *got_packet_ptr = 1;
+    }
+
+    return 0;
+}
+
 int ff_thread_video_encode_frame(AVCodecContext *avctx, AVPacket *pkt,
                                  AVFrame *frame, int *got_packet_ptr)
 {
@@ -306,6 +653,9 @@ int ff_thread_video_encode_frame(AVCodecContext *avctx, AVPacket *pkt,
 
     av_assert1(!*got_packet_ptr);
 
+    if (c->gop_mode)
+        return gop_encode_frame(avctx, pkt, frame, got_packet_ptr);
+
     if(frame){
         av_frame_move_ref(c->tasks[c->task_index].indata, frame);
 
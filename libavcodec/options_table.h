@@ -364,6 +364,10 @@ static const AVOption avcodec_options[] = {
 {"thread_type", "select multithreading type", OFFSET(thread_type), AV_OPT_TYPE_FLAGS, {.i64 = FF_THREAD_SLICE|FF_THREAD_FRAME }, 0, INT_MAX, V|A|E|D, .unit = "thread_type"},
 {"slice", NULL, 0, AV_OPT_TYPE_CONST, {.i64 = FF_THREAD_SLICE }, INT_MIN, INT_MAX, V|E|D, .unit = "thread_type"},
 {"frame", NULL, 0, AV_OPT_TYPE_CONST, {.i64 = FF_THREAD_FRAME }, INT_MIN, INT_MAX, V|E|D, .unit = "thread_type"},
+{"gop", NULL, 0, AV_OPT_TYPE_CONST, {.i64 = FF_THREAD_GOP }, INT_MIN, INT_MAX, V|E, .unit = "thread_type"},
+{"thread_spin", "time in microseconds idle slice threads busy-wait before sleeping", OFFSET(thread_spin), AV_OPT_TYPE_INT, {.i64 = 0 }, 0, INT_MAX, V|A|E|D},
+{"thread_job_chunk", "number of consecutive jobs claimed by a slice thread at once, 0 for auto", OFFSET(thread_job_chunk), AV_OPT_TYPE_INT, {.i64 = 1 }, 0, INT_MAX, V|A|E|D},
+{"thread_affinity", "CPUs to run slice threads on, e.g. 0-3,8 or node1", OFFSET(thread_affinity), AV_OPT_TYPE_STRING, {.str = NULL }, 0, 0, V|A|E|D},
 {"audio_service_type", "audio service type", OFFSET(audio_service_type), AV_OPT_TYPE_INT, {.i64 = AV_AUDIO_SERVICE_TYPE_MAIN }, 0, AV_AUDIO_SERVICE_TYPE_NB-1, A|E, .unit = "audio_service_type"},
 {"ma", "Main Audio Service", 0, AV_OPT_TYPE_CONST, {.i64 = AV_AUDIO_SERVICE_TYPE_MAIN },              INT_MIN, INT_MAX, A|E, .unit = "audio_service_type"},
 {"ef", "Effects",            0, AV_OPT_TYPE_CONST, {.i64 = AV_AUDIO_SERVICE_TYPE_EFFECTS },           INT_MIN, INT_MAX, A|E, .unit = "audio_service_type"},
@@ -114,6 +114,11 @@ av_cold int ff_slice_thread_init(AVCodecContext *avctx)
     SliceThreadContext *c;
     int thread_count = avctx->thread_count;
     void (*mainfunc)(void *);
+    const AVSliceThreadConfig cfg = {
+        .spin_us   = avctx->thread_spin,
+        .job_chunk = avctx->thread_job_chunk,
+        .affinity  = avctx->thread_affinity,
+    };
 
     if (!thread_count) {
         int nb_cpus = av_cpu_count();
@@ -135,8 +140,8 @@ av_cold int ff_slice_thread_init(AVCodecContext *avctx)
     if (!c)
         return AVERROR(ENOMEM);
     mainfunc = ffcodec(avctx->codec)->caps_internal & FF_CODEC_CAP_SLICE_THREAD_HAS_MF ? &main_function : NULL;
-    thread_count = avpriv_slicethread_create(&c->thread, avctx, worker_func,
-                                             mainfunc, thread_count);
+    thread_count = avpriv_slicethread_create2(&c->thread, avctx, worker_func,
+                                              mainfunc, thread_count, &cfg);
     if (thread_count <= 1) {
         ff_slice_thread_free(avctx);
         avctx->thread_count = 1;
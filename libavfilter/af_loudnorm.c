@@ -34,6 +34,7 @@ enum FrameType {
     INNER_FRAME,
     FINAL_FRAME,
     LINEAR_MODE,
+    ANALYZE_MODE,
     FRAME_NB
 };
 
@@ -63,6 +64,7 @@ typedef struct LoudNormContext {
     double measured_thresh;
     double offset;
     int linear;
+    int analyze;
     int dual_mono;
     /* enum PrintFormat */
     int print_format;
@@ -119,6 +121,7 @@ static const AVOption loudnorm_options[] = {
     { "measured_thresh",  "measured threshold of input file",  OFFSET(measured_thresh),  AV_OPT_TYPE_DOUBLE,  {.dbl = -70.},   -99.,        0.,  FLAGS },
     { "offset",           "set offset gain",                   OFFSET(offset),           AV_OPT_TYPE_DOUBLE,  {.dbl =  0.},    -99.,       99.,  FLAGS },
     { "linear",           "normalize linearly if possible",    OFFSET(linear),           AV_OPT_TYPE_BOOL,    {.i64 =  1},        0,         1,  FLAGS },
+    { "analyze",          "only measure the input",            OFFSET(analyze),          AV_OPT_TYPE_BOOL,    {.i64 =  0},        0,         1,  FLAGS },
     { "dual_mono",        "treat mono input as dual-mono",     OFFSET(dual_mono),        AV_OPT_TYPE_BOOL,    {.i64 =  0},        0,         1,  FLAGS },
     { "print_format",     "set print format for stats",        OFFSET(print_format),     AV_OPT_TYPE_INT,     {.i64 =  NONE},  NONE,  PF_NB -1,  FLAGS, .unit = "print_format" },
     {     "none",         0,                                   0,                        AV_OPT_TYPE_CONST,   {.i64 =  NONE},     0,         0,  FLAGS, .unit = "print_format" },
@@ -426,6 +429,11 @@ static int filter_frame(AVFilterLink *inlink, AVFrame *in)
     double gain, gain_next, env_global, env_shortterm,
     global, shortterm, lra, relative_threshold;
 
+    if (s->frame_type == ANALYZE_MODE) {
+        ff_ebur128_add_frames_double(s->r128_in, (const double *)in->data[0], in->nb_samples);
+        return ff_filter_frame(outlink, in);
+    }
+
     if (av_frame_is_writable(in)) {
         out = in;
     } else {
@@ -690,7 +698,7 @@ static int activate(AVFilterContext *ctx)
 
     FF_FILTER_FORWARD_STATUS_BACK(outlink, inlink);
 
-    if (s->frame_type != LINEAR_MODE) {
+    if (s->frame_type != LINEAR_MODE && s->frame_type != ANALYZE_MODE) {
         int nb_samples;
 
         if (s->frame_type == FIRST_FRAME) {
@@ -712,7 +720,7 @@ static int activate(AVFilterContext *ctx)
 
             for (int i = 0; i < FF_ARRAY_ELEMS(s->pts); i++)
                 s->pts[i] = in->pts + i * nb_samples;
-        } else if (s->frame_type == LINEAR_MODE) {
+        } else if (s->frame_type == LINEAR_MODE || s->frame_type == ANALYZE_MODE) {
             s->pts[0] = in->pts;
         } else {
             s->pts[FF_ARRAY_ELEMS(s->pts) - 1] = in->pts;
@@ -763,14 +771,19 @@ static int config_input(AVFilterLink *inlink)
     if (!s->r128_in)
         return AVERROR(ENOMEM);
 
+    if (inlink->ch_layout.nb_channels == 1 && s->dual_mono)
+        ff_ebur128_set_channel(s->r128_in, 0, FF_EBUR128_DUAL_MONO);
+
+    s->channels = inlink->ch_layout.nb_channels;
+    if (s->frame_type == ANALYZE_MODE)
+        return 0;
+
     s->r128_out = ff_ebur128_init(inlink->ch_layout.nb_channels, inlink->sample_rate, 0, FF_EBUR128_MODE_I | FF_EBUR128_MODE_S | FF_EBUR128_MODE_LRA | FF_EBUR128_MODE_SAMPLE_PEAK);
     if (!s->r128_out)
         return AVERROR(ENOMEM);
 
-    if (inlink->ch_layout.nb_channels == 1 && s->dual_mono) {
-        ff_ebur128_set_channel(s->r128_in,  0, FF_EBUR128_DUAL_MONO);
+    if (inlink->ch_layout.nb_channels == 1 && s->dual_mono)
         ff_ebur128_set_channel(s->r128_out, 0, FF_EBUR128_DUAL_MONO);
-    }
 
     s->buf_size = frame_size(inlink->sample_rate, 3000) * inlink->ch_layout.nb_channels;
     s->buf = av_malloc_array(s->buf_size, sizeof(*s->buf));
@@ -791,7 +804,6 @@ static int config_input(AVFilterLink *inlink)
     s->buf_index =
     s->prev_buf_index =
     s->limiter_buf_index = 0;
-    s->channels = inlink->ch_layout.nb_channels;
     s->index = 1;
     s->limiter_state = OUT;
     s->offset = pow(10., s->offset / 20.);
@@ -812,7 +824,9 @@ static av_cold int init(AVFilterContext *ctx)
         return AVERROR(EINVAL);
     }
 
-    if (s->linear) {
+    if (s->analyze) {
+        s->frame_type = ANALYZE_MODE;
+    } else if (s->linear) {
         double offset, offset_tp;
         offset    = s->target_i - s->measured_i;
         offset_tp = s->measured_tp + offset;
@@ -835,7 +849,7 @@ static av_cold void uninit(AVFilterContext *ctx)
     int c;
     FILE *stats_file = NULL;
 
-    if (!s->r128_in || !s->r128_out)
+    if (!s->r128_in || (!s->r128_out && s->frame_type != ANALYZE_MODE))
         goto end;
 
     ff_ebur128_loudness_range(s->r128_in, &lra_in);
@@ -848,14 +862,16 @@ static av_cold void uninit(AVFilterContext *ctx)
             tp_in = tmp;
     }
 
-    ff_ebur128_loudness_range(s->r128_out, &lra_out);
-    ff_ebur128_loudness_global(s->r128_out, &i_out);
-    ff_ebur128_relative_threshold(s->r128_out, &thresh_out);
-    for (c = 0; c < s->channels; c++) {
-        double tmp;
-        ff_ebur128_sample_peak(s->r128_out, c, &tmp);
-        if ((c == 0) || (tmp > tp_out))
-            tp_out = tmp;
+    if (s->r128_out) {
+        ff_ebur128_loudness_range(s->r128_out, &lra_out);
+        ff_ebur128_loudness_global(s->r128_out, &i_out);
+        ff_ebur128_relative_threshold(s->r128_out, &thresh_out);
+        for (c = 0; c < s->channels; c++) {
+            double tmp;
+            ff_ebur128_sample_peak(s->r128_out, c, &tmp);
+            if ((c == 0) || (tmp > tp_out))
+                tp_out = tmp;
+        }
     }
 
 
@@ -880,45 +896,78 @@ static av_cold void uninit(AVFilterContext *ctx)
     case JSON:
     case SUMMARY: {
         char stats[1024];
-        const char *const format = s->print_format == JSON ?
-            "{\n"
-            "\t\"input_i\" : \"%.2f\",\n"
-            "\t\"input_tp\" : \"%.2f\",\n"
-            "\t\"input_lra\" : \"%.2f\",\n"
-            "\t\"input_thresh\" : \"%.2f\",\n"
-            "\t\"output_i\" : \"%.2f\",\n"
-            "\t\"output_tp\" : \"%+.2f\",\n"
-            "\t\"output_lra\" : \"%.2f\",\n"
-            "\t\"output_thresh\" : \"%.2f\",\n"
-            "\t\"normalization_type\" : \"%s\",\n"
-            "\t\"target_offset\" : \"%.2f\"\n"
-            "}\n" :
-            "Input Integrated:   %+6.1f LUFS\n"
-            "Input True Peak:    %+6.1f dBTP\n"
-            "Input LRA:          %6.1f LU\n"
-            "Input Threshold:    %+6.1f LUFS\n"
-            "\n"
-            "Output Integrated:  %+6.1f LUFS\n"
-            "Output True Peak:   %+6.1f dBTP\n"
-            "Output LRA:         %6.1f LU\n"
-            "Output Threshold:   %+6.1f LUFS\n"
-            "\n"
-            "Normalization Type:   %s\n"
-            "Target Offset:      %+6.1f LU\n";
-
-        snprintf(stats, sizeof(stats), format,
-            i_in,
-            20. * log10(tp_in),
-            lra_in,
-            thresh_in,
-            i_out,
-            20. * log10(tp_out),
-            lra_out,
-            thresh_out,
-            s->frame_type == LINEAR_MODE ? (s->print_format == JSON ? "linear"  : "Linear")
-                                         : (s->print_format == JSON ? "dynamic" : "Dynamic"),
-            s->target_i - i_out
-        );
+
+        if (s->frame_type == ANALYZE_MODE) {
+            /* the output is not measured: its fields and the target offset
+             * are left out of the JSON, as they would not hold numbers */
+            const char *const format = s->print_format == JSON ?
+                "{\n"
+                "\t\"input_i\" : \"%.2f\",\n"
+                "\t\"input_tp\" : \"%.2f\",\n"
+                "\t\"input_lra\" : \"%.2f\",\n"
+                "\t\"input_thresh\" : \"%.2f\",\n"
+                "\t\"normalization_type\" : \"none\"\n"
+                "}\n" :
+                "Input Integrated:   %+6.1f LUFS\n"
+                "Input True Peak:    %+6.1f dBTP\n"
+                "Input LRA:          %6.1f LU\n"
+                "Input Threshold:    %+6.1f LUFS\n"
+                "\n"
+                "Output Integrated:     N/A\n"
+                "Output True Peak:      N/A\n"
+                "Output LRA:            N/A\n"
+                "Output Threshold:      N/A\n"
+                "\n"
+                "Normalization Type:   None\n"
+                "Target Offset:         N/A\n";
+
+            snprintf(stats, sizeof(stats), format,
+                i_in,
+                20. * log10(tp_in),
+                lra_in,
+                thresh_in
+            );
+        } else {
+            const char *const format = s->print_format == JSON ?
+                "{\n"
+                "\t\"input_i\" : \"%.2f\",\n"
+                "\t\"input_tp\" : \"%.2f\",\n"
+                "\t\"input_lra\" : \"%.2f\",\n"
+                "\t\"input_thresh\" : \"%.2f\",\n"
+                "\t\"output_i\" : \"%.2f\",\n"
+                "\t\"output_tp\" : \"%+.2f\",\n"
+                "\t\"output_lra\" : \"%.2f\",\n"
+                "\t\"output_thresh\" : \"%.2f\",\n"
+                "\t\"normalization_type\" : \"%s\",\n"
+                "\t\"target_offset\" : \"%.2f\"\n"
+                "}\n" :
+                "Input Integrated:   %+6.1f LUFS\n"
+                "Input True Peak:    %+6.1f dBTP\n"
+                "Input LRA:          %6.1f LU\n"
+                "Input Threshold:    %+6.1f LUFS\n"
+                "\n"
+                "Output Integrated:  %+6.1f LUFS\n"
+                "Output True Peak:   %+6.1f dBTP\n"
+                "Output LRA:         %6.1f LU\n"
+                "Output Threshold:   %+6.1f LUFS\n"
+                "\n"
+                "Normalization Type:   %s\n"
+                "Target Offset:      %+6.1f LU\n";
+
+            snprintf(stats, sizeof(stats), format,
+                i_in,
+                20. * log10(tp_in),
+                lra_in,
+                thresh_in,
+                i_out,
+                20. * log10(tp_out),
+                lra_out,
+                thresh_out,
+                s->frame_type == LINEAR_MODE ? (s->print_format == JSON ? "linear"  : "Linear")
+                                             : (s->print_format == JSON ? "dynamic" : "Dynamic"),
+                s->target_i - i_out
+            );
+        }
         av_log(ctx, AV_LOG_INFO, "\n%s", stats);
         if (stats_file)
             fprintf(stats_file, "%s", stats);
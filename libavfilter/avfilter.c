@@ -216,19 +216,31 @@ static void link_free(AVFilterLink **link)
 static void update_link_current_pts(FilterLinkInternal *li, int64_t pts)
 {
     AVFilterLink *const link = &li->l.pub;
+    FFFilterGraph *graphi = li->l.graph ? fffiltergraph(li->l.graph) : NULL;
 
     if (pts == AV_NOPTS_VALUE)
         return;
+    /* the age heap compares the sink links while other links are updated;
+     * the links not in the heap are only accessed by their two filters */
+    if (graphi && li->age_index >= 0)
+        ff_graph_pipeline_lock(graphi);
     li->l.current_pts = pts;
     li->l.current_pts_us = av_rescale_q(pts, link->time_base, AV_TIME_BASE_Q);
     /* TODO use duration */
-    if (li->l.graph && li->age_index >= 0)
+    if (graphi && li->age_index >= 0) {
         ff_avfilter_graph_update_heap(li->l.graph, li);
+        ff_graph_pipeline_unlock(graphi);
+    }
 }
 
 void ff_filter_set_ready(AVFilterContext *filter, unsigned priority)
 {
     FFFilterContext *ctxi = fffilterctx(filter);
+
+    if (filter->graph && fffiltergraph(filter->graph)->pipeline) {
+        ff_graph_pipeline_set_ready(fffiltergraph(filter->graph), filter, priority);
+        return;
+    }
     ctxi->ready = FFMAX(ctxi->ready, priority);
 }
 
@@ -242,7 +254,7 @@ static void filter_unblock(AVFilterContext *filter)
 
     for (i = 0; i < filter->nb_outputs; i++) {
         FilterLinkInternal * const li = ff_link_internal(filter->outputs[i]);
-        li->frame_blocked_in = 0;
+        atomic_store_explicit(&li->frame_blocked_in, 0, memory_order_relaxed);
     }
 }
 
@@ -257,7 +269,7 @@ void ff_avfilter_link_set_in_status(AVFilterLink *link, int status, int64_t pts)
     li->status_in = status;
     li->status_in_pts = pts;
     li->frame_wanted_out = 0;
-    li->frame_blocked_in = 0;
+    atomic_store_explicit(&li->frame_blocked_in, 0, memory_order_relaxed);
     filter_unblock(link->dst);
     ff_filter_set_ready(link->dst, 200);
 }
@@ -492,7 +504,9 @@ int ff_request_frame(AVFilterLink *link)
     if (li->status_in) {
         if (ff_framequeue_queued_frames(&li->fifo)) {
             av_assert1(!li->frame_wanted_out);
-            av_assert1(fffilterctx(link->dst)->ready >= 300);
+            /* a pipeline thread may have taken the ready status already */
+            av_assert1(fffiltergraph(link->dst->graph)->pipeline ||
+                       fffilterctx(link->dst)->ready >= 300);
             return 0;
         } else {
             /* Acknowledge status change. Filters using ff_request_frame() will
@@ -536,7 +550,7 @@ static int request_frame_to_filter(AVFilterLink *link)
 
     FF_TPRINTF_START(NULL, request_frame_to_filter); ff_tlog_link(NULL, link, 1);
     /* Assume the filter is blocked, let the method clear it if not */
-    li->frame_blocked_in = 1;
+    atomic_store_explicit(&li->frame_blocked_in, 1, memory_order_relaxed);
     if (link->srcpad->request_frame)
         ret = link->srcpad->request_frame(link);
     else if (link->src->inputs[0])
@@ -1102,7 +1116,8 @@ int ff_filter_frame(AVFilterLink *link, AVFrame *frame)
                                        link->time_base);
     }
 
-    li->frame_blocked_in = li->frame_wanted_out = 0;
+    atomic_store_explicit(&li->frame_blocked_in, 0, memory_order_relaxed);
+    li->frame_wanted_out = 0;
     li->l.frame_count_in++;
     li->l.sample_count_in += frame->nb_samples;
     filter_unblock(link->dst);
@@ -1284,7 +1299,7 @@ static int filter_activate_default(AVFilterContext *filter)
     for (i = 0; i < filter->nb_outputs; i++) {
         FilterLinkInternal * const li = ff_link_internal(filter->outputs[i]);
         if (li->frame_wanted_out &&
-            !li->frame_blocked_in) {
+            !atomic_load_explicit(&li->frame_blocked_in, memory_order_relaxed)) {
             return request_frame_to_filter(filter->outputs[i]);
         }
     }
@@ -1445,14 +1460,12 @@ static int filter_activate_default(AVFilterContext *filter)
 
 int ff_filter_activate(AVFilterContext *filter)
 {
-    FFFilterContext *ctxi = fffilterctx(filter);
     const FFFilter *const fi = fffilter(filter->filter);
     int ret;
 
     /* Generic timeline support is not yet implemented but should be easy */
     av_assert1(!(fi->p.flags & AVFILTER_FLAG_SUPPORT_TIMELINE_GENERIC &&
                  fi->activate));
-    ctxi->ready = 0;
     ret = fi->activate ? fi->activate(filter) : filter_activate_default(filter);
     if (ret == FFERROR_NOT_READY)
         ret = 0;
@@ -1630,7 +1643,7 @@ void ff_inlink_set_status(AVFilterLink *link, int status)
     if (li->status_out)
         return;
     li->frame_wanted_out = 0;
-    li->frame_blocked_in = 0;
+    atomic_store_explicit(&li->frame_blocked_in, 0, memory_order_relaxed);
     link_set_out_status(link, status, AV_NOPTS_VALUE);
     while (ff_framequeue_queued_frames(&li->fifo)) {
            AVFrame *frame = ff_framequeue_take(&li->fifo);
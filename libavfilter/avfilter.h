@@ -644,6 +644,48 @@ typedef struct AVFilterGraph {
      * avfilter_graph_config().
      */
     unsigned max_buffered_frames;
+
+    /**
+     * Time in microseconds for which idle filter threads busy-wait for new
+     * jobs before going to sleep. 0 (the default) makes them sleep
+     * immediately. Must be set before adding any filters to the graph.
+     */
+    int thread_spin;
+
+    /**
+     * Number of consecutive jobs claimed by a filter thread at once, 0 to
+     * choose automatically. The default is 1. Must be set before adding any
+     * filters to the graph.
+     */
+    int thread_job_chunk;
+
+    /**
+     * CPUs to run the filter threads on, as a list of CPU numbers and ranges
+     * such as "0-3,8", or "nodeN" for the CPUs of NUMA node N. NULL (the
+     * default) means no restriction. Must be set before adding any filters
+     * to the graph, access only through AVOptions.
+     */
+    char *thread_affinity;
+
+    /**
+     * Number of threads activating the filters of the graph, besides the
+     * caller. With a nonzero value, filters that do not share a link, e.g.
+     * the branches after a split or the stages of a chain, run in parallel,
+     * and adding a frame to a buffer source without AV_BUFFERSRC_FLAG_PUSH
+     * returns without waiting for it to be filtered. 0 (the default) runs
+     * all filters on the calling thread. A custom execute callback must
+     * support concurrent calls when this is set. This field must be set
+     * before calling avfilter_graph_config(); freeing a filter of the
+     * configured graph stops the threads.
+     */
+    int pipeline_threads;
+
+    /**
+     * Number of frames queued in the graph above which adding a frame to a
+     * buffer source waits for the pipeline threads to catch up. Only used
+     * when pipeline_threads is nonzero.
+     */
+    int pipeline_queue;
 } AVFilterGraph;
 
 /**
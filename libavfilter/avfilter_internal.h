@@ -25,6 +25,7 @@
 #ifndef AVFILTER_AVFILTER_INTERNAL_H
 #define AVFILTER_AVFILTER_INTERNAL_H
 
+#include <stdatomic.h>
 #include <stdint.h>
 
 #include "avfilter.h"
@@ -45,8 +46,10 @@ typedef struct FilterLinkInternal {
      * If set, the source filter can not generate a frame as is.
      * The goal is to avoid repeatedly calling the request_frame() method on
      * the same link.
+     * Atomic since it is cleared by the filters feeding the source filter,
+     * which may run on other pipeline threads.
      */
-    int frame_blocked_in;
+    atomic_int frame_blocked_in;
 
     /**
      * Link input status.
@@ -110,6 +113,12 @@ typedef struct FFFilterContext {
      */
     unsigned ready;
 
+    /**
+     * Set while the filter is activated by a pipeline thread or used by the
+     * caller, guarded by the pipeline lock.
+     */
+    int busy;
+
     /// parsed expression
     struct AVExpr *enable;
     /// variable values for the enable expression
@@ -145,6 +154,11 @@ typedef struct FFFilterGraph {
     void *thread;
     avfilter_execute_func *thread_execute;
     FFFrameQueueGlobal frame_queues;
+
+    /**
+     * Pipeline threads, NULL unless AVFilterGraph.pipeline_threads is set.
+     */
+    struct GraphPipeline *pipeline;
 } FFFilterGraph;
 
 static inline FFFilterGraph *fffiltergraph(AVFilterGraph *graph)
@@ -153,7 +167,8 @@ static inline FFFilterGraph *fffiltergraph(AVFilterGraph *graph)
 }
 
 /**
- * Update the position of a link in the age heap.
+ * Update the position of a link in the age heap. Must be called with the
+ * pipeline lock held, see ff_graph_pipeline_lock().
  */
 void ff_avfilter_graph_update_heap(AVFilterGraph *graph,
                                    struct FilterLinkInternal *li);
@@ -173,6 +188,9 @@ AVFilterContext *ff_filter_alloc(const AVFilter *filter, const char *inst_name);
  */
 void ff_filter_graph_remove_filter(AVFilterGraph *graph, AVFilterContext *filter);
 
+/**
+ * Activate a filter. The caller must have cleared its ready status.
+ */
 int ff_filter_activate(AVFilterContext *filter);
 
 /**
@@ -192,6 +210,63 @@ int ff_graph_thread_init(FFFilterGraph *graph);
 
 void ff_graph_thread_free(FFFilterGraph *graph);
 
+/**
+ * Start the pipeline threads of a configured graph.
+ */
+int ff_graph_pipeline_init(FFFilterGraph *graph);
+
+/**
+ * Stop the pipeline threads, the graph is run by the caller afterwards.
+ */
+void ff_graph_pipeline_free(FFFilterGraph *graph);
+
+/**
+ * Raise the ready status of a filter in a graph with pipeline threads.
+ */
+void ff_graph_pipeline_set_ready(FFFilterGraph *graph, AVFilterContext *filter,
+                                 unsigned priority);
+
+/**
+ * Wait until the filter and its neighbours are not activated by a pipeline
+ * thread and reserve it for the caller, which can then access its state and
+ * links. Every call must be paired with ff_graph_pipeline_release().
+ * No-op if the graph has no pipeline threads.
+ */
+void ff_graph_pipeline_acquire(AVFilterContext *filter);
+
+void ff_graph_pipeline_release(AVFilterContext *filter);
+
+/**
+ * Wait for the pipeline threads to make progress.
+ *
+ * @return 0 after a filter was activated, the error returned by an
+ *         activation, or, once no filter is ready anymore,
+ *         FFERROR_BUFFERSRC_EMPTY if a buffer source without frames was
+ *         activated and AVERROR(EAGAIN) otherwise
+ */
+int ff_graph_pipeline_run(FFFilterGraph *graph);
+
+/**
+ * Wait while more than AVFilterGraph.pipeline_queue frames are queued and
+ * the pipeline threads can still make progress.
+ */
+void ff_graph_pipeline_throttle(FFFilterGraph *graph);
+
+/**
+ * Stop activating filters and wait for the running activations, so that the
+ * caller can access any filter. Must not be called from a filter.
+ */
+void ff_graph_pipeline_pause(FFFilterGraph *graph);
+
+void ff_graph_pipeline_resume(FFFilterGraph *graph);
+
+/**
+ * Lock the state shared by all filters of a graph with pipeline threads.
+ */
+void ff_graph_pipeline_lock(FFFilterGraph *graph);
+
+void ff_graph_pipeline_unlock(FFFilterGraph *graph);
+
 /**
  * Negotiate the media format, dimensions, etc of all inputs to a filter.
  *
@@ -58,6 +58,16 @@ static const AVOption filtergraph_options[] = {
         AV_OPT_TYPE_STRING, {.str = NULL}, 0, 0, F|A },
     {"max_buffered_frames"  , "maximum number of buffered frames allowed", OFFSET(max_buffered_frames),
         AV_OPT_TYPE_UINT,   {.i64 = 0}, 0, UINT_MAX, F|V|A },
+    { "thread_spin",      "time in microseconds idle threads busy-wait before sleeping", OFFSET(thread_spin),
+        AV_OPT_TYPE_INT,    { .i64 = 0 }, 0, INT_MAX, F|V|A },
+    { "thread_job_chunk", "number of consecutive jobs claimed by a thread at once, 0 for auto", OFFSET(thread_job_chunk),
+        AV_OPT_TYPE_INT,    { .i64 = 1 }, 0, INT_MAX, F|V|A },
+    { "thread_affinity",  "CPUs to run threads on, e.g. 0-3,8 or node1", OFFSET(thread_affinity),
+        AV_OPT_TYPE_STRING, { .str = NULL }, 0, 0, F|V|A },
+    { "pipeline_threads", "number of threads running filters in parallel, 0 to disable", OFFSET(pipeline_threads),
+        AV_OPT_TYPE_INT,    { .i64 = 0 }, 0, INT_MAX, F|V|A },
+    { "pipeline_queue",   "number of queued frames above which feeding the graph blocks", OFFSET(pipeline_queue),
+        AV_OPT_TYPE_INT,    { .i64 = 8 }, 1, INT_MAX, F|V|A },
     { NULL },
 };
 
@@ -80,6 +90,54 @@ int ff_graph_thread_init(FFFilterGraph *graph)
     graph->p.nb_threads  = 1;
     return 0;
 }
+
+int ff_graph_pipeline_init(FFFilterGraph *graph)
+{
+    graph->p.pipeline_threads = 0;
+    return 0;
+}
+
+void ff_graph_pipeline_free(FFFilterGraph *graph)
+{
+}
+
+void ff_graph_pipeline_set_ready(FFFilterGraph *graph, AVFilterContext *filter,
+                                 unsigned priority)
+{
+}
+
+void ff_graph_pipeline_acquire(AVFilterContext *filter)
+{
+}
+
+void ff_graph_pipeline_release(AVFilterContext *filter)
+{
+}
+
+int ff_graph_pipeline_run(FFFilterGraph *graph)
+{
+    return AVERROR(EAGAIN);
+}
+
+void ff_graph_pipeline_throttle(FFFilterGraph *graph)
+{
+}
+
+void ff_graph_pipeline_pause(FFFilterGraph *graph)
+{
+}
+
+void ff_graph_pipeline_resume(FFFilterGraph *graph)
+{
+}
+
+void ff_graph_pipeline_lock(FFFilterGraph *graph)
+{
+}
+
+void ff_graph_pipeline_unlock(FFFilterGraph *graph)
+{
+}
 #endif
 
 AVFilterGraph *avfilter_graph_alloc(void)
@@ -100,7 +158,18 @@ AVFilterGraph *avfilter_graph_alloc(void)
 
 void ff_filter_graph_remove_filter(AVFilterGraph *graph, AVFilterContext *filter)
 {
+    FFFilterGraph *graphi = fffiltergraph(graph);
     int i, j;
+
+    /* The links of the filter are freed while its neighbours may be running,
+     * so the remaining filters are run by the caller from now on. */
+    if (graphi->pipeline) {
+        av_log(graph, AV_LOG_VERBOSE,
+               "Filter '%s' removed from the configured graph, "
+               "stopping the pipeline threads\n", filter->name);
+        ff_graph_pipeline_free(graphi);
+    }
+
     for (i = 0; i < graph->nb_filters; i++) {
         if (graph->filters[i] == filter) {
             FFSWAP(AVFilterContext*, graph->filters[i],
@@ -124,6 +193,8 @@ void avfilter_graph_free(AVFilterGraph **graphp)
     if (!graph)
         return;
 
+    ff_graph_pipeline_free(graphi);
+
     while (graph->nb_filters)
         avfilter_free(graph->filters[0]);
 
@@ -1447,19 +1518,32 @@ int avfilter_graph_config(AVFilterGraph *graphctx, void *log_ctx)
         return ret;
     if ((ret = graph_config_pointers(graphctx, log_ctx)))
         return ret;
+    if ((ret = ff_graph_pipeline_init(fffiltergraph(graphctx))) < 0)
+        return ret;
 
     return 0;
 }
 
 int avfilter_graph_send_command(AVFilterGraph *graph, const char *target, const char *cmd, const char *arg, char *res, int res_len, int flags)
 {
-    int i, r = AVERROR(ENOSYS);
+    int r;
 
     if (!graph)
-        return r;
+        return AVERROR(ENOSYS);
+
+    ff_graph_pipeline_pause(fffiltergraph(graph));
+    r = ff_filter_graph_send_command(graph, target, cmd, arg, res, res_len, flags);
+    ff_graph_pipeline_resume(fffiltergraph(graph));
+
+    return r;
+}
+
+int ff_filter_graph_send_command(AVFilterGraph *graph, const char *target, const char *cmd, const char *arg, char *res, int res_len, int flags)
+{
+    int i, r = AVERROR(ENOSYS);
 
     if ((flags & AVFILTER_CMD_FLAG_ONE) && !(flags & AVFILTER_CMD_FLAG_FAST)) {
-        r = avfilter_graph_send_command(graph, target, cmd, arg, res, res_len, flags | AVFILTER_CMD_FLAG_FAST);
+        r = ff_filter_graph_send_command(graph, target, cmd, arg, res, res_len, flags | AVFILTER_CMD_FLAG_FAST);
         if (r != AVERROR(ENOSYS))
             return r;
     }
@@ -1481,13 +1565,10 @@ int avfilter_graph_send_command(AVFilterGraph *graph, const char *target, const
     return r;
 }
 
-int avfilter_graph_queue_command(AVFilterGraph *graph, const char *target, const char *command, const char *arg, int flags, double ts)
+static int graph_queue_command(AVFilterGraph *graph, const char *target, const char *command, const char *arg, int flags, double ts)
 {
     int i;
 
-    if(!graph)
-        return 0;
-
     for (i = 0; i < graph->nb_filters; i++) {
         AVFilterContext *filter = graph->filters[i];
         FFFilterContext *ctxi   = fffilterctx(filter);
@@ -1513,6 +1594,20 @@ int avfilter_graph_queue_command(AVFilterGraph *graph, const char *target, const
     return 0;
 }
 
+int avfilter_graph_queue_command(AVFilterGraph *graph, const char *target, const char *command, const char *arg, int flags, double ts)
+{
+    int ret;
+
+    if(!graph)
+        return 0;
+
+    ff_graph_pipeline_pause(fffiltergraph(graph));
+    ret = graph_queue_command(graph, target, command, arg, flags, ts);
+    ff_graph_pipeline_resume(fffiltergraph(graph));
+
+    return ret;
+}
+
 static void heap_bubble_up(FFFilterGraph *graph,
                            FilterLinkInternal *li, int index)
 {
@@ -1564,16 +1659,43 @@ void ff_avfilter_graph_update_heap(AVFilterGraph *graph, FilterLinkInternal *li)
     heap_bubble_down(graphi, li, li->age_index);
 }
 
+static FilterLinkInternal *heap_get_oldest(FFFilterGraph *graph)
+{
+    FilterLinkInternal *li;
+
+    ff_graph_pipeline_lock(graph);
+    li = graph->sink_links_count ? graph->sink_links[0] : NULL;
+    ff_graph_pipeline_unlock(graph);
+
+    return li;
+}
+
+static void heap_remove(FFFilterGraph *graph, FilterLinkInternal *li)
+{
+    FilterLinkInternal *last;
+    int index;
+
+    ff_graph_pipeline_lock(graph);
+    /* with pipeline threads, the link may have moved in the meantime */
+    index = li->age_index;
+    last  = graph->sink_links[--graph->sink_links_count];
+    if (index < graph->sink_links_count) {
+        heap_bubble_up  (graph, last, index);
+        heap_bubble_down(graph, last, last->age_index);
+    }
+    li->age_index = -1;
+    ff_graph_pipeline_unlock(graph);
+}
+
 int avfilter_graph_request_oldest(AVFilterGraph *graph)
 {
     FFFilterGraph *graphi = fffiltergraph(graph);
-    FilterLinkInternal *oldesti = graphi->sink_links[0];
-    AVFilterLink *oldest = &oldesti->l.pub;
+    FilterLinkInternal *oldesti;
+    AVFilterLink *oldest;
     int64_t frame_count;
-    int r;
+    int r, ret = 0;
 
-    while (graphi->sink_links_count) {
-        oldesti = graphi->sink_links[0];
+    while ((oldesti = heap_get_oldest(graphi))) {
         oldest  = &oldesti->l.pub;
         if (fffilter(oldest->dst->filter)->activate) {
             r = av_buffersink_get_frame_flags(oldest->dst, NULL,
@@ -1581,7 +1703,9 @@ int avfilter_graph_request_oldest(AVFilterGraph *graph)
             if (r != AVERROR_EOF)
                 return r;
         } else {
+            ff_graph_pipeline_acquire(oldest->dst);
             r = ff_request_frame(oldest);
+            ff_graph_pipeline_release(oldest->dst);
         }
         if (r != AVERROR_EOF)
             break;
@@ -1589,28 +1713,32 @@ int avfilter_graph_request_oldest(AVFilterGraph *graph)
                oldest->dst->name,
                oldest->dstpad->name);
         /* EOF: remove the link from the heap */
-        if (oldesti->age_index < --graphi->sink_links_count)
-            heap_bubble_down(graphi, graphi->sink_links[graphi->sink_links_count],
-                             oldesti->age_index);
-        oldesti->age_index = -1;
+        heap_remove(graphi, oldesti);
     }
-    if (!graphi->sink_links_count)
+    if (!oldesti)
         return AVERROR_EOF;
     av_assert1(!fffilter(oldest->dst->filter)->activate);
     av_assert1(oldesti->age_index >= 0);
+    ff_graph_pipeline_acquire(oldest->dst);
     frame_count = oldesti->l.frame_count_out;
     while (frame_count == oldesti->l.frame_count_out) {
+        ff_graph_pipeline_release(oldest->dst);
         r = ff_filter_graph_run_once(graph);
+        ff_graph_pipeline_acquire(oldest->dst);
         if (r == FFERROR_BUFFERSRC_EMPTY)
             r = 0;
         if (r == AVERROR(EAGAIN) &&
-            !oldesti->frame_wanted_out && !oldesti->frame_blocked_in &&
+            !oldesti->frame_wanted_out &&
+            !atomic_load_explicit(&oldesti->frame_blocked_in, memory_order_relaxed) &&
             !oldesti->status_in)
             (void)ff_request_frame(oldest);
-        else if (r < 0)
-            return r;
+        else if (r < 0) {
+            ret = r;
+            break;
+        }
     }
-    return 0;
+    ff_graph_pipeline_release(oldest->dst);
+    return ret;
 }
 
 int ff_filter_graph_run_once(AVFilterGraph *graph)
@@ -1618,6 +1746,9 @@ int ff_filter_graph_run_once(AVFilterGraph *graph)
     FFFilterContext *ctxi;
     unsigned i;
 
+    if (fffiltergraph(graph)->pipeline)
+        return ff_graph_pipeline_run(fffiltergraph(graph));
+
     av_assert0(graph->nb_filters);
     ctxi = fffilterctx(graph->filters[0]);
     for (i = 1; i < graph->nb_filters; i++) {
@@ -1629,5 +1760,6 @@ int ff_filter_graph_run_once(AVFilterGraph *graph)
 
     if (!ctxi->ready)
         return AVERROR(EAGAIN);
+    ctxi->ready = 0;
     return ff_filter_activate(&ctxi->p);
 }
@@ -110,7 +110,8 @@ static int return_or_keep_frame(BufferSinkContext *buf, AVFrame *out, AVFrame *i
     }
 }
 
-static int get_frame_internal(AVFilterContext *ctx, AVFrame *frame, int flags, int samples)
+/* called with the sink acquired from the pipeline threads, if any */
+static int get_frame_acquired(AVFilterContext *ctx, AVFrame *frame, int flags, int samples)
 {
     BufferSinkContext *buf = ctx->priv;
     AVFilterLink *inlink = ctx->inputs[0];
@@ -136,7 +137,9 @@ static int get_frame_internal(AVFilterContext *ctx, AVFrame *frame, int flags, i
         } else if ((flags & AV_BUFFERSINK_FLAG_NO_REQUEST)) {
             return AVERROR(EAGAIN);
         } else if (li->frame_wanted_out) {
+            ff_graph_pipeline_release(ctx);
             ret = ff_filter_graph_run_once(ctx->graph);
+            ff_graph_pipeline_acquire(ctx);
             if (ret == FFERROR_BUFFERSRC_EMPTY) {
                 buffersrc_empty = 1;
             } else if (ret == AVERROR(EAGAIN)) {
@@ -152,6 +155,17 @@ static int get_frame_internal(AVFilterContext *ctx, AVFrame *frame, int flags, i
     }
 }
 
+static int get_frame_internal(AVFilterContext *ctx, AVFrame *frame, int flags, int samples)
+{
+    int ret;
+
+    ff_graph_pipeline_acquire(ctx);
+    ret = get_frame_acquired(ctx, frame, flags, samples);
+    ff_graph_pipeline_release(ctx);
+
+    return ret;
+}
+
 int attribute_align_arg av_buffersink_get_frame_flags(AVFilterContext *ctx, AVFrame *frame, int flags)
 {
     return get_frame_internal(ctx, frame, flags,
@@ -206,7 +206,16 @@ static int push_frame(AVFilterGraph *graph)
     return 0;
 }
 
-int attribute_align_arg av_buffersrc_add_frame_flags(AVFilterContext *ctx, AVFrame *frame, int flags)
+static void close_acquired(AVFilterContext *ctx, int64_t pts)
+{
+    BufferSourceContext *s = ctx->priv;
+
+    s->eof = 1;
+    ff_avfilter_link_set_in_status(ctx->outputs[0], AVERROR_EOF, pts);
+}
+
+/* called with the source acquired from the pipeline threads, if any */
+static int add_frame_acquired(AVFilterContext *ctx, AVFrame *frame, int flags)
 {
     BufferSourceContext *s = ctx->priv;
     AVFrame *copy;
@@ -214,8 +223,10 @@ int attribute_align_arg av_buffersrc_add_frame_flags(AVFilterContext *ctx, AVFra
 
     s->nb_failed_requests = 0;
 
-    if (!frame)
-        return av_buffersrc_close(ctx, s->last_pts, flags);
+    if (!frame) {
+        close_acquired(ctx, s->last_pts);
+        return 0;
+    }
     if (s->eof)
         return AVERROR_EOF;
 
@@ -264,7 +275,16 @@ int attribute_align_arg av_buffersrc_add_frame_flags(AVFilterContext *ctx, AVFra
     if (copy->alpha_mode == AVALPHA_MODE_UNSPECIFIED)
         copy->alpha_mode = ctx->outputs[0]->alpha_mode;
 
-    ret = ff_filter_frame(ctx->outputs[0], copy);
+    return ff_filter_frame(ctx->outputs[0], copy);
+}
+
+int attribute_align_arg av_buffersrc_add_frame_flags(AVFilterContext *ctx, AVFrame *frame, int flags)
+{
+    int ret;
+
+    ff_graph_pipeline_acquire(ctx);
+    ret = add_frame_acquired(ctx, frame, flags);
+    ff_graph_pipeline_release(ctx);
     if (ret < 0)
         return ret;
 
@@ -272,6 +292,9 @@ int attribute_align_arg av_buffersrc_add_frame_flags(AVFilterContext *ctx, AVFra
         ret = push_frame(ctx->graph);
         if (ret < 0)
             return ret;
+    } else {
+        /* do not let the pipeline threads fall behind too much */
+        ff_graph_pipeline_throttle(fffiltergraph(ctx->graph));
     }
 
     return 0;
@@ -279,21 +302,24 @@ int attribute_align_arg av_buffersrc_add_frame_flags(AVFilterContext *ctx, AVFra
 
 int av_buffersrc_close(AVFilterContext *ctx, int64_t pts, unsigned flags)
 {
-    BufferSourceContext *s = ctx->priv;
-
-    s->eof = 1;
-    ff_avfilter_link_set_in_status(ctx->outputs[0], AVERROR_EOF, pts);
+    ff_graph_pipeline_acquire(ctx);
+    close_acquired(ctx, pts);
+    ff_graph_pipeline_release(ctx);
     return (flags & AV_BUFFERSRC_FLAG_PUSH) ? push_frame(ctx->graph) : 0;
 }
 
 int av_buffersrc_get_status(AVFilterContext *ctx)
 {
     BufferSourceContext *s = ctx->priv;
+    int eof;
 
+    ff_graph_pipeline_acquire(ctx);
     if (!s->eof && ff_outlink_get_status(ctx->outputs[0]))
         s->eof = 1;
+    eof = s->eof;
+    ff_graph_pipeline_release(ctx);
 
-    return s->eof ? AVERROR(EOF) : 0;
+    return eof ? AVERROR(EOF) : 0;
 }
 
 static av_cold int init_video(AVFilterContext *ctx)
@@ -332,7 +358,13 @@ static av_cold int init_video(AVFilterContext *ctx)
 
 unsigned av_buffersrc_get_nb_failed_requests(AVFilterContext *buffer_src)
 {
-    return ((BufferSourceContext *)buffer_src->priv)->nb_failed_requests;
+    unsigned ret;
+
+    ff_graph_pipeline_acquire(buffer_src);
+    ret = ((BufferSourceContext *)buffer_src->priv)->nb_failed_requests;
+    ff_graph_pipeline_release(buffer_src);
+
+    return ret;
 }
 
 #define OFFSET(x) offsetof(BufferSourceContext, x)
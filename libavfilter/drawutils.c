@@ -21,6 +21,8 @@
 
 #include <string.h>
 
+#include "config.h"
+
 #include "libavutil/avassert.h"
 #include "libavutil/avutil.h"
 #include "libavutil/csp.h"
@@ -162,6 +164,10 @@ int ff_draw_init2(FFDrawContext *draw, enum AVPixelFormat format, enum AVColorSp
     memcpy(draw->pixelstep, pixelstep, sizeof(draw->pixelstep));
     draw->hsub[1] = draw->hsub[2] = draw->hsub_max = desc->log2_chroma_w;
     draw->vsub[1] = draw->vsub[2] = draw->vsub_max = desc->log2_chroma_h;
+    draw->blend_mask_line = ff_blend_mask_line_c;
+#if ARCH_X86 && HAVE_X86ASM
+    ff_draw_init_x86(draw);
+#endif
     return 0;
 }
 
@@ -506,6 +512,15 @@ static void blend_pixel(uint8_t *dst, unsigned src, unsigned alpha,
     *dst = ((0x1010101 - alpha) * *dst + alpha * src) >> 24;
 }
 
+void ff_blend_mask_line_c(uint8_t *dst, const uint8_t *mask, int w,
+                          unsigned src, unsigned alpha)
+{
+    for (int x = 0; x < w; x++) {
+        unsigned a = mask[x] * alpha;
+        dst[x] = ((0x1010101 - a) * dst[x] + a * src) >> 24;
+    }
+}
+
 static void blend_line_hv16(uint8_t *dst, int dst_delta,
                             unsigned src, unsigned alpha,
                             const uint8_t *mask, int mask_linesize, int l2depth, int w,
@@ -615,7 +630,15 @@ void ff_blend_mask(FFDrawContext *draw, FFDrawColor *color,
                 p += dst_linesize[plane];
                 m += top * mask_linesize;
             }
-            if (depth <= 8) {
+            if (depth <= 8 && l2depth == 3 && draw->pixelstep[plane] == 1 &&
+                !draw->hsub[plane] && !draw->vsub[plane]) {
+                for (int y = 0; y < h_sub; y++) {
+                    draw->blend_mask_line(p, m + xm0, w_sub,
+                                          color->comp[plane].u8[index], alpha);
+                    p += dst_linesize[plane];
+                    m += mask_linesize;
+                }
+            } else if (depth <= 8) {
                 for (int y = 0; y < h_sub; y++) {
                     blend_line_hv(p, draw->pixelstep[plane],
                                   color->comp[plane].u8[index], alpha,
@@ -47,6 +47,14 @@ typedef struct FFDrawContext {
     enum AVColorSpace csp;
     enum AVAlphaMode alpha;
     double rgb2yuv[3][3];
+
+    /**
+     * Blend a line of 8-bit samples with the value src through an 8-bit mask,
+     * as done by ff_blend_mask() on a plane without subsampling nor
+     * interleaving; alpha is in the [ 0 ; 0x10203 ] range.
+     */
+    void (*blend_mask_line)(uint8_t *dst, const uint8_t *mask, int w,
+                            unsigned src, unsigned alpha);
 } FFDrawContext;
 
 typedef struct FFDrawColor {
@@ -93,6 +101,11 @@ int ff_draw_init_from_link(FFDrawContext *draw, const AVFilterLink *link,
  */
 int ff_draw_init(FFDrawContext *draw, enum AVPixelFormat format, unsigned flags);
 
+void ff_draw_init_x86(FFDrawContext *draw);
+
+void ff_blend_mask_line_c(uint8_t *dst, const uint8_t *mask, int w,
+                          unsigned src, unsigned alpha);
+
 
 
 /**
@@ -77,6 +77,20 @@ struct integrator {
 
 struct rect { int x, y, w, h; };
 
+/**
+ * Per-channel filter state (biquad history and window sums) is kept in
+ * "lanes": the channels of each job are contiguous, and consecutive jobs
+ * are separated by LANE_PAD unused lanes so that no two threads ever write
+ * to the same cache line. The windowed sample caches are instead split into
+ * one contiguous block per job.
+ */
+#define LANE_PAD 8
+
+typedef struct ThreadData {
+    const double *samples;
+    int nb_samples;
+} ThreadData;
+
 typedef struct EBUR128Context {
     const AVClass *class;           ///< AVClass context for log and options purpose
     EBUR128DSPContext dsp;
@@ -110,7 +124,9 @@ typedef struct EBUR128Context {
 
     /* audio */
     int nb_channels;                ///< number of channels in the input
-    double *ch_weighting;           ///< channel weighting mapping
+    int nb_jobs;                    ///< number of channel groups filtered in parallel
+    int nb_lanes;                   ///< number of per-channel state slots, including the padding between groups
+    double *ch_weighting;           ///< channel weighting mapping, indexed by lane
     int sample_count;               ///< sample count used for refresh frequency, reset at refresh
     int nb_samples;                 ///< number of samples to consume per single input frame
     int idx_insample;               ///< current sample position of processed samples in single input frame
@@ -426,6 +442,14 @@ static int config_audio_input(AVFilterLink *inlink)
     return 0;
 }
 
+static int channel_job(const EBUR128Context *ebur128, int ch)
+{
+    int jobnr = 0;
+    while (ch >= ebur128->nb_channels * (jobnr + 1) / ebur128->nb_jobs)
+        jobnr++;
+    return jobnr;
+}
+
 static int config_audio_output(AVFilterLink *outlink)
 {
     int i;
@@ -439,9 +463,11 @@ static int config_audio_output(AVFilterLink *outlink)
                    AV_CH_SURROUND_DIRECT_LEFT               |AV_CH_SURROUND_DIRECT_RIGHT)
 
     ebur128->nb_channels  = nb_channels;
-    ebur128->dsp.y        = av_calloc(nb_channels, 3 * sizeof(*ebur128->dsp.y));
-    ebur128->dsp.z        = av_calloc(nb_channels, 3 * sizeof(*ebur128->dsp.z));
-    ebur128->ch_weighting = av_calloc(nb_channels, sizeof(*ebur128->ch_weighting));
+    ebur128->nb_jobs      = FFMIN(ff_filter_get_nb_threads(ctx), nb_channels);
+    ebur128->nb_lanes     = nb_channels + (ebur128->nb_jobs - 1) * LANE_PAD;
+    ebur128->dsp.y        = av_calloc(ebur128->nb_lanes, 3 * sizeof(*ebur128->dsp.y));
+    ebur128->dsp.z        = av_calloc(ebur128->nb_lanes, 3 * sizeof(*ebur128->dsp.z));
+    ebur128->ch_weighting = av_calloc(ebur128->nb_lanes, sizeof(*ebur128->ch_weighting));
     if (!ebur128->ch_weighting || !ebur128->dsp.y || !ebur128->dsp.z)
         return AVERROR(ENOMEM);
 
@@ -450,8 +476,8 @@ static int config_audio_output(AVFilterLink *outlink)
 
     ebur128->i400.cache_size = I400_BINS(outlink->sample_rate);
     ebur128->i3000.cache_size = I3000_BINS(outlink->sample_rate);
-    ebur128->i400.sum = av_calloc(nb_channels, sizeof(*ebur128->i400.sum));
-    ebur128->i3000.sum = av_calloc(nb_channels, sizeof(*ebur128->i3000.sum));
+    ebur128->i400.sum = av_calloc(ebur128->nb_lanes, sizeof(*ebur128->i400.sum));
+    ebur128->i3000.sum = av_calloc(ebur128->nb_lanes, sizeof(*ebur128->i3000.sum));
     ebur128->i400.cache = av_calloc(nb_channels * ebur128->i400.cache_size, sizeof(*ebur128->i400.cache));
     ebur128->i3000.cache = av_calloc(nb_channels * ebur128->i3000.cache_size, sizeof(*ebur128->i3000.cache));
     if (!ebur128->i400.sum || !ebur128->i3000.sum ||
@@ -461,12 +487,14 @@ static int config_audio_output(AVFilterLink *outlink)
     for (i = 0; i < nb_channels; i++) {
         /* channel weighting */
         const enum AVChannel chl = av_channel_layout_channel_from_index(&outlink->ch_layout, i);
+        const int jobnr = channel_job(ebur128, i);
+        const int lane  = i + jobnr * LANE_PAD;
         if (chl == AV_CHAN_LOW_FREQUENCY || chl == AV_CHAN_LOW_FREQUENCY_2) {
-            ebur128->ch_weighting[i] = 0;
+            ebur128->ch_weighting[lane] = 0;
         } else if (chl < 64 && (1ULL << chl) & BACK_MASK) {
-            ebur128->ch_weighting[i] = 1.41;
+            ebur128->ch_weighting[lane] = 1.41;
         } else {
-            ebur128->ch_weighting[i] = 1.0;
+            ebur128->ch_weighting[lane] = 1.0;
         }
     }
 
@@ -667,6 +695,51 @@ double ff_ebur128_find_peak_c(double *restrict ch_peaks, const int nb_channels,
     return maxpeak;
 }
 
+static int filter_channels_slice(AVFilterContext *ctx, void *arg, int jobnr, int nb_jobs)
+{
+    const EBUR128Context *ebur128 = ctx->priv;
+    const ThreadData *td = arg;
+    const int nb_channels = ebur128->nb_channels;
+    const int ch_start = nb_channels *  jobnr      / nb_jobs;
+    const int ch_end   = nb_channels * (jobnr + 1) / nb_jobs;
+    const int nb_job_channels = ch_end - ch_start;
+    const int lane = ch_start + jobnr * LANE_PAD;
+    const double *samples = td->samples + ch_start;
+    double *cache_400  = ebur128->i400.cache  + ch_start * ebur128->i400.cache_size;
+    double *cache_3000 = ebur128->i3000.cache + ch_start * ebur128->i3000.cache_size;
+    int pos_400  = ebur128->i400.cache_pos;
+    int pos_3000 = ebur128->i3000.cache_pos;
+    EBUR128DSPContext dsp = ebur128->dsp;
+
+    dsp.y += 3 * lane;
+    dsp.z += 3 * lane;
+
+    for (int i = 0; i < td->nb_samples; i++) {
+        dsp.filter_channels(&dsp, samples,
+                            &cache_400 [pos_400  * nb_job_channels],
+                            &cache_3000[pos_3000 * nb_job_channels],
+                            &ebur128->i400.sum[lane], &ebur128->i3000.sum[lane],
+                            nb_job_channels);
+        samples += nb_channels;
+
+        if (++pos_400 == ebur128->i400.cache_size)
+            pos_400 = 0;
+        if (++pos_3000 == ebur128->i3000.cache_size)
+            pos_3000 = 0;
+    }
+
+    return 0;
+}
+
+static void advance_cache(struct integrator *integ, int nb_samples)
+{
+    integ->cache_pos += nb_samples;
+    if (integ->cache_pos >= integ->cache_size) {
+        integ->filled     = 1;
+        integ->cache_pos -= integ->cache_size;
+    }
+}
+
 static int filter_frame(AVFilterLink *inlink, AVFrame *insamples)
 {
     int ret;
@@ -709,29 +782,23 @@ static int filter_frame(AVFilterLink *inlink, AVFrame *insamples)
     }
 
     for (int idx_insample = ebur128->idx_insample; idx_insample < nb_samples; idx_insample++) {
-        const int bin_id_400  = ebur128->i400.cache_pos++;
-        const int bin_id_3000 = ebur128->i3000.cache_pos++;
-
-        if (ebur128->i400.cache_pos == ebur128->i400.cache_size) {
-            ebur128->i400.filled    = 1;
-            ebur128->i400.cache_pos = 0;
-        }
+        /* For integrated loudness, gating blocks are 400ms long with 75%
+         * overlap (see BS.1770-2 p5), so a re-computation is needed each 100ms
+         * (4800 samples at 48kHz). Filter everything up to the next block
+         * boundary at once, with the channels split across the jobs. */
+        const int block_size = FFMAX(inlink->sample_rate / 10, 1);
+        ThreadData td;
 
-        if (ebur128->i3000.cache_pos == ebur128->i3000.cache_size) {
-            ebur128->i3000.filled    = 1;
-            ebur128->i3000.cache_pos = 0;
-        }
+        td.samples    = &samples[idx_insample * nb_channels];
+        td.nb_samples = FFMIN(nb_samples - idx_insample, block_size - ebur128->sample_count);
+        ff_filter_execute(ctx, filter_channels_slice, &td, NULL, ebur128->nb_jobs);
 
-        dsp->filter_channels(dsp, &samples[idx_insample * nb_channels],
-                             &ebur128->i400.cache[bin_id_400 * nb_channels],
-                             &ebur128->i3000.cache[bin_id_3000 * nb_channels],
-                             ebur128->i400.sum, ebur128->i3000.sum,
-                             nb_channels);
+        advance_cache(&ebur128->i400,  td.nb_samples);
+        advance_cache(&ebur128->i3000, td.nb_samples);
+        idx_insample += td.nb_samples - 1;
+        ebur128->sample_count += td.nb_samples;
 
-        /* For integrated loudness, gating blocks are 400ms long with 75%
-         * overlap (see BS.1770-2 p5), so a re-computation is needed each 100ms
-         * (4800 samples at 48kHz). */
-        if (++ebur128->sample_count == inlink->sample_rate / 10) {
+        if (ebur128->sample_count == block_size) {
             double loudness_400, loudness_3000;
             double power_400 = 1e-12, power_3000 = 1e-12;
             AVFilterLink *outlink = ctx->outputs[0];
@@ -744,8 +811,8 @@ static int filter_frame(AVFilterLink *inlink, AVFrame *insamples)
 #define COMPUTE_LOUDNESS(m, time) do {                                              \
     if (ebur128->i##time.filled) {                                                  \
         /* weighting sum of the last <time> ms */                                   \
-        for (int ch = 0; ch < nb_channels; ch++)                                    \
-            power_##time += ebur128->ch_weighting[ch] * ebur128->i##time.sum[ch];   \
+        for (int i = 0; i < ebur128->nb_lanes; i++)                                 \
+            power_##time += ebur128->ch_weighting[i] * ebur128->i##time.sum[i];     \
         power_##time /= I##time##_BINS(inlink->sample_rate);                        \
     }                                                                               \
     loudness_##time = LOUDNESS(power_##time);                                       \
@@ -1110,7 +1177,8 @@ const FFFilter ff_af_ebur128 = {
     .p.description = NULL_IF_CONFIG_SMALL("EBU R128 scanner."),
     .p.outputs     = NULL,
     .p.priv_class  = &ebur128_class,
-    .p.flags       = AVFILTER_FLAG_DYNAMIC_OUTPUTS,
+    .p.flags       = AVFILTER_FLAG_DYNAMIC_OUTPUTS |
+                     AVFILTER_FLAG_SLICE_THREADS,
     .priv_size     = sizeof(EBUR128Context),
     .init          = init,
     .uninit        = uninit,
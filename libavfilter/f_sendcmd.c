@@ -564,10 +564,10 @@ static int filter_frame(AVFilterLink *inlink, AVFrame *ref)
                     av_log(ctx, AV_LOG_VERBOSE,
                            "Processing command #%d target:%s command:%s arg:%s\n",
                            cmd->index, cmd->target, cmd->command, cmd_arg);
-                    ret = avfilter_graph_send_command(inl->graph,
-                                                      cmd->target, cmd->command, cmd_arg,
-                                                      buf, sizeof(buf),
-                                                      AVFILTER_CMD_FLAG_ONE);
+                    ret = ff_filter_graph_send_command(inl->graph,
+                                                       cmd->target, cmd->command, cmd_arg,
+                                                       buf, sizeof(buf),
+                                                       AVFILTER_CMD_FLAG_ONE);
                     av_log(ctx, AV_LOG_VERBOSE,
                            "Command reply for command #%d: ret:%s res:%s\n",
                            cmd->index, av_err2str(ret), buf);
@@ -608,6 +608,7 @@ const FFFilter ff_vf_sendcmd = {
     .init        = init,
     .uninit      = uninit,
     .priv_size   = sizeof(SendCmdContext),
+    .flags_internal = FF_FILTER_FLAG_EXCLUSIVE,
     FILTER_INPUTS(sendcmd_inputs),
     FILTER_OUTPUTS(ff_video_default_filterpad),
 };
@@ -632,6 +633,7 @@ const FFFilter ff_af_asendcmd = {
     .init        = init,
     .uninit      = uninit,
     .priv_size   = sizeof(SendCmdContext),
+    .flags_internal = FF_FILTER_FLAG_EXCLUSIVE,
     FILTER_INPUTS(asendcmd_inputs),
     FILTER_OUTPUTS(ff_audio_default_filterpad),
 };
@@ -176,10 +176,10 @@ static int filter_frame(AVFilterLink *inlink, AVFrame *ref)
         av_log(ctx, AV_LOG_VERBOSE,
                "Processing command #%d target:%s command:%s arg:%s\n",
                zmq->command_count, cmd.target, cmd.command, cmd.arg);
-        ret = avfilter_graph_send_command(ff_filter_link(inlink)->graph,
-                                          cmd.target, cmd.command, cmd.arg,
-                                          cmd_buf, sizeof(cmd_buf),
-                                          AVFILTER_CMD_FLAG_ONE);
+        ret = ff_filter_graph_send_command(ff_filter_link(inlink)->graph,
+                                           cmd.target, cmd.command, cmd.arg,
+                                           cmd_buf, sizeof(cmd_buf),
+                                           AVFILTER_CMD_FLAG_ONE);
         send_buf = av_asprintf("%d %s%s%s",
                                -ret, av_err2str(ret), cmd_buf[0] ? "\n" : "", cmd_buf);
         if (!send_buf) {
@@ -224,6 +224,7 @@ const FFFilter ff_vf_zmq = {
     .init        = init,
     .uninit      = uninit,
     .priv_size   = sizeof(ZMQContext),
+    .flags_internal = FF_FILTER_FLAG_EXCLUSIVE,
     FILTER_INPUTS(zmq_inputs),
     FILTER_OUTPUTS(ff_video_default_filterpad),
 };
@@ -247,6 +248,7 @@ const FFFilter ff_af_azmq = {
     .init        = init,
     .uninit      = uninit,
     .priv_size   = sizeof(ZMQContext),
+    .flags_internal = FF_FILTER_FLAG_EXCLUSIVE,
     FILTER_INPUTS(azmq_inputs),
     FILTER_OUTPUTS(ff_audio_default_filterpad),
 };
@@ -207,6 +207,20 @@ static inline FilterLink* ff_filter_link(AVFilterLink *link)
  */
 #define FF_FILTER_FLAG_HWFRAME_AWARE (1 << 0)
 
+/**
+ * The filter accesses other filters of the graph while processing, so it
+ * must not run concurrently with any of them.
+ */
+#define FF_FILTER_FLAG_EXCLUSIVE (1 << 1)
+
+/**
+ * avfilter_graph_send_command() for use by filters with
+ * FF_FILTER_FLAG_EXCLUSIVE.
+ */
+int ff_filter_graph_send_command(AVFilterGraph *graph, const char *target,
+                                 const char *cmd, const char *arg,
+                                 char *res, int res_len, int flags);
+
 /**
  * Find the index of a link.
  *
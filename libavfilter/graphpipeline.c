@@ -0,0 +1,434 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/**
+ * @file
+ * Pipeline-parallel filter graph execution
+ *
+ * A pool of threads activates the filters of the graph that are ready, in
+ * the same order of priority as ff_filter_graph_run_once(). Two filters
+ * sharing a link are never busy at the same time, so every link is only
+ * accessed by one side at a time and activate() sees the same state as in
+ * serial execution. The caller reserves the buffer sources and sinks the
+ * same way before feeding or draining them. Only the ready status of the
+ * filters and a few graph-wide fields are shared between busy filters;
+ * they are guarded by the pipeline lock. The filters that are ready are kept
+ * in a list ordered by priority, so that picking the next one only looks at
+ * those instead of at the whole graph.
+ *
+ * The frame queues of the links between the threads are bounded by
+ * AVFilterGraph.pipeline_queue, which throttles the caller when it feeds
+ * frames faster than the graph can process them.
+ */
+
+#include <stdatomic.h>
+#include <string.h>
+
+#include "libavutil/avassert.h"
+#include "libavutil/error.h"
+#include "libavutil/internal.h"
+#include "libavutil/log.h"
+#include "libavutil/mem.h"
+#include "libavutil/thread.h"
+
+#include "avfilter.h"
+#include "avfilter_internal.h"
+#include "filters.h"
+
+typedef struct GraphPipeline {
+    AVFilterGraph *graph;
+
+    pthread_mutex_t lock;
+    pthread_cond_t  work_cond;  ///< signaled when a filter may be activated
+    pthread_cond_t  done_cond;  ///< signaled when a filter is no longer busy
+
+    pthread_t *workers;
+    int     nb_workers;
+    int     exit;
+
+    /**
+     * Filters with nonzero ready, by decreasing priority and in the order they
+     * became ready for the same priority.
+     */
+    FFFilterContext **ready;
+    unsigned nb_ready;
+    unsigned ready_size;
+    unsigned nb_busy;           ///< number of filters with busy set
+    int      exclusive;         ///< a FF_FILTER_FLAG_EXCLUSIVE filter is busy
+    int      paused;
+
+    uint64_t nb_activations;
+    uint64_t nb_activations_seen; ///< value seen by ff_graph_pipeline_run()
+    int      src_empty;
+    int      error;
+} GraphPipeline;
+
+static int is_exclusive(const AVFilterContext *ctx)
+{
+    return fffilter(ctx->filter)->flags_internal & FF_FILTER_FLAG_EXCLUSIVE;
+}
+
+static int can_acquire(const GraphPipeline *p, AVFilterContext *ctx)
+{
+    if (fffilterctx(ctx)->busy || p->paused || p->exclusive)
+        return 0;
+    if (is_exclusive(ctx))
+        return !p->nb_busy;
+
+    for (unsigned i = 0; i < ctx->nb_inputs; i++)
+        if (ctx->inputs[i] && fffilterctx(ctx->inputs[i]->src)->busy)
+            return 0;
+    for (unsigned i = 0; i < ctx->nb_outputs; i++)
+        if (ctx->outputs[i] && fffilterctx(ctx->outputs[i]->dst)->busy)
+            return 0;
+
+    return 1;
+}
+
+static void set_busy(GraphPipeline *p, AVFilterContext *ctx)
+{
+    fffilterctx(ctx)->busy = 1;
+    p->nb_busy++;
+    if (is_exclusive(ctx))
+        p->exclusive = 1;
+}
+
+static void clear_busy(GraphPipeline *p, AVFilterContext *ctx)
+{
+    fffilterctx(ctx)->busy = 0;
+    p->nb_busy--;
+    if (is_exclusive(ctx))
+        p->exclusive = 0;
+
+    /* the neighbours may have become available */
+    pthread_cond_broadcast(&p->work_cond);
+    pthread_cond_broadcast(&p->done_cond);
+}
+
+static int is_idle(const GraphPipeline *p)
+{
+    return !p->nb_ready && !p->nb_busy;
+}
+
+static void ready_insert(GraphPipeline *p, FFFilterContext *ctxi)
+{
+    unsigned pos = p->nb_ready;
+
+    av_assert1(p->nb_ready < p->ready_size);
+    while (pos && p->ready[pos - 1]->ready < ctxi->ready)
+        pos--;
+    memmove(&p->ready[pos + 1], &p->ready[pos],
+            (p->nb_ready - pos) * sizeof(*p->ready));
+    p->ready[pos] = ctxi;
+    p->nb_ready++;
+}
+
+static void ready_remove(GraphPipeline *p, unsigned pos)
+{
+    p->nb_ready--;
+    memmove(&p->ready[pos], &p->ready[pos + 1],
+            (p->nb_ready - pos) * sizeof(*p->ready));
+}
+
+static int ready_alloc(GraphPipeline *p, unsigned nb_filters)
+{
+    FFFilterContext **ready;
+
+    if (nb_filters <= p->ready_size)
+        return 0;
+
+    ready = av_realloc_array(p->ready, nb_filters, sizeof(*ready));
+    if (!ready)
+        return AVERROR(ENOMEM);
+    p->ready      = ready;
+    p->ready_size = nb_filters;
+    return 0;
+}
+
+/* take the filter with the highest priority that can run now off the list */
+static AVFilterContext *pick_filter(GraphPipeline *p)
+{
+    for (unsigned i = 0; i < p->nb_ready; i++) {
+        FFFilterContext *ctxi = p->ready[i];
+
+        if (can_acquire(p, &ctxi->p)) {
+            ready_remove(p, i);
+            ctxi->ready = 0;
+            return &ctxi->p;
+        }
+    }
+
+    return NULL;
+}
+
+static void * attribute_align_arg worker(void *arg)
+{
+    GraphPipeline *p = arg;
+
+    pthread_mutex_lock(&p->lock);
+    while (!p->exit) {
+        AVFilterContext *ctx = pick_filter(p);
+        int ret;
+
+        if (!ctx) {
+            pthread_cond_wait(&p->work_cond, &p->lock);
+            continue;
+        }
+
+        set_busy(p, ctx);
+        pthread_mutex_unlock(&p->lock);
+
+        ret = ff_filter_activate(ctx);
+
+        pthread_mutex_lock(&p->lock);
+        clear_busy(p, ctx);
+        p->nb_activations++;
+        if (ret == FFERROR_BUFFERSRC_EMPTY)
+            p->src_empty = 1;
+        else if (ret < 0 && ret != AVERROR(EAGAIN) && !p->error)
+            p->error = ret;
+    }
+    pthread_mutex_unlock(&p->lock);
+
+    return NULL;
+}
+
+void ff_graph_pipeline_set_ready(FFFilterGraph *graph, AVFilterContext *filter,
+                                 unsigned priority)
+{
+    GraphPipeline *p = graph->pipeline;
+    FFFilterContext *ctxi = fffilterctx(filter);
+
+    pthread_mutex_lock(&p->lock);
+    if (priority > ctxi->ready) {
+        if (ctxi->ready) {
+            unsigned pos = 0;
+            while (p->ready[pos] != ctxi)
+                pos++;
+            ready_remove(p, pos);
+        } else {
+            /* the filter may have been added after the pipeline started */
+            if (p->nb_ready == p->ready_size) {
+                int ret = ready_alloc(p, FFMAX(p->graph->nb_filters, p->nb_ready + 1));
+                if (ret < 0) {
+                    if (!p->error)
+                        p->error = ret;
+                    pthread_cond_broadcast(&p->done_cond);
+                    goto end;
+                }
+            }
+            pthread_cond_signal(&p->work_cond);
+        }
+        ctxi->ready = priority;
+        ready_insert(p, ctxi);
+    }
+end:
+    pthread_mutex_unlock(&p->lock);
+}
+
+void ff_graph_pipeline_acquire(AVFilterContext *filter)
+{
+    GraphPipeline *p = fffiltergraph(filter->graph)->pipeline;
+
+    if (!p)
+        return;
+
+    pthread_mutex_lock(&p->lock);
+    while (!can_acquire(p, filter))
+        pthread_cond_wait(&p->done_cond, &p->lock);
+    set_busy(p, filter);
+    pthread_mutex_unlock(&p->lock);
+}
+
+void ff_graph_pipeline_release(AVFilterContext *filter)
+{
+    GraphPipeline *p = fffiltergraph(filter->graph)->pipeline;
+
+    if (!p)
+        return;
+
+    pthread_mutex_lock(&p->lock);
+    clear_busy(p, filter);
+    pthread_mutex_unlock(&p->lock);
+}
+
+int ff_graph_pipeline_run(FFFilterGraph *graph)
+{
+    GraphPipeline *p = graph->pipeline;
+    int ret;
+
+    pthread_mutex_lock(&p->lock);
+    while (p->nb_activations == p->nb_activations_seen &&
+           !is_idle(p) && !p->error)
+        pthread_cond_wait(&p->done_cond, &p->lock);
+
+    if (p->error) {
+        ret = p->error;
+        p->error = 0;
+    } else if (p->nb_activations != p->nb_activations_seen) {
+        ret = 0;
+    } else {
+        ret = p->src_empty ? FFERROR_BUFFERSRC_EMPTY : AVERROR(EAGAIN);
+        p->src_empty = 0;
+    }
+    p->nb_activations_seen = p->nb_activations;
+    pthread_mutex_unlock(&p->lock);
+
+    return ret;
+}
+
+void ff_graph_pipeline_throttle(FFFilterGraph *graph)
+{
+    GraphPipeline *p = graph->pipeline;
+
+    if (!p)
+        return;
+
+    pthread_mutex_lock(&p->lock);
+    while (!is_idle(p) && !p->error &&
+           atomic_load_explicit(&graph->frame_queues.queued, memory_order_relaxed) >
+           p->graph->pipeline_queue)
+        pthread_cond_wait(&p->done_cond, &p->lock);
+    pthread_mutex_unlock(&p->lock);
+}
+
+void ff_graph_pipeline_pause(FFFilterGraph *graph)
+{
+    GraphPipeline *p = graph->pipeline;
+
+    if (!p)
+        return;
+
+    pthread_mutex_lock(&p->lock);
+    p->paused++;
+    while (p->nb_busy)
+        pthread_cond_wait(&p->done_cond, &p->lock);
+    pthread_mutex_unlock(&p->lock);
+}
+
+void ff_graph_pipeline_resume(FFFilterGraph *graph)
+{
+    GraphPipeline *p = graph->pipeline;
+
+    if (!p)
+        return;
+
+    pthread_mutex_lock(&p->lock);
+    p->paused--;
+    pthread_cond_broadcast(&p->work_cond);
+    pthread_mutex_unlock(&p->lock);
+}
+
+void ff_graph_pipeline_lock(FFFilterGraph *graph)
+{
+    if (graph->pipeline)
+        pthread_mutex_lock(&graph->pipeline->lock);
+}
+
+void ff_graph_pipeline_unlock(FFFilterGraph *graph)
+{
+    if (graph->pipeline)
+        pthread_mutex_unlock(&graph->pipeline->lock);
+}
+
+void ff_graph_pipeline_free(FFFilterGraph *graph)
+{
+    GraphPipeline *p = graph->pipeline;
+
+    if (!p)
+        return;
+
+    pthread_mutex_lock(&p->lock);
+    p->exit = 1;
+    pthread_cond_broadcast(&p->work_cond);
+    pthread_mutex_unlock(&p->lock);
+
+    for (int i = 0; i < p->nb_workers; i++)
+        pthread_join(p->workers[i], NULL);
+
+    graph->pipeline = NULL;
+
+    pthread_cond_destroy(&p->done_cond);
+    pthread_cond_destroy(&p->work_cond);
+    pthread_mutex_destroy(&p->lock);
+    av_freep(&p->ready);
+    av_freep(&p->workers);
+    av_freep(&p);
+}
+
+int ff_graph_pipeline_init(FFFilterGraph *graph)
+{
+    AVFilterGraph *graphp = &graph->p;
+    GraphPipeline *p;
+    int ret;
+
+    if (graph->pipeline || graphp->pipeline_threads <= 0)
+        return 0;
+
+    p = av_mallocz(sizeof(*p));
+    if (!p)
+        return AVERROR(ENOMEM);
+    p->graph = graphp;
+
+    p->workers = av_calloc(graphp->pipeline_threads, sizeof(*p->workers));
+    if (!p->workers) {
+        ret = AVERROR(ENOMEM);
+        goto fail;
+    }
+    ret = ready_alloc(p, graphp->nb_filters);
+    if (ret < 0)
+        goto fail;
+
+    if ((ret = pthread_mutex_init(&p->lock, NULL)))
+        goto fail;
+    if ((ret = pthread_cond_init(&p->work_cond, NULL)))
+        goto fail_lock;
+    if ((ret = pthread_cond_init(&p->done_cond, NULL)))
+        goto fail_work_cond;
+
+    for (unsigned i = 0; i < graphp->nb_filters; i++) {
+        FFFilterContext *ctxi = fffilterctx(graphp->filters[i]);
+        ctxi->busy = 0;
+        if (ctxi->ready)
+            ready_insert(p, ctxi);
+    }
+
+    graph->pipeline = p;
+
+    for (; p->nb_workers < graphp->pipeline_threads; p->nb_workers++) {
+        ret = pthread_create(&p->workers[p->nb_workers], NULL, worker, p);
+        if (ret) {
+            ff_graph_pipeline_free(graph);
+            return AVERROR(ret);
+        }
+    }
+
+    av_log(graphp, AV_LOG_VERBOSE, "Running filters on %d pipeline threads\n",
+           p->nb_workers);
+
+    return 0;
+fail_work_cond:
+    pthread_cond_destroy(&p->work_cond);
+fail_lock:
+    pthread_mutex_destroy(&p->lock);
+fail:
+    av_freep(&p->ready);
+    av_freep(&p->workers);
+    av_freep(&p);
+    return ret < 0 ? ret : AVERROR(ret);
+}
@@ -27,6 +27,7 @@
 #include "libavutil/macros.h"
 #include "libavutil/mem.h"
 #include "libavutil/slicethread.h"
+#include "libavutil/thread.h"
 
 #include "avfilter.h"
 #include "avfilter_internal.h"
@@ -36,6 +37,9 @@ typedef struct ThreadContext {
     AVSliceThread *thread;
     avfilter_action_func *func;
 
+    /* serializes filters running on different pipeline threads */
+    AVMutex lock;
+
     /* per-execute parameters */
     AVFilterContext *ctx;
     void *arg;
@@ -53,6 +57,7 @@ static void worker_func(void *priv, int jobnr, int threadnr, int nb_jobs, int nb
 static void slice_thread_uninit(ThreadContext *c)
 {
     avpriv_slicethread_free(&c->thread);
+    ff_mutex_destroy(&c->lock);
 }
 
 static int thread_execute(AVFilterContext *ctx, avfilter_action_func *func,
@@ -62,21 +67,35 @@ static int thread_execute(AVFilterContext *ctx, avfilter_action_func *func,
 
     if (nb_jobs <= 0)
         return 0;
+    ff_mutex_lock(&c->lock);
     c->ctx         = ctx;
     c->arg         = arg;
     c->func        = func;
     c->rets        = ret;
 
     avpriv_slicethread_execute(c->thread, nb_jobs, 0);
+    ff_mutex_unlock(&c->lock);
     return 0;
 }
 
-static int thread_init_internal(ThreadContext *c, int nb_threads)
+static int thread_init_internal(ThreadContext *c, const AVFilterGraph *graph)
 {
-    nb_threads = avpriv_slicethread_create(&c->thread, c, worker_func, NULL, nb_threads);
-    if (nb_threads <= 1)
+    const AVSliceThreadConfig cfg = {
+        .spin_us   = graph->thread_spin,
+        .job_chunk = graph->thread_job_chunk,
+        .affinity  = graph->thread_affinity,
+    };
+    int nb_threads;
+
+    nb_threads = avpriv_slicethread_create2(&c->thread, c, worker_func, NULL,
+                                            graph->nb_threads, &cfg);
+    if (nb_threads <= 1) {
         avpriv_slicethread_free(&c->thread);
-    return FFMAX(nb_threads, 1);
+        return FFMAX(nb_threads, 1);
+    }
+
+    ff_mutex_init(&c->lock, NULL);
+    return nb_threads;
 }
 
 int ff_graph_thread_init(FFFilterGraph *graphi)
@@ -93,7 +112,7 @@ int ff_graph_thread_init(FFFilterGraph *graphi)
     if (!graphi->thread)
         return AVERROR(ENOMEM);
 
-    ret = thread_init_internal(graphi->thread, graph->nb_threads);
+    ret = thread_init_internal(graphi->thread, graph);
     if (ret <= 1) {
         av_freep(&graphi->thread);
         graph->thread_type = 0;
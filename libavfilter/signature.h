@@ -107,6 +107,8 @@ typedef struct StreamContext {
     /* overflow protection */
     int divide;
 
+    int *intjlut; /* column of the 32x32 grid for each pixel column */
+
     FineSignature* finesiglist;
     FineSignature* curfinesig;
 
@@ -134,11 +136,18 @@ typedef struct SignatureContext {
     int thcomposdist;
     int thl1;
     int thdi;
-    int thit;
+    char *index;
+    double thit;
     /* end input parameters */
 
     uint8_t l1distlut[243*242/2]; /* 243 + 242 + 241 ... */
     StreamContext* streamcontexts;
+
+    /* memory-mapped index of stored binary signatures */
+    uint8_t *index_buf;
+    size_t index_size;
+    size_t *index_offsets; /* start of each entry, followed by the end of the last one */
+    int nb_index_entries;
 } SignatureContext;
 
 
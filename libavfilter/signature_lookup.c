@@ -23,6 +23,7 @@
  * MPEG-7 video signature calculation and lookup filter
  */
 
+#include "libavutil/bprint.h"
 #include "libavutil/mem.h"
 #include "signature.h"
 
@@ -532,7 +533,9 @@ static MatchingInfo evaluate_parameters(AVFilterContext *ctx, SignatureContext *
     return bestmatch;
 }
 
-static MatchingInfo lookup_signatures(AVFilterContext *ctx, SignatureContext *sc, StreamContext *first, StreamContext *second, int mode)
+/* the stages are traced into log, if not NULL */
+static MatchingInfo lookup_signatures(AVFilterContext *ctx, SignatureContext *sc, StreamContext *first, StreamContext *second, int mode,
+                                      AVBPrint *log)
 {
     CoarseSignature *cs, *cs2;
     MatchingInfo *infos;
@@ -547,33 +550,34 @@ static MatchingInfo lookup_signatures(AVFilterContext *ctx, SignatureContext *sc
     bestmatch.meandist = 99999;
     bestmatch.whole = 0;
 
-    fill_l1distlut(sc->l1distlut);
-
     /* stage 1: coarsesignature matching */
     if (find_next_coarsecandidate(sc, second->coarsesiglist, &cs, &cs2, 1) == 0)
         return bestmatch; /* no candidate found */
     do {
-        av_log(ctx, AV_LOG_DEBUG, "Stage 1: got coarsesignature pair. "
-               "indices of first frame: %"PRIu32" and %"PRIu32"\n",
-               cs->first->index, cs2->first->index);
+        if (log) {
+            av_bprintf(log, "Stage 1: got coarsesignature pair. "
+                       "indices of first frame: %"PRIu32" and %"PRIu32"\n",
+                       cs->first->index, cs2->first->index);
+            av_bprintf(log, "Stage 2: calculate matching parameters\n");
+        }
         /* stage 2: l1-distance and hough-transform */
-        av_log(ctx, AV_LOG_DEBUG, "Stage 2: calculate matching parameters\n");
         infos = get_matching_parameters(ctx, sc, cs->first, cs2->first);
-        if (av_log_get_level() == AV_LOG_DEBUG) {
+        if (log) {
             for (i = infos; i != NULL; i = i->next) {
-                av_log(ctx, AV_LOG_DEBUG, "Stage 2: matching pair at %"PRIu32" and %"PRIu32", "
-                       "ratio %f, offset %d\n", i->first->index, i->second->index,
-                       i->framerateratio, i->offset);
+                av_bprintf(log, "Stage 2: matching pair at %"PRIu32" and %"PRIu32", "
+                           "ratio %f, offset %d\n", i->first->index, i->second->index,
+                           i->framerateratio, i->offset);
             }
+            av_bprintf(log, "Stage 3: evaluate\n");
         }
         /* stage 3: evaluation */
-        av_log(ctx, AV_LOG_DEBUG, "Stage 3: evaluate\n");
         if (infos) {
             bestmatch = evaluate_parameters(ctx, sc, infos, bestmatch, mode);
-            av_log(ctx, AV_LOG_DEBUG, "Stage 3: best matching pair at %"PRIu32" and %"PRIu32", "
-                   "ratio %f, offset %d, score %d, %d frames matching\n",
-                   bestmatch.first->index, bestmatch.second->index,
-                   bestmatch.framerateratio, bestmatch.offset, bestmatch.score, bestmatch.matchframes);
+            if (log)
+                av_bprintf(log, "Stage 3: best matching pair at %"PRIu32" and %"PRIu32", "
+                           "ratio %f, offset %d, score %d, %d frames matching\n",
+                           bestmatch.first->index, bestmatch.second->index,
+                           bestmatch.framerateratio, bestmatch.offset, bestmatch.score, bestmatch.matchframes);
             sll_free(&infos);
         }
     } while (find_next_coarsecandidate(sc, second->coarsesiglist, &cs, &cs2, 0) && !bestmatch.whole);
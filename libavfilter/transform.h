@@ -94,6 +94,9 @@ void ff_get_matrix(
  * @param dst_stride  destination image line size in bytes
  * @param width       image width in pixels
  * @param height      image height in pixels
+ * @param slice_start first destination row to transform
+ * @param slice_end   last destination row to transform, exclusive; the
+ *                    whole source image may be accessed for any slice
  * @param matrix      9-item affine transformation matrix
  * @param interpolate pixel interpolation method
  * @param fill        edge fill method
@@ -101,7 +104,9 @@ void ff_get_matrix(
  */
 int ff_affine_transform(const uint8_t *src, uint8_t *dst,
                         int src_stride, int dst_stride,
-                        int width, int height, const float *matrix,
+                        int width, int height,
+                        int slice_start, int slice_end,
+                        const float *matrix,
                         enum InterpolateMethod interpolate,
                         enum FillMethod fill);
 
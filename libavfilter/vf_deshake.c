@@ -86,11 +86,20 @@ typedef struct Transform {
 
 #define MAX_R 64
 
+typedef struct MotionSlice {
+    int (*counts)[2*MAX_R+1];  ///< Motion vector counts of the slice
+    int nb_angles;             ///< Number of block angles found by the slice
+    int center_x;              ///< Sum of the block motion vectors
+    int center_y;
+} MotionSlice;
+
 typedef struct DeshakeContext {
     const AVClass *class;
     int counts[2*MAX_R+1][2*MAX_R+1]; ///< Scratch buffer for motion search
     double *angles;            ///< Scratch buffer for block angles
     unsigned angles_size;
+    MotionSlice *slices;       ///< Per-job motion search state
+    int nb_slices;
     AVFrame *ref;              ///< Previous frame
     int rx;                    ///< Maximum horizontal shift
     int ry;                    ///< Maximum vertical shift
@@ -141,6 +150,20 @@ static const AVOption deshake_options[] = {
 
 AVFILTER_DEFINE_CLASS(deshake);
 
+typedef struct MotionThreadData {
+    uint8_t *src1, *src2;
+    int width, stride;
+    int nb_rows, nb_cols;      ///< Number of rows and columns of blocks
+} MotionThreadData;
+
+typedef struct TransformThreadData {
+    const float *matrix[3];
+    int width[3], height[3];
+    enum InterpolateMethod interpolate;
+    enum FillMethod fill;
+    AVFrame *in, *out;
+} TransformThreadData;
+
 static int cmp(const void *a, const void *b)
 {
     return FFDIFFSIGN(*(const double *)a, *(const double *)b);
@@ -277,6 +300,50 @@ static double block_angle(int x, int y, int cx, int cy, IntMotionVector *shift)
            diff;
 }
 
+/**
+ * Find the most likely shift for every block in a range of block rows and
+ * store the motion vectors in the counts of the slice.
+ */
+static int find_motion_slice(AVFilterContext *ctx, void *arg, int jobnr, int nb_jobs)
+{
+    DeshakeContext *deshake = ctx->priv;
+    const MotionThreadData *td = arg;
+    MotionSlice *slice = &deshake->slices[jobnr];
+    const int row_start = (td->nb_rows *  jobnr     ) / nb_jobs;
+    const int row_end   = (td->nb_rows * (jobnr + 1)) / nb_jobs;
+    double *angles = deshake->angles + row_start * td->nb_cols;
+    IntMotionVector mv = {0, 0};
+    int contrast;
+
+    memset(slice->counts, 0, (deshake->rx * 2 + 1) * sizeof(*slice->counts));
+    slice->nb_angles = 0;
+    slice->center_x  = 0;
+    slice->center_y  = 0;
+
+    for (int row = row_start; row < row_end; row++) {
+        const int y = deshake->ry + row * deshake->blocksize * 2;
+        // We use a width of 16 here to match the sad function
+        for (int x = deshake->rx; x < td->width - deshake->rx - 16; x += 16) {
+            // If the contrast is too low, just skip this block as it probably
+            // won't be very useful to us.
+            contrast = block_contrast(td->src2, x, y, td->stride, deshake->blocksize);
+            if (contrast > deshake->contrast) {
+                find_block_motion(deshake, td->src1, td->src2, x, y, td->stride, &mv);
+                if (mv.x != -1 && mv.y != -1) {
+                    slice->counts[mv.x + deshake->rx][mv.y + deshake->ry] += 1;
+                    if (x > deshake->rx && y > deshake->ry)
+                        angles[slice->nb_angles++] = block_angle(x, y, 0, 0, &mv);
+
+                    slice->center_x += mv.x;
+                    slice->center_y += mv.y;
+                }
+            }
+        }
+    }
+
+    return 0;
+}
+
 /**
  * Find the estimated global motion for a scene given the most likely shift
  * for each block in the frame. The global motion is estimated to be the
@@ -284,19 +351,31 @@ static double block_angle(int x, int y, int cx, int cy, IntMotionVector *shift)
  * move one pixel to the right and two pixels down, this would yield a
  * motion vector (1, -2).
  */
-static void find_motion(DeshakeContext *deshake, uint8_t *src1, uint8_t *src2,
+static void find_motion(AVFilterContext *ctx, uint8_t *src1, uint8_t *src2,
                         int width, int height, int stride, Transform *t)
 {
+    DeshakeContext *deshake = ctx->priv;
+    MotionThreadData td;
     int x, y;
-    IntMotionVector mv = {0, 0};
     int count_max_value = 0;
-    int contrast;
+    int nb_jobs;
 
     int pos;
     int center_x = 0, center_y = 0;
     double p_x, p_y;
 
-    av_fast_malloc(&deshake->angles, &deshake->angles_size, width * height / (16 * deshake->blocksize) * sizeof(*deshake->angles));
+    td.src1    = src1;
+    td.src2    = src2;
+    td.width   = width;
+    td.stride  = stride;
+    td.nb_rows = 0;
+    td.nb_cols = 0;
+    for (y = deshake->ry; y < height - deshake->ry - (deshake->blocksize * 2); y += deshake->blocksize * 2)
+        td.nb_rows++;
+    for (x = deshake->rx; x < width - deshake->rx - 16; x += 16)
+        td.nb_cols++;
+
+    av_fast_malloc(&deshake->angles, &deshake->angles_size, td.nb_rows * td.nb_cols * sizeof(*deshake->angles));
 
     // Reset counts to zero
     for (x = 0; x < deshake->rx * 2 + 1; x++) {
@@ -305,27 +384,25 @@ static void find_motion(DeshakeContext *deshake, uint8_t *src1, uint8_t *src2,
         }
     }
 
-    pos = 0;
-    // Find motion for every block and store the motion vector in the counts
-    for (y = deshake->ry; y < height - deshake->ry - (deshake->blocksize * 2); y += deshake->blocksize * 2) {
-        // We use a width of 16 here to match the sad function
-        for (x = deshake->rx; x < width - deshake->rx - 16; x += 16) {
-            // If the contrast is too low, just skip this block as it probably
-            // won't be very useful to us.
-            contrast = block_contrast(src2, x, y, stride, deshake->blocksize);
-            if (contrast > deshake->contrast) {
-                //av_log(NULL, AV_LOG_ERROR, "%d\n", contrast);
-                find_block_motion(deshake, src1, src2, x, y, stride, &mv);
-                if (mv.x != -1 && mv.y != -1) {
-                    deshake->counts[mv.x + deshake->rx][mv.y + deshake->ry] += 1;
-                    if (x > deshake->rx && y > deshake->ry)
-                        deshake->angles[pos++] = block_angle(x, y, 0, 0, &mv);
+    // Find motion for every block, with the block rows split across the jobs
+    nb_jobs = FFMIN(deshake->nb_slices, td.nb_rows);
+    ff_filter_execute(ctx, find_motion_slice, &td, NULL, nb_jobs);
 
-                    center_x += mv.x;
-                    center_y += mv.y;
-                }
-            }
-        }
+    // Merge the slices, keeping the angles in raster order
+    pos = 0;
+    for (int i = 0; i < nb_jobs; i++) {
+        const MotionSlice *slice = &deshake->slices[i];
+        const int row_start = (td.nb_rows * i) / nb_jobs;
+
+        for (x = 0; x < deshake->rx * 2 + 1; x++)
+            for (y = 0; y < deshake->ry * 2 + 1; y++)
+                deshake->counts[x][y] += slice->counts[x][y];
+
+        memmove(deshake->angles + pos, deshake->angles + row_start * td.nb_cols,
+                slice->nb_angles * sizeof(*deshake->angles));
+        pos      += slice->nb_angles;
+        center_x += slice->center_x;
+        center_y += slice->center_y;
     }
 
     if (pos) {
@@ -364,31 +441,51 @@ static void find_motion(DeshakeContext *deshake, uint8_t *src1, uint8_t *src2,
     //av_log(NULL, AV_LOG_ERROR, "%d x %d\n", avg->x, avg->y);
 }
 
+static int transform_slice(AVFilterContext *ctx, void *arg, int jobnr, int nb_jobs)
+{
+    const TransformThreadData *td = arg;
+    int ret;
+
+    for (int i = 0; i < 3; i++) {
+        const int slice_start = (td->height[i] *  jobnr     ) / nb_jobs;
+        const int slice_end   = (td->height[i] * (jobnr + 1)) / nb_jobs;
+
+        // Transform the luma and chroma planes
+        ret = ff_affine_transform(td->in->data[i], td->out->data[i], td->in->linesize[i],
+                                  td->out->linesize[i], td->width[i], td->height[i],
+                                  slice_start, slice_end,
+                                  td->matrix[i], td->interpolate, td->fill);
+        if (ret < 0)
+            return ret;
+    }
+    return 0;
+}
+
 static int deshake_transform_c(AVFilterContext *ctx,
                                     int width, int height, int cw, int ch,
                                     const float *matrix_y, const float *matrix_uv,
                                     enum InterpolateMethod interpolate,
                                     enum FillMethod fill, AVFrame *in, AVFrame *out)
 {
-    int i = 0, ret = 0;
-    const float *matrixs[3];
-    int plane_w[3], plane_h[3];
-    matrixs[0] = matrix_y;
-    matrixs[1] =  matrixs[2] = matrix_uv;
-    plane_w[0] = width;
-    plane_w[1] = plane_w[2] = cw;
-    plane_h[0] = height;
-    plane_h[1] = plane_h[2] = ch;
-
-    for (i = 0; i < 3; i++) {
-        // Transform the luma and chroma planes
-        ret = ff_affine_transform(in->data[i], out->data[i], in->linesize[i],
-                                  out->linesize[i], plane_w[i], plane_h[i],
-                                  matrixs[i], interpolate, fill);
-        if (ret < 0)
-            return ret;
-    }
-    return ret;
+    TransformThreadData td;
+
+    if ((unsigned)interpolate >= INTERPOLATE_COUNT)
+        return AVERROR(EINVAL);
+
+    td.matrix[0] = matrix_y;
+    td.matrix[1] = td.matrix[2] = matrix_uv;
+    td.width[0]  = width;
+    td.width[1]  = td.width[2]  = cw;
+    td.height[0] = height;
+    td.height[1] = td.height[2] = ch;
+    td.interpolate = interpolate;
+    td.fill = fill;
+    td.in   = in;
+    td.out  = out;
+
+    ff_filter_execute(ctx, transform_slice, &td, NULL,
+                      FFMIN(ch, ff_filter_get_nb_threads(ctx)));
+    return 0;
 }
 
 static av_cold int init(AVFilterContext *ctx)
@@ -430,9 +527,31 @@ static const enum AVPixelFormat pix_fmts[] = {
     AV_PIX_FMT_YUVJ444P, AV_PIX_FMT_YUVJ440P, AV_PIX_FMT_NONE
 };
 
+static void free_slices(DeshakeContext *deshake)
+{
+    for (int i = 0; i < deshake->nb_slices; i++)
+        av_freep(&deshake->slices[i].counts);
+    av_freep(&deshake->slices);
+    deshake->nb_slices = 0;
+}
+
 static int config_props(AVFilterLink *link)
 {
-    DeshakeContext *deshake = link->dst->priv;
+    AVFilterContext *ctx = link->dst;
+    DeshakeContext *deshake = ctx->priv;
+    const int nb_slices = ff_filter_get_nb_threads(ctx);
+
+    free_slices(deshake);
+    deshake->slices = av_calloc(nb_slices, sizeof(*deshake->slices));
+    if (!deshake->slices)
+        return AVERROR(ENOMEM);
+    deshake->nb_slices = nb_slices;
+    for (int i = 0; i < nb_slices; i++) {
+        deshake->slices[i].counts = av_calloc(deshake->rx * 2 + 1,
+                                              sizeof(*deshake->slices[i].counts));
+        if (!deshake->slices[i].counts)
+            return AVERROR(ENOMEM);
+    }
 
     deshake->ref = NULL;
     deshake->last.vec.x = 0;
@@ -449,6 +568,7 @@ static av_cold void uninit(AVFilterContext *ctx)
     av_frame_free(&deshake->ref);
     av_freep(&deshake->angles);
     deshake->angles_size = 0;
+    free_slices(deshake);
     if (deshake->fp)
         fclose(deshake->fp);
 }
@@ -485,7 +605,7 @@ static int filter_frame(AVFilterLink *link, AVFrame *in)
 
     if (deshake->cx < 0 || deshake->cy < 0 || deshake->cw < 0 || deshake->ch < 0) {
         // Find the most likely global motion for the current frame
-        find_motion(deshake, (deshake->ref == NULL) ? in->data[0] : deshake->ref->data[0], in->data[0], link->w, link->h, in->linesize[0], &t);
+        find_motion(link->dst, (deshake->ref == NULL) ? in->data[0] : deshake->ref->data[0], in->data[0], link->w, link->h, in->linesize[0], &t);
     } else {
         uint8_t *src1 = (deshake->ref == NULL) ? in->data[0] : deshake->ref->data[0];
         uint8_t *src2 = in->data[0];
@@ -502,7 +622,7 @@ static int filter_frame(AVFilterLink *link, AVFrame *in)
         src1 += deshake->cy * in->linesize[0] + deshake->cx;
         src2 += deshake->cy * in->linesize[0] + deshake->cx;
 
-        find_motion(deshake, src1, src2, deshake->cw, deshake->ch, in->linesize[0], &t);
+        find_motion(link->dst, src1, src2, deshake->cw, deshake->ch, in->linesize[0], &t);
     }
 
 
@@ -593,6 +713,7 @@ const FFFilter ff_vf_deshake = {
     .p.name        = "deshake",
     .p.description = NULL_IF_CONFIG_SMALL("Stabilize shaky video."),
     .p.priv_class  = &deshake_class,
+    .p.flags       = AVFILTER_FLAG_SLICE_THREADS,
     .priv_size     = sizeof(DeshakeContext),
     .init          = init,
     .uninit        = uninit,
@@ -39,6 +39,7 @@
 #include <unistd.h>
 #endif
 #include <fenv.h>
+#include <stdatomic.h>
 
 #if CONFIG_LIBFONTCONFIG
 #include <fontconfig/fontconfig.h>
@@ -233,6 +234,20 @@ typedef struct TextMetrics {
     int rect_y;                     ///< y position of the box
 } TextMetrics;
 
+typedef struct ThreadData {
+    AVFrame *frame;
+    int x, y;                       ///< position of the text origin in the frame
+    int clip_x0, clip_y0;           ///< top-left corner of the clipping region
+    int clip_x1, clip_y1;           ///< bottom-right corner of the clipping region
+    int box_x, box_y, box_w, box_h; ///< the background box
+    int slice_y, slice_h;           ///< the rows of the frame to draw on
+    FFDrawColor *fontcolor;
+    FFDrawColor *shadowcolor;
+    FFDrawColor *bordercolor;
+    FFDrawColor *boxcolor;
+    atomic_int ret;                 ///< first error returned by a slice
+} ThreadData;
+
 typedef struct DrawTextContext {
     const AVClass *class;
     int exp_mode;                   ///< expansion mode to use for the text
@@ -315,6 +330,14 @@ typedef struct DrawTextContext {
     int tab_count;                  ///< the number of tab characters
     int blank_advance64;            ///< the size of the space character
     int tab_warning_printed;        ///< ensure the tab warning to be printed only once
+
+    AVBPrint layout_text;           ///< the expanded text of the cached layout
+    unsigned int layout_fontsize;   ///< the font size of the cached layout
+    int layout_valid;               ///< tells if lines and layout_metrics can be reused
+    TextMetrics layout_metrics;     ///< the metrics of the cached layout
+    int glyphs_x64;                 ///< horizontal subpixel position of the cached glyph positions
+    int glyphs_y64;                 ///< vertical subpixel position of the cached glyph positions
+    int glyphs_valid;               ///< tells if the glyph positions in lines can be reused
 } DrawTextContext;
 
 #define OFFSET(x) offsetof(DrawTextContext, x)
@@ -1067,6 +1090,7 @@ static av_cold int init(AVFilterContext *ctx)
 
     av_bprint_init(&s->expanded_text, 0, AV_BPRINT_SIZE_UNLIMITED);
     av_bprint_init(&s->expanded_fontcolor, 0, AV_BPRINT_SIZE_UNLIMITED);
+    av_bprint_init(&s->layout_text, 0, AV_BPRINT_SIZE_UNLIMITED);
 
     return 0;
 }
@@ -1114,6 +1138,31 @@ static int glyph_enu_free(void *opaque, void *elem)
     return 0;
 }
 
+static void hb_destroy(HarfbuzzData *hb)
+{
+    hb_font_destroy(hb->font);
+    hb_buffer_destroy(hb->buf);
+    hb->buf = NULL;
+    hb->font = NULL;
+    hb->glyph_info = NULL;
+    hb->glyph_pos = NULL;
+}
+
+// Drops the cached text layout and glyph positions
+static void reset_layout(DrawTextContext *s)
+{
+    for (int l = 0; l < s->line_count; ++l) {
+        TextLine *line = &s->lines[l];
+        av_freep(&line->glyphs);
+        hb_destroy(&line->hb_data);
+    }
+    av_freep(&s->lines);
+    av_freep(&s->tab_clusters);
+    s->line_count = 0;
+    s->layout_valid = 0;
+    s->glyphs_valid = 0;
+}
+
 static av_cold void uninit(AVFilterContext *ctx)
 {
     DrawTextContext *s = ctx->priv;
@@ -1133,8 +1182,11 @@ static av_cold void uninit(AVFilterContext *ctx)
     FT_Stroker_Done(s->stroker);
     FT_Done_FreeType(s->library);
 
+    reset_layout(s);
+
     av_bprint_finalize(&s->expanded_text, NULL);
     av_bprint_finalize(&s->expanded_fontcolor, NULL);
+    av_bprint_finalize(&s->layout_text, NULL);
 }
 
 static int config_input(AVFilterLink *inlink)
@@ -1238,6 +1290,7 @@ static int command(AVFilterContext *ctx, const char *cmd, const char *arg, char
             old->fontsize_pexpr = NULL;
             old->blank_advance64 = 0;
         }
+        reset_layout(old);
         return config_input(ctx->inputs[0]);
     }
 
@@ -1269,12 +1322,85 @@ static void update_alpha(DrawTextContext *s)
         s->alpha = 256 * alpha;
 }
 
-static int draw_glyphs(AVFilterContext *ctx, AVFrame *frame,
-                       FFDrawColor *color,
-                       TextMetrics *metrics,
-                       int x, int y, int borderw)
+// Computes the position of the glyphs for the given subpixel position of the
+// text and loads the glyph bitmaps
+static int render_text(AVFilterContext *ctx, const TextMetrics *metrics,
+                       int x64, int y64)
 {
     DrawTextContext *s = ctx->priv;
+    int x = 0, y = 0, shift_x64, shift_y64, ret;
+    int last_tab_idx = 0;
+    Glyph *glyph = NULL;
+
+    s->glyphs_valid = 0;
+
+    if ((!(s->text_align & TA_LEFT) || (s->text_align & TA_RIGHT)) &&
+        !s->tab_warning_printed && s->tab_count > 0) {
+        s->tab_warning_printed = 1;
+        av_log(ctx, AV_LOG_WARNING, "Tab characters are only supported with left horizontal alignment\n");
+    }
+
+    for (int l = 0; l < s->line_count; ++l) {
+        TextLine *line = &s->lines[l];
+        HarfbuzzData *hb = &line->hb_data;
+        if (!line->glyphs) {
+            line->glyphs = av_calloc(hb->glyph_count, sizeof(GlyphInfo));
+            if (!line->glyphs)
+                return AVERROR(ENOMEM);
+        }
+
+        for (int t = 0; t < hb->glyph_count; ++t) {
+            GlyphInfo *g_info = &line->glyphs[t];
+            uint8_t is_tab = last_tab_idx < s->tab_count &&
+                hb->glyph_info[t].cluster == s->tab_clusters[last_tab_idx] - line->cluster_offset;
+            int true_x, true_y;
+            if (is_tab) {
+                ++last_tab_idx;
+            }
+            true_x = x + hb->glyph_pos[t].x_offset;
+            true_y = y + hb->glyph_pos[t].y_offset;
+            shift_x64 = (((x64 + true_x) >> 4) & 0b0011) << 4;
+            shift_y64 = ((4 - (((y64 + true_y) >> 4) & 0b0011)) & 0b0011) << 4;
+
+            ret = load_glyph(ctx, &glyph, hb->glyph_info[t].codepoint, shift_x64, shift_y64);
+            if (ret != 0) {
+                return ret;
+            }
+            g_info->code = hb->glyph_info[t].codepoint;
+            g_info->x = (x64 + true_x) >> 6;
+            g_info->y = ((y64 + true_y) >> 6) + (shift_y64 > 0 ? 1 : 0);
+            g_info->shift_x64 = shift_x64;
+            g_info->shift_y64 = shift_y64;
+
+            if (!is_tab) {
+                x += hb->glyph_pos[t].x_advance;
+            } else {
+                int size = s->blank_advance64 * s->tabsize;
+                x = (x / size + 1) * size;
+            }
+            y += hb->glyph_pos[t].y_advance;
+        }
+
+        y += metrics->line_height64 + s->line_spacing * 64;
+        x = 0;
+    }
+
+    s->glyphs_x64 = x64;
+    s->glyphs_y64 = y64;
+    s->glyphs_valid = 1;
+
+    return 0;
+}
+
+// Blends the glyphs (or their borders) on the rows [slice_start, slice_end)
+// of the frame, one after the other so that overlapping glyphs look the same
+// whatever the number of slices
+static int draw_glyphs(AVFilterContext *ctx, const ThreadData *td,
+                       FFDrawColor *color, int x, int y, int borderw,
+                       int slice_start, int slice_end)
+{
+    DrawTextContext *s = ctx->priv;
+    AVFrame *frame = td->frame;
     int g, l, x1, y1, w1, h1, idx;
     int dx = 0, dy = 0, pdx = 0;
     GlyphInfo *info;
@@ -1283,7 +1409,9 @@ static int draw_glyphs(AVFilterContext *ctx, AVFrame *frame,
     FT_BitmapGlyph b_glyph;
     uint8_t j_left = 0, j_right = 0, j_top = 0, j_bottom = 0;
     int line_w, offset_y = 0;
-    int clip_x = 0, clip_y = 0;
+    const int clip_x = td->clip_x1;
+    const int clip_y = FFMIN(td->clip_y1, slice_end);
+    const int top = FFMAX(td->clip_y0, slice_start);
 
     j_left = !!(s->text_align & TA_LEFT);
     j_right = !!(s->text_align & TA_RIGHT);
@@ -1291,18 +1419,13 @@ static int draw_glyphs(AVFilterContext *ctx, AVFrame *frame,
     j_bottom = !!(s->text_align & TA_BOTTOM);
 
     if (j_top && j_bottom) {
-        offset_y = (s->box_height - metrics->height) / 2;
+        offset_y = (s->box_height - s->layout_metrics.height) / 2;
     } else if (j_bottom) {
-        offset_y = s->box_height - metrics->height;
-    }
-
-    if ((!j_left || j_right) && !s->tab_warning_printed && s->tab_count > 0) {
-        s->tab_warning_printed = 1;
-        av_log(ctx, AV_LOG_WARNING, "Tab characters are only supported with left horizontal alignment\n");
+        offset_y = s->box_height - s->layout_metrics.height;
     }
 
-    clip_x = FFMIN(metrics->rect_x + s->box_width + s->bb_right, frame->width);
-    clip_y = FFMIN(metrics->rect_y + s->box_height + s->bb_bottom, frame->height);
+    x += td->x;
+    y += td->y;
 
     for (l = 0; l < s->line_count; ++l) {
         TextLine *line = &s->lines[l];
@@ -1332,13 +1455,13 @@ static int draw_glyphs(AVFilterContext *ctx, AVFrame *frame,
 
             // Offset of the glyph's bitmap in the visible region
             dx = dy = 0;
-            if (x1 < metrics->rect_x - s->bb_left) {
-                dx = metrics->rect_x - s->bb_left - x1;
-                x1 = metrics->rect_x - s->bb_left;
+            if (x1 < td->clip_x0) {
+                dx = td->clip_x0 - x1;
+                x1 = td->clip_x0;
             }
-            if (y1 < metrics->rect_y - s->bb_top) {
-                dy = metrics->rect_y - s->bb_top - y1;
-                y1 = metrics->rect_y - s->bb_top;
+            if (y1 < top) {
+                dy = top - y1;
+                y1 = top;
             }
 
             // check if the glyph is empty or out of the clipping region
@@ -1381,16 +1504,6 @@ static int shape_text_hb(DrawTextContext *s, HarfbuzzData* hb, const char* text,
     return 0;
 }
 
-static void hb_destroy(HarfbuzzData *hb)
-{
-    hb_font_destroy(hb->font);
-    hb_buffer_destroy(hb->buf);
-    hb->buf = NULL;
-    hb->font = NULL;
-    hb->glyph_info = NULL;
-    hb->glyph_pos = NULL;
-}
-
 static int measure_text(AVFilterContext *ctx, TextMetrics *metrics)
 {
     DrawTextContext *s = ctx->priv;
@@ -1549,15 +1662,74 @@ done:
     return ret;
 }
 
+// Returns the first row of a slice, aligned on the chroma rows so that
+// no chroma sample is blended by two jobs
+static int slice_row(const DrawTextContext *s, const ThreadData *td, int jobnr, int nb_jobs)
+{
+    const int end = td->slice_y + td->slice_h;
+
+    if (!jobnr)
+        return td->slice_y;
+    if (jobnr == nb_jobs)
+        return end;
+    return FFMIN(FFALIGN(td->slice_y + td->slice_h * jobnr / nb_jobs,
+                         1 << s->dc.vsub_max), end);
+}
+
+static int draw_text_rows(AVFilterContext *ctx, const ThreadData *td,
+                          int slice_start, int slice_end)
+{
+    DrawTextContext *s = ctx->priv;
+    int ret;
+
+    if (s->draw_box) {
+        const int box_y0 = FFMAX(td->box_y, slice_start);
+        const int box_y1 = FFMIN(td->box_y + td->box_h, slice_end);
+        if (box_y0 < box_y1)
+            ff_blend_rectangle(&s->dc, td->boxcolor,
+                td->frame->data, td->frame->linesize, td->frame->width, td->frame->height,
+                td->box_x, box_y0, td->box_w, box_y1 - box_y0);
+    }
+
+    if (s->shadowx || s->shadowy) {
+        if ((ret = draw_glyphs(ctx, td, td->shadowcolor, s->shadowx, s->shadowy,
+                               s->borderw, slice_start, slice_end)) < 0)
+            return ret;
+    }
+
+    if (s->borderw) {
+        if ((ret = draw_glyphs(ctx, td, td->bordercolor, 0, 0, 1,
+                               slice_start, slice_end)) < 0)
+            return ret;
+    }
+
+    return draw_glyphs(ctx, td, td->fontcolor, 0, 0, 0, slice_start, slice_end);
+}
+
+static int draw_text_slice(AVFilterContext *ctx, void *arg, int jobnr, int nb_jobs)
+{
+    DrawTextContext *s = ctx->priv;
+    ThreadData *td = arg;
+    const int slice_start = slice_row(s, td, jobnr, nb_jobs);
+    const int slice_end = slice_row(s, td, jobnr + 1, nb_jobs);
+    int ret, first = 0;
+
+    if (slice_start >= slice_end)
+        return 0;
+
+    ret = draw_text_rows(ctx, td, slice_start, slice_end);
+    if (ret < 0)
+        atomic_compare_exchange_strong(&td->ret, &first, ret);
+    return ret;
+}
+
 static int draw_text(AVFilterContext *ctx, AVFrame *frame)
 {
     DrawTextContext *s = ctx->priv;
     AVFilterLink *inlink = ctx->inputs[0];
     FilterLink *inl = ff_filter_link(inlink);
-    int x = 0, y = 0, ret;
-    int shift_x64, shift_y64;
+    int ret;
     int x64, y64;
-    Glyph *glyph = NULL;
 
     time_t now = time(0);
     struct tm ltime;
@@ -1570,9 +1742,7 @@ static int draw_text(AVFilterContext *ctx, AVFrame *frame)
 
     int width = frame->width;
     int height = frame->height;
-    int rec_x = 0, rec_y = 0, rec_width = 0, rec_height = 0;
     int is_outside = 0;
-    int last_tab_idx = 0;
 
     TextMetrics metrics;
 
@@ -1623,9 +1793,21 @@ static int draw_text(AVFilterContext *ctx, AVFrame *frame)
         return ret;
     }
 
-    if ((ret = measure_text(ctx, &metrics)) < 0) {
-        return ret;
+    /* the text is only shaped again when it or the font size changed */
+    if (!s->layout_valid || s->layout_fontsize != s->fontsize ||
+        strcmp(s->layout_text.str, bp->str)) {
+        reset_layout(s);
+        if ((ret = measure_text(ctx, &s->layout_metrics)) < 0) {
+            return ret;
+        }
+        av_bprint_clear(&s->layout_text);
+        av_bprintf(&s->layout_text, "%s", bp->str);
+        if (!av_bprint_is_complete(&s->layout_text))
+            return AVERROR(ENOMEM);
+        s->layout_fontsize = s->fontsize;
+        s->layout_valid = 1;
     }
+    metrics = s->layout_metrics;
 
     s->max_glyph_h = POS_CEIL(metrics.max_y64 - metrics.min_y64, 64);
     s->max_glyph_w = POS_CEIL(metrics.max_x64 - metrics.min_x64, 64);
@@ -1705,8 +1887,6 @@ static int draw_text(AVFilterContext *ctx, AVFrame *frame)
             s->y = FFMAX(height - metrics.height - offsetbottom, 0);
     }
 
-    x = 0;
-    y = 0;
     x64 = (int)(s->x * 64.);
     if (s->y_align == YA_FONT) {
         y64 = (int)(s->y * 64. + s->face->size->metrics.ascender);
@@ -1716,47 +1896,6 @@ static int draw_text(AVFilterContext *ctx, AVFrame *frame)
         y64 = (int)(s->y * 64. + metrics.offset_top64);
     }
 
-    for (int l = 0; l < s->line_count; ++l) {
-        TextLine *line = &s->lines[l];
-        HarfbuzzData *hb = &line->hb_data;
-        line->glyphs = av_mallocz(hb->glyph_count * sizeof(GlyphInfo));
-
-        for (int t = 0; t < hb->glyph_count; ++t) {
-            GlyphInfo *g_info = &line->glyphs[t];
-            uint8_t is_tab = last_tab_idx < s->tab_count &&
-                hb->glyph_info[t].cluster == s->tab_clusters[last_tab_idx] - line->cluster_offset;
-            int true_x, true_y;
-            if (is_tab) {
-                ++last_tab_idx;
-            }
-            true_x = x + hb->glyph_pos[t].x_offset;
-            true_y = y + hb->glyph_pos[t].y_offset;
-            shift_x64 = (((x64 + true_x) >> 4) & 0b0011) << 4;
-            shift_y64 = ((4 - (((y64 + true_y) >> 4) & 0b0011)) & 0b0011) << 4;
-
-            ret = load_glyph(ctx, &glyph, hb->glyph_info[t].codepoint, shift_x64, shift_y64);
-            if (ret != 0) {
-                return ret;
-            }
-            g_info->code = hb->glyph_info[t].codepoint;
-            g_info->x = (x64 + true_x) >> 6;
-            g_info->y = ((y64 + true_y) >> 6) + (shift_y64 > 0 ? 1 : 0);
-            g_info->shift_x64 = shift_x64;
-            g_info->shift_y64 = shift_y64;
-
-            if (!is_tab) {
-                x += hb->glyph_pos[t].x_advance;
-            } else {
-                int size = s->blank_advance64 * s->tabsize;
-                x = (x / size + 1) * size;
-            }
-            y += hb->glyph_pos[t].y_advance;
-        }
-
-        y += metrics.line_height64 + s->line_spacing * 64;
-        x = 0;
-    }
-
     metrics.rect_x = s->x;
     if (s->y_align == YA_BASELINE) {
         metrics.rect_y = s->y - metrics.offset_top64 / 64;
@@ -1767,6 +1906,14 @@ static int draw_text(AVFilterContext *ctx, AVFrame *frame)
     s->box_width = s->boxw == 0 ? metrics.width : s->boxw;
     s->box_height = s->boxh == 0 ? metrics.height : s->boxh;
 
+    /* The glyph bitmaps only depend on the subpixel position of the text:
+     * the glyph positions are reused as long as it does not change. */
+    if (!s->glyphs_valid || s->glyphs_x64 != (x64 & 63) || s->glyphs_y64 != (y64 & 63)) {
+        if ((ret = render_text(ctx, &metrics, x64 & 63, y64 & 63)) < 0) {
+            return ret;
+        }
+    }
+
     if (!s->draw_box) {
         // Create a border for the clipping region to take into account subpixel
         // errors in text measurement and effects.
@@ -1784,46 +1931,34 @@ static int draw_text(AVFilterContext *ctx, AVFrame *frame)
                     metrics.rect_y + s->box_height + s->bb_bottom <= 0;
 
     if (!is_outside) {
-        /* draw box */
-        if (s->draw_box) {
-            rec_x = metrics.rect_x - s->bb_left;
-            rec_y = metrics.rect_y - s->bb_top;
-            rec_width = s->box_width + s->bb_right + s->bb_left;
-            rec_height = s->box_height + s->bb_bottom + s->bb_top;
-            ff_blend_rectangle(&s->dc, &boxcolor,
-                frame->data, frame->linesize, width, height,
-                rec_x, rec_y, rec_width, rec_height);
-        }
-
-        if (s->shadowx || s->shadowy) {
-            if ((ret = draw_glyphs(ctx, frame, &shadowcolor, &metrics,
-                    s->shadowx, s->shadowy, s->borderw)) < 0) {
-                return ret;
-            }
-        }
-
-        if (s->borderw) {
-            if ((ret = draw_glyphs(ctx, frame, &bordercolor, &metrics,
-                    0, 0, s->borderw)) < 0) {
-                return ret;
-            }
-        }
-
-        if ((ret = draw_glyphs(ctx, frame, &fontcolor, &metrics, 0,
-                0, 0)) < 0) {
-            return ret;
+        ThreadData td = {
+            .frame       = frame,
+            .x           = x64 >> 6,
+            .y           = y64 >> 6,
+            .clip_x0     = metrics.rect_x - s->bb_left,
+            .clip_y0     = metrics.rect_y - s->bb_top,
+            .clip_x1     = FFMIN(metrics.rect_x + s->box_width + s->bb_right, width),
+            .clip_y1     = FFMIN(metrics.rect_y + s->box_height + s->bb_bottom, height),
+            .box_x       = metrics.rect_x - s->bb_left,
+            .box_y       = metrics.rect_y - s->bb_top,
+            .box_w       = s->box_width + s->bb_right + s->bb_left,
+            .box_h       = s->box_height + s->bb_bottom + s->bb_top,
+            .fontcolor   = &fontcolor,
+            .shadowcolor = &shadowcolor,
+            .bordercolor = &bordercolor,
+            .boxcolor    = &boxcolor,
+        };
+        td.slice_y = FFMAX(td.clip_y0, 0);
+        td.slice_h = td.clip_y1 - td.slice_y;
+        atomic_init(&td.ret, 0);
+
+        if (td.slice_h > 0) {
+            ff_filter_execute(ctx, draw_text_slice, &td, NULL,
+                              FFMIN(td.slice_h, ff_filter_get_nb_threads(ctx)));
+            return atomic_load(&td.ret);
         }
     }
 
-    // FREE data structures
-    for (int l = 0; l < s->line_count; ++l) {
-        TextLine *line = &s->lines[l];
-        av_freep(&line->glyphs);
-        hb_destroy(&line->hb_data);
-    }
-    av_freep(&s->lines);
-    av_freep(&s->tab_clusters);
-
     return 0;
 }
 
@@ -1884,7 +2019,10 @@ static int filter_frame(AVFilterLink *inlink, AVFrame *frame)
             s->x = bbox->x;
             s->y = bbox->y - s->fontsize;
         }
-        draw_text(ctx, frame);
+        if ((ret = draw_text(ctx, frame)) < 0) {
+            av_frame_free(&frame);
+            return ret;
+        }
     }
 
     return ff_filter_frame(outlink, frame);
@@ -1904,7 +2042,8 @@ const FFFilter ff_vf_drawtext = {
     .p.name        = "drawtext",
     .p.description = NULL_IF_CONFIG_SMALL("Draw text on top of video frames using libfreetype library."),
     .p.priv_class  = &drawtext_class,
-    .p.flags       = AVFILTER_FLAG_SUPPORT_TIMELINE_GENERIC,
+    .p.flags       = AVFILTER_FLAG_SUPPORT_TIMELINE_GENERIC |
+                     AVFILTER_FLAG_SLICE_THREADS,
     .priv_size     = sizeof(DrawTextContext),
     .init          = init,
     .uninit        = uninit,
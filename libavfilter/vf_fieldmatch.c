@@ -41,6 +41,7 @@
 #include "filters.h"
 #include "formats.h"
 #include "video.h"
+#include "vf_fieldmatch.h"
 
 #define INPUT_MAIN     0
 #define INPUT_CLEANSRC 1
@@ -68,6 +69,11 @@ enum comb_matching_mode {
     NB_COMBMATCH
 };
 
+typedef struct MatchSums {
+    uint64_t pc, pm, pml;           ///< previous frame field difference sums
+    uint64_t nc, nm, nml;           ///< next frame field difference sums
+} MatchSums;
+
 enum comb_dbg {
     COMBDBG_NONE,
     COMBDBG_PCN,
@@ -109,8 +115,13 @@ typedef struct FieldMatchContext {
     uint8_t *cmask_data[4];
     int cmask_linesize[4];
     int *c_array;
+    int *c_cells;                   ///< combed pixel count of each half block
     int tpitchy, tpitchuv;
     uint8_t *tbuffer;
+    MatchSums *sums;                ///< per-job field difference sums
+    int nb_threads;
+
+    FieldMatchDSPContext dsp;
 } FieldMatchContext;
 
 #define OFFSET(x) offsetof(FieldMatchContext, x)
@@ -195,80 +206,96 @@ static void fill_buf(uint8_t *data, int w, int h, int linesize, uint8_t v)
     }
 }
 
-static int calc_combed_score(const FieldMatchContext *fm, const AVFrame *src)
+typedef struct CombThreadData {
+    const AVFrame *src;
+} CombThreadData;
+
+/**
+ * Build the comb mask of a range of lines of every plane.
+ */
+static int comb_mask_slice(AVFilterContext *ctx, void *arg, int jobnr, int nb_jobs)
 {
-    int x, y, plane, max_v = 0;
+    const FieldMatchContext *fm = ctx->priv;
+    const CombThreadData *td = arg;
+    const AVFrame *src = td->src;
     const int cthresh = fm->cthresh;
-    const int cthresh6 = cthresh * 6;
 
-    for (plane = 0; plane < (fm->chroma ? 3 : 1); plane++) {
-        const uint8_t *srcp = src->data[plane];
+    for (int plane = 0; plane < (fm->chroma ? 3 : 1); plane++) {
         const int src_linesize = src->linesize[plane];
+        const int cmk_linesize = fm->cmask_linesize[plane];
         const int width  = get_width (fm, src, plane, INPUT_MAIN);
         const int height = get_height(fm, src, plane, INPUT_MAIN);
-        uint8_t *cmkp = fm->cmask_data[plane];
-        const int cmk_linesize = fm->cmask_linesize[plane];
-
-        if (cthresh < 0) {
-            fill_buf(cmkp, width, height, cmk_linesize, 0xff);
-            continue;
-        }
-        fill_buf(cmkp, width, height, cmk_linesize, 0);
-
-        /* [1 -3 4 -3 1] vertical filter */
-#define FILTER(xm2, xm1, xp1, xp2) \
-        abs(  4 * srcp[x] \
-             -3 * (srcp[x + (xm1)*src_linesize] + srcp[x + (xp1)*src_linesize]) \
-             +    (srcp[x + (xm2)*src_linesize] + srcp[x + (xp2)*src_linesize])) > cthresh6
-
-        /* first line */
-        for (x = 0; x < width; x++) {
-            const int s1 = abs(srcp[x] - srcp[x + src_linesize]);
-            if (s1 > cthresh && FILTER(2, 1, 1, 2))
-                cmkp[x] = 0xff;
-        }
-        srcp += src_linesize;
-        cmkp += cmk_linesize;
-
-        /* second line */
-        for (x = 0; x < width; x++) {
-            const int s1 = abs(srcp[x] - srcp[x - src_linesize]);
-            const int s2 = abs(srcp[x] - srcp[x + src_linesize]);
-            if (s1 > cthresh && s2 > cthresh && FILTER(2, -1, 1, 2))
-                cmkp[x] = 0xff;
-        }
-        srcp += src_linesize;
-        cmkp += cmk_linesize;
-
-        /* all lines minus first two and last two */
-        for (y = 2; y < height-2; y++) {
-            for (x = 0; x < width; x++) {
-                const int s1 = abs(srcp[x] - srcp[x - src_linesize]);
-                const int s2 = abs(srcp[x] - srcp[x + src_linesize]);
-                if (s1 > cthresh && s2 > cthresh && FILTER(-2, -1, 1, 2))
-                    cmkp[x] = 0xff;
+        const int slice_start = (height *  jobnr     ) / nb_jobs;
+        const int slice_end   = (height * (jobnr + 1)) / nb_jobs;
+
+        for (int y = slice_start; y < slice_end; y++) {
+            const uint8_t *srcp = src->data[plane] + y * src_linesize;
+            uint8_t *cmkp = fm->cmask_data[plane] + y * cmk_linesize;
+            /* the neighbours are mirrored at the top and bottom lines */
+            const int up2 = y > 1          ? -2 :  2;
+            const int up1 = y > 0          ? -1 :  1;
+            const int dn1 = y < height - 1 ?  1 : -1;
+            const int dn2 = y < height - 2 ?  2 : -2;
+
+            if (cthresh < 0) {
+                memset(cmkp, 0xff, width);
+                continue;
             }
-            srcp += src_linesize;
-            cmkp += cmk_linesize;
+            fm->dsp.comb_line(cmkp,
+                              srcp + up2 * src_linesize, srcp + up1 * src_linesize,
+                              srcp,
+                              srcp + dn1 * src_linesize, srcp + dn2 * src_linesize,
+                              width, cthresh);
         }
+    }
+    return 0;
+}
 
-        /* before-last line */
-        for (x = 0; x < width; x++) {
-            const int s1 = abs(srcp[x] - srcp[x - src_linesize]);
-            const int s2 = abs(srcp[x] - srcp[x + src_linesize]);
-            if (s1 > cthresh && s2 > cthresh && FILTER(-2, -1, 1, -2))
-                cmkp[x] = 0xff;
-        }
-        srcp += src_linesize;
-        cmkp += cmk_linesize;
-
-        /* last line */
-        for (x = 0; x < width; x++) {
-            const int s1 = abs(srcp[x] - srcp[x - src_linesize]);
-            if (s1 > cthresh && FILTER(-2, -1, -1, -2))
-                cmkp[x] = 0xff;
+/**
+ * Count the combed pixels of a range of rows of half blocks.
+ */
+static int comb_count_slice(AVFilterContext *ctx, void *arg, int jobnr, int nb_jobs)
+{
+    const FieldMatchContext *fm = ctx->priv;
+    const CombThreadData *td = arg;
+    const int width  = td->src->width;
+    const int height = td->src->height;
+    const int xhalf = fm->blockx / 2;
+    const int yhalf = fm->blocky / 2;
+    const int xshift = av_log2(xhalf);
+    const int xcells = (width  - 1) / xhalf + 1;
+    const int ycells = (height - 2) / yhalf + 1;
+    const int cell_start = (ycells *  jobnr     ) / nb_jobs;
+    const int cell_end   = (ycells * (jobnr + 1)) / nb_jobs;
+    const int cmk_linesize = fm->cmask_linesize[0];
+
+    for (int cy = cell_start; cy < cell_end; cy++) {
+        int *cells = fm->c_cells + cy * xcells;
+        const int y_start = FFMAX(cy * yhalf, 1);
+        const int y_end   = FFMIN((cy + 1) * yhalf, height - 1);
+
+        memset(cells, 0, xcells * sizeof(*cells));
+        for (int y = y_start; y < y_end; y++) {
+            const uint8_t *cmkp = fm->cmask_data[0] + y * cmk_linesize;
+            const uint8_t *cmkpp = cmkp - cmk_linesize;
+            const uint8_t *cmkpn = cmkp + cmk_linesize;
+
+            /* the mask only holds 0x00 and 0xff */
+            for (int x = 0; x < width; x++)
+                cells[x >> xshift] += (cmkpp[x] & cmkp[x] & cmkpn[x]) & 1;
         }
     }
+    return 0;
+}
+
+static int calc_combed_score(AVFilterContext *ctx, const AVFrame *src)
+{
+    const FieldMatchContext *fm = ctx->priv;
+    CombThreadData td = { .src = src };
+    int x, y, max_v = 0;
+
+    ff_filter_execute(ctx, comb_mask_slice, &td, NULL,
+                      FFMIN(src->height, fm->nb_threads));
 
     if (fm->chroma) {
         uint8_t *cmkp  = fm->cmask_data[0];
@@ -308,83 +335,39 @@ static int calc_combed_score(const FieldMatchContext *fm, const AVFrame *src)
         const int blocky = fm->blocky;
         const int xhalf = blockx/2;
         const int yhalf = blocky/2;
-        const int cmk_linesize = fm->cmask_linesize[0];
-        const uint8_t *cmkp    = fm->cmask_data[0] + cmk_linesize;
         const int width  = src->width;
         const int height = src->height;
         const int xblocks = ((width+xhalf)/blockx) + 1;
         const int xblocks4 = xblocks<<2;
         const int yblocks = ((height+yhalf)/blocky) + 1;
+        const int xcells = (width  - 1) / xhalf + 1;
+        const int ycells = (height - 2) / yhalf + 1;
         int *c_array = fm->c_array;
         const int arraysize = (xblocks*yblocks)<<2;
-        int      heighta = (height/(blocky/2))*(blocky/2);
-        const int widtha = (width /(blockx/2))*(blockx/2);
-        if (heighta == height)
-            heighta = height - yhalf;
-        memset(c_array, 0, arraysize * sizeof(*c_array));
 
-#define C_ARRAY_ADD(v) do {                         \
-    const int box1 = (x / blockx) * 4;              \
-    const int box2 = ((x + xhalf) / blockx) * 4;    \
-    c_array[temp1 + box1    ] += v;                 \
-    c_array[temp1 + box2 + 1] += v;                 \
-    c_array[temp2 + box1 + 2] += v;                 \
-    c_array[temp2 + box2 + 3] += v;                 \
-} while (0)
+        ff_filter_execute(ctx, comb_count_slice, &td, NULL,
+                          FFMIN(ycells, fm->nb_threads));
 
-#define VERTICAL_HALF(y_start, y_end) do {                                  \
-    for (y = y_start; y < y_end; y++) {                                     \
-        const int temp1 = (y / blocky) * xblocks4;                          \
-        const int temp2 = ((y + yhalf) / blocky) * xblocks4;                \
-        for (x = 0; x < width; x++)                                         \
-            if (cmkp[x - cmk_linesize] == 0xff &&                           \
-                cmkp[x               ] == 0xff &&                           \
-                cmkp[x + cmk_linesize] == 0xff)                             \
-                C_ARRAY_ADD(1);                                             \
-        cmkp += cmk_linesize;                                               \
-    }                                                                       \
-} while (0)
-
-        VERTICAL_HALF(1, yhalf);
-
-        for (y = yhalf; y < heighta; y += yhalf) {
-            const int temp1 = (y / blocky) * xblocks4;
-            const int temp2 = ((y + yhalf) / blocky) * xblocks4;
-
-            for (x = 0; x < widtha; x += xhalf) {
-                const uint8_t *cmkp_tmp = cmkp + x;
-                int u, v, sum = 0;
-                for (u = 0; u < yhalf; u++) {
-                    for (v = 0; v < xhalf; v++)
-                        if (cmkp_tmp[v - cmk_linesize] == 0xff &&
-                            cmkp_tmp[v               ] == 0xff &&
-                            cmkp_tmp[v + cmk_linesize] == 0xff)
-                            sum++;
-                    cmkp_tmp += cmk_linesize;
-                }
-                if (sum)
-                    C_ARRAY_ADD(sum);
-            }
-
-            for (x = widtha; x < width; x++) {
-                const uint8_t *cmkp_tmp = cmkp + x;
-                int u, sum = 0;
-                for (u = 0; u < yhalf; u++) {
-                    if (cmkp_tmp[-cmk_linesize] == 0xff &&
-                        cmkp_tmp[            0] == 0xff &&
-                        cmkp_tmp[ cmk_linesize] == 0xff)
-                        sum++;
-                    cmkp_tmp += cmk_linesize;
-                }
-                if (sum)
-                    C_ARRAY_ADD(sum);
+        /* every half block contributes to the 4 overlapping blocks it is part of */
+        memset(c_array, 0, arraysize * sizeof(*c_array));
+        for (y = 0; y < ycells; y++) {
+            const int *cells = fm->c_cells + y * xcells;
+            const int temp1 = (y >> 1) * xblocks4;
+            const int temp2 = ((y + 1) >> 1) * xblocks4;
+
+            for (x = 0; x < xcells; x++) {
+                const int box1 = (x >> 1) * 4;
+                const int box2 = ((x + 1) >> 1) * 4;
+                const int v = cells[x];
+                if (!v)
+                    continue;
+                c_array[temp1 + box1    ] += v;
+                c_array[temp1 + box2 + 1] += v;
+                c_array[temp2 + box1 + 2] += v;
+                c_array[temp2 + box2 + 3] += v;
             }
-
-            cmkp += cmk_linesize * yhalf;
         }
 
-        VERTICAL_HALF(heighta, height - 1);
-
         for (x = 0; x < arraysize; x++)
             if (c_array[x] > max_v)
                 max_v = c_array[x];
@@ -392,42 +375,61 @@ static int calc_combed_score(const FieldMatchContext *fm, const AVFrame *src)
     return max_v;
 }
 
+typedef struct CompareThreadData {
+    int plane, width, height;
+    int y0a, y1a, startx, stopx;
+    /* diff map input: fields of the two candidate frames */
+    const uint8_t *prvp, *nxtp;
+    int prv_linesize, nxt_linesize;
+    uint8_t *mapd;                  ///< first diff map line written
+    uint8_t *mapp;                  ///< first diff map line read by the comparison
+    int map_linesize;
+    const uint8_t *srcpf, *srcf, *srcnf;
+    const uint8_t *prvpf, *prvnf, *nxtpf, *nxtnf;
+    int srcf_linesize, prvf_linesize, nxtf_linesize;
+} CompareThreadData;
+
 // the secret is that tbuffer is an interlaced, offset subset of all the lines
-static void build_abs_diff_mask(const uint8_t *prvp, int prv_linesize,
-                                const uint8_t *nxtp, int nxt_linesize,
-                                uint8_t *tbuffer,    int tbuf_linesize,
-                                int width, int height)
+static int abs_diff_mask_slice(AVFilterContext *ctx, void *arg, int jobnr, int nb_jobs)
 {
-    int y, x;
-
-    prvp -= prv_linesize;
-    nxtp -= nxt_linesize;
-    for (y = 0; y < height; y++) {
-        for (x = 0; x < width; x++)
-            tbuffer[x] = FFABS(prvp[x] - nxtp[x]);
-        prvp += prv_linesize;
-        nxtp += nxt_linesize;
-        tbuffer += tbuf_linesize;
-    }
+    const FieldMatchContext *fm = ctx->priv;
+    const CompareThreadData *td = arg;
+    const int tpitch = td->plane ? fm->tpitchuv : fm->tpitchy;
+    const int map_linesize = fm->map_linesize[td->plane];
+    const int height = td->height;
+    const int slice_start = (height *  jobnr     ) / nb_jobs;
+    const int slice_end   = (height * (jobnr + 1)) / nb_jobs;
+
+    fill_buf(fm->map_data[td->plane] + slice_start * map_linesize,
+             td->width, slice_end - slice_start, map_linesize, 0);
+
+    /* lines of the tbuffer are split on the same boundaries, halved */
+    for (int y = slice_start >> 1; y < slice_end >> 1; y++)
+        fm->dsp.abs_diff_line(fm->tbuffer + y * tpitch,
+                              td->prvp + (y - 1) * td->prv_linesize,
+                              td->nxtp + (y - 1) * td->nxt_linesize,
+                              td->width);
+    return 0;
 }
 
 /**
  * Build a map over which pixels differ a lot/a little
  */
-static void build_diff_map(FieldMatchContext *fm,
-                           const uint8_t *prvp, int prv_linesize,
-                           const uint8_t *nxtp, int nxt_linesize,
-                           uint8_t *dstp, int dst_linesize, int height,
-                           int width, int plane)
+static int diff_map_slice(AVFilterContext *ctx, void *arg, int jobnr, int nb_jobs)
 {
+    const FieldMatchContext *fm = ctx->priv;
+    const CompareThreadData *td = arg;
+    const int width  = td->width;
+    const int height = td->height;
+    const int nb_lines = (height - 3) / 2;
+    const int slice_start = (nb_lines *  jobnr     ) / nb_jobs;
+    const int slice_end   = (nb_lines * (jobnr + 1)) / nb_jobs;
     int x, y, u, diff, count;
-    int tpitch = plane ? fm->tpitchuv : fm->tpitchy;
-    const uint8_t *dp = fm->tbuffer + tpitch;
+    int tpitch = td->plane ? fm->tpitchuv : fm->tpitchy;
+    const uint8_t *dp = fm->tbuffer + tpitch * (slice_start + 1);
+    uint8_t *dstp = td->mapd + td->map_linesize * slice_start;
 
-    build_abs_diff_mask(prvp, prv_linesize, nxtp, nxt_linesize,
-                        fm->tbuffer, tpitch, width, height>>1);
-
-    for (y = 2; y < height - 2; y += 2) {
+    for (y = 2 + 2 * slice_start; y < 2 + 2 * slice_end; y += 2) {
         for (x = 1; x < width - 1; x++) {
             diff = dp[x];
             if (diff > 3) {
@@ -468,8 +470,71 @@ static void build_diff_map(FieldMatchContext *fm,
             }
         }
         dp += tpitch;
-        dstp += dst_linesize;
+        dstp += td->map_linesize;
+    }
+    return 0;
+}
+
+/**
+ * Accumulate the field differences of a range of lines into the sums of the job.
+ */
+static int compare_fields_slice(AVFilterContext *ctx, void *arg, int jobnr, int nb_jobs)
+{
+    const FieldMatchContext *fm = ctx->priv;
+    const CompareThreadData *td = arg;
+    MatchSums *sums = &fm->sums[jobnr];
+    const int map_linesize = td->map_linesize;
+    const int nb_lines = (td->height - 3) / 2;
+    const int slice_start = (nb_lines *  jobnr     ) / nb_jobs;
+    const int slice_end   = (nb_lines * (jobnr + 1)) / nb_jobs;
+    const uint8_t *mapp  = td->mapp  + slice_start * map_linesize;
+    const uint8_t *srcpf = td->srcpf + slice_start * td->srcf_linesize;
+    const uint8_t *srcf  = td->srcf  + slice_start * td->srcf_linesize;
+    const uint8_t *srcnf = td->srcnf + slice_start * td->srcf_linesize;
+    const uint8_t *prvpf = td->prvpf + slice_start * td->prvf_linesize;
+    const uint8_t *prvnf = td->prvnf + slice_start * td->prvf_linesize;
+    const uint8_t *nxtpf = td->nxtpf + slice_start * td->nxtf_linesize;
+    const uint8_t *nxtnf = td->nxtnf + slice_start * td->nxtf_linesize;
+    int x, y, temp1, temp2;
+
+    for (y = 2 + 2 * slice_start; y < 2 + 2 * slice_end; y += 2) {
+        if (td->y0a == td->y1a || y < td->y0a || y > td->y1a) {
+            for (x = td->startx; x < td->stopx; x++) {
+                if (mapp[x] > 0 || mapp[x + map_linesize] > 0) {
+                    temp1 = srcpf[x] + (srcf[x] << 2) + srcnf[x]; // [1 4 1]
+
+                    temp2 = abs(3 * (prvpf[x] + prvnf[x]) - temp1);
+                    if (temp2 > 23 && ((mapp[x]&1) || (mapp[x + map_linesize]&1)))
+                        sums->pc += temp2;
+                    if (temp2 > 42) {
+                        if ((mapp[x]&2) || (mapp[x + map_linesize]&2))
+                            sums->pm += temp2;
+                        if ((mapp[x]&4) || (mapp[x + map_linesize]&4))
+                            sums->pml += temp2;
+                    }
+
+                    temp2 = abs(3 * (nxtpf[x] + nxtnf[x]) - temp1);
+                    if (temp2 > 23 && ((mapp[x]&1) || (mapp[x + map_linesize]&1)))
+                        sums->nc += temp2;
+                    if (temp2 > 42) {
+                        if ((mapp[x]&2) || (mapp[x + map_linesize]&2))
+                            sums->nm += temp2;
+                        if ((mapp[x]&4) || (mapp[x + map_linesize]&4))
+                            sums->nml += temp2;
+                    }
+                }
+            }
+        }
+        prvpf += td->prvf_linesize;
+        prvnf += td->prvf_linesize;
+        srcpf += td->srcf_linesize;
+        srcf  += td->srcf_linesize;
+        srcnf += td->srcf_linesize;
+        nxtpf += td->nxtf_linesize;
+        nxtnf += td->nxtf_linesize;
+        mapp  += map_linesize;
     }
+    return 0;
 }
 
 enum { mP, mC, mN, mB, mU };
@@ -486,8 +551,9 @@ static AVFrame *select_frame(FieldMatchContext *fm, int match)
     else  /* match == mC */              return fm->src;
 }
 
-static int compare_fields(FieldMatchContext *fm, int match1, int match2, int field)
+static int compare_fields(AVFilterContext *ctx, int match1, int match2, int field)
 {
+    FieldMatchContext *fm = ctx->priv;
     int plane, ret;
     uint64_t accumPc = 0, accumPm = 0, accumPml = 0;
     uint64_t accumNc = 0, accumNm = 0, accumNml = 0;
@@ -496,7 +562,8 @@ static int compare_fields(FieldMatchContext *fm, int match1, int match2, int fie
     const AVFrame *src = fm->src;
 
     for (plane = 0; plane < (fm->mchroma ? 3 : 1); plane++) {
-        int x, y, temp1, temp2, fbase;
+        CompareThreadData td;
+        int fbase, nb_jobs;
         const AVFrame *prev, *next;
         uint8_t *mapp    = fm->map_data[plane];
         int map_linesize = fm->map_linesize[plane];
@@ -507,20 +574,12 @@ static int compare_fields(FieldMatchContext *fm, int match1, int match2, int fie
         int prvf_linesize, nxtf_linesize;
         const int width  = get_width (fm, src, plane, INPUT_MAIN);
         const int height = get_height(fm, src, plane, INPUT_MAIN);
-        const int y0a = fm->y0 >> (plane ? fm->vsub[INPUT_MAIN] : 0);
-        const int y1a = fm->y1 >> (plane ? fm->vsub[INPUT_MAIN] : 0);
-        const int startx = (plane == 0 ? 8 : 8 >> fm->hsub[INPUT_MAIN]);
-        const int stopx  = width - startx;
-        const uint8_t *srcpf, *srcf, *srcnf;
+        const uint8_t *srcf;
         const uint8_t *prvpf, *prvnf, *nxtpf, *nxtnf;
 
-        fill_buf(mapp, width, height, map_linesize, 0);
-
         /* match1 */
         fbase = get_field_base(match1, field);
         srcf  = srcp + (fbase + 1) * src_linesize;
-        srcpf = srcf - srcf_linesize;
-        srcnf = srcf + srcf_linesize;
         mapp  = mapp + fbase * map_linesize;
         prev = select_frame(fm, match1);
         prv_linesize  = prev->linesize[plane];
@@ -537,49 +596,58 @@ static int compare_fields(FieldMatchContext *fm, int match1, int match2, int fie
         nxtnf = nxtpf + nxtf_linesize;                      // next frame, next     field
 
         map_linesize <<= 1;
-        if ((match1 >= 3 && field == 1) || (match1 < 3 && field != 1))
-            build_diff_map(fm, prvpf, prvf_linesize, nxtpf, nxtf_linesize,
-                           mapp, map_linesize, height, width, plane);
-        else
-            build_diff_map(fm, prvnf, prvf_linesize, nxtnf, nxtf_linesize,
-                           mapp + map_linesize, map_linesize, height, width, plane);
-
-        for (y = 2; y < height - 2; y += 2) {
-            if (y0a == y1a || y < y0a || y > y1a) {
-                for (x = startx; x < stopx; x++) {
-                    if (mapp[x] > 0 || mapp[x + map_linesize] > 0) {
-                        temp1 = srcpf[x] + (srcf[x] << 2) + srcnf[x]; // [1 4 1]
-
-                        temp2 = abs(3 * (prvpf[x] + prvnf[x]) - temp1);
-                        if (temp2 > 23 && ((mapp[x]&1) || (mapp[x + map_linesize]&1)))
-                            accumPc += temp2;
-                        if (temp2 > 42) {
-                            if ((mapp[x]&2) || (mapp[x + map_linesize]&2))
-                                accumPm += temp2;
-                            if ((mapp[x]&4) || (mapp[x + map_linesize]&4))
-                                accumPml += temp2;
-                        }
 
-                        temp2 = abs(3 * (nxtpf[x] + nxtnf[x]) - temp1);
-                        if (temp2 > 23 && ((mapp[x]&1) || (mapp[x + map_linesize]&1)))
-                            accumNc += temp2;
-                        if (temp2 > 42) {
-                            if ((mapp[x]&2) || (mapp[x + map_linesize]&2))
-                                accumNm += temp2;
-                            if ((mapp[x]&4) || (mapp[x + map_linesize]&4))
-                                accumNml += temp2;
-                        }
-                    }
-                }
-            }
-            prvpf += prvf_linesize;
-            prvnf += prvf_linesize;
-            srcpf += srcf_linesize;
-            srcf  += srcf_linesize;
-            srcnf += srcf_linesize;
-            nxtpf += nxtf_linesize;
-            nxtnf += nxtf_linesize;
-            mapp  += map_linesize;
+        td = (CompareThreadData) {
+            .plane         = plane,
+            .width         = width,
+            .height        = height,
+            .y0a           = fm->y0 >> (plane ? fm->vsub[INPUT_MAIN] : 0),
+            .y1a           = fm->y1 >> (plane ? fm->vsub[INPUT_MAIN] : 0),
+            .startx        = plane == 0 ? 8 : 8 >> fm->hsub[INPUT_MAIN],
+            .prv_linesize  = prvf_linesize,
+            .nxt_linesize  = nxtf_linesize,
+            .mapp          = mapp,
+            .map_linesize  = map_linesize,
+            .srcpf         = srcf - srcf_linesize,
+            .srcf          = srcf,
+            .srcnf         = srcf + srcf_linesize,
+            .prvpf         = prvpf,
+            .prvnf         = prvnf,
+            .nxtpf         = nxtpf,
+            .nxtnf         = nxtnf,
+            .srcf_linesize = srcf_linesize,
+            .prvf_linesize = prvf_linesize,
+            .nxtf_linesize = nxtf_linesize,
+        };
+        td.stopx = width - td.startx;
+        if ((match1 >= 3 && field == 1) || (match1 < 3 && field != 1)) {
+            td.prvp = prvpf;
+            td.nxtp = nxtpf;
+            td.mapd = mapp;
+        } else {
+            td.prvp = prvnf;
+            td.nxtp = nxtnf;
+            td.mapd = mapp + map_linesize;
+        }
+
+        /* each step reads lines written by neighbouring jobs of the previous one */
+        ff_filter_execute(ctx, abs_diff_mask_slice, &td, NULL,
+                          FFMIN(height / 2, fm->nb_threads));
+
+        nb_jobs = FFMIN((height - 3) / 2, fm->nb_threads);
+        if (nb_jobs <= 0)
+            continue;
+        ff_filter_execute(ctx, diff_map_slice, &td, NULL, nb_jobs);
+
+        memset(fm->sums, 0, nb_jobs * sizeof(*fm->sums));
+        ff_filter_execute(ctx, compare_fields_slice, &td, NULL, nb_jobs);
+        for (int i = 0; i < nb_jobs; i++) {
+            accumPc  += fm->sums[i].pc;
+            accumPm  += fm->sums[i].pm;
+            accumPml += fm->sums[i].pml;
+            accumNc  += fm->sums[i].nc;
+            accumNm  += fm->sums[i].nm;
+            accumNml += fm->sums[i].nml;
         }
     }
 
@@ -659,7 +727,7 @@ static int checkmm(AVFilterContext *ctx, int *combs, int m1, int m2,
             gen_frames[mid] = create_weave_frame(ctx, mid, field,               \
                                                  fm->prv, fm->src, fm->nxt,     \
                                                  INPUT_MAIN);                   \
-        combs[mid] = calc_combed_score(fm, gen_frames[mid]);                    \
+        combs[mid] = calc_combed_score(ctx, gen_frames[mid]);                   \
     }                                                                           \
 } while (0)
 
@@ -734,7 +802,7 @@ static int filter_frame(AVFilterLink *inlink, AVFrame *in)
                 ret = AVERROR(ENOMEM);
                 goto fail;
             }
-            combs[i] = calc_combed_score(fm, gen_frames[i]);
+            combs[i] = calc_combed_score(ctx, gen_frames[i]);
         }
         av_log(ctx, AV_LOG_INFO, "COMBS: %3d %3d %3d %3d %3d\n",
                combs[0], combs[1], combs[2], combs[3], combs[4]);
@@ -747,9 +815,9 @@ static int filter_frame(AVFilterLink *inlink, AVFrame *in)
     }
 
     /* p/c selection and optional 3-way p/c/n matches */
-    match = compare_fields(fm, fxo[mC], fxo[mP], field);
+    match = compare_fields(ctx, fxo[mC], fxo[mP], field);
     if (fm->mode == MODE_PCN || fm->mode == MODE_PCN_UB)
-        match = compare_fields(fm, match, fxo[mN], field);
+        match = compare_fields(ctx, match, fxo[mN], field);
 
     /* scene change check */
     if (fm->combmatch == COMBMATCH_SC) {
@@ -969,16 +1037,23 @@ static int config_input(AVFilterLink *inlink)
         fm->vsub[INPUT_CLEANSRC] = pix_desc->log2_chroma_h;
     }
 
-    fm->tpitchy  = FFALIGN(w,      16);
-    fm->tpitchuv = FFALIGN(w >> 1, 16);
+    fm->tpitchy  = FFALIGN(w, 16);
+    fm->tpitchuv = FFALIGN(AV_CEIL_RSHIFT(w, fm->hsub[INPUT_MAIN]), 16);
 
+    fm->nb_threads = ff_filter_get_nb_threads(ctx);
     fm->tbuffer = av_calloc((h/2 + 4) * fm->tpitchy, sizeof(*fm->tbuffer));
     fm->c_array = av_malloc_array((((w + fm->blockx/2)/fm->blockx)+1) *
                             (((h + fm->blocky/2)/fm->blocky)+1),
                             4 * sizeof(*fm->c_array));
-    if (!fm->tbuffer || !fm->c_array)
+    fm->c_cells = av_malloc_array(((w - 1) / (fm->blockx/2) + 1) *
+                                  ((h - 2) / (fm->blocky/2) + 1),
+                                  sizeof(*fm->c_cells));
+    fm->sums = av_calloc(fm->nb_threads, sizeof(*fm->sums));
+    if (!fm->tbuffer || !fm->c_array || !fm->c_cells || !fm->sums)
         return AVERROR(ENOMEM);
 
+    ff_fieldmatch_dsp_init(&fm->dsp);
+
     return 0;
 }
 
@@ -1034,6 +1109,8 @@ static av_cold void fieldmatch_uninit(AVFilterContext *ctx)
     av_freep(&fm->cmask_data[0]);
     av_freep(&fm->tbuffer);
     av_freep(&fm->c_array);
+    av_freep(&fm->c_cells);
+    av_freep(&fm->sums);
 }
 
 static int config_output(AVFilterLink *outlink)
@@ -1067,7 +1144,7 @@ const FFFilter ff_vf_fieldmatch = {
     .p.name         = "fieldmatch",
     .p.description  = NULL_IF_CONFIG_SMALL("Field matching for inverse telecine."),
     .p.priv_class   = &fieldmatch_class,
-    .p.flags        = AVFILTER_FLAG_DYNAMIC_INPUTS,
+    .p.flags        = AVFILTER_FLAG_DYNAMIC_INPUTS | AVFILTER_FLAG_SLICE_THREADS,
     .priv_size      = sizeof(FieldMatchContext),
     .init           = fieldmatch_init,
     .activate       = activate,
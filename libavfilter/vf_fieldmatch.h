@@ -0,0 +1,81 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#ifndef AVFILTER_FIELDMATCH_H
+#define AVFILTER_FIELDMATCH_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#include "config.h"
+#include "libavutil/common.h"
+
+typedef struct FieldMatchDSPContext {
+    /**
+     * Build one line of the comb mask: dst[x] is set to 0xff if the pixel
+     * differs from both vertical neighbours by more than cthresh and the
+     * [1 -3 4 -3 1] vertical filter exceeds 6 * cthresh, and to 0 otherwise.
+     */
+    void (*comb_line)(uint8_t *dst, const uint8_t *srcpp, const uint8_t *srcp,
+                      const uint8_t *src, const uint8_t *srcn,
+                      const uint8_t *srcnn, ptrdiff_t width, int cthresh);
+
+    /**
+     * dst[x] = |a[x] - b[x]|
+     */
+    void (*abs_diff_line)(uint8_t *dst, const uint8_t *a, const uint8_t *b,
+                          ptrdiff_t width);
+} FieldMatchDSPContext;
+
+void ff_fieldmatch_dsp_init_x86(FieldMatchDSPContext *dsp);
+
+static void fieldmatch_comb_line_c(uint8_t *dst, const uint8_t *srcpp,
+                                   const uint8_t *srcp, const uint8_t *src,
+                                   const uint8_t *srcn, const uint8_t *srcnn,
+                                   ptrdiff_t width, int cthresh)
+{
+    const int cthresh6 = cthresh * 6;
+
+    for (ptrdiff_t x = 0; x < width; x++) {
+        const int s1 = abs(src[x] - srcp[x]);
+        const int s2 = abs(src[x] - srcn[x]);
+        dst[x] = s1 > cthresh && s2 > cthresh &&
+                 abs(4 * src[x] - 3 * (srcp[x] + srcn[x]) +
+                     srcpp[x] + srcnn[x]) > cthresh6 ? 0xff : 0;
+    }
+}
+
+static void fieldmatch_abs_diff_line_c(uint8_t *dst, const uint8_t *a,
+                                       const uint8_t *b, ptrdiff_t width)
+{
+    for (ptrdiff_t x = 0; x < width; x++)
+        dst[x] = FFABS(a[x] - b[x]);
+}
+
+static inline void ff_fieldmatch_dsp_init(FieldMatchDSPContext *dsp)
+{
+    dsp->comb_line     = fieldmatch_comb_line_c;
+    dsp->abs_diff_line = fieldmatch_abs_diff_line_c;
+
+#if ARCH_X86 && HAVE_X86ASM
+    ff_fieldmatch_dsp_init_x86(dsp);
+#endif
+}
+
+#endif /* AVFILTER_FIELDMATCH_H */
@@ -19,12 +19,15 @@
  * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
  */
 
+#include <stdatomic.h>
+
 #include "motion_estimation.h"
 #include "libavcodec/mathops.h"
 #include "libavutil/common.h"
 #include "libavutil/mem.h"
 #include "libavutil/opt.h"
 #include "libavutil/pixdesc.h"
+#include "libavutil/thread.h"
 #include "avfilter.h"
 #include "filters.h"
 #include "video.h"
@@ -161,6 +164,14 @@ typedef struct Frame {
     Block *blocks;
 } Frame;
 
+typedef struct ThreadData {
+    Block *blocks;
+    int dir;
+    int alpha;
+    AVFrame *out;
+    int pred_x, pred_y;     ///< predictor left by the last block searched
+} ThreadData;
+
 typedef struct MIContext {
     const AVClass *class;
     AVMotionEstContext me_ctx;
@@ -195,6 +206,13 @@ typedef struct MIContext {
     int log2_chroma_w;
     int log2_chroma_h;
     int nb_planes;
+
+    /* the motion search of a block row depends on the row above */
+    atomic_int *row_progress;
+    atomic_int next_row;
+    AVMutex progress_lock;
+    AVCond progress_cond;
+    int *job_rets;
 } MIContext;
 
 #define OFFSET(x) offsetof(MIContext, x)
@@ -254,8 +272,8 @@ static uint64_t get_sbad(AVMotionEstContext *me_ctx, int x, int y, int x_mv, int
     int linesize = me_ctx->linesize;
     int mv_x1 = x_mv - x;
     int mv_y1 = y_mv - y;
-    int mv_x, mv_y, i, j;
-    uint64_t sbad = 0;
+    int mv_x, mv_y;
+    uint64_t sbad;
 
     x = av_clip(x, me_ctx->x_min, me_ctx->x_max);
     y = av_clip(y, me_ctx->y_min, me_ctx->y_max);
@@ -265,9 +283,7 @@ static uint64_t get_sbad(AVMotionEstContext *me_ctx, int x, int y, int x_mv, int
     data_cur += (y + mv_y) * linesize;
     data_next += (y - mv_y) * linesize;
 
-    for (j = 0; j < me_ctx->mb_size; j++)
-        for (i = 0; i < me_ctx->mb_size; i++)
-            sbad += FFABS(data_cur[x + mv_x + i + j * linesize] - data_next[x - mv_x + i + j * linesize]);
+    sbad = ff_me_sad(me_ctx, data_cur + x + mv_x, data_next + x - mv_x, me_ctx->mb_size);
 
     return sbad + (FFABS(mv_x1 - me_ctx->pred_x) + FFABS(mv_y1 - me_ctx->pred_y)) * COST_PRED_SCALE;
 }
@@ -281,19 +297,20 @@ static uint64_t get_sbad_ob(AVMotionEstContext *me_ctx, int x, int y, int x_mv,
     int x_max = me_ctx->x_max - me_ctx->mb_size / 2;
     int y_min = me_ctx->y_min + me_ctx->mb_size / 2;
     int y_max = me_ctx->y_max - me_ctx->mb_size / 2;
+    int ob = me_ctx->mb_size / 2;
     int mv_x1 = x_mv - x;
     int mv_y1 = y_mv - y;
-    int mv_x, mv_y, i, j;
-    uint64_t sbad = 0;
+    int mv_x, mv_y;
+    uint64_t sbad;
 
     x = av_clip(x, x_min, x_max);
     y = av_clip(y, y_min, y_max);
     mv_x = av_clip(x_mv - x, -FFMIN(x - x_min, x_max - x), FFMIN(x - x_min, x_max - x));
     mv_y = av_clip(y_mv - y, -FFMIN(y - y_min, y_max - y), FFMIN(y - y_min, y_max - y));
 
-    for (j = -me_ctx->mb_size / 2; j < me_ctx->mb_size * 3 / 2; j++)
-        for (i = -me_ctx->mb_size / 2; i < me_ctx->mb_size * 3 / 2; i++)
-            sbad += FFABS(data_cur[x + mv_x + i + (y + mv_y + j) * linesize] - data_next[x - mv_x + i + (y - mv_y + j) * linesize]);
+    sbad = ff_me_sad(me_ctx, data_cur + x + mv_x - ob + (y + mv_y - ob) * linesize,
+                     data_next + x - mv_x - ob + (y - mv_y - ob) * linesize,
+                     me_ctx->mb_size * 3 / 2 + ob);
 
     return sbad + (FFABS(mv_x1 - me_ctx->pred_x) + FFABS(mv_y1 - me_ctx->pred_y)) * COST_PRED_SCALE;
 }
@@ -307,19 +324,19 @@ static uint64_t get_sad_ob(AVMotionEstContext *me_ctx, int x, int y, int x_mv, i
     int x_max = me_ctx->x_max - me_ctx->mb_size / 2;
     int y_min = me_ctx->y_min + me_ctx->mb_size / 2;
     int y_max = me_ctx->y_max - me_ctx->mb_size / 2;
+    int ob = me_ctx->mb_size / 2;
     int mv_x = x_mv - x;
     int mv_y = y_mv - y;
-    int i, j;
-    uint64_t sad = 0;
+    uint64_t sad;
 
     x = av_clip(x, x_min, x_max);
     y = av_clip(y, y_min, y_max);
     x_mv = av_clip(x_mv, x_min, x_max);
     y_mv = av_clip(y_mv, y_min, y_max);
 
-    for (j = -me_ctx->mb_size / 2; j < me_ctx->mb_size * 3 / 2; j++)
-        for (i = -me_ctx->mb_size / 2; i < me_ctx->mb_size * 3 / 2; i++)
-            sad += FFABS(data_ref[x_mv + i + (y_mv + j) * linesize] - data_cur[x + i + (y + j) * linesize]);
+    sad = ff_me_sad(me_ctx, data_ref + x_mv - ob + (y_mv - ob) * linesize,
+                    data_cur + x - ob + (y - ob) * linesize,
+                    me_ctx->mb_size * 3 / 2 + ob);
 
     return sad + (FFABS(mv_x - me_ctx->pred_x) + FFABS(mv_y - me_ctx->pred_y)) * COST_PRED_SCALE;
 }
@@ -378,6 +395,14 @@ static int config_input(AVFilterLink *inlink)
             if (!FF_ALLOCZ_TYPED_ARRAY(mi_ctx->int_blocks, mi_ctx->b_count))
                 return AVERROR(ENOMEM);
 
+        if (mi_ctx->me_mode == ME_MODE_BILAT && mi_ctx->vsbmc)
+            if (!FF_ALLOCZ_TYPED_ARRAY(mi_ctx->job_rets, mi_ctx->b_height))
+                return AVERROR(ENOMEM);
+
+        mi_ctx->row_progress = av_calloc(mi_ctx->b_height, sizeof(*mi_ctx->row_progress));
+        if (!mi_ctx->row_progress)
+            return AVERROR(ENOMEM);
+
         if (mi_ctx->me_method == AV_ME_METHOD_EPZS) {
             for (i = 0; i < 3; i++) {
                 mi_ctx->mv_table[i] = av_calloc(mi_ctx->b_count, sizeof(*mi_ctx->mv_table[0]));
@@ -414,9 +439,9 @@ static int config_output(AVFilterLink *outlink)
         preds.nb++;\
     } while(0)
 
-static void search_mv(MIContext *mi_ctx, Block *blocks, int mb_x, int mb_y, int dir)
+static void search_mv(MIContext *mi_ctx, AVMotionEstContext *me_ctx, Block *blocks,
+                      int mb_x, int mb_y, int dir)
 {
-    AVMotionEstContext *me_ctx = &mi_ctx->me_ctx;
     AVMotionEstPredictor *preds = me_ctx->preds;
     Block *block = &blocks[mb_x + mb_y * mi_ctx->b_width];
 
@@ -556,8 +581,83 @@ static void search_mv(MIContext *mi_ctx, Block *blocks, int mb_x, int mb_y, int
     block->mvs[dir][1] = mv[1] - y_mb;
 }
 
-static void bilateral_me(MIContext *mi_ctx)
+static void report_progress(MIContext *mi_ctx, int mb_y, int progress)
+{
+    atomic_store_explicit(&mi_ctx->row_progress[mb_y], progress, memory_order_release);
+    ff_mutex_lock(&mi_ctx->progress_lock);
+    ff_cond_broadcast(&mi_ctx->progress_cond);
+    ff_mutex_unlock(&mi_ctx->progress_lock);
+}
+
+static void await_progress(MIContext *mi_ctx, int mb_y, int progress)
+{
+    if (atomic_load_explicit(&mi_ctx->row_progress[mb_y], memory_order_acquire) >= progress)
+        return;
+
+    ff_mutex_lock(&mi_ctx->progress_lock);
+    while (atomic_load_explicit(&mi_ctx->row_progress[mb_y], memory_order_acquire) < progress)
+        ff_cond_wait(&mi_ctx->progress_cond, &mi_ctx->progress_lock);
+    ff_mutex_unlock(&mi_ctx->progress_lock);
+}
+
+static int search_mv_rows(AVFilterContext *ctx, void *arg, int jobnr, int nb_jobs)
 {
+    MIContext *mi_ctx = ctx->priv;
+    ThreadData *td = arg;
+    AVMotionEstContext me_ctx = mi_ctx->me_ctx;
+    /* EPZS and UMH predict from the left, top and top-right blocks */
+    const int wavefront = mi_ctx->me_method == AV_ME_METHOD_EPZS ||
+                          mi_ctx->me_method == AV_ME_METHOD_UMH;
+    int mb_x, mb_y;
+
+    /* rows are taken in order, so a row is never waited for before it was
+     * picked by a running job */
+    while ((mb_y = atomic_fetch_add_explicit(&mi_ctx->next_row, 1, memory_order_relaxed)) < mi_ctx->b_height) {
+        for (mb_x = 0; mb_x < mi_ctx->b_width; mb_x++) {
+            if (wavefront && mb_y > 0)
+                await_progress(mi_ctx, mb_y - 1, FFMIN(mb_x + 2, mi_ctx->b_width));
+
+            search_mv(mi_ctx, &me_ctx, td->blocks, mb_x, mb_y, td->dir);
+
+            if (wavefront)
+                report_progress(mi_ctx, mb_y, mb_x + 1);
+        }
+
+        if (mb_y == mi_ctx->b_height - 1) {
+            td->pred_x = me_ctx.pred_x;
+            td->pred_y = me_ctx.pred_y;
+        }
+    }
+
+    return 0;
+}
+
+static void search_mvs(AVFilterContext *ctx, Block *blocks, int dir)
+{
+    MIContext *mi_ctx = ctx->priv;
+    ThreadData td;
+    int mb_y;
+
+    td.blocks = blocks;
+    td.dir    = dir;
+    td.pred_x = mi_ctx->me_ctx.pred_x;
+    td.pred_y = mi_ctx->me_ctx.pred_y;
+
+    for (mb_y = 0; mb_y < mi_ctx->b_height; mb_y++)
+        atomic_init(&mi_ctx->row_progress[mb_y], 0);
+    atomic_init(&mi_ctx->next_row, 0);
+
+    ff_filter_execute(ctx, search_mv_rows, &td, NULL,
+                      FFMIN(mi_ctx->b_height, ff_filter_get_nb_threads(ctx)));
+
+    /* keep the predictor of the last block, as a serial search would */
+    mi_ctx->me_ctx.pred_x = td.pred_x;
+    mi_ctx->me_ctx.pred_y = td.pred_y;
+}
+
+static void bilateral_me(AVFilterContext *ctx)
+{
+    MIContext *mi_ctx = ctx->priv;
     Block *block;
     int mb_x, mb_y;
 
@@ -572,14 +672,12 @@ static void bilateral_me(MIContext *mi_ctx)
             block->mvs[0][1] = 0;
         }
 
-    for (mb_y = 0; mb_y < mi_ctx->b_height; mb_y++)
-        for (mb_x = 0; mb_x < mi_ctx->b_width; mb_x++)
-            search_mv(mi_ctx, mi_ctx->int_blocks, mb_x, mb_y, 0);
+    search_mvs(ctx, mi_ctx->int_blocks, 0);
 }
 
-static int var_size_bme(MIContext *mi_ctx, Block *block, int x_mb, int y_mb, int n)
+static int var_size_bme(MIContext *mi_ctx, AVMotionEstContext *me_ctx, Block *block,
+                        int x_mb, int y_mb, int n)
 {
-    AVMotionEstContext *me_ctx = &mi_ctx->me_ctx;
     uint64_t cost_sb, cost_old;
     int mb_size = me_ctx->mb_size;
     int search_param = me_ctx->search_param;
@@ -588,6 +686,8 @@ static int var_size_bme(MIContext *mi_ctx, Block *block, int x_mb, int y_mb, int
     int ret;
 
     me_ctx->mb_size = 1 << n;
+    me_ctx->pred_x = block->mvs[0][0];
+    me_ctx->pred_y = block->mvs[0][1];
     cost_old = me_ctx->get_cost(me_ctx, x_mb, y_mb, x_mb + block->mvs[0][0], y_mb + block->mvs[0][1]);
     me_ctx->mb_size = mb_size;
 
@@ -614,7 +714,7 @@ static int var_size_bme(MIContext *mi_ctx, Block *block, int x_mb, int y_mb, int
             me_ctx->pred_x = block->mvs[0][0];
             me_ctx->pred_y = block->mvs[0][1];
 
-            cost_sb = ff_me_search_ds(&mi_ctx->me_ctx, x_mb + block->mvs[0][0], y_mb + block->mvs[0][1], mv);
+            cost_sb = ff_me_search_ds(me_ctx, x_mb + block->mvs[0][0], y_mb + block->mvs[0][1], mv);
             mv_x = mv[0] - x_mb;
             mv_y = mv[1] - y_mb;
 
@@ -626,7 +726,7 @@ static int var_size_bme(MIContext *mi_ctx, Block *block, int x_mb, int y_mb, int
                 sb->mvs[0][1] = mv_y;
 
                 if (n > 1) {
-                    if (ret = var_size_bme(mi_ctx, sb, x_mb + (x << (n - 1)), y_mb + (y << (n - 1)), n - 1))
+                    if (ret = var_size_bme(mi_ctx, me_ctx, sb, x_mb + (x << (n - 1)), y_mb + (y << (n - 1)), n - 1))
                         return ret;
                 } else
                     sb->sb = 0;
@@ -639,12 +739,51 @@ static int var_size_bme(MIContext *mi_ctx, Block *block, int x_mb, int y_mb, int
     return 0;
 }
 
-static int cluster_mvs(MIContext *mi_ctx)
+static int var_size_bme_slice(AVFilterContext *ctx, void *arg, int jobnr, int nb_jobs)
 {
+    MIContext *mi_ctx = ctx->priv;
+    AVMotionEstContext me_ctx = mi_ctx->me_ctx;
+    const int slice_start = (mi_ctx->b_height *  jobnr     ) / nb_jobs;
+    const int slice_end   = (mi_ctx->b_height * (jobnr + 1)) / nb_jobs;
+    int mb_x, mb_y, x, y, dx, dy;
+    int ret;
+    Block *block;
+
+    /* find boundaries */
+    for (mb_y = slice_start; mb_y < slice_end; mb_y++)
+        for (mb_x = 0; mb_x < mi_ctx->b_width; mb_x++) {
+            block = &mi_ctx->int_blocks[mb_x + mb_y * mi_ctx->b_width];
+            for (y = FFMAX(mb_y - 1, 0); y < FFMIN(mb_y + 2, mi_ctx->b_height); y++)
+                for (x = FFMAX(mb_x - 1, 0); x < FFMIN(mb_x + 2, mi_ctx->b_width); x++) {
+                    dx = x - mb_x;
+                    dy = y - mb_y;
+
+                    if ((x - mb_x) && (y - mb_y) || !dx && !dy)
+                        continue;
+
+                    if (!mb_x || !mb_y || mb_x == mi_ctx->b_width - 1 || mb_y == mi_ctx->b_height - 1)
+                        continue;
+
+                    if (block->cid != mi_ctx->int_blocks[x + y * mi_ctx->b_width].cid) {
+                        if (!dx && block->cid == mi_ctx->int_blocks[x + (mb_y - dy) * mi_ctx->b_width].cid ||
+                            !dy && block->cid == mi_ctx->int_blocks[(mb_x - dx) + y * mi_ctx->b_width].cid) {
+                            if (ret = var_size_bme(mi_ctx, &me_ctx, block, mb_x << mi_ctx->log2_mb_size, mb_y << mi_ctx->log2_mb_size, mi_ctx->log2_mb_size))
+                                return ret;
+                        }
+                    }
+                }
+        }
+
+    return 0;
+}
+
+static int cluster_mvs(AVFilterContext *ctx)
+{
+    MIContext *mi_ctx = ctx->priv;
     int changed, c, c_max = 0;
     int mb_x, mb_y, x, y;
     int mv_x, mv_y, avg_x, avg_y, dx, dy;
-    int d, ret;
+    int d, i, nb_jobs;
     Block *block;
     Cluster *cluster, *cluster_new;
 
@@ -701,29 +840,29 @@ static int cluster_mvs(MIContext *mi_ctx)
             }
     } while (changed);
 
-    /* find boundaries */
-    for (mb_y = 0; mb_y < mi_ctx->b_height; mb_y++)
-        for (mb_x = 0; mb_x < mi_ctx->b_width; mb_x++) {
-            block = &mi_ctx->int_blocks[mb_x + mb_y * mi_ctx->b_width];
-            for (y = FFMAX(mb_y - 1, 0); y < FFMIN(mb_y + 2, mi_ctx->b_height); y++)
-                for (x = FFMAX(mb_x - 1, 0); x < FFMIN(mb_x + 2, mi_ctx->b_width); x++) {
-                    dx = x - mb_x;
-                    dy = y - mb_y;
+    nb_jobs = FFMIN(mi_ctx->b_height, ff_filter_get_nb_threads(ctx));
+    ff_filter_execute(ctx, var_size_bme_slice, NULL, mi_ctx->job_rets, nb_jobs);
+    for (i = 0; i < nb_jobs; i++)
+        if (mi_ctx->job_rets[i])
+            return mi_ctx->job_rets[i];
 
-                    if ((x - mb_x) && (y - mb_y) || !dx && !dy)
-                        continue;
+    return 0;
+}
 
-                    if (!mb_x || !mb_y || mb_x == mi_ctx->b_width - 1 || mb_y == mi_ctx->b_height - 1)
-                        continue;
+static int get_sbad_slice(AVFilterContext *ctx, void *arg, int jobnr, int nb_jobs)
+{
+    MIContext *mi_ctx = ctx->priv;
+    const int slice_start = (mi_ctx->b_height *  jobnr     ) / nb_jobs;
+    const int slice_end   = (mi_ctx->b_height * (jobnr + 1)) / nb_jobs;
+    int mb_x, mb_y;
 
-                    if (block->cid != mi_ctx->int_blocks[x + y * mi_ctx->b_width].cid) {
-                        if (!dx && block->cid == mi_ctx->int_blocks[x + (mb_y - dy) * mi_ctx->b_width].cid ||
-                            !dy && block->cid == mi_ctx->int_blocks[(mb_x - dx) + y * mi_ctx->b_width].cid) {
-                            if (ret = var_size_bme(mi_ctx, block, mb_x << mi_ctx->log2_mb_size, mb_y << mi_ctx->log2_mb_size, mi_ctx->log2_mb_size))
-                                return ret;
-                        }
-                    }
-                }
+    for (mb_y = slice_start; mb_y < slice_end; mb_y++)
+        for (mb_x = 0; mb_x < mi_ctx->b_width; mb_x++) {
+            int x_mb = mb_x << mi_ctx->log2_mb_size;
+            int y_mb = mb_y << mi_ctx->log2_mb_size;
+            Block *block = &mi_ctx->int_blocks[mb_x + mb_y * mi_ctx->b_width];
+
+            block->sbad = get_sbad(&mi_ctx->me_ctx, x_mb, y_mb, x_mb + block->mvs[0][0], y_mb + block->mvs[0][1]);
         }
 
     return 0;
@@ -757,9 +896,7 @@ static int inject_frame(AVFilterLink *inlink, AVFrame *avf_in)
                     mi_ctx->me_ctx.data_cur = mi_ctx->frames[2].avf->data[0];
                     mi_ctx->me_ctx.data_ref = mi_ctx->frames[dir ? 3 : 1].avf->data[0];
 
-                    for (mb_y = 0; mb_y < mi_ctx->b_height; mb_y++)
-                        for (mb_x = 0; mb_x < mi_ctx->b_width; mb_x++)
-                            search_mv(mi_ctx, mi_ctx->frames[2].blocks, mb_x, mb_y, dir);
+                    search_mvs(ctx, mi_ctx->frames[2].blocks, dir);
                 }
             }
 
@@ -774,19 +911,11 @@ static int inject_frame(AVFilterLink *inlink, AVFrame *avf_in)
             mi_ctx->me_ctx.data_cur = mi_ctx->frames[1].avf->data[0];
             mi_ctx->me_ctx.data_ref = mi_ctx->frames[2].avf->data[0];
 
-            bilateral_me(mi_ctx);
-
-            if (mi_ctx->mc_mode == MC_MODE_AOBMC) {
-
-                for (mb_y = 0; mb_y < mi_ctx->b_height; mb_y++)
-                    for (mb_x = 0; mb_x < mi_ctx->b_width; mb_x++) {
-                        int x_mb = mb_x << mi_ctx->log2_mb_size;
-                        int y_mb = mb_y << mi_ctx->log2_mb_size;
-                        block = &mi_ctx->int_blocks[mb_x + mb_y * mi_ctx->b_width];
+            bilateral_me(ctx);
 
-                        block->sbad = get_sbad(&mi_ctx->me_ctx, x_mb, y_mb, x_mb + block->mvs[0][0], y_mb + block->mvs[0][1]);
-                    }
-            }
+            if (mi_ctx->mc_mode == MC_MODE_AOBMC)
+                ff_filter_execute(ctx, get_sbad_slice, NULL, NULL,
+                                  FFMIN(mi_ctx->b_height, ff_filter_get_nb_threads(ctx)));
 
             if (mi_ctx->vsbmc) {
 
@@ -806,7 +935,7 @@ static int inject_frame(AVFilterLink *inlink, AVFrame *avf_in)
 
                 mi_ctx->clusters[0].nb = mi_ctx->b_count;
 
-                if (ret = cluster_mvs(mi_ctx))
+                if (ret = cluster_mvs(ctx))
                     return ret;
             }
         }
@@ -855,17 +984,13 @@ static int detect_scene_change(AVFilterContext *ctx)
         pixel_refs->nb++;\
     } while(0)
 
-static void bidirectional_obmc(MIContext *mi_ctx, int alpha)
+static void bidirectional_obmc(MIContext *mi_ctx, int alpha, int slice_start, int slice_end)
 {
     int x, y;
     int width = mi_ctx->frames[0].avf->width;
     int height = mi_ctx->frames[0].avf->height;
     int mb_y, mb_x, dir;
 
-    for (y = 0; y < height; y++)
-        for (x = 0; x < width; x++)
-            mi_ctx->pixel_refs[x + y * width].nb = 0;
-
     for (dir = 0; dir < 2; dir++)
         for (mb_y = 0; mb_y < mi_ctx->b_height; mb_y++)
             for (mb_x = 0; mb_x < mi_ctx->b_width; mb_x++) {
@@ -879,9 +1004,9 @@ static void bidirectional_obmc(MIContext *mi_ctx, int alpha)
                 start_y = (mb_y << mi_ctx->log2_mb_size) - mi_ctx->mb_size / 2 + mv_y * a / ALPHA_MAX;
 
                 startc_x = av_clip(start_x, 0, width - 1);
-                startc_y = av_clip(start_y, 0, height - 1);
+                startc_y = av_clip(start_y, slice_start, slice_end);
                 endc_x = av_clip(start_x + (2 << mi_ctx->log2_mb_size), 0, width - 1);
-                endc_y = av_clip(start_y + (2 << mi_ctx->log2_mb_size), 0, height - 1);
+                endc_y = av_clip(start_y + (2 << mi_ctx->log2_mb_size), slice_start, FFMIN(slice_end, height - 1));
 
                 if (dir) {
                     mv_x = -mv_x;
@@ -905,16 +1030,16 @@ static void bidirectional_obmc(MIContext *mi_ctx, int alpha)
             }
 }
 
-static void set_frame_data(MIContext *mi_ctx, int alpha, AVFrame *avf_out)
+static void set_frame_data(MIContext *mi_ctx, int alpha, AVFrame *avf_out,
+                           int slice_start, int slice_end)
 {
     int x, y, plane;
 
     for (plane = 0; plane < mi_ctx->nb_planes; plane++) {
         int width = avf_out->width;
-        int height = avf_out->height;
         int chroma = plane == 1 || plane == 2;
 
-        for (y = 0; y < height; y++)
+        for (y = slice_start; y < slice_end; y++)
             for (x = 0; x < width; x++) {
                 int x_mv, y_mv;
                 int weight_sum = 0;
@@ -966,7 +1091,8 @@ static void set_frame_data(MIContext *mi_ctx, int alpha, AVFrame *avf_out)
     }
 }
 
-static void var_size_bmc(MIContext *mi_ctx, Block *block, int x_mb, int y_mb, int n, int alpha)
+static void var_size_bmc(MIContext *mi_ctx, Block *block, int x_mb, int y_mb, int n, int alpha,
+                         int slice_start, int slice_end)
 {
     int sb_x, sb_y;
     int width = mi_ctx->frames[0].avf->width;
@@ -977,16 +1103,17 @@ static void var_size_bmc(MIContext *mi_ctx, Block *block, int x_mb, int y_mb, in
             Block *sb = &block->subs[sb_x + sb_y * 2];
 
             if (sb->sb)
-                var_size_bmc(mi_ctx, sb, x_mb + (sb_x << (n - 1)), y_mb + (sb_y << (n - 1)), n - 1, alpha);
+                var_size_bmc(mi_ctx, sb, x_mb + (sb_x << (n - 1)), y_mb + (sb_y << (n - 1)), n - 1, alpha,
+                             slice_start, slice_end);
             else {
                 int x, y;
                 int mv_x = sb->mvs[0][0] * 2;
                 int mv_y = sb->mvs[0][1] * 2;
 
                 int start_x = x_mb + (sb_x << (n - 1));
-                int start_y = y_mb + (sb_y << (n - 1));
+                int start_y = FFMAX(y_mb + (sb_y << (n - 1)), slice_start);
                 int end_x = start_x + (1 << (n - 1));
-                int end_y = start_y + (1 << (n - 1));
+                int end_y = FFMIN(y_mb + (sb_y << (n - 1)) + (1 << (n - 1)), slice_end);
 
                 for (y = start_y; y < end_y; y++)  {
                     int y_min = -y;
@@ -1005,7 +1132,8 @@ static void var_size_bmc(MIContext *mi_ctx, Block *block, int x_mb, int y_mb, in
         }
 }
 
-static void bilateral_obmc(MIContext *mi_ctx, Block *block, int mb_x, int mb_y, int alpha)
+static void bilateral_obmc(MIContext *mi_ctx, Block *block, int mb_x, int mb_y, int alpha,
+                           int slice_start, int slice_end)
 {
     int x, y;
     int width = mi_ctx->frames[0].avf->width;
@@ -1034,9 +1162,9 @@ static void bilateral_obmc(MIContext *mi_ctx, Block *block, int mb_x, int mb_y,
     start_y = (mb_y << mi_ctx->log2_mb_size) - mi_ctx->mb_size / 2;
 
     startc_x = av_clip(start_x, 0, width - 1);
-    startc_y = av_clip(start_y, 0, height - 1);
+    startc_y = av_clip(start_y, slice_start, slice_end);
     endc_x = av_clip(start_x + (2 << mi_ctx->log2_mb_size), 0, width - 1);
-    endc_y = av_clip(start_y + (2 << mi_ctx->log2_mb_size), 0, height - 1);
+    endc_y = av_clip(start_y + (2 << mi_ctx->log2_mb_size), slice_start, FFMIN(slice_end, height - 1));
 
     for (y = startc_y; y < endc_y; y++) {
         int y_min = -y;
@@ -1069,6 +1197,60 @@ static void bilateral_obmc(MIContext *mi_ctx, Block *block, int mb_x, int mb_y,
     }
 }
 
+static int slice_row(const MIContext *mi_ctx, int height, int jobnr, int nb_jobs)
+{
+    /* several luma rows write the same chroma row, keep them together */
+    if (jobnr == nb_jobs)
+        return height;
+    return (height * jobnr / nb_jobs) >> mi_ctx->log2_chroma_h << mi_ctx->log2_chroma_h;
+}
+
+static int motion_compensate_slice(AVFilterContext *ctx, void *arg, int jobnr, int nb_jobs)
+{
+    MIContext *mi_ctx = ctx->priv;
+    ThreadData *td = arg;
+    int width = mi_ctx->frames[0].avf->width;
+    int height = mi_ctx->frames[0].avf->height;
+    const int slice_start = slice_row(mi_ctx, height, jobnr,     nb_jobs);
+    const int slice_end   = slice_row(mi_ctx, height, jobnr + 1, nb_jobs);
+    int x, y;
+
+    /* every slice only adds the contributions to its own pixels, in the
+     * same order as a serial pass over all blocks */
+    for (y = slice_start; y < slice_end; y++)
+        for (x = 0; x < width; x++)
+            mi_ctx->pixel_refs[x + y * width].nb = 0;
+
+    if (mi_ctx->me_mode == ME_MODE_BIDIR) {
+        bidirectional_obmc(mi_ctx, td->alpha, slice_start, slice_end);
+    } else if (mi_ctx->me_mode == ME_MODE_BILAT) {
+        int mb_x, mb_y;
+        Block *block;
+
+        for (mb_y = 0; mb_y < mi_ctx->b_height; mb_y++) {
+            int y_mb = mb_y << mi_ctx->log2_mb_size;
+
+            if (y_mb + mi_ctx->mb_size * 3 / 2 <= slice_start ||
+                y_mb - mi_ctx->mb_size / 2 >= slice_end)
+                continue;
+
+            for (mb_x = 0; mb_x < mi_ctx->b_width; mb_x++) {
+                block = &mi_ctx->int_blocks[mb_x + mb_y * mi_ctx->b_width];
+
+                if (block->sb)
+                    var_size_bmc(mi_ctx, block, mb_x << mi_ctx->log2_mb_size, y_mb, mi_ctx->log2_mb_size, td->alpha,
+                                 slice_start, slice_end);
+
+                bilateral_obmc(mi_ctx, block, mb_x, mb_y, td->alpha, slice_start, slice_end);
+            }
+        }
+    }
+
+    set_frame_data(mi_ctx, td->alpha, td->out, slice_start, slice_end);
+
+    return 0;
+}
+
 static void interpolate(AVFilterLink *inlink, AVFrame *avf_out)
 {
     AVFilterContext *ctx = inlink->dst;
@@ -1126,34 +1308,17 @@ static void interpolate(AVFilterLink *inlink, AVFrame *avf_out)
             }
 
             break;
-        case MI_MODE_MCI:
-            if (mi_ctx->me_mode == ME_MODE_BIDIR) {
-                bidirectional_obmc(mi_ctx, alpha);
-                set_frame_data(mi_ctx, alpha, avf_out);
-
-            } else if (mi_ctx->me_mode == ME_MODE_BILAT) {
-                int mb_x, mb_y;
-                Block *block;
+        case MI_MODE_MCI: {
+            ThreadData td;
 
-                for (y = 0; y < mi_ctx->frames[0].avf->height; y++)
-                    for (x = 0; x < mi_ctx->frames[0].avf->width; x++)
-                        mi_ctx->pixel_refs[x + y * mi_ctx->frames[0].avf->width].nb = 0;
-
-                for (mb_y = 0; mb_y < mi_ctx->b_height; mb_y++)
-                    for (mb_x = 0; mb_x < mi_ctx->b_width; mb_x++) {
-                        block = &mi_ctx->int_blocks[mb_x + mb_y * mi_ctx->b_width];
-
-                        if (block->sb)
-                            var_size_bmc(mi_ctx, block, mb_x << mi_ctx->log2_mb_size, mb_y << mi_ctx->log2_mb_size, mi_ctx->log2_mb_size, alpha);
-
-                        bilateral_obmc(mi_ctx, block, mb_x, mb_y, alpha);
-
-                    }
-
-                set_frame_data(mi_ctx, alpha, avf_out);
-            }
+            td.alpha = alpha;
+            td.out   = avf_out;
+            ff_filter_execute(ctx, motion_compensate_slice, &td, NULL,
+                              FFMIN(avf_out->height >> mi_ctx->log2_chroma_h,
+                                    ff_filter_get_nb_threads(ctx)));
 
             break;
+        }
     }
 }
 
@@ -1208,6 +1373,19 @@ static int filter_frame(AVFilterLink *inlink, AVFrame *avf_in)
     return 0;
 }
 
+static av_cold int init(AVFilterContext *ctx)
+{
+    MIContext *mi_ctx = ctx->priv;
+    int ret;
+
+    if ((ret = ff_mutex_init(&mi_ctx->progress_lock, NULL)))
+        return AVERROR(ret);
+    if ((ret = ff_cond_init(&mi_ctx->progress_cond, NULL)))
+        return AVERROR(ret);
+
+    return 0;
+}
+
 static av_cold void free_blocks(Block *block, int sb)
 {
     if (block->subs)
@@ -1237,6 +1415,11 @@ static av_cold void uninit(AVFilterContext *ctx)
 
     for (i = 0; i < 3; i++)
         av_freep(&mi_ctx->mv_table[i]);
+
+    av_freep(&mi_ctx->row_progress);
+    av_freep(&mi_ctx->job_rets);
+    ff_cond_destroy(&mi_ctx->progress_cond);
+    ff_mutex_destroy(&mi_ctx->progress_lock);
 }
 
 static const AVFilterPad minterpolate_inputs[] = {
@@ -1260,7 +1443,9 @@ const FFFilter ff_vf_minterpolate = {
     .p.name        = "minterpolate",
     .p.description = NULL_IF_CONFIG_SMALL("Frame rate conversion using Motion Interpolation."),
     .p.priv_class  = &minterpolate_class,
+    .p.flags       = AVFILTER_FLAG_SLICE_THREADS,
     .priv_size     = sizeof(MIContext),
+    .init          = init,
     .uninit        = uninit,
     FILTER_INPUTS(minterpolate_inputs),
     FILTER_OUTPUTS(minterpolate_outputs),
@@ -54,9 +54,17 @@ struct range_box {
     int sorted_by;      // whether range of colors is sorted by red (0), green (1) or blue (2)
 };
 
-struct hist_node {
-    struct color_ref *entries;
-    int nb_entries;
+struct hist_slot {
+    uint32_t color;
+    int idx;            // index of the color in color_table->entries, -1 if the slot is free
+};
+
+/* Open addressing hash table of the colors */
+struct color_table {
+    struct color_ref *entries;  // the colors, in the order they were first seen
+    int nb_entries;             // at most nb_slots / 2
+    struct hist_slot *slots;    // linear probing table, half full at most
+    int nb_slots;               // number of slots (power of 2)
 };
 
 enum {
@@ -66,8 +74,14 @@ enum {
     NB_STATS_MODE
 };
 
+/* number of buckets defining the order of the color references */
 #define HIST_SIZE (1<<15)
 
+typedef struct ThreadData {
+    const AVFrame *f;           // frame to count the pixels of
+    const AVFrame *ref;         // if set, the pixels equal to the ones of ref are skipped
+} ThreadData;
+
 typedef struct PaletteGenContext {
     const AVClass *class;
 
@@ -76,7 +90,12 @@ typedef struct PaletteGenContext {
     int stats_mode;
 
     AVFrame *prev_frame;                    // previous frame used for the diff stats_mode
-    struct hist_node histogram[HIST_SIZE];  // histogram/hashtable of the colors
+    AVFrame *last_in;                       // previous frame in the single stats_mode
+    AVFrame *last_palette;                  // palette of last_in in the single stats_mode
+    struct color_table histogram;           // histogram/hashtable of the colors
+    struct color_table *job_hists;          // histograms of the frame slices, merged after each frame
+    int nb_job_hists;
+    int *job_rets;
     struct color_ref **refs;                // references of all the colors used in the stream
     int nb_refs;                            // number of color references (or number of different colors)
     struct range_box boxes[256];            // define the segmentation of the colorspace (the final palette)
@@ -281,25 +300,34 @@ static void write_palette(AVFilterContext *ctx, AVFrame *out)
 }
 
 /**
- * Crawl the histogram to get all the defined colors, and create a linear list
- * of them (each color reference entry is a pointer to the value in the
- * histogram/hash table).
+ * Create a linear list of all the colors of the histogram (each color
+ * reference entry is a pointer to the value in the histogram/hash table).
+ * The colors are ordered by their hash, then by their first appearance.
  */
-static struct color_ref **load_color_refs(const struct hist_node *hist, int nb_refs)
+static struct color_ref **load_color_refs(struct color_table *hist)
 {
-    int k = 0;
+    const int nb_refs = hist->nb_entries;
     struct color_ref **refs = av_malloc_array(nb_refs, sizeof(*refs));
+    int *pos = av_calloc(HIST_SIZE + 1, sizeof(*pos));
 
-    if (!refs)
+    if (!refs || !pos) {
+        av_free(refs);
+        av_free(pos);
         return NULL;
+    }
 
-    for (int j = 0; j < HIST_SIZE; j++) {
-        const struct hist_node *node = &hist[j];
+    for (int i = 0; i < nb_refs; i++)
+        pos[(ff_lowbias32(hist->entries[i].color) & (HIST_SIZE - 1)) + 1]++;
+    for (int j = 0; j < HIST_SIZE; j++)
+        pos[j + 1] += pos[j];
 
-        for (int i = 0; i < node->nb_entries; i++)
-            refs[k++] = &node->entries[i];
+    for (int i = 0; i < nb_refs; i++) {
+        struct color_ref *e = &hist->entries[i];
+        e->lab = ff_srgb_u8_to_oklab_int(e->color);
+        refs[pos[ff_lowbias32(e->color) & (HIST_SIZE - 1)]++] = e;
     }
 
+    av_free(pos);
     return refs;
 }
 
@@ -326,7 +354,7 @@ static AVFrame *get_palette_frame(AVFilterContext *ctx)
     struct range_box *box;
 
     /* reference only the used colors from histogram */
-    s->refs = load_color_refs(s->histogram, s->nb_refs);
+    s->refs = load_color_refs(&s->histogram);
     if (!s->refs) {
         av_log(ctx, AV_LOG_ERROR, "Unable to allocate references for %d different colors\n", s->nb_refs);
         return NULL;
@@ -391,75 +419,178 @@ static AVFrame *get_palette_frame(AVFilterContext *ctx)
     return out;
 }
 
+static int grow_table(struct color_table *t)
+{
+    const int nb_slots = t->nb_slots ? t->nb_slots << 1 : 1 << 10;
+    struct color_ref *entries;
+    struct hist_slot *slots;
+
+    if (nb_slots <= 0)
+        return AVERROR(ENOMEM);
+    entries = av_realloc_array(t->entries, nb_slots / 2, sizeof(*entries));
+    if (!entries)
+        return AVERROR(ENOMEM);
+    t->entries = entries;
+
+    slots = av_malloc_array(nb_slots, sizeof(*slots));
+    if (!slots)
+        return AVERROR(ENOMEM);
+    for (int i = 0; i < nb_slots; i++)
+        slots[i].idx = -1;
+
+    for (int i = 0; i < t->nb_entries; i++) {
+        const uint32_t color = t->entries[i].color;
+        uint32_t hash = ff_lowbias32(color) & (nb_slots - 1);
+
+        while (slots[hash].idx >= 0)
+            hash = (hash + 1) & (nb_slots - 1);
+        slots[hash].color = color;
+        slots[hash].idx   = i;
+    }
+
+    av_free(t->slots);
+    t->slots    = slots;
+    t->nb_slots = nb_slots;
+    return 0;
+}
+
+static void reset_table(struct color_table *t)
+{
+    if (!t->nb_entries)
+        return;
+    for (int i = 0; i < t->nb_slots; i++)
+        t->slots[i].idx = -1;
+    t->nb_entries = 0;
+}
+
+static void free_table(struct color_table *t)
+{
+    av_freep(&t->entries);
+    av_freep(&t->slots);
+    t->nb_entries = t->nb_slots = 0;
+}
+
 /**
- * Locate the color in the hash table and increment its counter.
+ * Insert a color which is not in the hash table yet.
  */
-static int color_inc(struct hist_node *hist, uint32_t color)
+static int add_color(struct color_table *t, uint32_t color, int64_t count)
 {
-    const uint32_t hash = ff_lowbias32(color) & (HIST_SIZE - 1);
-    struct hist_node *node = &hist[hash];
     struct color_ref *e;
+    uint32_t hash;
+    int ret;
 
-    for (int i = 0; i < node->nb_entries; i++) {
-        e = &node->entries[i];
-        if (e->color == color) {
-            e->count++;
+    if (t->nb_entries >= t->nb_slots >> 1 && (ret = grow_table(t)) < 0)
+        return ret;
+
+    hash = ff_lowbias32(color) & (t->nb_slots - 1);
+    while (t->slots[hash].idx >= 0)
+        hash = (hash + 1) & (t->nb_slots - 1);
+
+    e = &t->entries[t->nb_entries];
+    e->color = color;
+    e->count = count;
+    t->slots[hash].color = color;
+    t->slots[hash].idx   = t->nb_entries++;
+    return 0;
+}
+
+/**
+ * Locate the color in the hash table and increase its counter. The table
+ * must have been allocated with grow_table().
+ */
+static av_always_inline int color_inc(struct color_table *t, uint32_t color, int64_t count)
+{
+    const uint32_t mask = t->nb_slots - 1;
+    uint32_t hash = ff_lowbias32(color) & mask;
+
+    /* the table is never more than half full, so there is always a free slot */
+    while (t->slots[hash].idx >= 0) {
+        if (t->slots[hash].color == color) {
+            t->entries[t->slots[hash].idx].count += count;
             return 0;
         }
+        hash = (hash + 1) & mask;
     }
 
-    e = av_dynarray2_add((void**)&node->entries, &node->nb_entries,
-                         sizeof(*node->entries), NULL);
-    if (!e)
-        return AVERROR(ENOMEM);
-    e->color = color;
-    e->lab = ff_srgb_u8_to_oklab_int(color);
-    e->count = 1;
-    return 1;
+    return add_color(t, color, count);
 }
 
 /**
- * Update histogram when pixels differ from previous frame.
+ * Update the histogram of a slice of the frame. In diff stats_mode, only the
+ * pixels which differ between the two frames are counted. The first slice is
+ * counted directly into the main histogram, the other ones into their own
+ * histogram.
  */
-static int update_histogram_diff(struct hist_node *hist,
-                                 const AVFrame *f1, const AVFrame *f2)
+static int update_histogram_slice(AVFilterContext *ctx, void *arg, int jobnr, int nb_jobs)
 {
-    int x, y, ret, nb_diff_colors = 0;
+    PaletteGenContext *s = ctx->priv;
+    const ThreadData *td = arg;
+    const AVFrame *f = td->f, *ref = td->ref;
+    struct color_table *hist = jobnr ? &s->job_hists[jobnr - 1] : &s->histogram;
+    const int slice_start = (f->height *  jobnr     ) / nb_jobs;
+    const int slice_end   = (f->height * (jobnr + 1)) / nb_jobs;
+    int ret;
 
-    for (y = 0; y < f1->height; y++) {
-        const uint32_t *p = (const uint32_t *)(f1->data[0] + y*f1->linesize[0]);
-        const uint32_t *q = (const uint32_t *)(f2->data[0] + y*f2->linesize[0]);
+    for (int y = slice_start; y < slice_end; y++) {
+        const uint32_t *p = (const uint32_t *)(f->data[0] + y*f->linesize[0]);
+        const uint32_t *q = ref ? (const uint32_t *)(ref->data[0] + y*ref->linesize[0]) : NULL;
 
-        for (x = 0; x < f1->width; x++) {
-            if (p[x] == q[x])
+        for (int x = 0; x < f->width; x++) {
+            if (q && p[x] == q[x])
                 continue;
-            ret = color_inc(hist, p[x]);
+            ret = color_inc(hist, p[x], 1);
             if (ret < 0)
                 return ret;
-            nb_diff_colors += ret;
         }
     }
-    return nb_diff_colors;
+    return 0;
 }
 
 /**
- * Simple histogram of the frame.
+ * Count the pixels of the frame into the histogram. The colors of the slices
+ * are merged in the slice order, so the colors keep the order in which a
+ * serial scan of the frame first sees them.
  */
-static int update_histogram_frame(struct hist_node *hist, const AVFrame *f)
+static int update_histogram(AVFilterContext *ctx, const AVFrame *f, const AVFrame *ref)
 {
-    int x, y, ret, nb_diff_colors = 0;
+    PaletteGenContext *s = ctx->priv;
+    ThreadData td = { .f = f, .ref = ref };
+    const int nb_jobs = FFMAX(1, FFMIN(f->height, s->nb_job_hists + 1));
+    int ret;
 
-    for (y = 0; y < f->height; y++) {
-        const uint32_t *p = (const uint32_t *)(f->data[0] + y*f->linesize[0]);
+    ff_filter_execute(ctx, update_histogram_slice, &td, s->job_rets, nb_jobs);
 
-        for (x = 0; x < f->width; x++) {
-            ret = color_inc(hist, p[x]);
+    for (int j = 0; j < nb_jobs; j++) {
+        if (s->job_rets[j] < 0) {
+            for (int i = 0; i < nb_jobs - 1; i++)
+                reset_table(&s->job_hists[i]);
+            return s->job_rets[j];
+        }
+    }
+
+    for (int j = 0; j < nb_jobs - 1; j++) {
+        struct color_table *t = &s->job_hists[j];
+
+        for (int i = 0; i < t->nb_entries; i++) {
+            ret = color_inc(&s->histogram, t->entries[i].color, t->entries[i].count);
             if (ret < 0)
                 return ret;
-            nb_diff_colors += ret;
         }
+        reset_table(t);
     }
-    return nb_diff_colors;
+
+    s->nb_refs = s->histogram.nb_entries;
+    return 0;
+}
+
+static int frames_equal(const AVFrame *a, const AVFrame *b)
+{
+    if (a->width != b->width || a->height != b->height)
+        return 0;
+    for (int y = 0; y < a->height; y++)
+        if (memcmp(a->data[0] + y*a->linesize[0], b->data[0] + y*b->linesize[0], a->width * 4))
+            return 0;
+    return 1;
 }
 
 /**
@@ -474,29 +605,54 @@ static int filter_frame(AVFilterLink *inlink, AVFrame *in)
     if (in->color_trc != AVCOL_TRC_UNSPECIFIED && in->color_trc != AVCOL_TRC_IEC61966_2_1)
         av_log(ctx, AV_LOG_WARNING, "The input frame is not in sRGB, colors may be off\n");
 
-    ret = s->prev_frame ? update_histogram_diff(s->histogram, s->prev_frame, in)
-                        : update_histogram_frame(s->histogram, in);
-    if (ret > 0)
-        s->nb_refs += ret;
+    if (s->stats_mode == STATS_MODE_SINGLE_FRAMES && s->last_palette &&
+        frames_equal(s->last_in, in)) {
+        /* same frame as the previous one: so is its palette */
+        AVFrame *out = av_frame_clone(s->last_palette);
+
+        if (!out) {
+            av_frame_free(&in);
+            return AVERROR(ENOMEM);
+        }
+        out->pts = in->pts;
+        av_frame_free(&in);
+        return ff_filter_frame(ctx->outputs[0], out);
+    }
+
+    ret = s->prev_frame ? update_histogram(ctx, s->prev_frame, in)
+                        : update_histogram(ctx, in, NULL);
+    if (ret < 0) {
+        av_frame_free(&in);
+        return ret;
+    }
 
     if (s->stats_mode == STATS_MODE_DIFF_FRAMES) {
         av_frame_free(&s->prev_frame);
         s->prev_frame = in;
     } else if (s->stats_mode == STATS_MODE_SINGLE_FRAMES && s->nb_refs > 0) {
         AVFrame *out;
-        int i;
 
         out = get_palette_frame(ctx);
-        out->pts = in->pts;
-        av_frame_free(&in);
-        ret = ff_filter_frame(ctx->outputs[0], out);
-        for (i = 0; i < HIST_SIZE; i++)
-            av_freep(&s->histogram[i].entries);
+        reset_table(&s->histogram);
         av_freep(&s->refs);
         s->nb_refs = 0;
         s->nb_boxes = 0;
         memset(s->boxes, 0, sizeof(s->boxes));
-        memset(s->histogram, 0, sizeof(s->histogram));
+        if (!out) {
+            av_frame_free(&in);
+            return AVERROR(ENOMEM);
+        }
+        out->pts = in->pts;
+
+        av_frame_free(&s->last_in);
+        av_frame_free(&s->last_palette);
+        s->last_in = in;
+        s->last_palette = av_frame_clone(out);
+        if (!s->last_palette) {
+            av_frame_free(&out);
+            return AVERROR(ENOMEM);
+        }
+        ret = ff_filter_frame(ctx->outputs[0], out);
     } else {
         av_frame_free(&in);
     }
@@ -528,8 +684,25 @@ static int request_frame(AVFilterLink *outlink)
  */
 static int config_output(AVFilterLink *outlink)
 {
+    AVFilterContext *ctx = outlink->src;
+    PaletteGenContext *s = ctx->priv;
+    const int nb_threads = ff_filter_get_nb_threads(ctx);
+    int ret;
+
     outlink->w = outlink->h = 16;
     outlink->sample_aspect_ratio = av_make_q(1, 1);
+
+    s->nb_job_hists = nb_threads - 1;
+    s->job_hists = av_calloc(nb_threads, sizeof(*s->job_hists));
+    s->job_rets  = av_calloc(nb_threads, sizeof(*s->job_rets));
+    if (!s->job_hists || !s->job_rets)
+        return AVERROR(ENOMEM);
+
+    if ((ret = grow_table(&s->histogram)) < 0)
+        return ret;
+    for (int i = 0; i < s->nb_job_hists; i++)
+        if ((ret = grow_table(&s->job_hists[i])) < 0)
+            return ret;
     return 0;
 }
 
@@ -550,10 +723,15 @@ static av_cold void uninit(AVFilterContext *ctx)
     int i;
     PaletteGenContext *s = ctx->priv;
 
-    for (i = 0; i < HIST_SIZE; i++)
-        av_freep(&s->histogram[i].entries);
+    free_table(&s->histogram);
+    for (i = 0; i < s->nb_job_hists; i++)
+        free_table(&s->job_hists[i]);
+    av_freep(&s->job_hists);
+    av_freep(&s->job_rets);
     av_freep(&s->refs);
     av_frame_free(&s->prev_frame);
+    av_frame_free(&s->last_in);
+    av_frame_free(&s->last_palette);
 }
 
 static const AVFilterPad palettegen_inputs[] = {
@@ -577,6 +755,7 @@ const FFFilter ff_vf_palettegen = {
     .p.name        = "palettegen",
     .p.description = NULL_IF_CONFIG_SMALL("Find the optimal palette for a given stream."),
     .p.priv_class  = &palettegen_class,
+    .p.flags       = AVFILTER_FLAG_SLICE_THREADS,
     .priv_size     = sizeof(PaletteGenContext),
     .init          = init,
     .uninit        = uninit,
@@ -24,12 +24,15 @@
  * Use a palette to downsample an input video stream.
  */
 
+#include <stdatomic.h>
+
 #include "libavutil/bprint.h"
 #include "libavutil/file_open.h"
 #include "libavutil/internal.h"
 #include "libavutil/mem.h"
 #include "libavutil/opt.h"
 #include "libavutil/qsort.h"
+#include "libavutil/thread.h"
 #include "avfilter.h"
 #include "filters.h"
 #include "formats.h"
@@ -82,18 +85,30 @@ struct cache_node {
 
 struct PaletteUseContext;
 
-typedef int (*set_frame_func)(struct PaletteUseContext *s, AVFrame *out, AVFrame *in,
-                              int x_start, int y_start, int width, int height);
+typedef int (*set_frame_func)(struct PaletteUseContext *s, struct cache_node *cache,
+                              AVFrame *out, AVFrame *in,
+                              int x_start, int y_start, int width, int height,
+                              int y, int x0, int x1);
+
+typedef struct ThreadData {
+    AVFrame *in, *out;
+    int x, y, w, h;
+} ThreadData;
+
+/* number of pixels of a row mapped between two progress reports */
+#define SPAN_SIZE 64
 
 typedef struct PaletteUseContext {
     const AVClass *class;
     FFFrameSync fs;
-    struct cache_node cache[CACHE_SIZE];    /* lookup cache */
+    struct cache_node (*caches)[CACHE_SIZE]; /* lookup cache of each job, kept across frames */
+    int nb_caches;
     struct color_node map[AVPALETTE_COUNT]; /* 3D-Tree (KD-Tree with K=3) for reverse colormap */
     uint32_t palette[AVPALETTE_COUNT];
     int transparency_index; /* index in the palette of transparency. -1 if there is no transparency in the palette. */
     int trans_thresh;
     int palette_loaded;
+    int map_loaded;
     int dither;
     int new;
     set_frame_func set_frame;
@@ -103,6 +118,13 @@ typedef struct PaletteUseContext {
     AVFrame *last_in;
     AVFrame *last_out;
 
+    /* error diffusion of a row depends on the row above */
+    atomic_int *row_progress;
+    atomic_int next_row;
+    AVMutex progress_lock;
+    AVCond progress_cond;
+    int *job_rets;
+
     /* debug options */
     char *dot_filename;
     int calc_mean_err;
@@ -239,11 +261,12 @@ struct stack_node {
  * Check if the requested color is in the cache already. If not, find it in the
  * color tree and cache it.
  */
-static av_always_inline int color_get(PaletteUseContext *s, uint32_t color)
+static av_always_inline int color_get(PaletteUseContext *s, struct cache_node *cache,
+                                      uint32_t color)
 {
     struct color_info clrinfo;
     const uint32_t hash = ff_lowbias32(color) & (CACHE_SIZE - 1);
-    struct cache_node *node = &s->cache[hash];
+    struct cache_node *node = &cache[hash];
     struct cached_color *e;
 
     // first, check for transparency
@@ -268,11 +291,11 @@ static av_always_inline int color_get(PaletteUseContext *s, uint32_t color)
     return e->pal_entry;
 }
 
-static av_always_inline int get_dst_color_err(PaletteUseContext *s,
+static av_always_inline int get_dst_color_err(PaletteUseContext *s, struct cache_node *cache,
                                               uint32_t c, int *er, int *eg, int *eb)
 {
     uint32_t dstc;
-    const int dstx = color_get(s, c);
+    const int dstx = color_get(s, cache, c);
     if (dstx < 0)
         return dstx;
     dstc = s->palette[dstx];
@@ -289,170 +312,172 @@ static av_always_inline int get_dst_color_err(PaletteUseContext *s,
     return dstx;
 }
 
-static av_always_inline int set_frame(PaletteUseContext *s, AVFrame *out, AVFrame *in,
+/**
+ * Map the pixels x0 to x1 - 1 of the row y, inside the processing window of
+ * w x h pixels at (x_start, y_start).
+ */
+static av_always_inline int set_frame(PaletteUseContext *s, struct cache_node *cache,
+                                      AVFrame *out, AVFrame *in,
                                       int x_start, int y_start, int w, int h,
+                                      int y, int x0, int x1,
                                       enum dithering_mode dither)
 {
     const int src_linesize = in ->linesize[0] >> 2;
     const int dst_linesize = out->linesize[0];
-    uint32_t *src = ((uint32_t *)in ->data[0]) + y_start*src_linesize;
-    uint8_t  *dst =              out->data[0]  + y_start*dst_linesize;
+    uint32_t *src = ((uint32_t *)in ->data[0]) + y*src_linesize;
+    uint8_t  *dst =              out->data[0]  + y*dst_linesize;
 
     w += x_start;
     h += y_start;
 
-    for (int y = y_start; y < h; y++) {
-        for (int x = x_start; x < w; x++) {
-            int er, eg, eb;
-
-            if (dither == DITHERING_BAYER) {
-                const int d = s->ordered_dither[(y & 7)<<3 | (x & 7)];
-                const uint8_t a8 = src[x] >> 24;
-                const uint8_t r8 = src[x] >> 16 & 0xff;
-                const uint8_t g8 = src[x] >>  8 & 0xff;
-                const uint8_t b8 = src[x]       & 0xff;
-                const uint8_t r = av_clip_uint8(r8 + d);
-                const uint8_t g = av_clip_uint8(g8 + d);
-                const uint8_t b = av_clip_uint8(b8 + d);
-                const uint32_t color_new = (unsigned)(a8) << 24 | r << 16 | g << 8 | b;
-                const int color = color_get(s, color_new);
-
-                if (color < 0)
-                    return color;
-                dst[x] = color;
-
-            } else if (dither == DITHERING_HECKBERT) {
-                const int right = x < w - 1, down = y < h - 1;
-                const int color = get_dst_color_err(s, src[x], &er, &eg, &eb);
-
-                if (color < 0)
-                    return color;
-                dst[x] = color;
-
-                if (right)         src[               x + 1] = dither_color(src[               x + 1], er, eg, eb, 3, 3);
-                if (         down) src[src_linesize + x    ] = dither_color(src[src_linesize + x    ], er, eg, eb, 3, 3);
-                if (right && down) src[src_linesize + x + 1] = dither_color(src[src_linesize + x + 1], er, eg, eb, 2, 3);
-
-            } else if (dither == DITHERING_FLOYD_STEINBERG) {
-                const int right = x < w - 1, down = y < h - 1, left = x > x_start;
-                const int color = get_dst_color_err(s, src[x], &er, &eg, &eb);
-
-                if (color < 0)
-                    return color;
-                dst[x] = color;
-
-                if (right)         src[               x + 1] = dither_color(src[               x + 1], er, eg, eb, 7, 4);
-                if (left  && down) src[src_linesize + x - 1] = dither_color(src[src_linesize + x - 1], er, eg, eb, 3, 4);
-                if (         down) src[src_linesize + x    ] = dither_color(src[src_linesize + x    ], er, eg, eb, 5, 4);
-                if (right && down) src[src_linesize + x + 1] = dither_color(src[src_linesize + x + 1], er, eg, eb, 1, 4);
-
-            } else if (dither == DITHERING_SIERRA2) {
-                const int right  = x < w - 1, down  = y < h - 1, left  = x > x_start;
-                const int right2 = x < w - 2,                    left2 = x > x_start + 1;
-                const int color = get_dst_color_err(s, src[x], &er, &eg, &eb);
-
-                if (color < 0)
-                    return color;
-                dst[x] = color;
-
-                if (right)          src[                 x + 1] = dither_color(src[                 x + 1], er, eg, eb, 4, 4);
-                if (right2)         src[                 x + 2] = dither_color(src[                 x + 2], er, eg, eb, 3, 4);
-
-                if (down) {
-                    if (left2)      src[  src_linesize + x - 2] = dither_color(src[  src_linesize + x - 2], er, eg, eb, 1, 4);
-                    if (left)       src[  src_linesize + x - 1] = dither_color(src[  src_linesize + x - 1], er, eg, eb, 2, 4);
-                    if (1)          src[  src_linesize + x    ] = dither_color(src[  src_linesize + x    ], er, eg, eb, 3, 4);
-                    if (right)      src[  src_linesize + x + 1] = dither_color(src[  src_linesize + x + 1], er, eg, eb, 2, 4);
-                    if (right2)     src[  src_linesize + x + 2] = dither_color(src[  src_linesize + x + 2], er, eg, eb, 1, 4);
-                }
+    for (int x = x0; x < x1; x++) {
+        int er, eg, eb;
+
+        if (dither == DITHERING_BAYER) {
+            const int d = s->ordered_dither[(y & 7)<<3 | (x & 7)];
+            const uint8_t a8 = src[x] >> 24;
+            const uint8_t r8 = src[x] >> 16 & 0xff;
+            const uint8_t g8 = src[x] >>  8 & 0xff;
+            const uint8_t b8 = src[x]       & 0xff;
+            const uint8_t r = av_clip_uint8(r8 + d);
+            const uint8_t g = av_clip_uint8(g8 + d);
+            const uint8_t b = av_clip_uint8(b8 + d);
+            const uint32_t color_new = (unsigned)(a8) << 24 | r << 16 | g << 8 | b;
+            const int color = color_get(s, cache, color_new);
+
+            if (color < 0)
+                return color;
+            dst[x] = color;
+
+        } else if (dither == DITHERING_HECKBERT) {
+            const int right = x < w - 1, down = y < h - 1;
+            const int color = get_dst_color_err(s, cache, src[x], &er, &eg, &eb);
+
+            if (color < 0)
+                return color;
+            dst[x] = color;
+
+            if (right)         src[               x + 1] = dither_color(src[               x + 1], er, eg, eb, 3, 3);
+            if (         down) src[src_linesize + x    ] = dither_color(src[src_linesize + x    ], er, eg, eb, 3, 3);
+            if (right && down) src[src_linesize + x + 1] = dither_color(src[src_linesize + x + 1], er, eg, eb, 2, 3);
+
+        } else if (dither == DITHERING_FLOYD_STEINBERG) {
+            const int right = x < w - 1, down = y < h - 1, left = x > x_start;
+            const int color = get_dst_color_err(s, cache, src[x], &er, &eg, &eb);
+
+            if (color < 0)
+                return color;
+            dst[x] = color;
+
+            if (right)         src[               x + 1] = dither_color(src[               x + 1], er, eg, eb, 7, 4);
+            if (left  && down) src[src_linesize + x - 1] = dither_color(src[src_linesize + x - 1], er, eg, eb, 3, 4);
+            if (         down) src[src_linesize + x    ] = dither_color(src[src_linesize + x    ], er, eg, eb, 5, 4);
+            if (right && down) src[src_linesize + x + 1] = dither_color(src[src_linesize + x + 1], er, eg, eb, 1, 4);
+
+        } else if (dither == DITHERING_SIERRA2) {
+            const int right  = x < w - 1, down  = y < h - 1, left  = x > x_start;
+            const int right2 = x < w - 2,                    left2 = x > x_start + 1;
+            const int color = get_dst_color_err(s, cache, src[x], &er, &eg, &eb);
+
+            if (color < 0)
+                return color;
+            dst[x] = color;
+
+            if (right)          src[                 x + 1] = dither_color(src[                 x + 1], er, eg, eb, 4, 4);
+            if (right2)         src[                 x + 2] = dither_color(src[                 x + 2], er, eg, eb, 3, 4);
+
+            if (down) {
+                if (left2)      src[  src_linesize + x - 2] = dither_color(src[  src_linesize + x - 2], er, eg, eb, 1, 4);
+                if (left)       src[  src_linesize + x - 1] = dither_color(src[  src_linesize + x - 1], er, eg, eb, 2, 4);
+                if (1)          src[  src_linesize + x    ] = dither_color(src[  src_linesize + x    ], er, eg, eb, 3, 4);
+                if (right)      src[  src_linesize + x + 1] = dither_color(src[  src_linesize + x + 1], er, eg, eb, 2, 4);
+                if (right2)     src[  src_linesize + x + 2] = dither_color(src[  src_linesize + x + 2], er, eg, eb, 1, 4);
+            }
 
-            } else if (dither == DITHERING_SIERRA2_4A) {
-                const int right = x < w - 1, down = y < h - 1, left = x > x_start;
-                const int color = get_dst_color_err(s, src[x], &er, &eg, &eb);
-
-                if (color < 0)
-                    return color;
-                dst[x] = color;
-
-                if (right)         src[               x + 1] = dither_color(src[               x + 1], er, eg, eb, 2, 2);
-                if (left  && down) src[src_linesize + x - 1] = dither_color(src[src_linesize + x - 1], er, eg, eb, 1, 2);
-                if (         down) src[src_linesize + x    ] = dither_color(src[src_linesize + x    ], er, eg, eb, 1, 2);
-
-            } else if (dither == DITHERING_SIERRA3) {
-                const int right  = x < w - 1, down  = y < h - 1, left  = x > x_start;
-                const int right2 = x < w - 2, down2 = y < h - 2, left2 = x > x_start + 1;
-                const int color = get_dst_color_err(s, src[x], &er, &eg, &eb);
-
-                if (color < 0)
-                    return color;
-                dst[x] = color;
-
-                if (right)         src[                 x + 1] = dither_color(src[                 x + 1], er, eg, eb, 5, 5);
-                if (right2)        src[                 x + 2] = dither_color(src[                 x + 2], er, eg, eb, 3, 5);
-
-                if (down) {
-                    if (left2)     src[src_linesize   + x - 2] = dither_color(src[src_linesize   + x - 2], er, eg, eb, 2, 5);
-                    if (left)      src[src_linesize   + x - 1] = dither_color(src[src_linesize   + x - 1], er, eg, eb, 4, 5);
-                    if (1)         src[src_linesize   + x    ] = dither_color(src[src_linesize   + x    ], er, eg, eb, 5, 5);
-                    if (right)     src[src_linesize   + x + 1] = dither_color(src[src_linesize   + x + 1], er, eg, eb, 4, 5);
-                    if (right2)    src[src_linesize   + x + 2] = dither_color(src[src_linesize   + x + 2], er, eg, eb, 2, 5);
-
-                    if (down2) {
-                        if (left)  src[src_linesize*2 + x - 1] = dither_color(src[src_linesize*2 + x - 1], er, eg, eb, 2, 5);
-                        if (1)     src[src_linesize*2 + x    ] = dither_color(src[src_linesize*2 + x    ], er, eg, eb, 3, 5);
-                        if (right) src[src_linesize*2 + x + 1] = dither_color(src[src_linesize*2 + x + 1], er, eg, eb, 2, 5);
-                    }
+        } else if (dither == DITHERING_SIERRA2_4A) {
+            const int right = x < w - 1, down = y < h - 1, left = x > x_start;
+            const int color = get_dst_color_err(s, cache, src[x], &er, &eg, &eb);
+
+            if (color < 0)
+                return color;
+            dst[x] = color;
+
+            if (right)         src[               x + 1] = dither_color(src[               x + 1], er, eg, eb, 2, 2);
+            if (left  && down) src[src_linesize + x - 1] = dither_color(src[src_linesize + x - 1], er, eg, eb, 1, 2);
+            if (         down) src[src_linesize + x    ] = dither_color(src[src_linesize + x    ], er, eg, eb, 1, 2);
+
+        } else if (dither == DITHERING_SIERRA3) {
+            const int right  = x < w - 1, down  = y < h - 1, left  = x > x_start;
+            const int right2 = x < w - 2, down2 = y < h - 2, left2 = x > x_start + 1;
+            const int color = get_dst_color_err(s, cache, src[x], &er, &eg, &eb);
+
+            if (color < 0)
+                return color;
+            dst[x] = color;
+
+            if (right)         src[                 x + 1] = dither_color(src[                 x + 1], er, eg, eb, 5, 5);
+            if (right2)        src[                 x + 2] = dither_color(src[                 x + 2], er, eg, eb, 3, 5);
+
+            if (down) {
+                if (left2)     src[src_linesize   + x - 2] = dither_color(src[src_linesize   + x - 2], er, eg, eb, 2, 5);
+                if (left)      src[src_linesize   + x - 1] = dither_color(src[src_linesize   + x - 1], er, eg, eb, 4, 5);
+                if (1)         src[src_linesize   + x    ] = dither_color(src[src_linesize   + x    ], er, eg, eb, 5, 5);
+                if (right)     src[src_linesize   + x + 1] = dither_color(src[src_linesize   + x + 1], er, eg, eb, 4, 5);
+                if (right2)    src[src_linesize   + x + 2] = dither_color(src[src_linesize   + x + 2], er, eg, eb, 2, 5);
+
+                if (down2) {
+                    if (left)  src[src_linesize*2 + x - 1] = dither_color(src[src_linesize*2 + x - 1], er, eg, eb, 2, 5);
+                    if (1)     src[src_linesize*2 + x    ] = dither_color(src[src_linesize*2 + x    ], er, eg, eb, 3, 5);
+                    if (right) src[src_linesize*2 + x + 1] = dither_color(src[src_linesize*2 + x + 1], er, eg, eb, 2, 5);
                 }
+            }
 
-            } else if (dither == DITHERING_BURKES) {
-                const int right  = x < w - 1, down  = y < h - 1, left  = x > x_start;
-                const int right2 = x < w - 2,                    left2 = x > x_start + 1;
-                const int color = get_dst_color_err(s, src[x], &er, &eg, &eb);
+        } else if (dither == DITHERING_BURKES) {
+            const int right  = x < w - 1, down  = y < h - 1, left  = x > x_start;
+            const int right2 = x < w - 2,                    left2 = x > x_start + 1;
+            const int color = get_dst_color_err(s, cache, src[x], &er, &eg, &eb);
 
-                if (color < 0)
-                    return color;
-                dst[x] = color;
+            if (color < 0)
+                return color;
+            dst[x] = color;
 
-                if (right)      src[                 x + 1] = dither_color(src[                 x + 1], er, eg, eb, 8, 5);
-                if (right2)     src[                 x + 2] = dither_color(src[                 x + 2], er, eg, eb, 4, 5);
+            if (right)      src[                 x + 1] = dither_color(src[                 x + 1], er, eg, eb, 8, 5);
+            if (right2)     src[                 x + 2] = dither_color(src[                 x + 2], er, eg, eb, 4, 5);
 
-                if (down) {
-                    if (left2)  src[src_linesize   + x - 2] = dither_color(src[src_linesize   + x - 2], er, eg, eb, 2, 5);
-                    if (left)   src[src_linesize   + x - 1] = dither_color(src[src_linesize   + x - 1], er, eg, eb, 4, 5);
-                    if (1)      src[src_linesize   + x    ] = dither_color(src[src_linesize   + x    ], er, eg, eb, 8, 5);
-                    if (right)  src[src_linesize   + x + 1] = dither_color(src[src_linesize   + x + 1], er, eg, eb, 4, 5);
-                    if (right2) src[src_linesize   + x + 2] = dither_color(src[src_linesize   + x + 2], er, eg, eb, 2, 5);
-                }
+            if (down) {
+                if (left2)  src[src_linesize   + x - 2] = dither_color(src[src_linesize   + x - 2], er, eg, eb, 2, 5);
+                if (left)   src[src_linesize   + x - 1] = dither_color(src[src_linesize   + x - 1], er, eg, eb, 4, 5);
+                if (1)      src[src_linesize   + x    ] = dither_color(src[src_linesize   + x    ], er, eg, eb, 8, 5);
+                if (right)  src[src_linesize   + x + 1] = dither_color(src[src_linesize   + x + 1], er, eg, eb, 4, 5);
+                if (right2) src[src_linesize   + x + 2] = dither_color(src[src_linesize   + x + 2], er, eg, eb, 2, 5);
+            }
 
-            } else if (dither == DITHERING_ATKINSON) {
-                const int right  = x < w - 1, down  = y < h - 1, left = x > x_start;
-                const int right2 = x < w - 2, down2 = y < h - 2;
-                const int color = get_dst_color_err(s, src[x], &er, &eg, &eb);
+        } else if (dither == DITHERING_ATKINSON) {
+            const int right  = x < w - 1, down  = y < h - 1, left = x > x_start;
+            const int right2 = x < w - 2, down2 = y < h - 2;
+            const int color = get_dst_color_err(s, cache, src[x], &er, &eg, &eb);
 
-                if (color < 0)
-                    return color;
-                dst[x] = color;
+            if (color < 0)
+                return color;
+            dst[x] = color;
 
-                if (right)     src[                 x + 1] = dither_color(src[                 x + 1], er, eg, eb, 1, 3);
-                if (right2)    src[                 x + 2] = dither_color(src[                 x + 2], er, eg, eb, 1, 3);
+            if (right)     src[                 x + 1] = dither_color(src[                 x + 1], er, eg, eb, 1, 3);
+            if (right2)    src[                 x + 2] = dither_color(src[                 x + 2], er, eg, eb, 1, 3);
 
-                if (down) {
-                    if (left)  src[src_linesize   + x - 1] = dither_color(src[src_linesize   + x - 1], er, eg, eb, 1, 3);
-                    if (1)     src[src_linesize   + x    ] = dither_color(src[src_linesize   + x    ], er, eg, eb, 1, 3);
-                    if (right) src[src_linesize   + x + 1] = dither_color(src[src_linesize   + x + 1], er, eg, eb, 1, 3);
-                    if (down2) src[src_linesize*2 + x    ] = dither_color(src[src_linesize*2 + x    ], er, eg, eb, 1, 3);
-                }
+            if (down) {
+                if (left)  src[src_linesize   + x - 1] = dither_color(src[src_linesize   + x - 1], er, eg, eb, 1, 3);
+                if (1)     src[src_linesize   + x    ] = dither_color(src[src_linesize   + x    ], er, eg, eb, 1, 3);
+                if (right) src[src_linesize   + x + 1] = dither_color(src[src_linesize   + x + 1], er, eg, eb, 1, 3);
+                if (down2) src[src_linesize*2 + x    ] = dither_color(src[src_linesize*2 + x    ], er, eg, eb, 1, 3);
+            }
 
-            } else {
-                const int color = color_get(s, src[x]);
+        } else {
+            const int color = color_get(s, cache, src[x]);
 
-                if (color < 0)
-                    return color;
-                dst[x] = color;
-            }
+            if (color < 0)
+                return color;
+            dst[x] = color;
         }
-        src += src_linesize;
-        dst += dst_linesize;
     }
     return 0;
 }
@@ -767,6 +792,59 @@ static void set_processing_window(enum diff_mode diff_mode,
     *hp = height;
 }
 
+static void report_progress(PaletteUseContext *s, int y, int progress)
+{
+    atomic_store_explicit(&s->row_progress[y], progress, memory_order_release);
+    ff_mutex_lock(&s->progress_lock);
+    ff_cond_broadcast(&s->progress_cond);
+    ff_mutex_unlock(&s->progress_lock);
+}
+
+static void await_progress(PaletteUseContext *s, int y, int progress)
+{
+    if (atomic_load_explicit(&s->row_progress[y], memory_order_acquire) >= progress)
+        return;
+
+    ff_mutex_lock(&s->progress_lock);
+    while (atomic_load_explicit(&s->row_progress[y], memory_order_acquire) < progress)
+        ff_cond_wait(&s->progress_cond, &s->progress_lock);
+    ff_mutex_unlock(&s->progress_lock);
+}
+
+static int set_frame_slice(AVFilterContext *ctx, void *arg, int jobnr, int nb_jobs)
+{
+    PaletteUseContext *s = ctx->priv;
+    const ThreadData *td = arg;
+    struct cache_node *cache = s->caches[jobnr];
+    const int diffusion = s->dither != DITHERING_NONE && s->dither != DITHERING_BAYER;
+    int y, ret = 0;
+
+    /* Rows are mapped in a wavefront: the errors are spread up to 2 pixels
+     * to the left and right of the rows below, so a span of a row is mapped
+     * once the row above is 4 pixels ahead of its end. The pixels then get
+     * their errors in the same order as in a serial pass. Rows are taken in
+     * order, so a row is never waited for before it was picked by a running
+     * job. */
+    while ((y = atomic_fetch_add_explicit(&s->next_row, 1, memory_order_relaxed)) < td->h) {
+        for (int x = 0; x < td->w; x += SPAN_SIZE) {
+            const int end = FFMIN(x + SPAN_SIZE, td->w);
+
+            if (diffusion && y > 0)
+                await_progress(s, y - 1, FFMIN(end + 4, td->w));
+
+            /* keep reporting progress on errors, the rows below wait for it */
+            if (ret >= 0)
+                ret = s->set_frame(s, cache, td->out, td->in, td->x, td->y, td->w, td->h,
+                                   td->y + y, td->x + x, td->x + end);
+
+            if (diffusion)
+                report_progress(s, y, end);
+        }
+    }
+
+    return ret;
+}
+
 static int apply_palette(AVFilterLink *inlink, AVFrame *in, AVFrame **outf)
 {
     int x, y, w, h, ret;
@@ -795,11 +873,22 @@ static int apply_palette(AVFilterLink *inlink, AVFrame *in, AVFrame **outf)
     ff_dlog(ctx, "%dx%d rect: (%d;%d) -> (%d,%d) [area:%dx%d]\n",
             w, h, x, y, x+w, y+h, in->width, in->height);
 
-    ret = s->set_frame(s, out, in, x, y, w, h);
-    if (ret < 0) {
-        av_frame_free(&out);
-        *outf = NULL;
-        return ret;
+    if (w > 0 && h > 0) {
+        ThreadData td = { .in = in, .out = out, .x = x, .y = y, .w = w, .h = h };
+        const int nb_jobs = FFMIN(h, s->nb_caches);
+
+        for (int i = 0; i < h; i++)
+            atomic_init(&s->row_progress[i], 0);
+        atomic_init(&s->next_row, 0);
+
+        ff_filter_execute(ctx, set_frame_slice, &td, s->job_rets, nb_jobs);
+        for (int i = 0; i < nb_jobs; i++) {
+            if (s->job_rets[i] < 0) {
+                av_frame_free(&out);
+                *outf = NULL;
+                return s->job_rets[i];
+            }
+        }
     }
     memcpy(out->data[1], s->palette, AVPALETTE_SIZE);
     *outf = out;
@@ -822,6 +911,13 @@ static int config_output(AVFilterLink *outlink)
     outlink->w = ctx->inputs[0]->w;
     outlink->h = ctx->inputs[0]->h;
 
+    s->nb_caches = ff_filter_get_nb_threads(ctx);
+    s->caches = av_calloc(s->nb_caches, sizeof(*s->caches));
+    s->job_rets = av_calloc(s->nb_caches, sizeof(*s->job_rets));
+    s->row_progress = av_calloc(outlink->h, sizeof(*s->row_progress));
+    if (!s->caches || !s->job_rets || !s->row_progress)
+        return AVERROR(ENOMEM);
+
     outlink->time_base = ctx->inputs[0]->time_base;
     if ((ret = ff_framesync_configure(&s->fs)) < 0)
         return ret;
@@ -843,35 +939,50 @@ static int config_input_palette(AVFilterLink *inlink)
     return 0;
 }
 
+static void free_caches(PaletteUseContext *s)
+{
+    for (int j = 0; j < s->nb_caches; j++) {
+        for (int i = 0; i < CACHE_SIZE; i++)
+            av_freep(&s->caches[j][i].entries);
+        memset(s->caches[j], 0, sizeof(s->caches[j]));
+    }
+}
+
 static void load_palette(PaletteUseContext *s, const AVFrame *palette_frame)
 {
     int i, x, y;
     const uint32_t *p = (const uint32_t *)palette_frame->data[0];
     const ptrdiff_t p_linesize = palette_frame->linesize[0] >> 2;
-
-    s->transparency_index = -1;
-
-    if (s->new) {
-        memset(s->palette, 0, sizeof(s->palette));
-        memset(s->map, 0, sizeof(s->map));
-        for (i = 0; i < CACHE_SIZE; i++)
-            av_freep(&s->cache[i].entries);
-        memset(s->cache, 0, sizeof(s->cache));
-    }
+    uint32_t palette[AVPALETTE_COUNT] = { 0 };
+    int transparency_index = -1;
 
     i = 0;
     for (y = 0; y < palette_frame->height; y++) {
         for (x = 0; x < palette_frame->width; x++) {
-            s->palette[i] = p[x];
+            palette[i] = p[x];
             if (p[x]>>24 < s->trans_thresh) {
-                s->transparency_index = i; // we are assuming at most one transparent color in palette
+                transparency_index = i; // we are assuming at most one transparent color in palette
             }
             i++;
         }
         p += p_linesize;
     }
 
+    /* with new=1 the palette is often the same for many frames: the colormap
+     * and the color caches are only reset when it actually changes */
+    if (s->map_loaded && !memcmp(palette, s->palette, sizeof(palette)))
+        return;
+
+    if (s->new) {
+        memset(s->map, 0, sizeof(s->map));
+        free_caches(s);
+    }
+
+    memcpy(s->palette, palette, sizeof(palette));
+    s->transparency_index = transparency_index;
+
     load_colormap(s);
+    s->map_loaded = 1;
 
     if (!s->new)
         s->palette_loaded = 1;
@@ -904,10 +1015,13 @@ static int load_apply_palette(FFFrameSync *fs)
 }
 
 #define DEFINE_SET_FRAME(name, value)                                           \
-static int set_frame_##name(PaletteUseContext *s, AVFrame *out, AVFrame *in,    \
-                            int x_start, int y_start, int w, int h)             \
+static int set_frame_##name(PaletteUseContext *s, struct cache_node *cache,     \
+                            AVFrame *out, AVFrame *in,                          \
+                            int x_start, int y_start, int w, int h,             \
+                            int y, int x0, int x1)                              \
 {                                                                               \
-    return set_frame(s, out, in, x_start, y_start, w, h, value);                \
+    return set_frame(s, cache, out, in, x_start, y_start, w, h,                 \
+                     y, x0, x1, value);                                         \
 }
 
 DEFINE_SET_FRAME(none,            DITHERING_NONE)
@@ -943,6 +1057,7 @@ static int dither_value(int p)
 static av_cold int init(AVFilterContext *ctx)
 {
     PaletteUseContext *s = ctx->priv;
+    int ret;
 
     s->last_in  = av_frame_alloc();
     s->last_out = av_frame_alloc();
@@ -951,6 +1066,11 @@ static av_cold int init(AVFilterContext *ctx)
 
     s->set_frame = set_frame_lut[s->dither];
 
+    if ((ret = ff_mutex_init(&s->progress_lock, NULL)))
+        return AVERROR(ret);
+    if ((ret = ff_cond_init(&s->progress_cond, NULL)))
+        return AVERROR(ret);
+
     if (s->dither == DITHERING_BAYER) {
         const int delta = 1 << (5 - s->bayer_scale); // to avoid too much luma
 
@@ -972,8 +1092,13 @@ static av_cold void uninit(AVFilterContext *ctx)
     PaletteUseContext *s = ctx->priv;
 
     ff_framesync_uninit(&s->fs);
-    for (int i = 0; i < CACHE_SIZE; i++)
-        av_freep(&s->cache[i].entries);
+    if (s->caches)
+        free_caches(s);
+    av_freep(&s->caches);
+    av_freep(&s->job_rets);
+    av_freep(&s->row_progress);
+    ff_mutex_destroy(&s->progress_lock);
+    ff_cond_destroy(&s->progress_cond);
     av_frame_free(&s->last_in);
     av_frame_free(&s->last_out);
 }
@@ -1001,6 +1126,7 @@ const FFFilter ff_vf_paletteuse = {
     .p.name        = "paletteuse",
     .p.description = NULL_IF_CONFIG_SMALL("Use a palette to downsample an input video stream."),
     .p.priv_class  = &paletteuse_class,
+    .p.flags       = AVFILTER_FLAG_SLICE_THREADS,
     .priv_size     = sizeof(PaletteUseContext),
     .init          = init,
     .uninit        = uninit,
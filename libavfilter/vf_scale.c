@@ -34,6 +34,7 @@
 #include "libavutil/pixfmt.h"
 #include "scale_eval.h"
 #include "video.h"
+#include "libavutil/avstring.h"
 #include "libavutil/eval.h"
 #include "libavutil/imgutils_internal.h"
 #include "libavutil/internal.h"
@@ -127,6 +128,7 @@ enum EvalMode {
 typedef struct ScaleContext {
     const AVClass *class;
     SwsContext *sws;
+    SwsGraphCache *graph_cache; ///< lets eval=frame switch back to earlier sizes cheaply, if enabled
     FFFrameSync fs;
 
     /**
@@ -173,6 +175,15 @@ typedef struct ScaleContext {
     int reset_sar;
 
     int eval_mode;              ///< expression evaluation mode
+    int graph_cache_size;       ///< number of unused graphs to keep, 0 for none
+
+    char *sizes_str;            ///< additional output sizes, '|'-separated
+    struct {
+        int w, h;
+    } *extra;                   ///< requested size of each additional output
+    int nb_extra;
+    AVFrame **out_frames;       ///< one entry per output, for activate_multi()
+    AVFrame **scaled;           ///< outputs that need scaling, for scale_frame()
 
 } ScaleContext;
 
@@ -180,6 +191,7 @@ const FFFilter ff_vf_scale2ref;
 #define IS_SCALE2REF(ctx) ((ctx)->filter == &ff_vf_scale2ref.p)
 
 static int config_props(AVFilterLink *outlink);
+static int config_props_extra(AVFilterLink *outlink);
 
 static int check_exprs(AVFilterContext *ctx)
 {
@@ -425,6 +437,13 @@ static av_cold int init(AVFilterContext *ctx)
     if (!scale->sws->threads)
         scale->sws->threads = ff_filter_get_nb_threads(ctx);
 
+    if (scale->graph_cache_size) {
+        scale->graph_cache = sws_graph_cache_alloc(scale->graph_cache_size);
+        if (!scale->graph_cache)
+            return AVERROR(ENOMEM);
+        scale->sws->graph_cache = scale->graph_cache;
+    }
+
     if (!IS_SCALE2REF(ctx) && scale->uses_ref) {
         AVFilterPad pad = {
             .name = "ref",
@@ -435,6 +454,60 @@ static av_cold int init(AVFilterContext *ctx)
             return ret;
     }
 
+    if (scale->sizes_str && *scale->sizes_str) {
+        char *sizes, *saveptr = NULL, *tok;
+
+        ret = 0;
+
+        if (IS_SCALE2REF(ctx) || scale->uses_ref) {
+            av_log(ctx, AV_LOG_ERROR,
+                   "Additional output sizes cannot be combined with a reference input.\n");
+            return AVERROR(EINVAL);
+        }
+
+        sizes = av_strdup(scale->sizes_str);
+        if (!sizes)
+            return AVERROR(ENOMEM);
+
+        for (tok = av_strtok(sizes, "|", &saveptr); tok;
+             tok = av_strtok(NULL, "|", &saveptr)) {
+            AVFilterPad pad = {
+                .type         = AVMEDIA_TYPE_VIDEO,
+                .config_props = config_props_extra,
+            };
+            int w, h;
+
+            if ((ret = av_parse_video_size(&w, &h, tok)) < 0) {
+                av_log(ctx, AV_LOG_ERROR, "Invalid size '%s'\n", tok);
+                break;
+            }
+
+            ret = av_reallocp_array(&scale->extra, scale->nb_extra + 1,
+                                    sizeof(*scale->extra));
+            if (ret < 0)
+                break;
+            scale->extra[scale->nb_extra].w = w;
+            scale->extra[scale->nb_extra].h = h;
+            scale->nb_extra++;
+
+            pad.name = av_asprintf("out%d", ctx->nb_outputs);
+            if (!pad.name) {
+                ret = AVERROR(ENOMEM);
+                break;
+            }
+            if ((ret = ff_append_outpad_free_name(ctx, &pad)) < 0)
+                break;
+        }
+        av_free(sizes);
+        if (ret < 0)
+            return ret;
+
+        scale->out_frames = av_calloc(ctx->nb_outputs, sizeof(*scale->out_frames));
+        scale->scaled     = av_calloc(ctx->nb_outputs, sizeof(*scale->scaled));
+        if (!scale->out_frames || !scale->scaled)
+            return AVERROR(ENOMEM);
+    }
+
     return 0;
 }
 
@@ -446,6 +519,10 @@ static av_cold void uninit(AVFilterContext *ctx)
     scale->w_pexpr = scale->h_pexpr = NULL;
     ff_framesync_uninit(&scale->fs);
     sws_free_context(&scale->sws);
+    sws_graph_cache_free(&scale->graph_cache);
+    av_freep(&scale->extra);
+    av_freep(&scale->out_frames);
+    av_freep(&scale->scaled);
 }
 
 static int query_formats(const AVFilterContext *ctx,
@@ -479,8 +556,10 @@ static int query_formats(const AVFilterContext *ctx,
                 return ret;
         }
     }
-    if ((ret = ff_formats_ref(formats, &cfg_out[0]->formats)) < 0)
-        return ret;
+    for (int i = 0; i <= scale->nb_extra; i++) {
+        if ((ret = ff_formats_ref(formats, &cfg_out[i]->formats)) < 0)
+            return ret;
+    }
 
     /* accept all supported inputs, even if user overrides their properties */
     formats = ff_all_color_spaces();
@@ -511,14 +590,18 @@ static int query_formats(const AVFilterContext *ctx,
             }
         }
     }
-    if ((ret = ff_formats_ref(formats, &cfg_out[0]->color_spaces)) < 0)
-        return ret;
+    for (int i = 0; i <= scale->nb_extra; i++) {
+        if ((ret = ff_formats_ref(formats, &cfg_out[i]->color_spaces)) < 0)
+            return ret;
+    }
 
     formats = scale->out_range != AVCOL_RANGE_UNSPECIFIED
                 ? ff_make_formats_list_singleton(scale->out_range)
                 : ff_all_color_ranges();
-    if ((ret = ff_formats_ref(formats, &cfg_out[0]->color_ranges)) < 0)
-        return ret;
+    for (int i = 0; i <= scale->nb_extra; i++) {
+        if ((ret = ff_formats_ref(formats, &cfg_out[i]->color_ranges)) < 0)
+            return ret;
+    }
 
     if (scale->sws->alpha_blend) {
         if ((ret = ff_formats_ref(ff_make_formats_list_singleton(AVALPHA_MODE_STRAIGHT),
@@ -618,34 +701,13 @@ fail:
     return ret;
 }
 
-static int config_props(AVFilterLink *outlink)
+/* Derive the SAR and side data of a scaled output from its final size */
+static void config_output_props(AVFilterContext *ctx, AVFilterLink *outlink,
+                                const AVFilterLink *inlink,
+                                const AVFilterLink *inlink0)
 {
-    AVFilterContext *ctx = outlink->src;
-    AVFilterLink *inlink0 = outlink->src->inputs[0];
-    AVFilterLink *inlink  = IS_SCALE2REF(ctx) ?
-                            outlink->src->inputs[1] :
-                            outlink->src->inputs[0];
     ScaleContext *scale = ctx->priv;
     uint8_t *flags_val = NULL;
-    double w_adj = 1.0;
-    int ret;
-
-    if ((ret = scale_eval_dimensions(ctx)) < 0)
-        goto fail;
-
-    outlink->w = scale->w;
-    outlink->h = scale->h;
-
-    if (scale->reset_sar)
-        w_adj = IS_SCALE2REF(ctx) ? scale->var_values[VAR_S2R_MAIN_SAR] :
-                                    scale->var_values[VAR_SAR];
-
-    ret = ff_scale_adjust_dimensions(inlink, &outlink->w, &outlink->h,
-                               scale->force_original_aspect_ratio,
-                               scale->force_divisible_by, w_adj);
-
-    if (ret < 0)
-        goto fail;
 
     if (outlink->w > INT_MAX ||
         outlink->h > INT_MAX ||
@@ -682,8 +744,39 @@ static int config_props(AVFilterLink *outlink)
         av_frame_side_data_remove_by_props(&outlink->side_data, &outlink->nb_side_data,
                                            AV_SIDE_DATA_PROP_COLOR_DEPENDENT);
     }
+}
 
-    if (!IS_SCALE2REF(ctx)) {
+static int config_props(AVFilterLink *outlink)
+{
+    AVFilterContext *ctx = outlink->src;
+    AVFilterLink *inlink0 = outlink->src->inputs[0];
+    AVFilterLink *inlink  = IS_SCALE2REF(ctx) ?
+                            outlink->src->inputs[1] :
+                            outlink->src->inputs[0];
+    ScaleContext *scale = ctx->priv;
+    double w_adj = 1.0;
+    int ret;
+
+    if ((ret = scale_eval_dimensions(ctx)) < 0)
+        goto fail;
+
+    outlink->w = scale->w;
+    outlink->h = scale->h;
+
+    if (scale->reset_sar)
+        w_adj = IS_SCALE2REF(ctx) ? scale->var_values[VAR_S2R_MAIN_SAR] :
+                                    scale->var_values[VAR_SAR];
+
+    ret = ff_scale_adjust_dimensions(inlink, &outlink->w, &outlink->h,
+                               scale->force_original_aspect_ratio,
+                               scale->force_divisible_by, w_adj);
+
+    if (ret < 0)
+        goto fail;
+
+    config_output_props(ctx, outlink, inlink, inlink0);
+
+    if (!IS_SCALE2REF(ctx) && !scale->nb_extra) {
         ff_framesync_uninit(&scale->fs);
         ret = ff_framesync_init(&scale->fs, ctx, ctx->nb_inputs);
         if (ret < 0)
@@ -712,6 +805,31 @@ fail:
     return ret;
 }
 
+static int config_props_extra(AVFilterLink *outlink)
+{
+    AVFilterContext *ctx = outlink->src;
+    AVFilterLink *inlink = ctx->inputs[0];
+    ScaleContext *scale = ctx->priv;
+    const int idx = FF_OUTLINK_IDX(outlink) - 1;
+    double w_adj = 1.0;
+    int ret;
+
+    outlink->w = scale->extra[idx].w;
+    outlink->h = scale->extra[idx].h;
+
+    if (scale->reset_sar && inlink->sample_aspect_ratio.num)
+        w_adj = av_q2d(inlink->sample_aspect_ratio);
+
+    ret = ff_scale_adjust_dimensions(inlink, &outlink->w, &outlink->h,
+                                     scale->force_original_aspect_ratio,
+                                     scale->force_divisible_by, w_adj);
+    if (ret < 0)
+        return ret;
+
+    config_output_props(ctx, outlink, inlink, inlink);
+    return 0;
+}
+
 static int config_props_ref(AVFilterLink *outlink)
 {
     AVFilterLink *inlink = outlink->src->inputs[1];
@@ -739,7 +857,54 @@ static int request_frame_ref(AVFilterLink *outlink)
     return ff_request_frame(outlink->src->inputs[1]);
 }
 
-/* Takes over ownership of *frame_in, passes ownership of *frame_out to caller */
+/* Allocate an output frame for outlink, with the properties of in */
+static AVFrame *alloc_out_frame(AVFilterLink *outlink, const AVFilterLink *inlink,
+                                const AVFrame *in)
+{
+    ScaleContext *scale = outlink->src->priv;
+    AVFrame *out = ff_get_video_buffer(outlink, outlink->w, outlink->h);
+    if (!out)
+        return NULL;
+
+    av_frame_copy_props(out, in);
+    out->width  = outlink->w;
+    out->height = outlink->h;
+    out->color_range = outlink->color_range;
+    out->colorspace = outlink->colorspace;
+    out->alpha_mode = outlink->alpha_mode;
+    if (scale->out_chroma_loc != AVCHROMA_LOC_UNSPECIFIED)
+        out->chroma_location = scale->out_chroma_loc;
+    if (scale->out_primaries != -1)
+        out->color_primaries = scale->out_primaries;
+    if (scale->out_transfer != -1)
+        out->color_trc = scale->out_transfer;
+
+    if (out->width != in->width || out->height != in->height) {
+        av_frame_side_data_remove_by_props(&out->side_data, &out->nb_side_data,
+                                           AV_SIDE_DATA_PROP_SIZE_DEPENDENT);
+    }
+
+    if (in->color_primaries != out->color_primaries || in->color_trc != out->color_trc) {
+        av_frame_side_data_remove_by_props(&out->side_data, &out->nb_side_data,
+                                           AV_SIDE_DATA_PROP_COLOR_DEPENDENT);
+    }
+
+    if (scale->reset_sar) {
+        out->sample_aspect_ratio = outlink->sample_aspect_ratio;
+    } else {
+        av_reduce(&out->sample_aspect_ratio.num, &out->sample_aspect_ratio.den,
+                (int64_t)in->sample_aspect_ratio.num * outlink->h * inlink->w,
+                (int64_t)in->sample_aspect_ratio.den * outlink->w * inlink->h,
+                INT_MAX);
+    }
+
+    return out;
+}
+
+/**
+ * Takes over ownership of *frame_in, passes ownership of frame_out[] to
+ * caller. frame_out must have room for one frame per scaled output.
+ */
 static int scale_frame(AVFilterLink *link, AVFrame **frame_in,
                        AVFrame **frame_out)
 {
@@ -748,6 +913,8 @@ static int scale_frame(AVFilterLink *link, AVFrame **frame_in,
     ScaleContext *scale = ctx->priv;
     AVFilterLink *outlink = ctx->outputs[0];
     AVFrame *out, *in = *frame_in;
+    const int nb_outs = 1 + scale->nb_extra;
+    int nb_scaled = 0;
     const AVPixFmtDescriptor *desc = av_pix_fmt_desc_get(link->format);
     char buf[32];
     int ret, flags_orig, frame_changed;
@@ -810,18 +977,16 @@ static int scale_frame(AVFilterLink *link, AVFrame **frame_in,
 
         if ((ret = config_props(outlink)) < 0)
             goto err;
+        for (int i = 1; i < nb_outs; i++) {
+            if ((ret = config_props_extra(ctx->outputs[i])) < 0)
+                goto err;
+        }
     }
 
 scale:
     scale->hsub = desc->log2_chroma_w;
     scale->vsub = desc->log2_chroma_h;
 
-    out = ff_get_video_buffer(outlink, outlink->w, outlink->h);
-    if (!out) {
-        ret = AVERROR(ENOMEM);
-        goto err;
-    }
-
     if (scale->in_color_matrix != -1)
         in->colorspace = scale->in_color_matrix;
     if (scale->in_primaries != -1)
@@ -838,59 +1003,80 @@ scale:
     else if (!scale->interlaced)
         in->flags &= ~AV_FRAME_FLAG_INTERLACED;
 
-    av_frame_copy_props(out, in);
-    out->width  = outlink->w;
-    out->height = outlink->h;
-    out->color_range = outlink->color_range;
-    out->colorspace = outlink->colorspace;
-    out->alpha_mode = outlink->alpha_mode;
-    if (scale->out_chroma_loc != AVCHROMA_LOC_UNSPECIFIED)
-        out->chroma_location = scale->out_chroma_loc;
-    if (scale->out_primaries != -1)
-        out->color_primaries = scale->out_primaries;
-    if (scale->out_transfer != -1)
-        out->color_trc = scale->out_transfer;
+    if (nb_outs == 1) {
+        out = alloc_out_frame(outlink, link, in);
+        if (!out) {
+            ret = AVERROR(ENOMEM);
+            goto err;
+        }
 
-    if (out->width != in->width || out->height != in->height) {
-        av_frame_side_data_remove_by_props(&out->side_data, &out->nb_side_data,
-                                           AV_SIDE_DATA_PROP_SIZE_DEPENDENT);
-    }
+        if (sws_is_noop(out, in)) {
+            av_frame_free(&out);
+            in->flags = flags_orig;
+            *frame_out = in;
+            return 0;
+        }
 
-    if (in->color_primaries != out->color_primaries || in->color_trc != out->color_trc) {
-        av_frame_side_data_remove_by_props(&out->side_data, &out->nb_side_data,
-                                           AV_SIDE_DATA_PROP_COLOR_DEPENDENT);
-    }
+        if (out->format == AV_PIX_FMT_PAL8) {
+            out->format = AV_PIX_FMT_BGR8;
+            avpriv_set_systematic_pal2((uint32_t*) out->data[1], out->format);
+        }
 
-    if (scale->reset_sar) {
-        out->sample_aspect_ratio = outlink->sample_aspect_ratio;
-    } else {
-        av_reduce(&out->sample_aspect_ratio.num, &out->sample_aspect_ratio.den,
-                (int64_t)in->sample_aspect_ratio.num * outlink->h * link->w,
-                (int64_t)in->sample_aspect_ratio.den * outlink->w * link->h,
-                INT_MAX);
+        ret = sws_scale_frame(scale->sws, out, in);
+        av_frame_free(&in);
+        out->flags = flags_orig;
+        out->format = outlink->format; /* undo PAL8 handling */
+        if (ret < 0)
+            av_frame_free(&out);
+        *frame_out = out;
+        return ret;
     }
 
-    if (sws_is_noop(out, in)) {
-        av_frame_free(&out);
-        in->flags = flags_orig;
-        *frame_out = in;
-        return 0;
+    /* outputs matching the input get a reference, all others are produced
+     * by a single multi-output graph sharing the common passes */
+    for (int i = 0; i < nb_outs; i++) {
+        out = alloc_out_frame(ctx->outputs[i], link, in);
+        if (!out) {
+            ret = AVERROR(ENOMEM);
+            goto err_multi;
+        }
+
+        if (sws_is_noop(out, in)) {
+            av_frame_free(&out);
+            continue;
+        }
+
+        if (out->format == AV_PIX_FMT_PAL8) {
+            out->format = AV_PIX_FMT_BGR8;
+            avpriv_set_systematic_pal2((uint32_t*) out->data[1], out->format);
+        }
+        frame_out[i] = scale->scaled[nb_scaled++] = out;
     }
 
-    if (out->format == AV_PIX_FMT_PAL8) {
-        out->format = AV_PIX_FMT_BGR8;
-        avpriv_set_systematic_pal2((uint32_t*) out->data[1], out->format);
+    ret = nb_scaled ? sws_scale_frames(scale->sws, scale->scaled, nb_scaled, in) : 0;
+    in->flags = flags_orig;
+    if (ret < 0)
+        goto err_multi;
+
+    for (int i = 0; i < nb_outs; i++) {
+        if (!frame_out[i]) {
+            frame_out[i] = av_frame_clone(in);
+            if (!frame_out[i]) {
+                ret = AVERROR(ENOMEM);
+                goto err_multi;
+            }
+        } else {
+            frame_out[i]->flags  = flags_orig;
+            frame_out[i]->format = ctx->outputs[i]->format;
+        }
     }
 
-    ret = sws_scale_frame(scale->sws, out, in);
     av_frame_free(&in);
-    out->flags = flags_orig;
-    out->format = outlink->format; /* undo PAL8 handling */
-    if (ret < 0)
-        av_frame_free(&out);
-    *frame_out = out;
-    return ret;
+    return 0;
 
+err_multi:
+    for (int i = 0; i < nb_outs; i++)
+        av_frame_free(&frame_out[i]);
 err:
     av_frame_free(&in);
     return ret;
@@ -1033,9 +1219,67 @@ static int process_command(AVFilterContext *ctx, const char *cmd, const char *ar
     return ret;
 }
 
+static int activate_multi(AVFilterContext *ctx)
+{
+    ScaleContext *scale = ctx->priv;
+    AVFilterLink *inlink = ctx->inputs[0];
+    AVFrame *in;
+    int64_t pts;
+    int status, ret, nb_eofs = 0;
+
+    for (int i = 0; i < ctx->nb_outputs; i++)
+        nb_eofs += ff_outlink_get_status(ctx->outputs[i]) == AVERROR_EOF;
+
+    if (nb_eofs == ctx->nb_outputs) {
+        ff_inlink_set_status(inlink, AVERROR_EOF);
+        return 0;
+    }
+
+    ret = ff_inlink_consume_frame(inlink, &in);
+    if (ret < 0)
+        return ret;
+    if (ret > 0) {
+        int i = 0;
+
+        ret = scale_frame(inlink, &in, scale->out_frames);
+        for (; ret >= 0 && i < ctx->nb_outputs; i++) {
+            AVFrame *out = scale->out_frames[i];
+            scale->out_frames[i] = NULL;
+            if (ff_outlink_get_status(ctx->outputs[i]))
+                av_frame_free(&out);
+            else
+                ret = ff_filter_frame(ctx->outputs[i], out);
+        }
+
+        /* on error, drop the frames of all outputs not yet sent */
+        for (; i < ctx->nb_outputs; i++)
+            av_frame_free(&scale->out_frames[i]);
+        return ret;
+    }
+
+    if (ff_inlink_acknowledge_status(inlink, &status, &pts)) {
+        for (int i = 0; i < ctx->nb_outputs; i++)
+            ff_outlink_set_status(ctx->outputs[i], status, pts);
+        return 0;
+    }
+
+    for (int i = 0; i < ctx->nb_outputs; i++) {
+        if (ff_outlink_frame_wanted(ctx->outputs[i])) {
+            ff_inlink_request_frame(inlink);
+            return 0;
+        }
+    }
+
+    return FFERROR_NOT_READY;
+}
+
 static int activate(AVFilterContext *ctx)
 {
     ScaleContext *scale = ctx->priv;
+
+    if (scale->nb_extra)
+        return activate_multi(ctx);
+
     return ff_framesync_activate(&scale->fs);
 }
 
@@ -1076,6 +1320,7 @@ static const AVOption scale_options[] = {
     { "interl", "set interlacing", OFFSET(interlaced), AV_OPT_TYPE_BOOL, {.i64 = 0 }, -1, 1, FLAGS },
     { "size",   "set video size",          OFFSET(size_str), AV_OPT_TYPE_STRING, {.str = NULL}, 0, .flags = FLAGS },
     { "s",      "set video size",          OFFSET(size_str), AV_OPT_TYPE_STRING, {.str = NULL}, 0, .flags = FLAGS },
+    { "sizes",  "set additional output sizes, separated by '|'", OFFSET(sizes_str), AV_OPT_TYPE_STRING, {.str = NULL}, 0, .flags = FLAGS },
     {  "in_color_matrix", "set input YCbCr type",   OFFSET(in_color_matrix),  AV_OPT_TYPE_INT, { .i64 = -1 }, -1, AVCOL_SPC_NB-1, .flags = FLAGS, .unit = "color" },
     { "out_color_matrix", "set output YCbCr type",  OFFSET(out_color_matrix), AV_OPT_TYPE_INT, { .i64 = AVCOL_SPC_UNSPECIFIED }, 0, AVCOL_SPC_NB-1, .flags = FLAGS, .unit = "color"},
         { "auto",        NULL, 0, AV_OPT_TYPE_CONST, {.i64=-1},                       0, 0, FLAGS, .unit = "color" },
@@ -1159,6 +1404,7 @@ static const AVOption scale_options[] = {
     { "eval", "specify when to evaluate expressions", OFFSET(eval_mode), AV_OPT_TYPE_INT, {.i64 = EVAL_MODE_INIT}, 0, EVAL_MODE_NB-1, FLAGS, .unit = "eval" },
          { "init",  "eval expressions once during initialization", 0, AV_OPT_TYPE_CONST, {.i64=EVAL_MODE_INIT},  .flags = FLAGS, .unit = "eval" },
          { "frame", "eval expressions during initialization and per-frame", 0, AV_OPT_TYPE_CONST, {.i64=EVAL_MODE_FRAME}, .flags = FLAGS, .unit = "eval" },
+    { "graph_cache", "number of unused scaling graphs to keep for reuse", OFFSET(graph_cache_size), AV_OPT_TYPE_INT, { .i64 = 0 }, 0, 64, FLAGS },
     { NULL }
 };
 
@@ -1191,7 +1437,7 @@ const FFFilter ff_vf_scale = {
     .p.name          = "scale",
     .p.description   = NULL_IF_CONFIG_SMALL("Scale the input video size and/or convert the image format."),
     .p.priv_class    = &scale_class,
-    .p.flags         = AVFILTER_FLAG_DYNAMIC_INPUTS,
+    .p.flags         = AVFILTER_FLAG_DYNAMIC_INPUTS | AVFILTER_FLAG_DYNAMIC_OUTPUTS,
     .preinit         = preinit,
     .init            = init,
     .uninit          = uninit,
@@ -24,11 +24,15 @@
  * @see http://epubs.surrey.ac.uk/531590/1/MPEG-7%20Video%20Signature%20Author%27s%20Copy.pdf
  */
 
+#include "libavcodec/defs.h"
+#include "libavcodec/get_bits.h"
 #include "libavcodec/put_bits.h"
 #include "libavformat/avformat.h"
 #include "libavutil/mem.h"
 #include "libavutil/opt.h"
 #include "libavutil/avstring.h"
+#include "libavutil/bprint.h"
+#include "libavutil/file.h"
 #include "libavutil/file_open.h"
 #include "avfilter.h"
 #include "filters.h"
@@ -63,6 +67,8 @@ static const AVOption signature_options[] = {
         OFFSET(thdi),         AV_OPT_TYPE_INT,    {.i64 = 0},        0, INT_MAX,          FLAGS },
     { "th_it",      "threshold for relation of good to all frames",
         OFFSET(thit),         AV_OPT_TYPE_DOUBLE, {.dbl = 0.5},    0.0, 1.0,              FLAGS },
+    { "index",      "file with stored binary signatures to match the inputs against",
+        OFFSET(index),        AV_OPT_TYPE_STRING, {.str = NULL},     0, 0,                FLAGS },
     { NULL }
 };
 
@@ -95,6 +101,14 @@ static int config_input(AVFilterLink *inlink)
     }
     sc->w = inlink->w;
     sc->h = inlink->h;
+
+    av_freep(&sc->intjlut);
+    sc->intjlut = av_malloc_array(inlink->w, sizeof(*sc->intjlut));
+    if (!sc->intjlut)
+        return AVERROR(ENOMEM);
+    for (int i = 0; i < inlink->w; i++)
+        sc->intjlut[i] = (i*32)/inlink->w;
+
     return 0;
 }
 
@@ -132,6 +146,41 @@ static int cmp(const void *x, const void *y)
     return *a < *b ? -1 : ( *a > *b ? 1 : 0 );
 }
 
+typedef struct ThreadData {
+    StreamContext *sc;
+    const AVFrame *in;
+    uint64_t (*intpic)[32];
+} ThreadData;
+
+/**
+ * Sum the luma of the pixels falling into each cell of the 32x32 grid.
+ * Every job owns a band of grid rows and only reads the picture rows
+ * mapping into it, so the jobs never touch the same cell.
+ */
+static int sum_rows(AVFilterContext *ctx, void *arg, int jobnr, int nb_jobs)
+{
+    ThreadData *td = arg;
+    const StreamContext *sc = td->sc;
+    const AVFrame *in = td->in;
+    const int *intjlut = sc->intjlut;
+    const int row_start = (32 *  jobnr   ) / nb_jobs;
+    const int row_end   = (32 * (jobnr+1)) / nb_jobs;
+    const int start     = (row_start * sc->h + 31) / 32;
+    const int end       = (row_end   * sc->h + 31) / 32;
+    const uint8_t *p = in->data[0] + start * in->linesize[0];
+
+    memset(td->intpic[row_start], 0, (row_end - row_start) * sizeof(*td->intpic));
+
+    for (int i = start; i < end; i++) {
+        uint64_t *row = td->intpic[(i*32)/sc->h];
+        for (int j = 0; j < sc->w; j++)
+            row[intjlut[j]] += p[j];
+        p += in->linesize[0];
+    }
+
+    return 0;
+}
+
 /**
  * sets the bit at position pos to 1 in data
  */
@@ -158,9 +207,7 @@ static int filter_frame(AVFilterLink *inlink, AVFrame *picref)
     uint8_t wordt2b[5] = { 0, 0, 0, 0, 0 }; /* word ternary to binary */
     uint64_t intpic[32][32];
     uint64_t rowcount;
-    uint8_t *p = picref->data[0];
-    int inti, intj;
-    int *intjlut;
+    ThreadData td;
 
     uint64_t conflist[DIFFELEM_SIZE];
     int f = 0, g = 0, w = 0;
@@ -190,23 +237,11 @@ static int filter_frame(AVFilterLink *inlink, AVFrame *picref)
     fs->pts = picref->pts;
     fs->index = sc->lastindex++;
 
-    memset(intpic, 0, sizeof(uint64_t)*32*32);
-    intjlut = av_malloc_array(inlink->w, sizeof(int));
-    if (!intjlut)
-        return AVERROR(ENOMEM);
-    for (i = 0; i < inlink->w; i++) {
-        intjlut[i] = (i*32)/inlink->w;
-    }
-
-    for (i = 0; i < inlink->h; i++) {
-        inti = (i*32)/inlink->h;
-        for (j = 0; j < inlink->w; j++) {
-            intj = intjlut[j];
-            intpic[inti][intj] += p[j];
-        }
-        p += picref->linesize[0];
-    }
-    av_freep(&intjlut);
+    td.sc = sc;
+    td.in = picref;
+    td.intpic = intpic;
+    ff_filter_execute(ctx, sum_rows, &td, NULL,
+                      FFMIN(32, ff_filter_get_nb_threads(ctx)));
 
     /* The following calculates a summed area table (intpic) and brings the numbers
      * in intpic to the same denominator.
@@ -574,13 +609,307 @@ static int export(AVFilterContext *ctx, StreamContext *sc, int input)
     }
 }
 
+/* size in bits of the header and of each coarse and fine signature of the
+ * binary format, see binary_export() */
+#define BINARY_HEADER_BITS (32 + 1 + 32 + 16 + 16 + 32 + 32 + 16 + 1 + 32 + 32 + 32)
+#define BINARY_COARSE_BITS (32 + 32 + 1 + 32 + 32 + 5 * 243)
+#define BINARY_FINE_BITS   (1 + 32 + 8 + 5 * 8 + SIGELEM_SIZE/5 * 8)
+
+/**
+ * Read the number of frames and of segments of a binary signature and
+ * return its size in bytes, or 0 if it is invalid.
+ */
+static size_t binary_size(const uint8_t *buf, size_t size,
+                          uint32_t *nb_frames, uint32_t *nb_segments)
+{
+    uint8_t header[(BINARY_HEADER_BITS + 7) / 8 + AV_INPUT_BUFFER_PADDING_SIZE] = { 0 };
+    GetBitContext gb;
+    uint64_t bits;
+
+    if (size < (BINARY_HEADER_BITS + 7) / 8)
+        return 0;
+    memcpy(header, buf, (BINARY_HEADER_BITS + 7) / 8);
+    init_get_bits(&gb, header, BINARY_HEADER_BITS);
+
+    if (get_bits_long(&gb, 32) != 1) /* NumOfSpatial Regions */
+        return 0;
+    skip_bits_long(&gb, 1 + 32 + 16 + 16 + 32);
+    *nb_frames = get_bits_long(&gb, 32);
+    skip_bits_long(&gb, 16 + 1 + 32 + 32);
+    *nb_segments = get_bits_long(&gb, 32);
+    if (!*nb_frames || *nb_segments != (*nb_frames + 44ULL) / 45)
+        return 0;
+
+    bits = BINARY_HEADER_BITS + (uint64_t)*nb_segments * BINARY_COARSE_BITS +
+           1 + (uint64_t)*nb_frames * BINARY_FINE_BITS;
+    if ((bits + 7) / 8 > size)
+        return 0;
+    return (bits + 7) / 8;
+}
+
+/**
+ * Load a binary signature, as written by binary_export(), into sc.
+ * The fine and coarse signatures are allocated as arrays, so they are
+ * freed with av_freep(&sc->finesiglist) and av_freep(&sc->coarsesiglist).
+ */
+static int binary_import(StreamContext *sc, const uint8_t *data, size_t size)
+{
+    uint32_t nb_frames, nb_segments;
+    FineSignature *fs;
+    CoarseSignature *cs;
+    GetBitContext gb;
+    uint8_t *buf;
+    int i, j, ret;
+
+    size = binary_size(data, size, &nb_frames, &nb_segments);
+    if (!size || size > INT_MAX / 8 - AV_INPUT_BUFFER_PADDING_SIZE)
+        return AVERROR_INVALIDDATA;
+
+    /* the mapped file is not padded for the bit reader */
+    buf = av_malloc(size + AV_INPUT_BUFFER_PADDING_SIZE);
+    if (!buf)
+        return AVERROR(ENOMEM);
+    memcpy(buf, data, size);
+    memset(buf + size, 0, AV_INPUT_BUFFER_PADDING_SIZE);
+    init_get_bits8(&gb, buf, size);
+
+    sc->finesiglist   = av_calloc(nb_frames, sizeof(*sc->finesiglist));
+    sc->coarsesiglist = av_calloc(nb_segments, sizeof(*sc->coarsesiglist));
+    if (!sc->finesiglist || !sc->coarsesiglist) {
+        ret = AVERROR(ENOMEM);
+        goto fail;
+    }
+
+    skip_bits_long(&gb, 32 + 1 + 32);
+    sc->w = get_bits(&gb, 16) + 1; /* PixelX,2 */
+    sc->h = get_bits(&gb, 16) + 1; /* PixelY,2 */
+    skip_bits_long(&gb, 32 + 32);
+    sc->time_base = (AVRational){ 1, get_bits(&gb, 16) }; /* MediaTimeUnit */
+    sc->time_base.den += !sc->time_base.den;
+    skip_bits_long(&gb, 1 + 32 + 32 + 32);
+    sc->lastindex = nb_frames;
+
+    for (i = 0; i < nb_segments; i++) {
+        uint32_t first, last;
+
+        cs = &sc->coarsesiglist[i];
+        first = get_bits_long(&gb, 32); /* StartFrameOfSegment */
+        last  = get_bits_long(&gb, 32); /* EndFrameOfSegment */
+        if (first > last || last >= nb_frames) {
+            ret = AVERROR_INVALIDDATA;
+            goto fail;
+        }
+        cs->first = &sc->finesiglist[first];
+        cs->last  = &sc->finesiglist[last];
+        cs->next  = i + 1 < nb_segments ? cs + 1 : NULL;
+        skip_bits_long(&gb, 1 + 32 + 32);
+        for (j = 0; j < 5; j++) {
+            for (int k = 0; k < 30; k++)
+                cs->data[j][k] = get_bits(&gb, 8);
+            cs->data[j][30] = get_bits(&gb, 3) << 5;
+        }
+    }
+    sc->coarseend = cs;
+
+    if (get_bits1(&gb)) { /* CompressionFlag */
+        ret = AVERROR_PATCHWELCOME;
+        goto fail;
+    }
+    for (i = 0; i < nb_frames; i++) {
+        fs = &sc->finesiglist[i];
+        fs->prev  = i ? fs - 1 : NULL;
+        fs->next  = i + 1 < nb_frames ? fs + 1 : NULL;
+        fs->index = i;
+        skip_bits1(&gb);
+        fs->pts = get_bits_long(&gb, 32); /* MediaTimeOfFrame */
+        fs->confidence = get_bits(&gb, 8); /* FrameConfidence */
+        for (j = 0; j < 5; j++)
+            fs->words[j] = get_bits(&gb, 8);
+        for (j = 0; j < SIGELEM_SIZE/5; j++)
+            fs->framesig[j] = get_bits(&gb, 8);
+    }
+    sc->curfinesig = fs;
+
+    av_free(buf);
+    return 0;
+fail:
+    av_freep(&sc->finesiglist);
+    av_freep(&sc->coarsesiglist);
+    av_free(buf);
+    return ret;
+}
+
+/**
+ * Map the index of stored signatures, which is a concatenation of binary
+ * signatures, and locate its entries.
+ */
+static int load_index(AVFilterContext *ctx)
+{
+    SignatureContext *sic = ctx->priv;
+    size_t pos = 0;
+    int ret;
+
+    ret = av_file_map(sic->index, &sic->index_buf, &sic->index_size, 0, ctx);
+    if (ret < 0)
+        return ret;
+
+    while (pos < sic->index_size) {
+        uint32_t nb_frames, nb_segments;
+        size_t size = binary_size(sic->index_buf + pos, sic->index_size - pos,
+                                  &nb_frames, &nb_segments);
+        size_t *offsets;
+
+        if (!size) {
+            av_log(ctx, AV_LOG_ERROR, "Invalid signature at offset %zu of index %s\n",
+                   pos, sic->index);
+            return AVERROR_INVALIDDATA;
+        }
+        offsets = av_realloc_array(sic->index_offsets, sic->nb_index_entries + 2,
+                                   sizeof(*offsets));
+        if (!offsets)
+            return AVERROR(ENOMEM);
+        sic->index_offsets = offsets;
+        offsets[sic->nb_index_entries++] = pos;
+        pos += size;
+        offsets[sic->nb_index_entries] = pos;
+    }
+
+    av_log(ctx, AV_LOG_VERBOSE, "%d signatures in index %s\n",
+           sic->nb_index_entries, sic->index);
+    return 0;
+}
+
+/* lookup of an input against another input or against an index entry */
+typedef struct LookupTask {
+    int first;          /* the input */
+    int second;         /* the other input, or -1 for an index entry */
+    int entry;          /* the index entry */
+    int err;
+    MatchingInfo match;
+    double first_time;  /* time of the first matching frames */
+    double second_time;
+    AVBPrint log;       /* stages of the lookup, printed at debug level */
+} LookupTask;
+
+typedef struct LookupThreadData {
+    LookupTask *tasks;
+    int nb_tasks;
+    int debug;
+} LookupThreadData;
+
+static void run_task(AVFilterContext *ctx, LookupTask *t, int debug)
+{
+    SignatureContext *sic = ctx->priv;
+    StreamContext *sc = &sic->streamcontexts[t->first];
+    StreamContext stored = { 0 }, *sc2 = &stored;
+
+    if (t->second >= 0) {
+        sc2 = &sic->streamcontexts[t->second];
+    } else {
+        const size_t start = sic->index_offsets[t->entry];
+        t->err = binary_import(sc2, sic->index_buf + start,
+                               sic->index_offsets[t->entry + 1] - start);
+        if (t->err < 0)
+            return;
+    }
+
+    t->match = lookup_signatures(ctx, sic, sc, sc2, sic->mode, debug ? &t->log : NULL);
+    if (t->match.score != 0) {
+        t->first_time  = (double)t->match.first->pts  * av_q2d(sc->time_base);
+        t->second_time = (double)t->match.second->pts * av_q2d(sc2->time_base);
+    }
+    /* the matching frames of a stored signature are freed below */
+    t->match.first = t->match.second = NULL;
+
+    av_freep(&stored.finesiglist);
+    av_freep(&stored.coarsesiglist);
+}
+
+static int lookup_tasks(AVFilterContext *ctx, void *arg, int jobnr, int nb_jobs)
+{
+    LookupThreadData *td = arg;
+    const int start = (td->nb_tasks *  jobnr   ) / nb_jobs;
+    const int end   = (td->nb_tasks * (jobnr+1)) / nb_jobs;
+
+    for (int n = start; n < end; n++)
+        run_task(ctx, &td->tasks[n], td->debug);
+    return 0;
+}
+
+/**
+ * Match every pair of inputs and every input against every entry of the
+ * index. The lookups are independent of each other, so they are spread over
+ * the filter threads; the results are logged afterwards, in order.
+ */
+static int lookup_all(AVFilterContext *ctx)
+{
+    SignatureContext *sic = ctx->priv;
+    LookupThreadData td;
+    int i, j, n;
+
+    td.nb_tasks = sic->nb_inputs * (sic->nb_inputs - 1) / 2 +
+                  sic->nb_inputs * sic->nb_index_entries;
+    td.tasks    = av_calloc(td.nb_tasks, sizeof(*td.tasks));
+    if (!td.tasks)
+        return AVERROR(ENOMEM);
+    td.debug    = av_log_get_level() >= AV_LOG_DEBUG;
+
+    for (i = 0, n = 0; i < sic->nb_inputs; i++) {
+        for (j = i+1; j < sic->nb_inputs; j++, n++) {
+            av_bprint_init(&td.tasks[n].log, 0, AV_BPRINT_SIZE_UNLIMITED);
+            td.tasks[n].first  = i;
+            td.tasks[n].second = j;
+        }
+        for (j = 0; j < sic->nb_index_entries; j++, n++) {
+            av_bprint_init(&td.tasks[n].log, 0, AV_BPRINT_SIZE_UNLIMITED);
+            td.tasks[n].first  = i;
+            td.tasks[n].second = -1;
+            td.tasks[n].entry  = j;
+        }
+    }
+
+    ff_filter_execute(ctx, lookup_tasks, &td, NULL,
+                      FFMIN(td.nb_tasks, ff_filter_get_nb_threads(ctx)));
+
+    for (n = 0; n < td.nb_tasks; n++) {
+        LookupTask *t = &td.tasks[n];
+        char second[64];
+
+        for (const char *line = t->log.str; *line; ) {
+            const size_t len = strcspn(line, "\n");
+            av_log(ctx, AV_LOG_DEBUG, "%.*s\n", (int)len, line);
+            line += len + !!line[len];
+        }
+        av_bprint_finalize(&t->log, NULL);
+
+        if (t->second >= 0)
+            snprintf(second, sizeof(second), "%d", t->second);
+        else
+            snprintf(second, sizeof(second), "index entry %d", t->entry);
+
+        if (t->err < 0) {
+            av_log(ctx, AV_LOG_ERROR, "cannot read %s: %s\n", second, av_err2str(t->err));
+        } else if (t->match.score != 0) {
+            av_log(ctx, AV_LOG_INFO, "matching of video %d at %f and %s at %f, %d frames matching\n",
+                    t->first, t->first_time, second, t->second_time, t->match.matchframes);
+            if (t->match.whole)
+                av_log(ctx, AV_LOG_INFO, "whole video matching\n");
+        } else {
+            av_log(ctx, t->second >= 0 ? AV_LOG_INFO : AV_LOG_VERBOSE,
+                   "no matching of video %d and %s\n", t->first, second);
+        }
+    }
+
+    av_freep(&td.tasks);
+    return 0;
+}
+
 static int request_frame(AVFilterLink *outlink)
 {
     AVFilterContext *ctx = outlink->src;
     SignatureContext *sic = ctx->priv;
-    StreamContext *sc, *sc2;
-    MatchingInfo match;
-    int i, j, ret;
+    StreamContext *sc;
+    int i, ret;
     int lookup = 1; /* indicates whether EOF of all files is reached */
 
     /* process all inputs */
@@ -606,25 +935,10 @@ static int request_frame(AVFilterLink *outlink)
     }
 
     /* signature lookup */
-    if (lookup && sic->mode != MODE_OFF) {
-        /* iterate over every pair */
-        for (i = 0; i < sic->nb_inputs; i++) {
-            sc = &(sic->streamcontexts[i]);
-            for (j = i+1; j < sic->nb_inputs; j++) {
-                sc2 = &(sic->streamcontexts[j]);
-                match = lookup_signatures(ctx, sic, sc, sc2, sic->mode);
-                if (match.score != 0) {
-                    av_log(ctx, AV_LOG_INFO, "matching of video %d at %f and %d at %f, %d frames matching\n",
-                            i, ((double) match.first->pts * sc->time_base.num) / sc->time_base.den,
-                            j, ((double) match.second->pts * sc2->time_base.num) / sc2->time_base.den,
-                            match.matchframes);
-                    if (match.whole)
-                        av_log(ctx, AV_LOG_INFO, "whole video matching\n");
-                } else {
-                    av_log(ctx, AV_LOG_INFO, "no matching of video %d and %d\n", i, j);
-                }
-            }
-        }
+    if (lookup && sic->mode != MODE_OFF && (sic->nb_inputs > 1 || sic->nb_index_entries)) {
+        int err = lookup_all(ctx);
+        if (err < 0)
+            return err;
     }
 
     return ret;
@@ -672,12 +986,18 @@ static av_cold int init(AVFilterContext *ctx)
         sc->midcoarse = 0;
     }
 
+    /* shared read-only by all lookup jobs */
+    fill_l1distlut(sic->l1distlut);
+
     /* check filename */
     if (sic->nb_inputs > 1 && strlen(sic->filename) > 0 && av_get_frame_filename(tmp, sizeof(tmp), sic->filename, 0) == -1) {
         av_log(ctx, AV_LOG_ERROR, "The filename must contain %%d or %%0nd, if you have more than one input.\n");
         return AVERROR(EINVAL);
     }
 
+    if (sic->index && (ret = load_index(ctx)) < 0)
+        return ret;
+
     return 0;
 }
 
@@ -713,9 +1033,14 @@ static av_cold void uninit(AVFilterContext *ctx)
                 av_freep(&tmp);
             }
             sc->coarsesiglist = NULL;
+            av_freep(&sc->intjlut);
         }
         av_freep(&sic->streamcontexts);
     }
+
+    if (sic->index_buf)
+        av_file_unmap(sic->index_buf, sic->index_size);
+    av_freep(&sic->index_offsets);
 }
 
 static int config_output(AVFilterLink *outlink)
@@ -748,7 +1073,7 @@ const FFFilter ff_vf_signature = {
     .p.description = NULL_IF_CONFIG_SMALL("Calculate the MPEG-7 video signature"),
     .p.priv_class  = &signature_class,
     .p.inputs      = NULL,
-    .p.flags       = AVFILTER_FLAG_DYNAMIC_INPUTS,
+    .p.flags       = AVFILTER_FLAG_DYNAMIC_INPUTS | AVFILTER_FLAG_SLICE_THREADS,
     .priv_size     = sizeof(SignatureContext),
     .init          = init,
     .uninit        = uninit,
@@ -0,0 +1,77 @@
+;*****************************************************************************
+;* x86-optimized functions for the drawing utilities
+;*
+;* This file is part of FFmpeg.
+;*
+;* FFmpeg is free software; you can redistribute it and/or
+;* modify it under the terms of the GNU Lesser General Public
+;* License as published by the Free Software Foundation; either
+;* version 2.1 of the License, or (at your option) any later version.
+;*
+;* FFmpeg is distributed in the hope that it will be useful,
+;* but WITHOUT ANY WARRANTY; without even the implied warranty of
+;* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+;* Lesser General Public License for more details.
+;*
+;* You should have received a copy of the GNU Lesser General Public
+;* License along with FFmpeg; if not, write to the Free Software
+;* Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+;*****************************************************************************
+
+%include "libavutil/x86/x86util.asm"
+
+SECTION_RODATA 32
+
+pd_0x1010101: times 8 dd 0x1010101
+
+SECTION .text
+
+;------------------------------------------------------------------------------
+; void ff_blend_mask_line(uint8_t *dst, const uint8_t *mask, intptr_t w,
+;                         unsigned src, unsigned alpha)
+;
+; dst = ((0x1010101 - a) * dst + a * src) >> 24 with a = mask * alpha, computed
+; as (dst * 0x1010101 + a * (src - dst)) >> 24, whose 32-bit result is exact.
+; w must be a multiple of mmsize / 4.
+;------------------------------------------------------------------------------
+%macro BLEND_MASK_LINE 0
+cglobal blend_mask_line, 5, 5, 6, dst, mask, w, src, alpha
+    movd         xm3, srcd
+    movd         xm4, alphad
+    VPBROADCASTD  m3, xm3
+    VPBROADCASTD  m4, xm4
+    mova          m5, [pd_0x1010101]
+    add         dstq, wq
+    add        maskq, wq
+    neg           wq
+.loop:
+    pmovzxbd      m0, [maskq + wq]
+    pmovzxbd      m1, [dstq + wq]
+    pmulld        m0, m4
+    psubd         m2, m3, m1
+    pmulld        m1, m5
+    pmulld        m2, m0
+    paddd         m1, m2
+    psrld         m1, 24
+%if mmsize == 32
+    vextracti128 xm0, m1, 1
+    packusdw     xm1, xm0
+    packuswb     xm1, xm1
+    movq  [dstq + wq], xm1
+%else
+    packusdw      m1, m1
+    packuswb      m1, m1
+    movd  [dstq + wq], m1
+%endif
+    add           wq, mmsize / 4
+    jl .loop
+    RET
+%endmacro
+
+INIT_XMM sse4
+BLEND_MASK_LINE
+
+%if HAVE_AVX2_EXTERNAL
+INIT_YMM avx2
+BLEND_MASK_LINE
+%endif
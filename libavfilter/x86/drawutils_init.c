@@ -0,0 +1,54 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include <stdint.h>
+
+#include "libavutil/attributes.h"
+#include "libavutil/cpu.h"
+#include "libavutil/x86/cpu.h"
+#include "libavfilter/drawutils.h"
+
+#define BLEND_MASK_LINE_FUNC(FUNC_NAME, ASM_FUNC_NAME, STEP)                  \
+void ASM_FUNC_NAME(uint8_t *dst, const uint8_t *mask, intptr_t w,             \
+                   unsigned src, unsigned alpha);                             \
+                                                                              \
+static void FUNC_NAME(uint8_t *dst, const uint8_t *mask, int w,               \
+                      unsigned src, unsigned alpha)                           \
+{                                                                             \
+    const int aw = w & ~(STEP - 1);                                           \
+    if (aw)                                                                   \
+        ASM_FUNC_NAME(dst, mask, aw, src, alpha);                             \
+    ff_blend_mask_line_c(dst + aw, mask + aw, w - aw, src, alpha);            \
+}
+
+BLEND_MASK_LINE_FUNC(blend_mask_line_sse4, ff_blend_mask_line_sse4, 4)
+#if HAVE_AVX2_EXTERNAL
+BLEND_MASK_LINE_FUNC(blend_mask_line_avx2, ff_blend_mask_line_avx2, 8)
+#endif
+
+av_cold void ff_draw_init_x86(FFDrawContext *draw)
+{
+    int cpu_flags = av_get_cpu_flags();
+
+    if (EXTERNAL_SSE4(cpu_flags))
+        draw->blend_mask_line = blend_mask_line_sse4;
+#if HAVE_AVX2_EXTERNAL
+    if (EXTERNAL_AVX2_FAST(cpu_flags))
+        draw->blend_mask_line = blend_mask_line_avx2;
+#endif
+}
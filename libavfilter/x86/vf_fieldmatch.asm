@@ -0,0 +1,141 @@
+;*****************************************************************************
+;* x86-optimized functions for fieldmatch filter
+;*
+;* This file is part of FFmpeg.
+;*
+;* FFmpeg is free software; you can redistribute it and/or
+;* modify it under the terms of the GNU Lesser General Public
+;* License as published by the Free Software Foundation; either
+;* version 2.1 of the License, or (at your option) any later version.
+;*
+;* FFmpeg is distributed in the hope that it will be useful,
+;* but WITHOUT ANY WARRANTY; without even the implied warranty of
+;* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+;* Lesser General Public License for more details.
+;*
+;* You should have received a copy of the GNU Lesser General Public
+;* License along with FFmpeg; if not, write to the Free Software
+;* Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+;*****************************************************************************
+
+%include "libavutil/x86/x86util.asm"
+
+SECTION .text
+
+;------------------------------------------------------------------------------
+; void ff_fieldmatch_abs_diff_line(uint8_t *dst, const uint8_t *a,
+;                                  const uint8_t *b, ptrdiff_t width)
+;------------------------------------------------------------------------------
+
+%macro ABS_DIFF_LINE 0
+cglobal fieldmatch_abs_diff_line, 4, 4, 3, dst, a, b, width
+    add        dstq, widthq
+    add          aq, widthq
+    add          bq, widthq
+    neg      widthq
+.loop:
+    movu         m0, [aq + widthq]
+    movu         m1, [bq + widthq]
+    psubusb      m2, m0, m1
+    psubusb      m1, m0
+    por          m2, m1
+    movu [dstq + widthq], m2
+    add      widthq, mmsize
+    jl .loop
+    RET
+%endmacro
+
+INIT_XMM sse2
+ABS_DIFF_LINE
+
+%if HAVE_AVX2_EXTERNAL
+INIT_YMM avx2
+ABS_DIFF_LINE
+%endif
+
+%if ARCH_X86_64
+
+;------------------------------------------------------------------------------
+; void ff_fieldmatch_comb_line(uint8_t *dst, const uint8_t *srcpp,
+;                              const uint8_t *srcp, const uint8_t *src,
+;                              const uint8_t *srcn, const uint8_t *srcnn,
+;                              ptrdiff_t width, int cthresh)
+;------------------------------------------------------------------------------
+
+; %1 = dst, %2 = unpack suffix
+; computes |4*c - 3*(p + n) + pp + nn| > 6*cthresh on one half of the words
+%macro COMB_FILTER_HALF 2
+    punpck%2     %1, m3, m2          ; c
+    psllw        %1, 2
+    punpck%2     m8, m4, m2          ; p
+    punpck%2     m9, m5, m2          ; n
+    paddw        m8, m9
+    psubw        %1, m8
+    psubw        %1, m8
+    psubw        %1, m8
+    punpck%2     m8, m10, m2         ; pp
+    punpck%2     m9, m11, m2         ; nn
+    paddw        %1, m8
+    paddw        %1, m9
+    ABS1         %1, m8
+    pcmpgtw      %1, m1
+%endmacro
+
+%macro COMB_LINE 0
+cglobal fieldmatch_comb_line, 8, 9, 13, dst, srcpp, srcp, src, srcn, srcnn, width, thresh, idx
+    lea        idxd, [threshq * 3]
+    add        idxd, idxd
+    imul       idxd, 0x00010001
+    movd        xm1, idxd
+    imul    threshd, 0x01010101
+    movd        xm0, threshd
+%if cpuflag(avx2)
+    vpbroadcastd m0, xm0
+    vpbroadcastd m1, xm1
+%else
+    pshufd       m0, m0, 0
+    pshufd       m1, m1, 0
+%endif
+    pxor         m2, m2
+    xor        idxq, idxq
+.loop:
+    movu         m3, [srcq  + idxq]
+    movu         m4, [srcpq + idxq]
+    movu         m5, [srcnq + idxq]
+    movu        m10, [srcppq + idxq]
+    movu        m11, [srcnnq + idxq]
+
+    ; reject the pixels with |c - p| <= cthresh or |c - n| <= cthresh
+    psubusb      m6, m3, m4
+    psubusb      m7, m4, m3
+    por          m6, m7
+    psubusb      m6, m0
+    pcmpeqb      m6, m2
+    psubusb      m7, m3, m5
+    psubusb      m8, m5, m3
+    por          m7, m8
+    psubusb      m7, m0
+    pcmpeqb      m7, m2
+    por          m6, m7
+
+    COMB_FILTER_HALF m12, lbw
+    COMB_FILTER_HALF  m7, hbw
+    packsswb    m12, m7
+    pandn        m6, m12
+    movu  [dstq + idxq], m6
+
+    add        idxq, mmsize
+    cmp        idxq, widthq
+    jl .loop
+    RET
+%endmacro
+
+INIT_XMM sse2
+COMB_LINE
+
+%if HAVE_AVX2_EXTERNAL
+INIT_YMM avx2
+COMB_LINE
+%endif
+
+%endif ; ARCH_X86_64
@@ -0,0 +1,87 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include "libavutil/attributes.h"
+#include "libavutil/cpu.h"
+#include "libavutil/x86/cpu.h"
+#include "libavfilter/vf_fieldmatch.h"
+
+/* the asm functions only handle multiples of SPAN pixels, the C code does the rest */
+#define ABS_DIFF_LINE_DECL(KIND, SPAN)                                              \
+void ff_fieldmatch_abs_diff_line_##KIND(uint8_t *dst, const uint8_t *a,             \
+                                        const uint8_t *b, ptrdiff_t width);         \
+static void fieldmatch_abs_diff_line_##KIND(uint8_t *dst, const uint8_t *a,         \
+                                            const uint8_t *b, ptrdiff_t width)      \
+{                                                                                   \
+    const ptrdiff_t w = width & ~(ptrdiff_t)(SPAN - 1);                             \
+    if (w > 0)                                                                      \
+        ff_fieldmatch_abs_diff_line_##KIND(dst, a, b, w);                           \
+    if (width > w)                                                                  \
+        fieldmatch_abs_diff_line_c(dst + w, a + w, b + w, width - w);               \
+}
+
+#define COMB_LINE_DECL(KIND, SPAN)                                                  \
+void ff_fieldmatch_comb_line_##KIND(uint8_t *dst, const uint8_t *srcpp,             \
+                                    const uint8_t *srcp, const uint8_t *src,        \
+                                    const uint8_t *srcn, const uint8_t *srcnn,      \
+                                    ptrdiff_t width, int cthresh);                  \
+static void fieldmatch_comb_line_##KIND(uint8_t *dst, const uint8_t *srcpp,         \
+                                        const uint8_t *srcp, const uint8_t *src,    \
+                                        const uint8_t *srcn, const uint8_t *srcnn,  \
+                                        ptrdiff_t width, int cthresh)               \
+{                                                                                   \
+    const ptrdiff_t w = width & ~(ptrdiff_t)(SPAN - 1);                             \
+    if (w > 0)                                                                      \
+        ff_fieldmatch_comb_line_##KIND(dst, srcpp, srcp, src, srcn, srcnn,          \
+                                       w, cthresh);                                 \
+    if (width > w)                                                                  \
+        fieldmatch_comb_line_c(dst + w, srcpp + w, srcp + w, src + w,               \
+                               srcn + w, srcnn + w, width - w, cthresh);            \
+}
+
+ABS_DIFF_LINE_DECL(sse2, 16)
+#if HAVE_AVX2_EXTERNAL
+ABS_DIFF_LINE_DECL(avx2, 32)
+#endif
+
+#if ARCH_X86_64
+COMB_LINE_DECL(sse2, 16)
+#if HAVE_AVX2_EXTERNAL
+COMB_LINE_DECL(avx2, 32)
+#endif
+#endif
+
+av_cold void ff_fieldmatch_dsp_init_x86(FieldMatchDSPContext *dsp)
+{
+    const int cpu_flags = av_get_cpu_flags();
+
+    if (EXTERNAL_SSE2(cpu_flags)) {
+        dsp->abs_diff_line = fieldmatch_abs_diff_line_sse2;
+#if ARCH_X86_64
+        dsp->comb_line     = fieldmatch_comb_line_sse2;
+#endif
+    }
+#if HAVE_AVX2_EXTERNAL
+    if (EXTERNAL_AVX2_FAST(cpu_flags)) {
+        dsp->abs_diff_line = fieldmatch_abs_diff_line_avx2;
+#if ARCH_X86_64
+        dsp->comb_line     = fieldmatch_comb_line_avx2;
+#endif
+    }
+#endif
+}
@@ -115,6 +115,41 @@ URLContext *ffio_geturlcontext(AVIOContext *s)
         return NULL;
 }
 
+int ffio_read_mapped(AVIOContext *s, int size, AVBufferRef **pbuf)
+{
+    URLContext *h = ffio_geturlcontext(s);
+    AVBufferRef *buf;
+    int64_t pos, ret;
+
+    if (!h || s->write_flag || s->update_checksum || size <= 0)
+        return AVERROR(ENOSYS);
+
+    pos = avio_tell(s);
+    if (pos < 0)
+        return AVERROR(ENOSYS);
+
+    ret = ffurl_get_mapping(h, &buf);
+    if (ret < 0)
+        return ret;
+
+    if ((uint64_t)pos + size + AV_INPUT_BUFFER_PADDING_SIZE > buf->size) {
+        av_buffer_unref(&buf);
+        return AVERROR(ENOSYS);
+    }
+
+    ret = avio_skip(s, size);
+    if (ret < 0) {
+        av_buffer_unref(&buf);
+        return ret;
+    }
+
+    buf->data += pos;
+    buf->size  = size;
+    *pbuf = buf;
+
+    return size;
+}
+
 static int url_alloc_for_protocol(URLContext **puc, const URLProtocol *up,
                                   const char *filename, int flags,
                                   const AVIOInterruptCB *int_cb)
@@ -845,6 +880,13 @@ int ffurl_get_short_seek(void *urlcontext)
     return h->prot->url_get_short_seek(h);
 }
 
+int ffurl_get_mapping(URLContext *h, AVBufferRef **buf)
+{
+    if (!h || !h->prot || !h->prot->url_get_mapping)
+        return AVERROR(ENOSYS);
+    return h->prot->url_get_mapping(h, buf);
+}
+
 int ffurl_shutdown(URLContext *h, int flags)
 {
     if (!h || !h->prot || !h->prot->url_shutdown)
@@ -21,6 +21,7 @@
 
 #include "avio.h"
 
+#include "libavutil/buffer.h"
 #include "libavutil/log.h"
 
 extern const AVClass ff_avio_class;
@@ -119,6 +120,20 @@ void ffio_init_write_context(FFIOContext *s, uint8_t *buffer, int buffer_size);
  */
 int ffio_read_indirect(AVIOContext *s, unsigned char *buf, int size, const unsigned char **data);
 
+/**
+ * Read size bytes without copying them, by referencing the memory mapping
+ * of the underlying protocol (e.g. the file protocol with the mmap option).
+ * The mapping is read-only and at least AV_INPUT_BUFFER_PADDING_SIZE
+ * readable bytes follow the returned data, but they are not zeroed.
+ *
+ * @param buf set to a new reference with data and size describing the
+ *            requested bytes on success
+ * @return size on success, AVERROR(ENOSYS) if the data is not available
+ *         in a mapping, in which case nothing was read, or another
+ *         negative error code
+ */
+int ffio_read_mapped(AVIOContext *s, int size, AVBufferRef **buf);
+
 void ffio_fill(AVIOContext *s, int b, int64_t count);
 
 static av_always_inline void ffio_wfourcc(AVIOContext *pb, const uint8_t *s)
@@ -378,6 +378,14 @@ int ff_generate_avci_extradata(AVStream *st);
  */
 int ff_get_extradata(void *logctx, AVCodecParameters *par, AVIOContext *pb, int size);
 
+/**
+ * Like av_get_packet(), but reference the data in place instead of copying
+ * it if pb is backed by a memory mapping (see ffio_read_mapped()).
+ * The packet data is then read-only and its padding is not zeroed, so this
+ * must only be used if the demuxer does not modify the data in place.
+ */
+int ff_get_packet_mapped(AVIOContext *pb, AVPacket *pkt, int size);
+
 /**
  * Find stream index based on format-specific stream ID
  * @return stream index, or < 0 on error
@@ -353,6 +353,27 @@ int ff_get_extradata(void *logctx, AVCodecParameters *par, AVIOContext *pb, int
     return ret;
 }
 
+int ff_get_packet_mapped(AVIOContext *pb, AVPacket *pkt, int size)
+{
+    int64_t pos = avio_tell(pb);
+    AVBufferRef *buf;
+    int ret;
+
+    ret = ffio_read_mapped(pb, size, &buf);
+    if (ret == AVERROR(ENOSYS))
+        return av_get_packet(pb, pkt, size);
+    if (ret < 0)
+        return ret;
+
+    av_packet_unref(pkt);
+    pkt->buf  = buf;
+    pkt->data = buf->data;
+    pkt->size = buf->size;
+    pkt->pos  = pos;
+
+    return pkt->size;
+}
+
 int ff_find_stream_index(const AVFormatContext *s, int id)
 {
     for (unsigned i = 0; i < s->nb_streams; i++)
@@ -19,6 +19,11 @@
  * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
  */
 
+/* for syscall() and MAP_POPULATE */
+#ifndef _GNU_SOURCE
+# define _GNU_SOURCE
+#endif
+
 #include "config_components.h"
 
 #include "libavutil/avstring.h"
@@ -42,6 +47,23 @@
 #include "os_support.h"
 #include "url.h"
 
+#if HAVE_MMAP
+#include <sys/mman.h>
+#endif
+
+#if HAVE_LINUX_IO_URING_H
+#include <stdatomic.h>
+#include <linux/io_uring.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#endif
+
+#if CONFIG_FILE_PROTOCOL && HAVE_MMAP && HAVE_LINUX_IO_URING_H && defined(__NR_io_uring_setup) && defined(__NR_io_uring_enter)
+#define FILE_URING 1
+#else
+#define FILE_URING 0
+#endif
+
 /* Some systems may not have S_ISFIFO */
 #ifndef S_ISFIFO
 #  ifdef S_IFIFO
@@ -97,6 +119,15 @@ typedef struct FileContext {
     int pkt_size;
     int follow;
     int seekable;
+    int io_uring;
+    int uring_depth;
+    int uring_block_size;
+    int mmap;
+    AVBufferRef *map;
+    int64_t map_pos;
+#if FILE_URING
+    struct FileURing *uring;
+#endif
 #if HAVE_DIRENT_H
     DIR *dir;
 #endif
@@ -108,6 +139,10 @@ static const AVOption file_options[] = {
     { "follow", "Follow a file as it is being written", offsetof(FileContext, follow), AV_OPT_TYPE_INT, { .i64 = 0 }, 0, 1, AV_OPT_FLAG_DECODING_PARAM },
     { "seekable", "Sets if the file is seekable", offsetof(FileContext, seekable), AV_OPT_TYPE_INT, { .i64 = -1 }, -1, 0, AV_OPT_FLAG_DECODING_PARAM | AV_OPT_FLAG_ENCODING_PARAM },
     { "pkt_size", "Maximum packet size", offsetof(FileContext, pkt_size), AV_OPT_TYPE_INT, { .i64 = 0 }, 0, INT_MAX, AV_OPT_FLAG_DECODING_PARAM | AV_OPT_FLAG_ENCODING_PARAM },
+    { "mmap", "Map the file into memory, allowing demuxers to avoid copying packet data", offsetof(FileContext, mmap), AV_OPT_TYPE_BOOL, { .i64 = 0 }, 0, 1, AV_OPT_FLAG_DECODING_PARAM },
+    { "io_uring", "Use io_uring for asynchronous I/O if available", offsetof(FileContext, io_uring), AV_OPT_TYPE_BOOL, { .i64 = 0 }, 0, 1, AV_OPT_FLAG_DECODING_PARAM | AV_OPT_FLAG_ENCODING_PARAM },
+    { "uring_depth", "Number of io_uring requests kept in flight", offsetof(FileContext, uring_depth), AV_OPT_TYPE_INT, { .i64 = 8 }, 1, 256, AV_OPT_FLAG_DECODING_PARAM | AV_OPT_FLAG_ENCODING_PARAM },
+    { "uring_block_size", "Size of each io_uring request", offsetof(FileContext, uring_block_size), AV_OPT_TYPE_INT, { .i64 = 262144 }, 4096, 64 << 20, AV_OPT_FLAG_DECODING_PARAM | AV_OPT_FLAG_ENCODING_PARAM },
     { NULL }
 };
 
@@ -138,11 +173,472 @@ static const AVClass fd_class = {
     .version    = LIBAVUTIL_VERSION_INT,
 };
 
+#if FILE_URING
+/*
+ * Asynchronous I/O using io_uring. Reads keep up to nb_reqs blocks in flight
+ * ahead of the read position, writes are gathered into blocks which are
+ * submitted without waiting for the previous ones to finish. The raw system
+ * calls are used, so that no library besides libc is needed.
+ */
+
+typedef struct URingRequest {
+    uint8_t     *buf;
+    struct iovec iov;
+    int64_t      pos;
+    int          size;
+    int          consumed;
+    int          result;
+    int          pending;
+} URingRequest;
+
+typedef struct FileURing {
+    int fd;
+
+    void    *sq_ptr, *cq_ptr;
+    size_t   sq_size, cq_size;
+    unsigned *sq_head, *sq_tail, *sq_mask, *sq_array;
+    unsigned *cq_head, *cq_tail, *cq_mask;
+    struct io_uring_sqe *sqes;
+    size_t   sqes_size;
+    struct io_uring_cqe *cqes;
+    unsigned to_submit;
+
+    URingRequest *reqs;
+    uint8_t      *buf;
+    int nb_reqs;
+    int block_size;
+    int write;
+
+    /* index of the oldest request, and number of requests submitted */
+    int head;
+    int nb_inflight;
+
+    /* position of the next byte returned to or accepted from the caller */
+    int64_t pos;
+    /* file offset of the next block to be submitted when reading */
+    int64_t submit_pos;
+    /* bytes gathered for the next write request */
+    int fill;
+    int err;
+} FileURing;
+
+static int uring_enter(FileURing *r, unsigned min_complete)
+{
+    unsigned flags = min_complete ? IORING_ENTER_GETEVENTS : 0;
+
+    while (r->to_submit || min_complete) {
+        int ret = syscall(__NR_io_uring_enter, r->fd, r->to_submit,
+                          min_complete, flags, NULL, 0);
+        if (ret < 0) {
+            if (errno == EINTR)
+                continue;
+            /* the kernel is out of resources, the entries are submitted
+             * again along with the next wait for a completion */
+            if (!min_complete && (errno == EAGAIN || errno == EBUSY))
+                break;
+            return AVERROR(errno);
+        }
+        r->to_submit -= FFMIN(ret, r->to_submit);
+        /* nothing was consumed; same as above, rather than retrying forever */
+        if (min_complete || !ret)
+            break;
+    }
+    return 0;
+}
+
+static void uring_queue(FileURing *r, int fd, int idx, int opcode)
+{
+    URingRequest *req = &r->reqs[idx];
+    unsigned tail = *r->sq_tail;
+    unsigned slot = tail & *r->sq_mask;
+    struct io_uring_sqe *sqe = &r->sqes[slot];
+
+    req->iov.iov_base = req->buf;
+    req->iov.iov_len  = req->size;
+    req->pending      = 1;
+
+    memset(sqe, 0, sizeof(*sqe));
+    sqe->opcode    = opcode;
+    sqe->fd        = fd;
+    sqe->addr      = (uintptr_t)&req->iov;
+    sqe->len       = 1;
+    sqe->off       = req->pos;
+    sqe->user_data = idx;
+
+    r->sq_array[slot] = slot;
+    atomic_store_explicit((atomic_uint *)r->sq_tail, tail + 1, memory_order_release);
+    r->to_submit++;
+}
+
+static void uring_reap(FileURing *r)
+{
+    unsigned head = *r->cq_head;
+    unsigned tail = atomic_load_explicit((atomic_uint *)r->cq_tail, memory_order_acquire);
+
+    for (; head != tail; head++) {
+        const struct io_uring_cqe *cqe = &r->cqes[head & *r->cq_mask];
+        URingRequest *req = &r->reqs[cqe->user_data];
+
+        req->result  = cqe->res;
+        req->pending = 0;
+    }
+    atomic_store_explicit((atomic_uint *)r->cq_head, head, memory_order_release);
+}
+
+static int uring_wait(FileURing *r, URingRequest *req)
+{
+    while (1) {
+        int ret;
+
+        uring_reap(r);
+        if (!req->pending)
+            return 0;
+
+        ret = uring_enter(r, 1);
+        if (ret < 0)
+            return ret;
+    }
+}
+
+static void uring_free(FileURing **pr)
+{
+    FileURing *r = *pr;
+
+    if (!r)
+        return;
+
+    if (r->sqes)
+        munmap(r->sqes, r->sqes_size);
+    if (r->cq_ptr)
+        munmap(r->cq_ptr, r->cq_size);
+    if (r->sq_ptr)
+        munmap(r->sq_ptr, r->sq_size);
+    if (r->fd >= 0)
+        close(r->fd);
+
+    av_freep(&r->buf);
+    av_freep(&r->reqs);
+    av_freep(pr);
+}
+
+static int uring_init(URLContext *h, int write)
+{
+    FileContext *c = h->priv_data;
+    struct io_uring_params p = { 0 };
+    FileURing *r;
+    void *ptr;
+    int ret;
+
+    r = av_mallocz(sizeof(*r));
+    if (!r)
+        return AVERROR(ENOMEM);
+    c->uring = r;
+
+    r->nb_reqs    = c->uring_depth;
+    r->block_size = c->uring_block_size;
+    r->write      = write;
+
+    r->fd = syscall(__NR_io_uring_setup, r->nb_reqs, &p);
+    if (r->fd < 0) {
+        ret = AVERROR(errno);
+        goto fail;
+    }
+
+    r->sq_size = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+    r->cq_size = p.cq_off.cqes  + p.cq_entries * sizeof(struct io_uring_cqe);
+    r->sqes_size = p.sq_entries * sizeof(struct io_uring_sqe);
+
+    ptr = mmap(NULL, r->sq_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+               r->fd, IORING_OFF_SQ_RING);
+    if (ptr == MAP_FAILED)
+        goto fail_errno;
+    r->sq_ptr = ptr;
+
+    ptr = mmap(NULL, r->cq_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+               r->fd, IORING_OFF_CQ_RING);
+    if (ptr == MAP_FAILED)
+        goto fail_errno;
+    r->cq_ptr = ptr;
+
+    ptr = mmap(NULL, r->sqes_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+               r->fd, IORING_OFF_SQES);
+    if (ptr == MAP_FAILED)
+        goto fail_errno;
+    r->sqes = ptr;
+
+    r->sq_head  = (unsigned *)((uint8_t *)r->sq_ptr + p.sq_off.head);
+    r->sq_tail  = (unsigned *)((uint8_t *)r->sq_ptr + p.sq_off.tail);
+    r->sq_mask  = (unsigned *)((uint8_t *)r->sq_ptr + p.sq_off.ring_mask);
+    r->sq_array = (unsigned *)((uint8_t *)r->sq_ptr + p.sq_off.array);
+    r->cq_head  = (unsigned *)((uint8_t *)r->cq_ptr + p.cq_off.head);
+    r->cq_tail  = (unsigned *)((uint8_t *)r->cq_ptr + p.cq_off.tail);
+    r->cq_mask  = (unsigned *)((uint8_t *)r->cq_ptr + p.cq_off.ring_mask);
+    r->cqes     = (struct io_uring_cqe *)((uint8_t *)r->cq_ptr + p.cq_off.cqes);
+
+    r->reqs = av_calloc(r->nb_reqs, sizeof(*r->reqs));
+    r->buf  = av_malloc_array(r->nb_reqs, r->block_size);
+    if (!r->reqs || !r->buf) {
+        ret = AVERROR(ENOMEM);
+        goto fail;
+    }
+    for (int i = 0; i < r->nb_reqs; i++)
+        r->reqs[i].buf = r->buf + (size_t)i * r->block_size;
+
+    return 0;
+fail_errno:
+    ret = AVERROR(errno);
+fail:
+    uring_free(&c->uring);
+    return ret;
+}
+
+/* wait for all reads in flight and restart reading ahead at r->pos */
+static int uring_read_reset(FileURing *r)
+{
+    int ret = 0;
+
+    for (; r->nb_inflight; r->nb_inflight--) {
+        int err = uring_wait(r, &r->reqs[r->head]);
+        if (err < 0)
+            ret = err;
+        r->head = (r->head + 1) % r->nb_reqs;
+    }
+    r->submit_pos = r->pos;
+
+    return ret;
+}
+
+static void uring_read_submit(FileURing *r, int fd)
+{
+    for (; r->nb_inflight < r->nb_reqs; r->nb_inflight++) {
+        int idx = (r->head + r->nb_inflight) % r->nb_reqs;
+        URingRequest *req = &r->reqs[idx];
+
+        req->pos      = r->submit_pos;
+        req->size     = r->block_size;
+        req->consumed = 0;
+        uring_queue(r, fd, idx, IORING_OP_READV);
+
+        r->submit_pos += r->block_size;
+    }
+}
+
+static int uring_read(URLContext *h, unsigned char *buf, int size)
+{
+    FileContext *c = h->priv_data;
+    FileURing   *r = c->uring;
+    URingRequest *req;
+    int ret, avail;
+
+    uring_read_submit(r, c->fd);
+
+    req = &r->reqs[r->head];
+    ret = uring_wait(r, req);
+    if (ret < 0)
+        return ret;
+
+    if (req->result < 0) {
+        ret = AVERROR(-req->result);
+        uring_read_reset(r);
+        return ret;
+    }
+
+    avail = req->result - req->consumed;
+    if (avail <= 0) {
+        /* end of file, read again from here if more data shows up */
+        ret = uring_read_reset(r);
+        if (ret < 0)
+            return ret;
+        return c->follow ? AVERROR(EAGAIN) : AVERROR_EOF;
+    }
+
+    size = FFMIN(size, avail);
+    memcpy(buf, req->buf + req->consumed, size);
+    req->consumed += size;
+    r->pos        += size;
+
+    if (req->consumed == req->result) {
+        if (req->result < req->size) {
+            /* short read, the blocks after this one start at the wrong offset */
+            ret = uring_read_reset(r);
+            if (ret < 0)
+                return ret;
+        } else {
+            r->head = (r->head + 1) % r->nb_reqs;
+            r->nb_inflight--;
+            uring_read_submit(r, c->fd);
+            ret = uring_enter(r, 0);
+            if (ret < 0)
+                return ret;
+        }
+    }
+
+    return size;
+}
+
+/* wait for the oldest write and complete it synchronously if it was short */
+static int uring_write_retire(FileURing *r, int fd)
+{
+    URingRequest *req = &r->reqs[r->head];
+    int ret = uring_wait(r, req);
+
+    r->head = (r->head + 1) % r->nb_reqs;
+    r->nb_inflight--;
+
+    if (ret < 0)
+        return ret;
+    if (req->result < 0)
+        return AVERROR(-req->result);
+
+    for (int done = req->result; done < req->size; ) {
+        ssize_t n = pwrite(fd, req->buf + done, req->size - done, req->pos + done);
+        if (n < 0) {
+            if (errno == EINTR)
+                continue;
+            return AVERROR(errno);
+        }
+        done += n;
+    }
+
+    return 0;
+}
+
+static int uring_write_submit(FileURing *r, int fd)
+{
+    int idx = (r->head + r->nb_inflight) % r->nb_reqs;
+    URingRequest *req = &r->reqs[idx];
+    int ret;
+
+    req->pos  = r->pos - r->fill;
+    req->size = r->fill;
+    uring_queue(r, fd, idx, IORING_OP_WRITEV);
+    r->nb_inflight++;
+    r->fill = 0;
+
+    ret = uring_enter(r, 0);
+    if (ret < 0)
+        return ret;
+
+    /* always keep a free block to gather data into */
+    if (r->nb_inflight == r->nb_reqs)
+        return uring_write_retire(r, fd);
+
+    return 0;
+}
+
+static int uring_write_flush(FileURing *r, int fd)
+{
+    int ret = 0;
+
+    if (r->fill)
+        ret = uring_write_submit(r, fd);
+
+    while (r->nb_inflight) {
+        int err = uring_write_retire(r, fd);
+        if (err < 0 && ret >= 0)
+            ret = err;
+    }
+
+    return ret;
+}
+
+static int uring_write(URLContext *h, const unsigned char *buf, int size)
+{
+    FileContext *c = h->priv_data;
+    FileURing   *r = c->uring;
+    uint8_t *dst;
+    int ret;
+
+    if (r->err < 0)
+        return r->err;
+
+    dst  = r->reqs[(r->head + r->nb_inflight) % r->nb_reqs].buf;
+    size = FFMIN(size, r->block_size - r->fill);
+    memcpy(dst + r->fill, buf, size);
+    r->fill += size;
+    r->pos  += size;
+
+    if (r->fill == r->block_size) {
+        ret = uring_write_submit(r, c->fd);
+        if (ret < 0) {
+            r->err = ret;
+            /* the data was accepted, the error is reported on the next call */
+        }
+    }
+
+    return size;
+}
+
+static int64_t uring_seek(URLContext *h, int64_t pos, int whence)
+{
+    FileContext *c = h->priv_data;
+    FileURing   *r = c->uring;
+    struct stat st;
+    int ret;
+
+    if (r->write) {
+        ret = uring_write_flush(r, c->fd);
+        if (ret < 0)
+            return ret;
+    }
+
+    if (whence == AVSEEK_SIZE || whence == SEEK_END) {
+        if (fstat(c->fd, &st) < 0)
+            return AVERROR(errno);
+        if (whence == AVSEEK_SIZE)
+            return S_ISFIFO(st.st_mode) ? 0 : st.st_size;
+        pos += st.st_size;
+    } else if (whence == SEEK_CUR) {
+        pos += r->pos;
+    } else if (whence != SEEK_SET) {
+        return AVERROR(EINVAL);
+    }
+    if (pos < 0)
+        return AVERROR(EINVAL);
+
+    if (!r->write && pos != r->pos) {
+        r->pos = pos;
+        ret = uring_read_reset(r);
+        if (ret < 0)
+            return ret;
+    }
+    r->pos = pos;
+
+    return pos;
+}
+
+static int uring_close(URLContext *h)
+{
+    FileContext *c = h->priv_data;
+    FileURing   *r = c->uring;
+    int ret;
+
+    ret = r->write ? uring_write_flush(r, c->fd) : uring_read_reset(r);
+    if (ret >= 0)
+        ret = r->err;
+    uring_free(&c->uring);
+
+    return ret;
+}
+#endif /* FILE_URING */
+
 static int file_read(URLContext *h, unsigned char *buf, int size)
 {
     FileContext *c = h->priv_data;
     int ret;
     size = FFMIN(size, c->blocksize);
+    if (c->map) {
+        if (c->map_pos >= c->map->size)
+            return AVERROR_EOF;
+        size = FFMIN(size, c->map->size - c->map_pos);
+        memcpy(buf, c->map->data + c->map_pos, size);
+        c->map_pos += size;
+        return size;
+    }
+#if FILE_URING
+    if (c->uring)
+        return uring_read(h, buf, size);
+#endif
     ret = read(c->fd, buf, size);
     if (ret == 0 && c->follow)
         return AVERROR(EAGAIN);
@@ -156,6 +652,10 @@ static int file_write(URLContext *h, const unsigned char *buf, int size)
     FileContext *c = h->priv_data;
     int ret;
     size = FFMIN(size, c->blocksize);
+#if FILE_URING
+    if (c->uring)
+        return uring_write(h, buf, size);
+#endif
     ret = write(c->fd, buf, size);
     return (ret == -1) ? AVERROR(errno) : ret;
 }
@@ -223,8 +723,15 @@ static int fd_dup(URLContext *h, int oldfd)
 static int file_close(URLContext *h)
 {
     FileContext *c = h->priv_data;
-    int ret = close(c->fd);
-    return (ret == -1) ? AVERROR(errno) : 0;
+    int ret = 0;
+    av_buffer_unref(&c->map);
+#if FILE_URING
+    if (c->uring)
+        ret = uring_close(h);
+#endif
+    if (close(c->fd) == -1 && ret >= 0)
+        ret = AVERROR(errno);
+    return ret;
 }
 
 /* XXX: use llseek */
@@ -233,6 +740,24 @@ static int64_t file_seek(URLContext *h, int64_t pos, int whence)
     FileContext *c = h->priv_data;
     int64_t ret;
 
+    if (c->map) {
+        if (whence == AVSEEK_SIZE)
+            return c->map->size;
+        if (whence == SEEK_CUR)
+            pos += c->map_pos;
+        else if (whence == SEEK_END)
+            pos += c->map->size;
+        else if (whence != SEEK_SET)
+            return AVERROR(EINVAL);
+        if (pos < 0)
+            return AVERROR(EINVAL);
+        return c->map_pos = pos;
+    }
+#if FILE_URING
+    if (c->uring)
+        return uring_seek(h, pos, whence);
+#endif
+
     if (whence == AVSEEK_SIZE) {
         struct stat st;
         ret = fstat(c->fd, &st);
@@ -282,6 +807,44 @@ static int file_move(URLContext *h_src, URLContext *h_dst)
     return 0;
 }
 
+#if HAVE_MMAP
+static void file_unmap(void *opaque, uint8_t *data)
+{
+    munmap(data, (uintptr_t)opaque);
+}
+
+/* the mapping is reference counted, so that packets can outlive the context */
+static int file_map(URLContext *h, size_t size)
+{
+    FileContext *c = h->priv_data;
+    void *ptr;
+
+    ptr = mmap(NULL, size, PROT_READ, MAP_SHARED, c->fd, 0);
+    if (ptr == MAP_FAILED)
+        return AVERROR(errno);
+
+    c->map = av_buffer_create(ptr, size, file_unmap, (void *)(uintptr_t)size,
+                              AV_BUFFER_FLAG_READONLY);
+    if (!c->map) {
+        munmap(ptr, size);
+        return AVERROR(ENOMEM);
+    }
+
+    return 0;
+}
+#endif
+
+static int file_get_mapping(URLContext *h, AVBufferRef **buf)
+{
+    FileContext *c = h->priv_data;
+
+    if (!c->map)
+        return AVERROR(ENOSYS);
+
+    *buf = av_buffer_ref(c->map);
+    return *buf ? 0 : AVERROR(ENOMEM);
+}
+
 static int file_open(URLContext *h, const char *filename, int flags)
 {
     FileContext *c = h->priv_data;
@@ -328,6 +891,45 @@ static int file_open(URLContext *h, const char *filename, int flags)
     if (c->seekable >= 0)
         h->is_streamed = !c->seekable;
 
+    if (c->mmap) {
+        if (flags & AVIO_FLAG_WRITE || c->follow ||
+            fstat(fd, &st) < 0 || !S_ISREG(st.st_mode) || st.st_size <= 0 ||
+            st.st_size != (size_t)st.st_size) {
+            av_log(h, AV_LOG_VERBOSE, "Not mapping this file\n");
+        } else {
+#if HAVE_MMAP
+            int ret = file_map(h, st.st_size);
+            if (ret < 0)
+                av_log(h, AV_LOG_VERBOSE, "Mapping the file failed: %s, "
+                       "using read()\n", av_err2str(ret));
+#else
+            av_log(h, AV_LOG_VERBOSE, "mmap not supported in this build, "
+                   "using read()\n");
+#endif
+        }
+    }
+
+    if (c->io_uring && !c->map) {
+        /* only plain reading or writing of regular files is done asynchronously */
+        if ((flags & AVIO_FLAG_READ_WRITE) == AVIO_FLAG_READ_WRITE ||
+            fstat(fd, &st) < 0 || !S_ISREG(st.st_mode)) {
+            av_log(h, AV_LOG_VERBOSE, "Not using io_uring for this file\n");
+        } else {
+#if FILE_URING
+            int ret = uring_init(h, !!(flags & AVIO_FLAG_WRITE));
+            if (ret < 0)
+                av_log(h, AV_LOG_VERBOSE, "io_uring not available: %s, "
+                       "using synchronous I/O\n", av_err2str(ret));
+            else
+                av_log(h, AV_LOG_DEBUG, "Using io_uring with %d requests of %d bytes\n",
+                       c->uring_depth, c->uring_block_size);
+#else
+            av_log(h, AV_LOG_VERBOSE, "io_uring not supported in this build, "
+                   "using synchronous I/O\n");
+#endif
+        }
+    }
+
     return 0;
 }
 
@@ -424,6 +1026,7 @@ const URLProtocol ff_file_protocol = {
     .url_close           = file_close,
     .url_get_file_handle = file_get_handle,
     .url_check           = file_check,
+    .url_get_mapping     = file_get_mapping,
     .url_delete          = file_delete,
     .url_move            = file_move,
     .priv_data_size      = sizeof(FileContext),
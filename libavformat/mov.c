@@ -11482,8 +11482,11 @@ static int mov_read_packet(AVFormatContext *s, AVPacket *pkt)
         else if (st->codecpar->codec_id == AV_CODEC_ID_APV && sample->size > 4) {
             const uint32_t au_size = avio_rb32(sc->pb);
             ret = av_get_packet(sc->pb, pkt, au_size);
-        } else
+        } else if (mov->aax_mode || mov->decryption_keys || mov->decryption_default_key) {
+            /* the data is decrypted in place */
             ret = av_get_packet(sc->pb, pkt, sample->size);
+        } else
+            ret = ff_get_packet_mapped(sc->pb, pkt, sample->size);
         if (ret < 0) {
             if (should_retry(sc->pb, ret)) {
                 mov_current_sample_dec(sc);
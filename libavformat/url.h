@@ -26,6 +26,7 @@
 
 #include "avio.h"
 
+#include "libavutil/buffer.h"
 #include "libavutil/dict.h"
 #include "libavutil/log.h"
 
@@ -83,6 +84,7 @@ typedef struct URLProtocol {
     int (*url_get_multi_file_handle)(URLContext *h, int **handles,
                                      int *numhandles);
     int (*url_get_short_seek)(URLContext *h);
+    int (*url_get_mapping)(URLContext *h, AVBufferRef **buf);
     int (*url_shutdown)(URLContext *h, int flags);
     const AVClass *priv_data_class;
     int priv_data_size;
@@ -263,6 +265,16 @@ int ffurl_get_multi_file_handle(URLContext *h, int **handles, int *numhandles);
  */
 int ffurl_get_short_seek(void *urlcontext);
 
+/**
+ * Return a read-only mapping of the whole resource, if the protocol provides
+ * one.
+ *
+ * @param buf set to a new reference to the mapping on success
+ * @return 0 on success, AVERROR(ENOSYS) if no mapping is available or
+ *         another negative error code
+ */
+int ffurl_get_mapping(URLContext *h, AVBufferRef **buf);
+
 /**
  * Signal the URLContext that we are done reading or writing the stream.
  *
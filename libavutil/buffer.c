@@ -256,6 +256,28 @@ int av_buffer_replace(AVBufferRef **pdst, const AVBufferRef *src)
     return 0;
 }
 
+static int buffer_pool_init_mutexes(AVBufferPool *pool)
+{
+    int i;
+
+    if (ff_mutex_init(&pool->mutex, NULL))
+        return AVERROR(ENOMEM);
+
+    for (i = 0; i < BUFFER_POOL_SHARDS; i++) {
+        BufferPoolShard *s = &pool->shards[i].s;
+        if (ff_mutex_init(&s->mutex, NULL))
+            goto fail;
+        atomic_init(&s->nb_entries, 0);
+    }
+
+    return 0;
+fail:
+    while (i--)
+        ff_mutex_destroy(&pool->shards[i].s.mutex);
+    ff_mutex_destroy(&pool->mutex);
+    return AVERROR(ENOMEM);
+}
+
 AVBufferPool *av_buffer_pool_init2(size_t size, void *opaque,
                                    AVBufferRef* (*alloc)(void *opaque, size_t size),
                                    void (*pool_free)(void *opaque))
@@ -264,7 +286,7 @@ AVBufferPool *av_buffer_pool_init2(size_t size, void *opaque,
     if (!pool)
         return NULL;
 
-    if (ff_mutex_init(&pool->mutex, NULL)) {
+    if (buffer_pool_init_mutexes(pool) < 0) {
         av_free(pool);
         return NULL;
     }
@@ -286,7 +308,7 @@ AVBufferPool *av_buffer_pool_init(size_t size, AVBufferRef* (*alloc)(size_t size
     if (!pool)
         return NULL;
 
-    if (ff_mutex_init(&pool->mutex, NULL)) {
+    if (buffer_pool_init_mutexes(pool) < 0) {
         av_free(pool);
         return NULL;
     }
@@ -301,12 +323,23 @@ AVBufferPool *av_buffer_pool_init(size_t size, AVBufferRef* (*alloc)(size_t size
 
 static void buffer_pool_flush(AVBufferPool *pool)
 {
-    while (pool->pool) {
-        BufferPoolEntry *buf = pool->pool;
-        pool->pool = buf->next;
-
-        buf->free(buf->opaque, buf->data);
-        av_freep(&buf);
+    for (int i = 0; i < BUFFER_POOL_SHARDS; i++) {
+        BufferPoolShard *s = &pool->shards[i].s;
+        BufferPoolEntry *buf;
+
+        ff_mutex_lock(&s->mutex);
+        buf = s->pool;
+        s->pool = NULL;
+        atomic_store_explicit(&s->nb_entries, 0, memory_order_relaxed);
+        ff_mutex_unlock(&s->mutex);
+
+        while (buf) {
+            BufferPoolEntry *next = buf->next;
+
+            buf->free(buf->opaque, buf->data);
+            av_free(buf);
+            buf = next;
+        }
     }
 }
 
@@ -317,6 +350,8 @@ static void buffer_pool_flush(AVBufferPool *pool)
 static void buffer_pool_free(AVBufferPool *pool)
 {
     buffer_pool_flush(pool);
+    for (int i = 0; i < BUFFER_POOL_SHARDS; i++)
+        ff_mutex_destroy(&pool->shards[i].s.mutex);
     ff_mutex_destroy(&pool->mutex);
 
     if (pool->pool_free)
@@ -334,23 +369,84 @@ void av_buffer_pool_uninit(AVBufferPool **ppool)
     pool   = *ppool;
     *ppool = NULL;
 
-    ff_mutex_lock(&pool->mutex);
     buffer_pool_flush(pool);
-    ff_mutex_unlock(&pool->mutex);
 
     if (atomic_fetch_sub_explicit(&pool->refcount, 1, memory_order_acq_rel) == 1)
         buffer_pool_free(pool);
 }
 
+/*
+ * Pick the shard for the calling thread. There is no portable thread-local
+ * storage, so threads are told apart by the address of their stack.
+ */
+static unsigned pool_shard_idx(void)
+{
+    int on_stack;
+    uint32_t h = (uintptr_t)&on_stack >> 16;
+
+    h *= 0x9E3779B1;
+    return (h >> 16) & (BUFFER_POOL_SHARDS - 1);
+}
+
+/* nb_entries is only written with the shard locked, so no atomic RMW is needed */
+static void pool_shard_add_count(BufferPoolShard *s, int delta)
+{
+    unsigned nb = atomic_load_explicit(&s->nb_entries, memory_order_relaxed);
+    atomic_store_explicit(&s->nb_entries, nb + delta, memory_order_relaxed);
+}
+
+static void pool_shard_push(BufferPoolShard *s, BufferPoolEntry *buf)
+{
+    ff_mutex_lock(&s->mutex);
+    buf->next = s->pool;
+    s->pool   = buf;
+    pool_shard_add_count(s, 1);
+    ff_mutex_unlock(&s->mutex);
+}
+
+static BufferPoolEntry *pool_shard_pop(BufferPoolShard *s)
+{
+    BufferPoolEntry *buf;
+
+    ff_mutex_lock(&s->mutex);
+    buf = s->pool;
+    if (buf) {
+        s->pool   = buf->next;
+        buf->next = NULL;
+        pool_shard_add_count(s, -1);
+    }
+    ff_mutex_unlock(&s->mutex);
+
+    return buf;
+}
+
+/*
+ * Take a free entry, starting with the shard of the calling thread.
+ * Unless force is set, shards that look empty are not locked.
+ */
+static BufferPoolEntry *pool_get_entry(AVBufferPool *pool, unsigned idx, int force)
+{
+    for (int i = 0; i < BUFFER_POOL_SHARDS; i++) {
+        BufferPoolShard *s = &pool->shards[(idx + i) & (BUFFER_POOL_SHARDS - 1)].s;
+        BufferPoolEntry *buf;
+
+        if (!force && !atomic_load_explicit(&s->nb_entries, memory_order_relaxed))
+            continue;
+
+        buf = pool_shard_pop(s);
+        if (buf)
+            return buf;
+    }
+
+    return NULL;
+}
+
 static void pool_release_buffer(void *opaque, uint8_t *data)
 {
     BufferPoolEntry *buf = opaque;
     AVBufferPool *pool = buf->pool;
 
-    ff_mutex_lock(&pool->mutex);
-    buf->next = pool->pool;
-    pool->pool = buf;
-    ff_mutex_unlock(&pool->mutex);
+    pool_shard_push(&pool->shards[pool_shard_idx()].s, buf);
 
     if (atomic_fetch_sub_explicit(&pool->refcount, 1, memory_order_acq_rel) == 1)
         buffer_pool_free(pool);
@@ -389,24 +485,30 @@ static AVBufferRef *pool_alloc_buffer(AVBufferPool *pool)
 
 AVBufferRef *av_buffer_pool_get(AVBufferPool *pool)
 {
-    AVBufferRef *ret;
+    unsigned idx = pool_shard_idx();
+    AVBufferRef *ret = NULL;
     BufferPoolEntry *buf;
 
-    ff_mutex_lock(&pool->mutex);
-    buf = pool->pool;
+    buf = pool_get_entry(pool, idx, 0);
+    if (!buf) {
+        ff_mutex_lock(&pool->mutex);
+        /* the counts may be stale, check all shards before growing the pool,
+         * as some allocators can only provide a fixed number of buffers */
+        buf = pool_get_entry(pool, idx, 1);
+        if (!buf)
+            ret = pool_alloc_buffer(pool);
+        ff_mutex_unlock(&pool->mutex);
+    }
+
     if (buf) {
         memset(&buf->buffer, 0, sizeof(buf->buffer));
         ret = buffer_create(&buf->buffer, buf->data, pool->size,
                             pool_release_buffer, buf, 0);
-        if (ret) {
-            pool->pool = buf->next;
-            buf->next = NULL;
+        if (ret)
             buf->buffer.flags_internal |= BUFFER_FLAG_NO_FREE;
-        }
-    } else {
-        ret = pool_alloc_buffer(pool);
+        else
+            pool_shard_push(&pool->shards[idx].s, buf);
     }
-    ff_mutex_unlock(&pool->mutex);
 
     if (ret)
         atomic_fetch_add_explicit(&pool->refcount, 1, memory_order_relaxed);
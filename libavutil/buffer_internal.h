@@ -85,9 +85,41 @@ typedef struct BufferPoolEntry {
     AVBuffer buffer;
 } BufferPoolEntry;
 
-struct AVBufferPool {
+/**
+ * Number of free lists an AVBufferPool is split into, must be a power of two.
+ */
+#define BUFFER_POOL_SHARDS 8
+
+/*
+ * A free list serving the threads that hash to it. Released buffers go to
+ * the list of the releasing thread, and av_buffer_pool_get() only looks at
+ * the lists of other threads when its own one is empty.
+ */
+typedef struct BufferPoolShard {
     AVMutex mutex;
     BufferPoolEntry *pool;
+    /*
+     * Number of entries in pool, written under mutex. It is read without
+     * holding the lock to skip empty lists.
+     */
+    atomic_uint nb_entries;
+} BufferPoolShard;
+
+struct AVBufferPool {
+    /*
+     * Serializes calls to the alloc callbacks, some hwcontext callbacks
+     * rely on this.
+     */
+    AVMutex mutex;
+
+    /*
+     * Padded so that threads working on different shards do not share
+     * cache lines.
+     */
+    union {
+        BufferPoolShard s;
+        uint8_t padding[128];
+    } shards[BUFFER_POOL_SHARDS];
 
     /*
      * This is used to track when the pool is to be freed.
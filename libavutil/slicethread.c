@@ -16,16 +16,47 @@
  * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
  */
 
+#include "config.h"
+
+#if HAVE_SCHED_SETAFFINITY
+#ifndef _GNU_SOURCE
+# define _GNU_SOURCE
+#endif
+#include <sched.h>
+#endif
+
+#include <errno.h>
 #include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
 #include "cpu.h"
 #include "internal.h"
+#include "log.h"
 #include "slicethread.h"
 #include "mem.h"
 #include "thread.h"
+#include "time.h"
 #include "avassert.h"
 
 #define MAX_AUTO_THREADS 16
 
+// number of polls of the flag between two reads of the clock while spinning
+#define SPIN_CLOCK_INTERVAL 64
+
+#if HAVE_INLINE_ASM && ARCH_X86
+#define cpu_relax() __asm__ volatile("pause" ::: "memory")
+#elif HAVE_INLINE_ASM && (ARCH_AARCH64 || ARCH_ARM)
+#define cpu_relax() __asm__ volatile("yield" ::: "memory")
+#else
+#define cpu_relax() do { } while (0)
+#endif
+
+#if HAVE_SCHED_SETAFFINITY && defined(CPU_SET)
+#define CAN_SET_AFFINITY 1
+#else
+#define CAN_SET_AFFINITY 0
+#endif
+
 #if HAVE_PTHREADS || HAVE_W32THREADS || HAVE_OS2THREADS
 
 typedef struct WorkerContext {
@@ -34,6 +65,10 @@ typedef struct WorkerContext {
     pthread_cond_t  cond;
     pthread_t       thread;
     int             done;
+    // set by the main thread to start running jobs
+    atomic_int      start;
+    // the worker is blocked on cond rather than spinning
+    atomic_int      sleeping;
 } WorkerContext;
 
 struct AVSliceThread {
@@ -41,14 +76,24 @@ struct AVSliceThread {
     int             nb_threads;
     int             nb_active_threads;
     int             nb_jobs;
+    unsigned        job_chunk;
+    unsigned        last_job;
 
     atomic_uint     first_job;
     atomic_uint     current_job;
     pthread_mutex_t done_mutex;
     pthread_cond_t  done_cond;
-    int             done;
+    atomic_int      done;
+    atomic_int      main_sleeping;
     int             finished;
 
+    int             spin_us;
+    int             job_chunk_opt;
+#if CAN_SET_AFFINITY
+    int             set_affinity;
+    cpu_set_t       affinity;
+#endif
+
     void            *priv;
     void            (*worker_func)(void *priv, int jobnr, int threadnr, int nb_jobs, int nb_threads);
     void            (*main_func)(void *priv);
@@ -58,14 +103,57 @@ static int run_jobs(AVSliceThread *ctx)
 {
     unsigned nb_jobs    = ctx->nb_jobs;
     unsigned nb_active_threads = ctx->nb_active_threads;
+    unsigned job_chunk  = ctx->job_chunk;
     unsigned first_job    = atomic_fetch_add_explicit(&ctx->first_job, 1, memory_order_acq_rel);
-    unsigned current_job  = first_job;
+    unsigned current_job  = first_job * job_chunk;
 
     do {
-        ctx->worker_func(ctx->priv, current_job, first_job, nb_jobs, nb_active_threads);
-    } while ((current_job = atomic_fetch_add_explicit(&ctx->current_job, 1, memory_order_acq_rel)) < nb_jobs);
+        unsigned end = FFMIN(current_job + job_chunk, nb_jobs);
 
-    return current_job == nb_jobs + nb_active_threads - 1;
+        for (unsigned job = current_job; job < end; job++)
+            ctx->worker_func(ctx->priv, job, first_job, nb_jobs, nb_active_threads);
+    } while ((current_job = atomic_fetch_add_explicit(&ctx->current_job, job_chunk, memory_order_acq_rel)) < nb_jobs);
+
+    return current_job == ctx->last_job;
+}
+
+/**
+ * Wait for flag to become nonzero, busy-waiting for up to spin_us
+ * microseconds before blocking on cond.
+ */
+static void spin_then_wait(atomic_int *flag, atomic_int *sleeping, int spin_us,
+                           pthread_mutex_t *mutex, pthread_cond_t *cond)
+{
+    if (spin_us > 0) {
+        int64_t deadline = av_gettime_relative() + spin_us;
+
+        do {
+            for (int i = 0; i < SPIN_CLOCK_INTERVAL; i++) {
+                if (atomic_load_explicit(flag, memory_order_acquire))
+                    return;
+                cpu_relax();
+            }
+        } while (av_gettime_relative() < deadline);
+    }
+
+    pthread_mutex_lock(mutex);
+    // pairs with wake(): either we see the flag, or the waker sees us sleeping
+    atomic_store(sleeping, 1);
+    while (!atomic_load(flag))
+        pthread_cond_wait(cond, mutex);
+    atomic_store(sleeping, 0);
+    pthread_mutex_unlock(mutex);
+}
+
+static void wake(atomic_int *flag, atomic_int *sleeping,
+                 pthread_mutex_t *mutex, pthread_cond_t *cond)
+{
+    atomic_store(flag, 1);
+    if (atomic_load(sleeping)) {
+        pthread_mutex_lock(mutex);
+        pthread_cond_signal(cond);
+        pthread_mutex_unlock(mutex);
+    }
 }
 
 static void *attribute_align_arg thread_worker(void *v)
@@ -73,33 +161,91 @@ static void *attribute_align_arg thread_worker(void *v)
     WorkerContext *w = v;
     AVSliceThread *ctx = w->ctx;
 
+#if CAN_SET_AFFINITY
+    if (ctx->set_affinity && sched_setaffinity(0, sizeof(ctx->affinity), &ctx->affinity))
+        av_log(NULL, AV_LOG_WARNING, "Could not set slice thread affinity\n");
+#endif
+
     pthread_mutex_lock(&w->mutex);
+    w->done = 1;
     pthread_cond_signal(&w->cond);
+    pthread_mutex_unlock(&w->mutex);
 
     while (1) {
-        w->done = 1;
-        while (w->done)
-            pthread_cond_wait(&w->cond, &w->mutex);
+        spin_then_wait(&w->start, &w->sleeping, ctx->spin_us, &w->mutex, &w->cond);
+        atomic_store_explicit(&w->start, 0, memory_order_relaxed);
 
-        if (ctx->finished) {
-            pthread_mutex_unlock(&w->mutex);
+        if (ctx->finished)
             return NULL;
-        }
 
-        if (run_jobs(ctx)) {
-            pthread_mutex_lock(&ctx->done_mutex);
-            ctx->done = 1;
-            pthread_cond_signal(&ctx->done_cond);
-            pthread_mutex_unlock(&ctx->done_mutex);
+        if (run_jobs(ctx))
+            wake(&ctx->done, &ctx->main_sleeping, &ctx->done_mutex, &ctx->done_cond);
+    }
+}
+
+#if CAN_SET_AFFINITY
+static int parse_cpu_list(const char *str, cpu_set_t *set)
+{
+    CPU_ZERO(set);
+
+    while (*str) {
+        char *end;
+        long first, last;
+
+        first = last = strtol(str, &end, 10);
+        if (end == str || first < 0)
+            return AVERROR(EINVAL);
+        if (*end == '-') {
+            str  = end + 1;
+            last = strtol(str, &end, 10);
+            if (end == str || last < first)
+                return AVERROR(EINVAL);
         }
+        if (last >= CPU_SETSIZE)
+            return AVERROR(EINVAL);
+
+        for (long i = first; i <= last; i++)
+            CPU_SET(i, set);
+
+        str = end;
+        if (*str == ',')
+            str++;
+        else if (*str && *str != '\n')
+            return AVERROR(EINVAL);
+        else
+            break;
     }
+
+    return CPU_COUNT(set) ? 0 : AVERROR(EINVAL);
 }
 
+static int parse_affinity(const char *str, cpu_set_t *set)
+{
+    char buf[1024], path[64];
+    unsigned node;
+    FILE *f;
+    int ret;
+
+    if (sscanf(str, "node%u", &node) != 1)
+        return parse_cpu_list(str, set);
+
+    // CPUs of a NUMA node, as reported by Linux
+    snprintf(path, sizeof(path), "/sys/devices/system/node/node%u/cpulist", node);
+    f = fopen(path, "r");
+    if (!f)
+        return AVERROR(errno);
+    ret = fgets(buf, sizeof(buf), f) ? parse_cpu_list(buf, set) : AVERROR(EIO);
+    fclose(f);
+
+    return ret;
+}
+#endif
+
 av_cold
-int avpriv_slicethread_create(AVSliceThread **pctx, void *priv,
-                              void (*worker_func)(void *priv, int jobnr, int threadnr, int nb_jobs, int nb_threads),
-                              void (*main_func)(void *priv),
-                              int nb_threads)
+int avpriv_slicethread_create2(AVSliceThread **pctx, void *priv,
+                               void (*worker_func)(void *priv, int jobnr, int threadnr, int nb_jobs, int nb_threads),
+                               void (*main_func)(void *priv),
+                               int nb_threads, const AVSliceThreadConfig *cfg)
 {
     AVSliceThread *ctx;
     int nb_workers, i;
@@ -122,6 +268,28 @@ int avpriv_slicethread_create(AVSliceThread **pctx, void *priv,
     if (!ctx)
         return AVERROR(ENOMEM);
 
+    if (cfg) {
+        ctx->spin_us       = FFMAX(cfg->spin_us, 0);
+        ctx->job_chunk_opt = FFMAX(cfg->job_chunk, 0);
+
+        if (cfg->affinity && *cfg->affinity) {
+#if CAN_SET_AFFINITY
+            ret = parse_affinity(cfg->affinity, &ctx->affinity);
+            if (ret < 0) {
+                av_log(NULL, AV_LOG_ERROR, "Invalid slice thread affinity: %s\n",
+                       cfg->affinity);
+                av_freep(pctx);
+                return ret;
+            }
+            ctx->set_affinity = 1;
+#else
+            av_log(NULL, AV_LOG_WARNING,
+                   "Setting the slice thread affinity is not supported on this platform\n");
+#endif
+        }
+    } else
+        ctx->job_chunk_opt = 1;
+
     if (nb_workers && !(ctx->workers = av_calloc(nb_workers, sizeof(*ctx->workers)))) {
         av_freep(pctx);
         return AVERROR(ENOMEM);
@@ -137,6 +305,8 @@ int avpriv_slicethread_create(AVSliceThread **pctx, void *priv,
 
     atomic_init(&ctx->first_job, 0);
     atomic_init(&ctx->current_job, 0);
+    atomic_init(&ctx->done, 0);
+    atomic_init(&ctx->main_sleeping, 0);
     ret = pthread_mutex_init(&ctx->done_mutex, NULL);
     if (ret) {
         av_freep(&ctx->workers);
@@ -149,11 +319,12 @@ int avpriv_slicethread_create(AVSliceThread **pctx, void *priv,
         avpriv_slicethread_free(pctx);
         return AVERROR(ret);
     }
-    ctx->done        = 0;
 
     for (i = 0; i < nb_workers; i++) {
         WorkerContext *w = &ctx->workers[i];
         w->ctx = ctx;
+        atomic_init(&w->start, 0);
+        atomic_init(&w->sleeping, 0);
         ret = pthread_mutex_init(&w->mutex, NULL);
         if (ret) {
             ctx->nb_threads = main_func ? i : i + 1;
@@ -167,18 +338,17 @@ int avpriv_slicethread_create(AVSliceThread **pctx, void *priv,
             avpriv_slicethread_free(pctx);
             return AVERROR(ret);
         }
-        pthread_mutex_lock(&w->mutex);
         w->done = 0;
 
         if (ret = pthread_create(&w->thread, NULL, thread_worker, w)) {
             ctx->nb_threads = main_func ? i : i + 1;
-            pthread_mutex_unlock(&w->mutex);
             pthread_cond_destroy(&w->cond);
             pthread_mutex_destroy(&w->mutex);
             avpriv_slicethread_free(pctx);
             return AVERROR(ret);
         }
 
+        pthread_mutex_lock(&w->mutex);
         while (!w->done)
             pthread_cond_wait(&w->cond, &w->mutex);
         pthread_mutex_unlock(&w->mutex);
@@ -187,25 +357,42 @@ int avpriv_slicethread_create(AVSliceThread **pctx, void *priv,
     return nb_threads;
 }
 
+av_cold
+int avpriv_slicethread_create(AVSliceThread **pctx, void *priv,
+                              void (*worker_func)(void *priv, int jobnr, int threadnr, int nb_jobs, int nb_threads),
+                              void (*main_func)(void *priv),
+                              int nb_threads)
+{
+    return avpriv_slicethread_create2(pctx, priv, worker_func, main_func,
+                                      nb_threads, NULL);
+}
+
 void avpriv_slicethread_execute(AVSliceThread *ctx, int nb_jobs, int execute_main)
 {
+    unsigned job_chunk, nb_chunks;
     int nb_workers, i, is_last = 0;
 
     av_assert0(nb_jobs > 0);
+
+    job_chunk = ctx->job_chunk_opt;
+    if (!job_chunk)
+        job_chunk = FFMAX(nb_jobs / (ctx->nb_threads * 4), 1);
+    nb_chunks = (nb_jobs + job_chunk - 1) / job_chunk;
+
     ctx->nb_jobs           = nb_jobs;
-    ctx->nb_active_threads = FFMIN(nb_jobs, ctx->nb_threads);
+    ctx->job_chunk         = job_chunk;
+    ctx->nb_active_threads = FFMIN(nb_chunks, ctx->nb_threads);
+    // the value of current_job seen by the last thread to run out of jobs
+    ctx->last_job          = (nb_chunks + ctx->nb_active_threads - 1) * job_chunk;
     atomic_store_explicit(&ctx->first_job, 0, memory_order_relaxed);
-    atomic_store_explicit(&ctx->current_job, ctx->nb_active_threads, memory_order_relaxed);
+    atomic_store_explicit(&ctx->current_job, ctx->nb_active_threads * job_chunk, memory_order_relaxed);
     nb_workers             = ctx->nb_active_threads;
     if (!ctx->main_func || !execute_main)
         nb_workers--;
 
     for (i = 0; i < nb_workers; i++) {
         WorkerContext *w = &ctx->workers[i];
-        pthread_mutex_lock(&w->mutex);
-        w->done = 0;
-        pthread_cond_signal(&w->cond);
-        pthread_mutex_unlock(&w->mutex);
+        wake(&w->start, &w->sleeping, &w->mutex, &w->cond);
     }
 
     if (ctx->main_func && execute_main)
@@ -214,11 +401,9 @@ void avpriv_slicethread_execute(AVSliceThread *ctx, int nb_jobs, int execute_mai
         is_last = run_jobs(ctx);
 
     if (!is_last) {
-        pthread_mutex_lock(&ctx->done_mutex);
-        while (!ctx->done)
-            pthread_cond_wait(&ctx->done_cond, &ctx->done_mutex);
-        ctx->done = 0;
-        pthread_mutex_unlock(&ctx->done_mutex);
+        spin_then_wait(&ctx->done, &ctx->main_sleeping, ctx->spin_us,
+                       &ctx->done_mutex, &ctx->done_cond);
+        atomic_store_explicit(&ctx->done, 0, memory_order_relaxed);
     }
 }
 
@@ -237,10 +422,7 @@ av_cold void avpriv_slicethread_free(AVSliceThread **pctx)
     ctx->finished = 1;
     for (i = 0; i < nb_workers; i++) {
         WorkerContext *w = &ctx->workers[i];
-        pthread_mutex_lock(&w->mutex);
-        w->done = 0;
-        pthread_cond_signal(&w->cond);
-        pthread_mutex_unlock(&w->mutex);
+        wake(&w->start, &w->sleeping, &w->mutex, &w->cond);
     }
 
     for (i = 0; i < nb_workers; i++) {
@@ -258,6 +440,15 @@ av_cold void avpriv_slicethread_free(AVSliceThread **pctx)
 
 #else /* HAVE_PTHREADS || HAVE_W32THREADS || HAVE_OS32THREADS */
 
+int avpriv_slicethread_create2(AVSliceThread **pctx, void *priv,
+                               void (*worker_func)(void *priv, int jobnr, int threadnr, int nb_jobs, int nb_threads),
+                               void (*main_func)(void *priv),
+                               int nb_threads, const AVSliceThreadConfig *cfg)
+{
+    *pctx = NULL;
+    return AVERROR(ENOSYS);
+}
+
 int avpriv_slicethread_create(AVSliceThread **pctx, void *priv,
                               void (*worker_func)(void *priv, int jobnr, int threadnr, int nb_jobs, int nb_threads),
                               void (*main_func)(void *priv),
@@ -21,6 +21,30 @@
 
 typedef struct AVSliceThread AVSliceThread;
 
+/**
+ * Optional tuning parameters for a slice threading context.
+ */
+typedef struct AVSliceThreadConfig {
+    /**
+     * Time in microseconds for which idle threads busy-wait for new jobs
+     * before going to sleep, 0 to sleep immediately. Spinning reduces the
+     * wakeup latency when execute is called often with short jobs, at the
+     * cost of CPU time.
+     */
+    int spin_us;
+    /**
+     * Number of consecutive jobs claimed by a thread at once, 0 to choose
+     * automatically based on the number of jobs and threads.
+     */
+    int job_chunk;
+    /**
+     * CPUs to run the worker threads on, as a list of CPU numbers and
+     * ranges such as "0-3,8", or "nodeN" for the CPUs of NUMA node N.
+     * NULL or empty for no restriction.
+     */
+    const char *affinity;
+} AVSliceThreadConfig;
+
 /**
  * Create slice threading context.
  * @param pctx slice threading context returned here
@@ -35,6 +59,16 @@ int avpriv_slicethread_create(AVSliceThread **pctx, void *priv,
                               void (*main_func)(void *priv),
                               int nb_threads);
 
+/**
+ * Create slice threading context, like avpriv_slicethread_create(), with
+ * additional tuning parameters.
+ * @param cfg tuning parameters, may be NULL for the defaults
+ */
+int avpriv_slicethread_create2(AVSliceThread **pctx, void *priv,
+                               void (*worker_func)(void *priv, int jobnr, int threadnr, int nb_jobs, int nb_threads),
+                               void (*main_func)(void *priv),
+                               int nb_threads, const AVSliceThreadConfig *cfg);
+
 /**
  * Execute slice threading.
  * @param ctx slice threading context
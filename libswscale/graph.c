@@ -23,11 +23,13 @@
 #include "libavutil/error.h"
 #include "libavutil/imgutils.h"
 #include "libavutil/macros.h"
+#include "libavutil/mathematics.h"
 #include "libavutil/mem.h"
 #include "libavutil/opt.h"
 #include "libavutil/pixdesc.h"
 #include "libavutil/refstruct.h"
 #include "libavutil/slicethread.h"
+#include "libavutil/thread.h"
 
 #include "libswscale/swscale.h"
 #include "libswscale/format.h"
@@ -76,7 +78,8 @@ static int frame_alloc_planes(AVFrame *dst)
 
 static int pass_alloc_output(SwsPass *pass)
 {
-    if (!pass || pass->output->avframe)
+    if (!pass || pass->dst_idx >= 0 || pass->output->avframe ||
+        pass->output->strips)
         return 0;
 
     SwsPassBuffer *buffer = pass->output;
@@ -98,10 +101,40 @@ static int pass_alloc_output(SwsPass *pass)
     return 0;
 }
 
+/* Allocates one strip of `lines` lines per thread, instead of a full frame */
+static int pass_alloc_strips(SwsPass *pass, int num_threads, int lines)
+{
+    SwsPassBuffer *buffer = pass->output;
+    av_assert0(!buffer->avframe && !buffer->strips);
+
+    buffer->strips = av_calloc(num_threads, sizeof(*buffer->strips));
+    if (!buffer->strips)
+        return AVERROR(ENOMEM);
+    buffer->num_strips = num_threads;
+
+    for (int i = 0; i < num_threads; i++) {
+        AVFrame *strip = buffer->strips[i] = av_frame_alloc();
+        if (!strip)
+            return AVERROR(ENOMEM);
+        strip->format = pass->format;
+        strip->width  = buffer->width;
+        strip->height = lines;
+
+        int ret = frame_alloc_planes(strip);
+        if (ret < 0)
+            return ret;
+    }
+
+    return 0;
+}
+
 static void free_buffer(AVRefStructOpaque opaque, void *obj)
 {
     SwsPassBuffer *buffer = obj;
     av_frame_free(&buffer->avframe);
+    for (int i = 0; i < buffer->num_strips; i++)
+        av_frame_free(&buffer->strips[i]);
+    av_freep(&buffer->strips);
 }
 
 static void pass_free(SwsPass *pass)
@@ -135,6 +168,8 @@ int ff_sws_graph_add_pass(SwsGraph *graph, enum AVPixelFormat fmt,
     pass->width  = width;
     pass->height = height;
     pass->input  = input;
+    pass->align  = align;
+    pass->dst_idx = -1;
     pass->output = av_refstruct_alloc_ext(sizeof(*pass->output), 0, NULL, free_buffer);
     if (!pass->output) {
         ret = AVERROR(ENOMEM);
@@ -410,6 +445,7 @@ static int init_legacy_subpass(SwsGraph *graph, SwsContext *sws,
             sws_free_context(&sws);
             return ret;
         }
+        input->flags = SWS_PASS_ANY_SLICE | SWS_PASS_ROWWISE;
     }
 
     if (c->srcXYZ && !(c->dstXYZ && unscaled)) {
@@ -419,6 +455,7 @@ static int init_legacy_subpass(SwsGraph *graph, SwsContext *sws,
             sws_free_context(&sws);
             return ret;
         }
+        input->flags = SWS_PASS_ANY_SLICE | SWS_PASS_ROWWISE;
     }
 
     ret = ff_sws_graph_add_pass(graph, sws->dst_format, dst_w, dst_h, input, align,
@@ -475,6 +512,7 @@ static int init_legacy_subpass(SwsGraph *graph, SwsContext *sws,
                                     1, run_rgb2xyz, NULL, c, NULL, &pass);
         if (ret < 0)
             return ret;
+        pass->flags = SWS_PASS_ANY_SLICE | SWS_PASS_ROWWISE;
     }
 
     *output = pass;
@@ -783,43 +821,341 @@ static int adapt_colors(SwsGraph *graph, SwsFormat src, SwsFormat dst,
         return ret;
     }
 
-    return ff_sws_graph_add_pass(graph, fmt_out, src.width, src.height,
-                                 input, 1, run_lut3d, setup_lut3d, lut,
-                                 free_lut3d, output);
+    ret = ff_sws_graph_add_pass(graph, fmt_out, src.width, src.height,
+                                input, 1, run_lut3d, setup_lut3d, lut,
+                                free_lut3d, output);
+    if (ret < 0)
+        return ret;
+
+    (*output)->flags = SWS_PASS_ANY_SLICE | SWS_PASS_ROWWISE;
+    return 0;
 }
 
 /***************************************
  * Main filter graph construction code *
  ***************************************/
 
-static int init_passes(SwsGraph *graph)
+/* Adds the passes converting `src`, read from `input`, to output `idx` */
+static int init_output(SwsGraph *graph, int idx, SwsFormat src, SwsPass *input,
+                       SwsPass **output)
 {
-    SwsFormat src = graph->src;
-    SwsFormat dst = graph->dst;
-    SwsPass *pass = NULL; /* read from main input image */
+    const SwsFormat *dst = &graph->dst[idx];
+    SwsPass *pass = input;
     int ret;
 
-    ret = adapt_colors(graph, src, dst, pass, &pass);
+    ret = adapt_colors(graph, src, *dst, pass, &pass);
     if (ret < 0)
         return ret;
     src.format = pass ? pass->format : src.format;
-    src.color  = dst.color;
+    src.color  = dst->color;
 
-    if (!ff_fmt_equal(&src, &dst)) {
-        ret = add_convert_pass(graph, &src, &dst, pass, &pass);
+    if (!ff_fmt_equal(&src, dst)) {
+        ret = add_convert_pass(graph, &src, dst, pass, &pass);
         if (ret < 0)
             return ret;
     }
 
-    if (pass)
+    if (pass != input) {
+        graph->noop = 0;
+    } else if (input && input->dst_idx < 0) {
+        /* Shared intermediate already matches this output; write it there */
+        pass = input;
+        graph->noop = 0;
+    } else {
+        /* No passes were added; add threaded memcpy pass */
+        graph->noop &= !input;
+        graph->dst_noop[idx] = !input;
+        ret = ff_sws_graph_add_pass(graph, dst->format, dst->width, dst->height,
+                                    input, 1, run_copy, NULL, NULL, NULL, &pass);
+        if (ret < 0)
+            return ret;
+        pass->flags = SWS_PASS_ANY_SLICE | SWS_PASS_ROWWISE;
+    }
+
+    pass->dst_idx = idx;
+    *output = pass;
+    return 0;
+}
+
+/**
+ * Picks the pixel format of the shared intermediate for multiple outputs.
+ * This is normally the output format, unless that would lose precision
+ * relative to the source; in which case we look for an equivalent layout
+ * with the depth of the source instead.
+ */
+static enum AVPixelFormat shared_format(const SwsFormat *src, const SwsFormat *dst)
+{
+    const AVPixFmtDescriptor *desc = NULL;
+    const int depth = src->desc->comp[0].depth;
+    const int planes = av_pix_fmt_count_planes(dst->format);
+    const uint64_t mask = AV_PIX_FMT_FLAG_PLANAR | AV_PIX_FMT_FLAG_RGB |
+                          AV_PIX_FMT_FLAG_ALPHA  | AV_PIX_FMT_FLAG_FLOAT;
+
+    if (depth <= dst->desc->comp[0].depth)
+        return dst->format;
+
+    while ((desc = av_pix_fmt_desc_next(desc))) {
+        const enum AVPixelFormat fmt = av_pix_fmt_desc_get_id(desc);
+        if (desc->nb_components != dst->desc->nb_components ||
+            desc->log2_chroma_w != dst->desc->log2_chroma_w ||
+            desc->log2_chroma_h != dst->desc->log2_chroma_h ||
+            (desc->flags & mask) != (dst->desc->flags & mask) ||
+            !!(desc->flags & AV_PIX_FMT_FLAG_BE) != HAVE_BIGENDIAN ||
+            av_pix_fmt_count_planes(fmt) != planes)
+            continue;
+
+        int ok = 1;
+        for (int i = 0; i < desc->nb_components; i++)
+            ok &= desc->comp[i].depth == depth && !desc->comp[i].shift;
+        if (ok && sws_test_format(fmt, 0) && sws_test_format(fmt, 1))
+            return fmt;
+    }
+
+    return dst->format;
+}
+
+/**
+ * If all outputs share the same format properties, convert the source to
+ * those properties once at its own resolution, so that unpacking and color
+ * mapping are not repeated for every output. Updates `src` and `input` to
+ * refer to the shared intermediate on success. Scaling from the intermediate
+ * rounds differently than scaling from the source, so this is only done
+ * with SWS_SHARE_INPUT.
+ */
+static int init_shared(SwsGraph *graph, SwsFormat *src, SwsPass **input)
+{
+    const SwsFormat *dst = &graph->dst[0];
+    int ret;
+
+    for (int i = 1; i < graph->num_dst; i++) {
+        if (!ff_props_equal(&graph->dst[i], dst))
+            return 0;
+    }
+
+    if (src->hw_format != AV_PIX_FMT_NONE || dst->hw_format != AV_PIX_FMT_NONE)
         return 0;
 
-    /* No passes were added, so no operations were necessary */
+    SwsFormat mid = *dst;
+    mid.width  = src->width;
+    mid.height = src->height;
+    mid.format = shared_format(src, dst);
+    mid.desc   = av_pix_fmt_desc_get(mid.format);
+    if (ff_props_equal(src, &mid))
+        return 0; /* nothing to share */
+
+    SwsFormat tmp = *src;
+    SwsPass *pass = NULL;
+    ret = adapt_colors(graph, tmp, mid, pass, &pass);
+    if (ret < 0)
+        return ret;
+    tmp.format = pass ? pass->format : tmp.format;
+    tmp.color  = mid.color;
+
+    if (!ff_fmt_equal(&tmp, &mid)) {
+        ret = add_convert_pass(graph, &tmp, &mid, pass, &pass);
+        if (ret < 0)
+            return ret;
+    }
+
+    if (pass) {
+        av_log(graph->ctx, AV_LOG_VERBOSE, "Sharing %s %dx%d intermediate "
+               "between %d outputs\n", av_get_pix_fmt_name(mid.format),
+               mid.width, mid.height, graph->num_dst);
+        *src   = mid;
+        *input = pass;
+    }
+
+    return 0;
+}
+
+/* Minimum size ratio for deriving one output from another with SWS_CASCADE */
+#define CASCADE_RATIO 2
+
+static int init_passes(SwsGraph *graph)
+{
+    SwsFormat src = graph->src;
+    SwsPass *input = NULL; /* read from main input image */
+    SwsPass **final;
+    int *order;
+    int ret;
+
     graph->noop = 1;
+    if (graph->num_dst > 1 && (graph->ctx->flags & SWS_SHARE_INPUT)) {
+        ret = init_shared(graph, &src, &input);
+        if (ret < 0)
+            return ret;
+    }
+
+    final = av_calloc(graph->num_dst, sizeof(*final));
+    order = av_malloc_array(graph->num_dst, sizeof(*order));
+    if (!final || !order) {
+        ret = AVERROR(ENOMEM);
+        goto end;
+    }
+
+    /* Handle larger outputs first, so smaller ones may be derived from them */
+    for (int i = 0; i < graph->num_dst; i++) {
+        const int64_t area = (int64_t) graph->dst[i].width * graph->dst[i].height;
+        int j = i;
+        for (; j > 0; j--) {
+            const SwsFormat *prev = &graph->dst[order[j - 1]];
+            if ((int64_t) prev->width * prev->height >= area)
+                break;
+            order[j] = order[j - 1];
+        }
+        order[j] = i;
+    }
+
+    for (int i = 0; i < graph->num_dst; i++) {
+        const int idx = order[i];
+        const SwsFormat *dst = &graph->dst[idx];
+        SwsFormat in_fmt = src;
+        SwsPass *in = input;
+
+        for (int j = 0; (graph->ctx->flags & SWS_CASCADE) && j < i; j++) {
+            const SwsFormat *prev = &graph->dst[order[j]];
+            if (ff_props_equal(prev, dst) &&
+                prev->width  >= CASCADE_RATIO * dst->width &&
+                prev->height >= CASCADE_RATIO * dst->height)
+            {
+                /* Keep the smallest suitable output */
+                in_fmt = *prev;
+                in     = final[order[j]];
+            }
+        }
+
+        ret = init_output(graph, idx, in_fmt, in, &final[idx]);
+        if (ret < 0)
+            goto end;
+    }
+
+    ret = 0;
+end:
+    av_free(final);
+    av_free(order);
+    return ret;
+}
+
+/**
+ * Target size of the data touched by one band of a fused pass group, per
+ * thread. This roughly corresponds to the size of a per-core L2 cache.
+ */
+#define BAND_CACHE_SIZE (256 << 10)
+
+/* Whether `next` may be fused with the pass right before it */
+static int can_fuse(const SwsGraph *graph, int idx)
+{
+    const SwsPass *prev = graph->passes[idx - 1];
+    const SwsPass *next = graph->passes[idx];
+    if (next->input != prev || prev->dst_idx >= 0 ||
+        !(next->flags & SWS_PASS_ROWWISE) || next->height != prev->height)
+        return 0;
+
+    /* The strips only hold the current band, so nothing else may read them */
+    for (int i = idx + 1; i < graph->num_passes; i++) {
+        if (graph->passes[i]->input == prev)
+            return 0;
+    }
+
+    return 1;
+}
+
+/* Band alignment required by a pass, in lines */
+static int band_align(const SwsPass *pass, int align)
+{
+    const int sub = 1 << ff_fmt_vshift(pass->format, 1);
+    align = align / av_gcd(align, pass->align) * pass->align;
+    return align / av_gcd(align, sub) * sub;
+}
+
+static size_t line_bytes(const SwsPass *pass)
+{
+    int linesize[4];
+    size_t bytes = 0;
+    if (av_image_fill_linesizes(linesize, pass->format, pass->width) < 0)
+        return 0;
+    for (int i = 0; i < 4; i++)
+        bytes += linesize[i] >> ff_fmt_vshift(pass->format, i);
+    return bytes;
+}
+
+/**
+ * Groups each pass that can be run on arbitrary slices with the row-wise
+ * passes following it. These groups are executed band by band, so that the
+ * intermediate images never leave the cache; and only need per-thread strips
+ * rather than full frame buffers.
+ */
+static int init_bands(SwsGraph *graph)
+{
+    for (int idx = 0; idx < graph->num_passes; idx++) {
+        SwsPass *head = graph->passes[idx];
+        if (!(head->flags & SWS_PASS_ANY_SLICE) || !head->align)
+            continue;
+
+        int num_fused = 0, align = band_align(head, 1);
+        size_t bytes = line_bytes(head);
+        while (idx + num_fused + 1 < graph->num_passes &&
+               can_fuse(graph, idx + num_fused + 1))
+        {
+            const SwsPass *pass = graph->passes[idx + ++num_fused];
+            align  = band_align(pass, align);
+            bytes += line_bytes(pass);
+        }
+
+        if (!num_fused)
+            continue;
+
+        /* Fit the working set into the cache, but keep all threads busy */
+        const int max_h = FFALIGN((head->height + graph->num_threads - 1) /
+                                  graph->num_threads, align);
+        int band_h = BAND_CACHE_SIZE / FFMAX(bytes, 1) / align * align;
+        band_h = av_clip(band_h, align, max_h);
+
+        for (int i = 0; i < num_fused; i++) {
+            int ret = pass_alloc_strips(graph->passes[idx + i],
+                                        graph->num_threads, band_h);
+            if (ret < 0)
+                return ret;
+        }
+
+        av_log(graph->ctx, AV_LOG_DEBUG, "Running %d passes in bands of "
+               "%d lines\n", num_fused + 1, band_h);
+        head->num_fused = num_fused;
+        head->band_h    = band_h;
+        idx += num_fused;
+    }
+
+    return 0;
+}
 
-    /* Add threaded memcpy pass */
-    return ff_sws_graph_add_pass(graph, dst.format, dst.width, dst.height,
-                                 pass, 1, run_copy, NULL, NULL, NULL, &pass);
+/* Maps the strip of `thread` onto the lines starting at `y` of the full image */
+static void strip_frame(const SwsPass *pass, int thread, int y, SwsFrame *out)
+{
+    ff_sws_frame_from_avframe(out, pass->output->strips[thread]);
+    for (int i = 0; i < 4; i++) {
+        if (out->data[i])
+            out->data[i] -= (y >> ff_fmt_vshift(out->format, i)) * out->linesize[i];
+    }
+    out->height = pass->height;
+    out->avframe = NULL;
+}
+
+static void run_band(const SwsGraph *graph, int band, int thread)
+{
+    SwsPass *const *passes = &graph->passes[graph->exec.pass_idx];
+    const SwsPass *head = passes[0];
+    const int y = band * head->band_h;
+    const int h = FFMIN(head->band_h, head->height - y);
+    SwsFrame in = *graph->exec.input, out;
+
+    for (int i = 0; i < head->num_fused; i++) {
+        strip_frame(passes[i], thread, y, &out);
+        passes[i]->run(&out, &in, y, h, passes[i]);
+        in = out;
+    }
+
+    passes[head->num_fused]->run(graph->exec.output, &in, y, h,
+                                 passes[head->num_fused]);
 }
 
 static void sws_graph_worker(void *priv, int jobnr, int threadnr, int nb_jobs,
@@ -827,14 +1163,19 @@ static void sws_graph_worker(void *priv, int jobnr, int threadnr, int nb_jobs,
 {
     SwsGraph *graph = priv;
     const SwsPass *pass = graph->exec.pass;
+    if (pass->num_fused) {
+        run_band(graph, jobnr, threadnr);
+        return;
+    }
+
     const int slice_y = jobnr * pass->slice_h;
     const int slice_h = FFMIN(pass->slice_h, pass->height - slice_y);
 
     pass->run(graph->exec.output, graph->exec.input, slice_y, slice_h, pass);
 }
 
-int ff_sws_graph_create(SwsContext *ctx, const SwsFormat *dst, const SwsFormat *src,
-                        int field, SwsGraph **out_graph)
+int ff_sws_graph_create_multi(SwsContext *ctx, const SwsFormat *dst, int num_dst,
+                              const SwsFormat *src, int field, SwsGraph **out_graph)
 {
     int ret;
     SwsGraph *graph = av_mallocz(sizeof(*graph));
@@ -843,10 +1184,18 @@ int ff_sws_graph_create(SwsContext *ctx, const SwsFormat *dst, const SwsFormat *
 
     graph->ctx = ctx;
     graph->src = *src;
-    graph->dst = *dst;
     graph->field = field;
     graph->opts_copy = *ctx;
 
+    graph->dst      = av_memdup(dst, num_dst * sizeof(*dst));
+    graph->dst_noop = av_calloc(num_dst, sizeof(*graph->dst_noop));
+    graph->exec.dst = av_calloc(num_dst, sizeof(*graph->exec.dst));
+    if (!graph->dst || !graph->dst_noop || !graph->exec.dst) {
+        ret = AVERROR(ENOMEM);
+        goto error;
+    }
+    graph->num_dst = num_dst;
+
     if (ctx->threads == 1) {
         graph->num_threads = 1;
     } else {
@@ -866,6 +1215,10 @@ int ff_sws_graph_create(SwsContext *ctx, const SwsFormat *dst, const SwsFormat *
     if (ret < 0)
         goto error;
 
+    ret = init_bands(graph);
+    if (ret < 0)
+        goto error;
+
     /* Resolve output buffers for all intermediate passes */
     for (int i = 0; i < graph->num_passes; i++) {
         ret = pass_alloc_output(graph->passes[i]->input);
@@ -881,6 +1234,12 @@ error:
     return ret;
 }
 
+int ff_sws_graph_create(SwsContext *ctx, const SwsFormat *dst, const SwsFormat *src,
+                        int field, SwsGraph **out_graph)
+{
+    return ff_sws_graph_create_multi(ctx, dst, 1, src, field, out_graph);
+}
+
 void ff_sws_graph_rollback(SwsGraph *graph, int since_idx)
 {
     for (int i = since_idx; i < graph->num_passes; i++)
@@ -899,6 +1258,9 @@ void ff_sws_graph_free(SwsGraph **pgraph)
     for (int i = 0; i < graph->num_passes; i++)
         pass_free(graph->passes[i]);
     av_free(graph->passes);
+    av_free(graph->exec.dst);
+    av_free(graph->dst_noop);
+    av_free(graph->dst);
 
     av_free(graph);
     *pgraph = NULL;
@@ -923,20 +1285,140 @@ static int opts_equal(const SwsContext *c1, const SwsContext *c2)
 
 }
 
-int ff_sws_graph_reinit(SwsContext *ctx, const SwsFormat *dst, const SwsFormat *src,
-                        int field, SwsGraph **out_graph)
+static int graph_equal(const SwsGraph *graph, const SwsContext *ctx,
+                       const SwsFormat *dst, int num_dst,
+                       const SwsFormat *src, int field)
+{
+    if (graph->num_dst != num_dst || graph->field != field ||
+        !ff_fmt_equal(&graph->src, src) || !opts_equal(ctx, &graph->opts_copy))
+        return 0;
+
+    for (int i = 0; i < num_dst; i++) {
+        if (!ff_fmt_equal(&graph->dst[i], &dst[i]))
+            return 0;
+    }
+
+    return 1;
+}
+
+struct SwsGraphCache {
+    AVMutex lock;
+    SwsGraph **graphs; /* most recently used first */
+    int num_graphs;
+    int max_graphs;
+};
+
+SwsGraphCache *sws_graph_cache_alloc(int max_graphs)
+{
+    SwsGraphCache *cache = av_mallocz(sizeof(*cache));
+    if (!cache)
+        return NULL;
+
+    cache->max_graphs = max_graphs > 0 ? max_graphs : 16;
+    cache->graphs = av_calloc(cache->max_graphs, sizeof(*cache->graphs));
+    if (!cache->graphs || ff_mutex_init(&cache->lock, NULL)) {
+        av_free(cache->graphs);
+        av_free(cache);
+        return NULL;
+    }
+
+    return cache;
+}
+
+void sws_graph_cache_free(SwsGraphCache **pcache)
+{
+    SwsGraphCache *cache = *pcache;
+    if (!cache)
+        return;
+
+    for (int i = 0; i < cache->num_graphs; i++)
+        ff_sws_graph_free(&cache->graphs[i]);
+    av_free(cache->graphs);
+    ff_mutex_destroy(&cache->lock);
+    av_freep(pcache);
+}
+
+/**
+ * Take a graph matching the given configuration out of the cache, or
+ * return NULL if there is none. The graph is removed from the cache so
+ * that it is never used by two contexts at the same time.
+ */
+static SwsGraph *graph_cache_get(SwsContext *ctx, const SwsFormat *dst, int num_dst,
+                                 const SwsFormat *src, int field)
+{
+    SwsGraphCache *cache = ctx->graph_cache;
+    SwsGraph *graph = NULL;
+
+    ff_mutex_lock(&cache->lock);
+    for (int i = 0; i < cache->num_graphs; i++) {
+        if (!graph_equal(cache->graphs[i], ctx, dst, num_dst, src, field))
+            continue;
+        graph = cache->graphs[i];
+        memmove(&cache->graphs[i], &cache->graphs[i + 1],
+                (cache->num_graphs - i - 1) * sizeof(*cache->graphs));
+        cache->num_graphs--;
+        break;
+    }
+    ff_mutex_unlock(&cache->lock);
+
+    if (graph)
+        graph->ctx = ctx;
+    return graph;
+}
+
+void ff_sws_graph_release(SwsContext *ctx, SwsGraph **pgraph)
+{
+    SwsGraphCache *cache = ctx->graph_cache;
+    SwsGraph *graph = *pgraph, *evict = NULL;
+    if (!graph)
+        return;
+
+    /* Hardware graphs depend on device state owned by the context */
+    if (!cache || graph->src.hw_format != AV_PIX_FMT_NONE) {
+        ff_sws_graph_free(pgraph);
+        return;
+    }
+
+    ff_mutex_lock(&cache->lock);
+    if (cache->num_graphs == cache->max_graphs)
+        evict = cache->graphs[--cache->num_graphs];
+    memmove(&cache->graphs[1], &cache->graphs[0],
+            cache->num_graphs * sizeof(*cache->graphs));
+    cache->graphs[0] = graph;
+    cache->num_graphs++;
+    ff_mutex_unlock(&cache->lock);
+
+    /* Freeing joins the graph's worker threads, so do it outside the lock */
+    ff_sws_graph_free(&evict);
+    *pgraph = NULL;
+}
+
+int ff_sws_graph_reinit_multi(SwsContext *ctx, const SwsFormat *dst, int num_dst,
+                              const SwsFormat *src, int field, SwsGraph **out_graph)
 {
     SwsGraph *graph = *out_graph;
-    if (graph && ff_fmt_equal(&graph->src, src) &&
-                 ff_fmt_equal(&graph->dst, dst) &&
-                 opts_equal(ctx, &graph->opts_copy))
-    {
+    if (graph && graph_equal(graph, ctx, dst, num_dst, src, field)) {
         ff_sws_graph_update_metadata(graph, &src->color);
         return 0;
     }
 
-    ff_sws_graph_free(out_graph);
-    return ff_sws_graph_create(ctx, dst, src, field, out_graph);
+    ff_sws_graph_release(ctx, out_graph);
+    if (ctx->graph_cache) {
+        graph = graph_cache_get(ctx, dst, num_dst, src, field);
+        if (graph) {
+            ff_sws_graph_update_metadata(graph, &src->color);
+            *out_graph = graph;
+            return 0;
+        }
+    }
+
+    return ff_sws_graph_create_multi(ctx, dst, num_dst, src, field, out_graph);
+}
+
+int ff_sws_graph_reinit(SwsContext *ctx, const SwsFormat *dst, const SwsFormat *src,
+                        int field, SwsGraph **out_graph)
+{
+    return ff_sws_graph_reinit_multi(ctx, dst, 1, src, field, out_graph);
 }
 
 void ff_sws_graph_update_metadata(SwsGraph *graph, const SwsColor *color)
@@ -974,20 +1456,84 @@ static void get_field(SwsGraph *graph, const AVFrame *avframe, SwsFrame *frame)
     frame->height = (frame->height + (graph->field == FIELD_TOP)) >> 1;
 }
 
-int ff_sws_graph_run(SwsGraph *graph, const AVFrame *dst, const AVFrame *src)
+/* Resolves the image written to by `pass`, or the source image for NULL */
+static const SwsFrame *pass_frame(const SwsGraph *graph, const SwsPass *pass,
+                                  const SwsFrame *src)
 {
-    av_assert0(dst->format == graph->dst.hw_format || dst->format == graph->dst.format);
+    if (!pass)
+        return src;
+    else if (pass->dst_idx >= 0)
+        return &graph->exec.dst[pass->dst_idx];
+    else
+        return &pass->output->frame;
+}
+
+/* Runs the group of fused passes starting at `idx` */
+static int run_bands(SwsGraph *graph, int idx)
+{
+    SwsPass *const *passes = &graph->passes[idx];
+    const SwsPass *head = passes[0];
+    const SwsPass *last = passes[head->num_fused];
+    const int num_bands = (head->height + head->band_h - 1) / head->band_h;
+    SwsFrame in = *graph->exec.input, out;
+
+    graph->exec.output = pass_frame(graph, last, NULL);
+
+    /* Setup sees the layout of the strips, as seen from the first thread */
+    for (int i = 0; i <= head->num_fused; i++) {
+        const SwsPass *pass = passes[i];
+        if (i < head->num_fused)
+            strip_frame(pass, 0, 0, &out);
+        else
+            out = *graph->exec.output;
+        if (pass->setup) {
+            int ret = pass->setup(&out, &in, pass);
+            if (ret < 0)
+                return ret;
+        }
+        in = out;
+    }
+
+    if (num_bands == 1 || !graph->slicethread) {
+        for (int i = 0; i < num_bands; i++)
+            run_band(graph, i, 0);
+    } else {
+        avpriv_slicethread_execute(graph->slicethread, num_bands, 0);
+    }
+
+    return 0;
+}
+
+int ff_sws_graph_run_multi(SwsGraph *graph, const AVFrame *const dst[], int num_dst,
+                           const AVFrame *src)
+{
+    av_assert0(num_dst == graph->num_dst);
     av_assert0(src->format == graph->src.hw_format || src->format == graph->src.format);
+    for (int i = 0; i < num_dst; i++) {
+        av_assert0(dst[i]->format == graph->dst[i].hw_format ||
+                   dst[i]->format == graph->dst[i].format);
+    }
 
-    SwsFrame src_field, dst_field;
-    get_field(graph, dst, &dst_field);
+    SwsFrame src_field;
     get_field(graph, src, &src_field);
+    for (int i = 0; i < num_dst; i++)
+        get_field(graph, dst[i], &graph->exec.dst[i]);
 
     for (int i = 0; i < graph->num_passes; i++) {
         const SwsPass *pass = graph->passes[i];
-        graph->exec.pass   = pass;
-        graph->exec.input  = pass->input ? &pass->input->output->frame : &src_field;
-        graph->exec.output = pass->output->avframe ? &pass->output->frame : &dst_field;
+        graph->exec.pass     = pass;
+        graph->exec.pass_idx = i;
+        graph->exec.input    = pass_frame(graph, pass->input, &src_field);
+        graph->exec.output   = pass_frame(graph, pass, NULL);
+
+        if (pass->num_fused) {
+            int ret = run_bands(graph, i);
+            if (ret < 0)
+                return ret;
+            i += pass->num_fused;
+            continue;
+        }
+
         if (pass->setup) {
             int ret = pass->setup(graph->exec.output, graph->exec.input, pass);
             if (ret < 0)
@@ -1003,3 +1549,8 @@ int ff_sws_graph_run(SwsGraph *graph, const AVFrame *dst, const AVFrame *src)
 
     return 0;
 }
+
+int ff_sws_graph_run(SwsGraph *graph, const AVFrame *dst, const AVFrame *src)
+{
+    return ff_sws_graph_run_multi(graph, &dst, 1, src);
+}
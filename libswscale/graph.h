@@ -61,8 +61,22 @@ typedef struct SwsPassBuffer {
 
     int width, height; /* dimensions of this buffer */
     AVFrame *avframe;  /* backing storage for `frame` */
+
+    /**
+     * For the output of a pass that is fused with its consumer, one strip
+     * per thread holding a single band of lines, in place of `avframe`.
+     */
+    AVFrame **strips;
+    int num_strips;
 } SwsPassBuffer;
 
+enum SwsPassFlags {
+    /* `run` may be called on any range of lines aligned to `align` */
+    SWS_PASS_ANY_SLICE = 1 << 0,
+    /* Output line `y` only depends on input line `y` (no vertical scaling) */
+    SWS_PASS_ROWWISE   = 1 << 1,
+};
+
 /**
  * Represents a single filter pass in the scaling graph. Each filter will
  * read from some previous pass's output, and write to a buffer associated
@@ -81,6 +95,16 @@ struct SwsPass {
     int width, height; /* new output size */
     int slice_h;       /* filter granularity */
     int num_slices;
+    int align;         /* minimum slice alignment, or 0 for no threading */
+    int flags;         /* combination of SwsPassFlags */
+
+    /**
+     * Number of passes following this one that are fused into it. The
+     * whole group is executed band by band, `band_h` output lines at a
+     * time, with the intermediate results only held in per-thread strips.
+     */
+    int num_fused;
+    int band_h;
 
     /**
      * Filter input. This pass's output will be resolved to form this pass's.
@@ -93,6 +117,13 @@ struct SwsPass {
      */
     SwsPassBuffer *output; /* refstruct */
 
+    /**
+     * Index of the graph output written to by this pass, or -1 for passes
+     * writing into their own intermediate `output` buffer. Passes reading
+     * from a pass with a valid index read directly from that output image.
+     */
+    int dst_idx;
+
     /**
      * Called once from the main thread before running the filter. Optional.
      * Returns 0 or a negative error code.
@@ -129,9 +160,13 @@ typedef struct SwsGraph {
     SwsContext opts_copy;
 
     /**
-     * Currently active format and processing parameters.
+     * Currently active format and processing parameters. Graphs created by
+     * ff_sws_graph_create_multi() have more than one output.
      */
-    SwsFormat src, dst;
+    SwsFormat src;
+    SwsFormat *dst;
+    bool *dst_noop; /* set for outputs that are plain copies of the source */
+    int num_dst;
     int field;
 
     /**
@@ -140,8 +175,10 @@ typedef struct SwsGraph {
      */
     struct {
         const SwsPass *pass; /* current filter pass */
+        int pass_idx;
         const SwsFrame *input; /* current filter pass input/output */
         const SwsFrame *output;
+        SwsFrame *dst; /* array of num_dst output images */
     } exec;
 } SwsGraph;
 
@@ -151,6 +188,16 @@ typedef struct SwsGraph {
 int ff_sws_graph_create(SwsContext *ctx, const SwsFormat *dst, const SwsFormat *src,
                         int field, SwsGraph **out_graph);
 
+/**
+ * Like ff_sws_graph_create(), but for a graph producing `num_dst` outputs
+ * from a single source. With SWS_SHARE_INPUT, work that only depends on the
+ * source (unpacking, color mapping) is shared between all outputs where
+ * possible; with SWS_CASCADE, smaller outputs may also be derived from
+ * larger ones.
+ */
+int ff_sws_graph_create_multi(SwsContext *ctx, const SwsFormat *dst, int num_dst,
+                              const SwsFormat *src, int field, SwsGraph **out_graph);
+
 
 /**
  * Allocate and add a new pass to the filter graph. Takes over ownership of
@@ -185,6 +232,12 @@ void ff_sws_graph_rollback(SwsGraph *graph, int since_idx);
  */
 void ff_sws_graph_free(SwsGraph **graph);
 
+/**
+ * Return a graph that is no longer needed by `ctx` to its graph cache, if it
+ * has one, or free it otherwise. Writes NULL to the provided pointer.
+ */
+void ff_sws_graph_release(SwsContext *ctx, SwsGraph **graph);
+
 /**
  * Update dynamic per-frame HDR metadata without requiring a full reinit.
  */
@@ -192,17 +245,31 @@ void ff_sws_graph_update_metadata(SwsGraph *graph, const SwsColor *color);
 
 /**
  * Wrapper around ff_sws_graph_create() that reuses the existing graph if the
- * format is compatible. This will also update dynamic per-frame metadata.
- * Must be called after changing any of the fields in `ctx`, or else they will
- * have no effect.
+ * format is compatible, or takes a matching graph from `ctx->graph_cache`
+ * if set. This will also update dynamic per-frame metadata. Must be called
+ * after changing any of the fields in `ctx`, or else they will have no
+ * effect.
  */
 int ff_sws_graph_reinit(SwsContext *ctx, const SwsFormat *dst, const SwsFormat *src,
                         int field, SwsGraph **graph);
 
+/**
+ * Multi-output version of ff_sws_graph_reinit().
+ */
+int ff_sws_graph_reinit_multi(SwsContext *ctx, const SwsFormat *dst, int num_dst,
+                              const SwsFormat *src, int field, SwsGraph **graph);
+
 /**
  * Dispatch the filter graph on a single field of the given frames. Internally
  * threaded.
  */
 int ff_sws_graph_run(SwsGraph *graph, const AVFrame *dst, const AVFrame *src);
 
+/**
+ * Multi-output version of ff_sws_graph_run(). `dst` must contain one frame
+ * for each output of the graph, in the same order as passed at creation.
+ */
+int ff_sws_graph_run_multi(SwsGraph *graph, const AVFrame *const dst[], int num_dst,
+                           const AVFrame *src);
+
 #endif /* SWSCALE_GRAPH_H */
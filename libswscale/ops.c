@@ -33,10 +33,14 @@
 extern const SwsOpBackend backend_c;
 extern const SwsOpBackend backend_murder;
 extern const SwsOpBackend backend_x86;
+extern const SwsOpBackend backend_x86_jit;
 extern const SwsOpBackend backend_vulkan;
 
 const SwsOpBackend * const ff_sws_op_backends[] = {
     &backend_murder,
+#if ARCH_X86_64
+    &backend_x86_jit,
+#endif
 #if ARCH_X86_64 && HAVE_X86ASM
     &backend_x86,
 #endif
@@ -123,15 +123,25 @@ static void op_pass_free(void *ptr)
     av_free(p);
 }
 
+/**
+ * Plane pointers are taken from the frames passed to run(), rather than the
+ * ones seen by setup(), since fused passes run on a different strip buffer
+ * per thread. Only the layout has to match.
+ */
 static inline void get_row_data(const SwsOpPass *p, const int y_dst,
+                                const SwsFrame *in_frame, const SwsFrame *out_frame,
                                 const uint8_t *in[4], uint8_t *out[4])
 {
     const SwsOpExec *base = &p->exec_base;
     const int y_src = p->offsets_y ? p->offsets_y[y_dst] : y_dst;
-    for (int i = 0; i < p->planes_in; i++)
-        in[i] = base->in[i] + (y_src >> base->in_sub_y[i]) * base->in_stride[i];
-    for (int i = 0; i < p->planes_out; i++)
-        out[i] = base->out[i] + (y_dst >> base->out_sub_y[i]) * base->out_stride[i];
+    for (int i = 0; i < p->planes_in; i++) {
+        const uint8_t *data = in_frame->data[p->idx_in[i]];
+        in[i] = data + (y_src >> base->in_sub_y[i]) * base->in_stride[i];
+    }
+    for (int i = 0; i < p->planes_out; i++) {
+        uint8_t *data = out_frame->data[p->idx_out[i]];
+        out[i] = data + (y_dst >> base->out_sub_y[i]) * base->out_stride[i];
+    }
 }
 
 static int op_pass_setup(const SwsFrame *out, const SwsFrame *in,
@@ -307,7 +317,8 @@ static void op_pass_run(const SwsFrame *out, const SwsFrame *in, const int y,
     const bool memcpy_out = p->memcpy_out;
     const int num_blocks  = p->num_blocks;
 
-    get_row_data(p, y, exec.in, exec.out);
+    av_assert1(in->linesize[p->idx_in[0]] == exec.in_stride[0]);
+    get_row_data(p, y, in, out, exec.in, exec.out);
     if (!memcpy_in && !memcpy_out) {
         /* Fast path (fully aligned/padded inputs and outputs) */
         comp->func(&exec, comp->priv, 0, y, num_blocks, y + h);
@@ -459,9 +470,16 @@ static int compile(SwsGraph *graph, const SwsOpList *ops, SwsPass *input,
         p->filter_size = filter->filter_size;
     }
 
-    return ff_sws_graph_add_pass(graph, dst->format, dst->width, dst->height,
-                                 input, p->comp.slice_align, op_pass_run,
-                                 op_pass_setup, p, op_pass_free, output);
+    ret = ff_sws_graph_add_pass(graph, dst->format, dst->width, dst->height,
+                                input, p->comp.slice_align, op_pass_run,
+                                op_pass_setup, p, op_pass_free, output);
+    if (ret < 0)
+        return ret;
+
+    (*output)->flags = SWS_PASS_ANY_SLICE;
+    if (read->rw.filter != SWS_OP_FILTER_V && ops->src.height == dst->height)
+        (*output)->flags |= SWS_PASS_ROWWISE;
+    return 0;
 
 fail:
     op_pass_free(p);
@@ -51,6 +51,9 @@ static const AVOption swscale_options[] = {
         { "bitexact",        "bit-exact mode",                0,  AV_OPT_TYPE_CONST, { .i64 = SWS_BITEXACT       }, .flags = VE, .unit = "sws_flags" },
         { "error_diffusion", "error diffusion dither",        0,  AV_OPT_TYPE_CONST, { .i64 = SWS_ERROR_DIFFUSION}, .flags = VE, .unit = "sws_flags" },
         { "unstable",        "allow experimental new code",   0,  AV_OPT_TYPE_CONST, { .i64 = SWS_UNSTABLE       }, .flags = VE, .unit = "sws_flags" },
+        { "cascade",         "derive small outputs from large ones", 0, AV_OPT_TYPE_CONST, { .i64 = SWS_CASCADE  }, .flags = VE, .unit = "sws_flags" },
+        { "share_input",     "convert the source once for all outputs", 0, AV_OPT_TYPE_CONST, { .i64 = SWS_SHARE_INPUT }, .flags = VE, .unit = "sws_flags" },
+        { "no_jit",          "never generate code at run time", 0, AV_OPT_TYPE_CONST, { .i64 = SWS_NO_JIT   }, .flags = VE, .unit = "sws_flags" },
 
     { "scaler",          "set scaling algorithm",         OFFSET(scaler),       AV_OPT_TYPE_INT,    { .i64 = SWS_SCALE_AUTO     }, .flags = VE, .unit = "sws_scaler", .max = SWS_SCALE_NB - 1 },
     { "scaler_sub",      "set subsampling algorithm",     OFFSET(scaler_sub),   AV_OPT_TYPE_INT,    { .i64 = SWS_SCALE_AUTO     }, .flags = VE, .unit = "sws_scaler", .max = SWS_SCALE_NB - 1 },
@@ -1419,28 +1419,37 @@ static int validate_params(SwsContext *ctx)
     return 0;
 }
 
-int sws_frame_setup(SwsContext *ctx, const AVFrame *dst, const AVFrame *src)
+static int frame_setup(SwsContext *ctx, const AVFrame *const dst[], int nb_dst,
+                       const AVFrame *src)
 {
     SwsInternal *s = sws_internal(ctx);
+    SwsFormat dst_fmts[SWS_MAX_OUTPUTS];
     const char *err_msg;
     int ret;
 
-    if (!src || !dst)
+    if (!src || !dst || nb_dst <= 0 || nb_dst > SWS_MAX_OUTPUTS)
         return AVERROR(EINVAL);
+    for (int i = 0; i < nb_dst; i++) {
+        if (!dst[i])
+            return AVERROR(EINVAL);
+    }
     if ((ret = validate_params(ctx)) < 0)
         return ret;
 
+    if (nb_dst > 1 && src->hw_frames_ctx)
+        return AVERROR(ENOTSUP);
+
     /* For now, if a single frame has a context, then both need a context */
-    if (!!src->hw_frames_ctx != !!dst->hw_frames_ctx) {
+    if (!!src->hw_frames_ctx != !!dst[0]->hw_frames_ctx) {
         return AVERROR(ENOTSUP);
     } else if (!!src->hw_frames_ctx) {
         /* Both hardware frames must already be allocated */
-        if (!src->data[0] || !dst->data[0])
+        if (!src->data[0] || !dst[0]->data[0])
             return AVERROR(EINVAL);
 
         AVHWFramesContext *src_hwfc, *dst_hwfc;
         src_hwfc = (AVHWFramesContext *)src->hw_frames_ctx->data;
-        dst_hwfc = (AVHWFramesContext *)dst->hw_frames_ctx->data;
+        dst_hwfc = (AVHWFramesContext *)dst[0]->hw_frames_ctx->data;
 
         /* Both frames must live on the same device */
         if (src_hwfc->device_ref->data != dst_hwfc->device_ref->data)
@@ -1461,24 +1470,28 @@ int sws_frame_setup(SwsContext *ctx, const AVFrame *dst, const AVFrame *src)
 
     for (int field = 0; field < 2; field++) {
         SwsFormat src_fmt = ff_fmt_from_frame(src, field);
-        SwsFormat dst_fmt = ff_fmt_from_frame(dst, field);
+        SwsFormat dst_fmt;
         int src_ok, dst_ok;
 
-        if ((src->flags ^ dst->flags) & AV_FRAME_FLAG_INTERLACED) {
-            err_msg = "Cannot convert interlaced to progressive frames or vice versa.\n";
-            ret = AVERROR(EINVAL);
-            goto fail;
-        }
+        for (int i = 0; i < nb_dst; i++) {
+            dst_fmt = dst_fmts[i] = ff_fmt_from_frame(dst[i], field);
+            if ((src->flags ^ dst[i]->flags) & AV_FRAME_FLAG_INTERLACED) {
+                err_msg = "Cannot convert interlaced to progressive frames or vice versa.\n";
+                ret = AVERROR(EINVAL);
+                goto fail;
+            }
 
-        src_ok = ff_test_fmt(&src_fmt, 0);
-        dst_ok = ff_test_fmt(&dst_fmt, 1);
-        if ((!src_ok || !dst_ok) && !ff_props_equal(&src_fmt, &dst_fmt)) {
-            err_msg = src_ok ? "Unsupported output" : "Unsupported input";
-            ret = AVERROR(ENOTSUP);
-            goto fail;
+            src_ok = ff_test_fmt(&src_fmt, 0);
+            dst_ok = ff_test_fmt(&dst_fmt, 1);
+            if ((!src_ok || !dst_ok) && !ff_props_equal(&src_fmt, &dst_fmt)) {
+                err_msg = src_ok ? "Unsupported output" : "Unsupported input";
+                ret = AVERROR(ENOTSUP);
+                goto fail;
+            }
         }
 
-        ret = ff_sws_graph_reinit(ctx, &dst_fmt, &src_fmt, field, &s->graph[field]);
+        ret = ff_sws_graph_reinit_multi(ctx, dst_fmts, nb_dst, &src_fmt, field,
+                                        &s->graph[field]);
         if (ret < 0) {
             err_msg = "Failed initializing scaling graph";
             goto fail;
@@ -1491,7 +1504,7 @@ int sws_frame_setup(SwsContext *ctx, const AVFrame *dst, const AVFrame *src)
         }
 
         if (!src_fmt.interlaced) {
-            ff_sws_graph_free(&s->graph[FIELD_BOTTOM]);
+            ff_sws_graph_release(ctx, &s->graph[FIELD_BOTTOM]);
             break;
         }
 
@@ -1515,6 +1528,71 @@ int sws_frame_setup(SwsContext *ctx, const AVFrame *dst, const AVFrame *src)
     return 0;
 }
 
+int sws_frame_setup(SwsContext *ctx, const AVFrame *dst, const AVFrame *src)
+{
+    return frame_setup(ctx, &dst, 1, src);
+}
+
+int sws_scale_frames(SwsContext *sws, AVFrame *const dst[], int nb_dst,
+                     const AVFrame *src)
+{
+    SwsInternal *c = sws_internal(sws);
+    int ret;
+
+    if (!src || !dst || nb_dst <= 0)
+        return AVERROR(EINVAL);
+
+    if (nb_dst == 1 || nb_dst > SWS_MAX_OUTPUTS || c->is_legacy_init ||
+        src->hw_frames_ctx)
+    {
+        /* No shared graph, scale each output independently */
+        for (int i = 0; i < nb_dst; i++) {
+            ret = sws_scale_frame(sws, dst[i], src);
+            if (ret < 0)
+                return ret;
+        }
+        return 0;
+    }
+
+    ret = frame_setup(sws, (const AVFrame *const *) dst, nb_dst, src);
+    if (ret < 0)
+        return ret;
+
+    if (!src->data[0])
+        return 0;
+
+    const SwsGraph *top = c->graph[FIELD_TOP];
+    const SwsGraph *bot = c->graph[FIELD_BOTTOM];
+    for (int i = 0; i < nb_dst; i++) {
+        AVFrame *out = dst[i];
+        if (out->data[0]) /* user-provided buffers */
+            continue;
+
+        /* Sanity */
+        memset(out->buf, 0, sizeof(out->buf));
+        memset(out->data, 0, sizeof(out->data));
+        memset(out->linesize, 0, sizeof(out->linesize));
+        out->extended_data = out->data;
+
+        /* The copy pass of this output sees the same image and skips it */
+        if (src->buf[0] && top->dst_noop[i] && (!bot || bot->dst_noop[i]))
+            ret = frame_ref(out, src);
+        else
+            ret = av_frame_get_buffer(out, 0);
+        if (ret < 0)
+            return ret;
+    }
+
+    for (int field = 0; field < (c->graph[FIELD_BOTTOM] ? 2 : 1); field++) {
+        ret = ff_sws_graph_run_multi(c->graph[field], (const AVFrame *const *) dst,
+                                     nb_dst, src);
+        if (ret < 0)
+            return ret;
+    }
+
+    return 0;
+}
+
 /**
  * swscale wrapper, so we don't need to export the SwsContext.
  * Assumes planar YUV to be in YUV order instead of YVU.
@@ -163,6 +163,30 @@ typedef enum SwsFlags {
      */
     SWS_UNSTABLE = 1 << 20,
 
+    /**
+     * When scaling to multiple outputs with sws_scale_frames(), allow
+     * deriving smaller outputs from already scaled larger ones (of at least
+     * twice the size), rather than always scaling from the full source. This
+     * saves memory bandwidth, at the cost of slightly different output.
+     */
+    SWS_CASCADE  = 1 << 21,
+
+    /**
+     * Never generate machine code at run time. Use this where mapping
+     * executable memory is disallowed by policy, or to compare against the
+     * statically compiled backends. Output is identical either way.
+     */
+    SWS_NO_JIT   = 1 << 22,
+
+    /**
+     * When scaling to multiple outputs with sws_scale_frames(), and all
+     * outputs share the same format and color properties, convert the source
+     * to those properties only once at its original resolution, and scale
+     * all outputs from this intermediate. This saves repeated unpacking and
+     * color mapping, at the cost of slightly different output.
+     */
+    SWS_SHARE_INPUT = 1 << 24,
+
     /**
      * Deprecated flags.
      */
@@ -198,6 +222,8 @@ typedef enum SwsIntent {
  * Context creation and management *
  ***********************************/
 
+typedef struct SwsGraphCache SwsGraphCache;
+
 /**
  * Main external API structure. New fields can be added to the end with
  * minor version bumps. Removal, reordering and changes to existing fields
@@ -280,6 +306,19 @@ typedef struct SwsContext {
      */
     SwsScaler scaler_sub;
 
+    /**
+     * Cache of scaling graphs, see sws_graph_cache_alloc(). If set, graphs
+     * that are no longer needed after a change in frame properties are kept
+     * around and reused when the same configuration comes back, instead of
+     * being rebuilt from scratch. The same cache may be shared by any number
+     * of contexts, including ones used from different threads.
+     *
+     * Not owned by the context; must outlive every context using it.
+     *
+     * Note: Does not affect the legacy (stateful) API.
+     */
+    SwsGraphCache *graph_cache;
+
     /* Remember to add new fields to graph.c:opts_equal() */
 } SwsContext;
 
@@ -294,6 +333,22 @@ SwsContext *sws_alloc_context(void);
  */
 void sws_free_context(SwsContext **ctx);
 
+/**
+ * Allocate a cache of scaling graphs, to be set as `SwsContext.graph_cache`.
+ * Graphs are evicted in least recently used order.
+ *
+ * @param max_graphs Maximum number of unused graphs kept in the cache, or
+ *                   0 for a default value.
+ * @return The new cache, or NULL on allocation failure.
+ */
+SwsGraphCache *sws_graph_cache_alloc(int max_graphs);
+
+/**
+ * Free the cache and all graphs in it, and write NULL to the provided
+ * pointer. Must not be called while any context still references it.
+ */
+void sws_graph_cache_free(SwsGraphCache **cache);
+
 /***************************
  * Supported frame formats *
  ***************************/
@@ -405,6 +460,29 @@ int sws_is_noop(const AVFrame *dst, const AVFrame *src);
  */
 int sws_scale_frame(SwsContext *c, AVFrame *dst, const AVFrame *src);
 
+/**
+ * Scale a single source frame to several destination frames at once.
+ *
+ * All outputs are processed by a single graph, in a single threaded dispatch.
+ * By default, each destination receives the same data as if `sws_scale_frame`
+ * had been called for it on its own. The flags `SWS_SHARE_INPUT` and
+ * `SWS_CASCADE` allow sharing more work between the outputs, in exchange
+ * for output that is no longer identical to separate conversions.
+ *
+ * This is intended for producing multiple renditions of the same video.
+ * Contexts that were explicitly initialized with `sws_init_context()`, or
+ * hardware frames, fall back to scaling each output independently.
+ *
+ * @param ctx    The scaling context.
+ * @param dst    Array of `nb_dst` destination frames, with the same semantics
+ *               as the `dst` argument to `sws_scale_frame`.
+ * @param nb_dst Number of destination frames.
+ * @param src    The source frame.
+ * @return >= 0 on success, a negative AVERROR code on failure.
+ */
+int sws_scale_frames(SwsContext *ctx, AVFrame *const dst[], int nb_dst,
+                     const AVFrame *src);
+
 /**
  * Filter kernel cut-off value. Values below this (absolute) magnitude
  * are cut off from the main filter kernel. Note that the window is
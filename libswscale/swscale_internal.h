@@ -54,6 +54,7 @@
 #define MAX_FILTER_SIZE SWS_MAX_FILTER_SIZE
 
 #define SWS_MAX_THREADS 8192 /* sanity clamp */
+#define SWS_MAX_OUTPUTS 16   /* max. number of outputs sharing one graph */
 
 #if HAVE_BIGENDIAN
 #define ALT32_CORR (-1)
@@ -708,7 +709,7 @@ static_assert(offsetof(SwsInternal, redDither) + DITHER32_INT == offsetof(SwsInt
 #if ARCH_X86_64
 /* x86 yuv2gbrp uses the SwsInternal for yuv coefficients
    if struct offsets change the asm needs to be updated too */
-static_assert(offsetof(SwsInternal, yuv2rgb_y_offset) == 40348,
+static_assert(offsetof(SwsInternal, yuv2rgb_y_offset) == 40364,
               "yuv2rgb_y_offset must be updated in x86 asm");
 #endif
 
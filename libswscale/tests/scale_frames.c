@@ -0,0 +1,163 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/**
+ * Check that sws_scale_frames() without SWS_SHARE_INPUT or SWS_CASCADE
+ * produces the same output as separate sws_scale_frame() calls, and that
+ * outputs matching the source are references to it.
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include "libavutil/error.h"
+#include "libavutil/frame.h"
+#include "libavutil/imgutils.h"
+#include "libavutil/lfg.h"
+#include "libavutil/macros.h"
+#include "libavutil/pixdesc.h"
+
+#include "libswscale/swscale.h"
+
+#define SRC_W 176
+#define SRC_H 144
+
+static const struct {
+    enum AVPixelFormat src, dst;
+} formats[] = {
+    { AV_PIX_FMT_YUV420P, AV_PIX_FMT_YUV420P },
+    { AV_PIX_FMT_YUV420P, AV_PIX_FMT_RGB24   },
+    { AV_PIX_FMT_RGB24,   AV_PIX_FMT_YUV420P },
+    { AV_PIX_FMT_RGBA,    AV_PIX_FMT_GBRAP   },
+    { AV_PIX_FMT_YUV422P, AV_PIX_FMT_YUV444P },
+};
+
+/* the first output has the size of the source */
+static const int sizes[][2] = {
+    { SRC_W,     SRC_H     },
+    { SRC_W / 2, SRC_H / 2 },
+    { 320,       240       },
+    { 58,        30        },
+};
+
+#define NB_OUTPUTS FF_ARRAY_ELEMS(sizes)
+
+static AVFrame *alloc_frame(enum AVPixelFormat format, int w, int h)
+{
+    AVFrame *frame = av_frame_alloc();
+    if (!frame)
+        return NULL;
+    frame->format = format;
+    frame->width  = w;
+    frame->height = h;
+    return frame;
+}
+
+static int frames_equal(const AVFrame *a, const AVFrame *b)
+{
+    const AVPixFmtDescriptor *desc = av_pix_fmt_desc_get(a->format);
+
+    for (int p = 0; p < av_pix_fmt_count_planes(a->format); p++) {
+        const int h = (p == 1 || p == 2) ? AV_CEIL_RSHIFT(a->height, desc->log2_chroma_h)
+                                         : a->height;
+        const int w = av_image_get_linesize(a->format, a->width, p);
+        for (int y = 0; y < h; y++) {
+            if (memcmp(a->data[p] + y * a->linesize[p],
+                       b->data[p] + y * b->linesize[p], w))
+                return 0;
+        }
+    }
+    return 1;
+}
+
+static int run_test(const AVFrame *src, enum AVPixelFormat dst_fmt)
+{
+    AVFrame *multi[NB_OUTPUTS] = { NULL }, *single = NULL;
+    SwsContext *ctx = sws_alloc_context(), *ref = sws_alloc_context();
+    int ret = AVERROR(ENOMEM);
+
+    if (!ctx || !ref)
+        goto end;
+    ctx->flags = ref->flags = SWS_BICUBIC | SWS_BITEXACT | SWS_ACCURATE_RND;
+
+    for (int i = 0; i < NB_OUTPUTS; i++) {
+        multi[i] = alloc_frame(dst_fmt, sizes[i][0], sizes[i][1]);
+        if (!multi[i])
+            goto end;
+    }
+
+    ret = sws_scale_frames(ctx, multi, NB_OUTPUTS, src);
+    if (ret < 0) {
+        fprintf(stderr, "sws_scale_frames() failed: %s\n", av_err2str(ret));
+        goto end;
+    }
+
+    for (int i = 0; i < NB_OUTPUTS; i++) {
+        single = alloc_frame(dst_fmt, sizes[i][0], sizes[i][1]);
+        if (!single) {
+            ret = AVERROR(ENOMEM);
+            goto end;
+        }
+        ret = sws_scale_frame(ref, single, src);
+        if (ret < 0) {
+            fprintf(stderr, "sws_scale_frame() failed: %s\n", av_err2str(ret));
+            goto end;
+        }
+
+        printf("%s -> %s %dx%d: %s%s\n", av_get_pix_fmt_name(src->format),
+               av_get_pix_fmt_name(dst_fmt), sizes[i][0], sizes[i][1],
+               frames_equal(multi[i], single) ? "same" : "different",
+               multi[i]->data[0] == src->data[0] ? ", source reference" : "");
+        av_frame_free(&single);
+    }
+
+    ret = 0;
+end:
+    for (int i = 0; i < NB_OUTPUTS; i++)
+        av_frame_free(&multi[i]);
+    av_frame_free(&single);
+    sws_free_context(&ctx);
+    sws_free_context(&ref);
+    return ret;
+}
+
+int main(void)
+{
+    AVLFG lfg;
+    int ret = 0;
+
+    av_lfg_init(&lfg, 1);
+
+    for (int i = 0; i < FF_ARRAY_ELEMS(formats) && ret >= 0; i++) {
+        AVFrame *src = alloc_frame(formats[i].src, SRC_W, SRC_H);
+        if (!src || av_frame_get_buffer(src, 0) < 0) {
+            av_frame_free(&src);
+            return 1;
+        }
+
+        for (int p = 0; p < 4 && src->buf[p]; p++) {
+            for (size_t j = 0; j < src->buf[p]->size; j++)
+                src->buf[p]->data[j] = av_lfg_get(&lfg);
+        }
+
+        ret = run_test(src, formats[i].dst);
+        av_frame_free(&src);
+    }
+
+    return ret < 0;
+}
@@ -2292,7 +2292,7 @@ void sws_freeContext(SwsContext *sws)
     av_refstruct_unref(&c->hw_priv);
 
     for (i = 0; i < FF_ARRAY_ELEMS(c->graph); i++)
-        ff_sws_graph_free(&c->graph[i]);
+        ff_sws_graph_release(sws, &c->graph[i]);
 
     for (i = 0; i < c->nb_slice_ctx; i++)
         sws_freeContext(c->slice_ctx[i]);
@@ -364,6 +364,10 @@ static int setup_filter_h(const SwsImplParams *params, SwsImplResult *out)
         float *f32;
     } weights;
 
+    /* The AVX-512 kernels widen each half of the gather separately, and
+     * expect the taps of each pixel to stay contiguous */
+    const bool interleave = !(params->table->cpu_flags & AV_CPU_FLAG_AVX512);
+
     const int sizeof_weight = hscale_sizeof_weight(op);
     weights.ptr = av_calloc(line_size, sizeof_weight * aligned_size);
     if (!weights.ptr)
@@ -383,7 +387,7 @@ static int setup_filter_h(const SwsImplParams *params, SwsImplResult *out)
             for (int i = 0; i < elems; i++) {
                 const int w = filter->weights[(x + i) * filter_size + j];
                 size_t idx = idx_base;
-                if (op->type == SWS_PIXEL_U8) {
+                if (op->type == SWS_PIXEL_U8 && interleave) {
                     /* Interleave the pixels within each lane, i.e.:
                      *  [a0 a1 a2 a3 | b0 b1 b2 b3 ] pixels 0-1, taps 0-3 (lane 0)
                      *  [e0 e1 e2 e3 | f0 f1 f2 f3 ] pixels 4-5, taps 0-3 (lane 1)
@@ -530,6 +534,56 @@ static int setup_filter_4x4_h(const SwsImplParams *params, SwsImplResult *out)
     &op_##NAME##3##SUFFIX,                                                      \
     &op_##NAME##4##SUFFIX
 
+#if HAVE_AVX512_EXTERNAL
+static bool check_filter_h_avx512(const SwsImplParams *params)
+{
+    /**
+     * Only use the wider gathers where the AVX2 gather kernel would also have
+     * been picked, since the 4x4 kernel is tuned to win everywhere else. For
+     * u8 with a single gather per pixel (up to 4 taps), the extra widening
+     * step makes this no faster than the AVX2 kernel.
+     */
+    const SwsOp *op = params->op;
+    const SwsFilterWeights *filter = op->rw.kernel;
+    if (op->type == SWS_PIXEL_U8 && filter->filter_size <= 4)
+        return false;
+    return !check_filter_4x4_h(params);
+}
+
+#define DECL_FILTERS_AVX512(TYPE)                                               \
+    DECL_FILTERS(_avx512, TYPE, V, filter_v,     .setup = setup_filter_v)       \
+    DECL_FILTERS(_avx512, TYPE, V, filter_fma_v, .setup = setup_filter_v,       \
+                 .check = check_filter_fma)                                     \
+    DECL_FILTERS(_avx512, TYPE, H, filter_h,     .setup = setup_filter_h,       \
+                 .check = check_filter_h_avx512)
+
+DECL_FILTERS_AVX512( U8)
+DECL_FILTERS_AVX512(U16)
+DECL_FILTERS_AVX512(F32)
+
+/**
+ * Filter kernels only; these produce the same register layout as the AVX2
+ * kernels, and are chained together with them. Must come before the AVX2
+ * tables so that they take priority on equal scores.
+ */
+static const SwsOpTable ops_filter_avx512 = {
+    .cpu_flags = AV_CPU_FLAG_AVX512,
+    .block_size = 16,
+    .entries = {
+        REF_FILTERS(filter_fma_v, _U8_avx512),
+        REF_FILTERS(filter_fma_v, _U16_avx512),
+        REF_FILTERS(filter_fma_v, _F32_avx512),
+        REF_FILTERS(filter_v, _U8_avx512),
+        REF_FILTERS(filter_v, _U16_avx512),
+        REF_FILTERS(filter_v, _F32_avx512),
+        REF_FILTERS(filter_h, _U8_avx512),
+        REF_FILTERS(filter_h, _U16_avx512),
+        REF_FILTERS(filter_h, _F32_avx512),
+        NULL
+    },
+};
+#endif /* HAVE_AVX512_EXTERNAL */
+
 #define DECL_FUNCS_8(SIZE, EXT, FLAG)                                           \
     DECL_RW(EXT, U8, read_planar,   READ,  1, false, 0)                         \
     DECL_RW(EXT, U8, read_planar,   READ,  2, false, 0)                         \
@@ -825,6 +879,9 @@ DECL_FUNCS_16(32, _m2_avx2, AVX2)
 DECL_FUNCS_32(16, _avx2, AVX2)
 
 static const SwsOpTable *const tables[] = {
+#if HAVE_AVX512_EXTERNAL
+    &ops_filter_avx512,
+#endif
     &ops8_m1_sse4,
     &ops8_m1_avx2,
     &ops8_m2_sse4,
@@ -824,3 +824,247 @@ decl_common_patterns scale
 dither_fns
 linear_fns
 filter_fns
+
+;---------------------------------------------------------
+; AVX-512 filter kernels
+;
+; These process the same 16 pixel block as the AVX2 kernels above, but use
+; a single ZMM register (and a single gather) per component instead of a
+; pair of YMM registers. The results are split back into the usual mx/mx2
+; register pairs at the end, so the rest of the chain stays on AVX2.
+;
+; Note that under INIT_ZMM, x86inc renumbers m0-m15 to zmm16-zmm31 to avoid
+; the need for vzeroupper; so the accumulators m0-m3 below are distinct from
+; the ymm0-ymm7 registers of the calling convention, which are spelled out
+; explicitly instead.
+
+%if HAVE_AVX512_EXTERNAL
+
+; Split the ZMM accumulators into the low/high YMM halves of mx..mw
+%macro split_zmm 1 ; elems
+            vextractf64x4 ymm4, m0, 1
+            vmovaps       ymm0, ym0
+IF %1 > 1,  vextractf64x4 ymm5, m1, 1
+IF %1 > 1,  vmovaps       ymm1, ym1
+IF %1 > 2,  vextractf64x4 ymm6, m2, 1
+IF %1 > 2,  vmovaps       ymm2, ym2
+IF %1 > 3,  vextractf64x4 ymm7, m3, 1
+IF %1 > 3,  vmovaps       ymm3, ym3
+%endmacro
+
+%macro filter_v_iter_zmm 3 ; elems, type, variant
+            vbroadcastss m12, [weights]
+            fload%2 m8,  [in0q]
+IF %1 > 1,  fload%2 m9,  [in1q]
+IF %1 > 2,  fload%2 m10, [in2q]
+IF %1 > 3,  fload%2 m11, [in3q]
+            fmaccum %3, m0, m8,  m12
+IF %1 > 1,  fmaccum %3, m1, m9,  m12
+IF %1 > 2,  fmaccum %3, m2, m10, m12
+IF %1 > 3,  fmaccum %3, m3, m11, m12
+%endmacro
+
+%macro filter_v_zmm 4 ; elems, type, sizeof_type, variant
+op filter_%4%1_%2
+%xdefine weights tmp0q
+%xdefine fltsize tmp1q
+            mov weights, [implq + SwsOpImpl.priv]     ; float *weights
+            mov fltsize, [implq + SwsOpImpl.priv + 8] ; size_t filter_size
+            ; weights += filter_size * y * sizeof(float)
+            mov tmp2q, fltsize
+            imul tmp2q, yq
+            lea weights, [weights + 4 * tmp2q]
+            filter_v_iter_zmm %1, %2, none
+            dec fltsize
+            jz .done
+            push in0q
+IF %1 > 1,  push in1q
+IF %1 > 2,  push in2q
+IF %1 > 3,  push in3q
+.loop:
+            add in0q, [execq + SwsOpExec.in_stride0]
+IF %1 > 1,  add in1q, [execq + SwsOpExec.in_stride1]
+IF %1 > 2,  add in2q, [execq + SwsOpExec.in_stride2]
+IF %1 > 3,  add in3q, [execq + SwsOpExec.in_stride3]
+            add weights, 4
+            filter_v_iter_zmm %1, %2, %4
+            dec fltsize
+            jnz .loop
+IF %1 > 3,  pop in3q
+IF %1 > 2,  pop in2q
+IF %1 > 1,  pop in1q
+            pop in0q
+.done:
+            split_zmm %1
+            LOAD_CONT tmp0q
+IF %1 > 3,  add in3q, 16 * %3
+IF %1 > 2,  add in2q, 16 * %3
+IF %1 > 1,  add in1q, 16 * %3
+            add in0q, 16 * %3
+            CONTINUE tmp0q
+%undef weights
+%undef fltsize
+%endmacro
+
+; The U8 kernel widens each half of the gathered taps separately, leaving
+; pairs of partial sums per pixel in two accumulators; these are only
+; reduced once at the end (see hsum_pairs)
+%macro filter_h_iter_zmm_U8 4 ; acc, acc2, src, first
+        kxnorw k1, k1, k1
+        vpgatherdd m8{k1}, [%3 + m14] ; 16 pixels, 4 taps each
+        vextracti64x4 ym9, m8, 1
+        pmovzxbw m8, ym8 ; pixels 0-7
+        pmovzxbw m9, ym9 ; pixels 8-15
+%if %4
+        pmaddwd %1, m8, [weights]
+        pmaddwd %2, m9, [weights + mmsize]
+%else
+        pmaddwd m8, [weights]
+        pmaddwd m9, [weights + mmsize]
+        paddd %1, m8
+        paddd %2, m9
+%endif
+%endmacro
+
+%macro filter_h_iter_zmm_U16 4 ; acc, acc2, src, first
+        kxnorw k1, k1, k1
+        vpgatherdd m8{k1}, [%3 + m14] ; 16 pixels, 2 taps each
+        psubw m8, m10
+%if %4
+        pmaddwd %1, m8, [weights]
+%else
+        pmaddwd m8, [weights]
+        paddd %1, m8
+%endif
+%endmacro
+
+%macro filter_h_iter_zmm_F32 4 ; acc, acc2, src, first
+        kxnorw k1, k1, k1
+        vpgatherdd m8{k1}, [%3 + m14] ; 16 pixels, 1 tap each
+%if %4
+        mulps %1, m8, [weights]
+%else
+        mulps m8, [weights]
+        addps %1, m8
+%endif
+%endmacro
+
+; Sum the adjacent tap pairs left by pmaddwd, and narrow to one dword per pixel
+%macro hsum_pairs 2 ; dst, src
+            psrlq m8, %2, 32
+            paddd %2, m8
+            vpmovqd %1, %2
+%endmacro
+
+%macro cvt_scale_ymm 1 ; reg
+            vcvtdq2ps %1, %1
+            mulps %1, ym12
+%endmacro
+
+%macro filter_h_zmm 4 ; elems, type, sizeof_type, sizeof_weight
+op filter_h%1_%2
+%xdefine weights tmp0q
+%xdefine fltsize tmp1q
+            mov tmp0q,   [execq + SwsOpExec.in_offset_x]
+            mov fltsize, [implq + SwsOpImpl.priv + 8] ; size_t filter_size
+            mov tmp2d, bxd
+            shl tmp2q, 4                   ; x := bx * 16
+            movu m14, [tmp0q + 4 * tmp2q]  ; &exec->in_offset_x[x]
+            mov weights, [implq + SwsOpImpl.priv]
+%ifidn %2, U16
+            vpbroadcastd m10, [bias16]
+            vpbroadcastd m11, [bias32]
+%endif
+            imul tmp2q, fltsize
+            lea weights, [weights + tmp2q * %4] ; weights += x * filter_size
+            filter_h_iter_zmm_%2 m0, m4, in0q, 1
+IF1 %1 > 1, filter_h_iter_zmm_%2 m1, m5, in1q, 1
+IF1 %1 > 2, filter_h_iter_zmm_%2 m2, m6, in2q, 1
+IF1 %1 > 3, filter_h_iter_zmm_%2 m3, m7, in3q, 1
+            sub fltsize, 4 / %3
+            jz .done
+            push in0q
+IF %1 > 1,  push in1q
+IF %1 > 2,  push in2q
+IF %1 > 3,  push in3q
+.loop:
+            add in0q, 4
+IF %1 > 1,  add in1q, 4
+IF %1 > 2,  add in2q, 4
+IF %1 > 3,  add in3q, 4
+            add weights, 64 * %4 / %3
+            filter_h_iter_zmm_%2 m0, m4, in0q, 0
+IF1 %1 > 1, filter_h_iter_zmm_%2 m1, m5, in1q, 0
+IF1 %1 > 2, filter_h_iter_zmm_%2 m2, m6, in2q, 0
+IF1 %1 > 3, filter_h_iter_zmm_%2 m3, m7, in3q, 0
+            sub fltsize, 4 / %3
+            jnz .loop
+IF %1 > 3,  pop in3q
+IF %1 > 2,  pop in2q
+IF %1 > 1,  pop in1q
+            pop in0q
+.done:
+            vbroadcastss m12, [scale_inv]
+%ifidn %2, U8
+            hsum_pairs ymm0, m0
+            hsum_pairs ymm4, m4
+IF %1 > 1,  hsum_pairs ymm1, m1
+IF %1 > 1,  hsum_pairs ymm5, m5
+IF %1 > 2,  hsum_pairs ymm2, m2
+IF %1 > 2,  hsum_pairs ymm6, m6
+IF %1 > 3,  hsum_pairs ymm3, m3
+IF %1 > 3,  hsum_pairs ymm7, m7
+            LOAD_CONT tmp0q
+            cvt_scale_ymm ymm0
+            cvt_scale_ymm ymm4
+IF %1 > 1,  cvt_scale_ymm ymm1
+IF %1 > 1,  cvt_scale_ymm ymm5
+IF %1 > 2,  cvt_scale_ymm ymm2
+IF %1 > 2,  cvt_scale_ymm ymm6
+IF %1 > 3,  cvt_scale_ymm ymm3
+IF %1 > 3,  cvt_scale_ymm ymm7
+%else
+%ifidn %2, U16
+            paddd m0, m11
+IF %1 > 1,  paddd m1, m11
+IF %1 > 2,  paddd m2, m11
+IF %1 > 3,  paddd m3, m11
+            vcvtdq2ps m0, m0
+IF %1 > 1,  vcvtdq2ps m1, m1
+IF %1 > 2,  vcvtdq2ps m2, m2
+IF %1 > 3,  vcvtdq2ps m3, m3
+%endif
+            LOAD_CONT tmp0q
+            mulps m0, m12
+IF %1 > 1,  mulps m1, m12
+IF %1 > 2,  mulps m2, m12
+IF %1 > 3,  mulps m3, m12
+            split_zmm %1
+%endif
+            CONTINUE tmp0q
+%undef weights
+%undef fltsize
+%endmacro
+
+%macro filter_fns_zmm 3 ; type, sizeof_type, sizeof_weight
+        filter_v_zmm 1, %1, %2, v
+        filter_v_zmm 2, %1, %2, v
+        filter_v_zmm 3, %1, %2, v
+        filter_v_zmm 4, %1, %2, v
+
+        filter_v_zmm 1, %1, %2, fma_v
+        filter_v_zmm 2, %1, %2, fma_v
+        filter_v_zmm 3, %1, %2, fma_v
+        filter_v_zmm 4, %1, %2, fma_v
+
+        filter_h_zmm 1, %1, %2, %3
+        filter_h_zmm 2, %1, %2, %3
+        filter_h_zmm 3, %1, %2, %3
+        filter_h_zmm 4, %1, %2, %3
+%endmacro
+
+INIT_ZMM avx512
+filter_fns_zmm U8,  1, 2
+filter_fns_zmm U16, 2, 2
+filter_fns_zmm F32, 4, 4
+%endif
@@ -0,0 +1,1371 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include "config.h"
+
+#define _DEFAULT_SOURCE
+#define _SVID_SOURCE // needed for MAP_ANONYMOUS
+#define _DARWIN_C_SOURCE // needed for MAP_ANON
+#include <string.h>
+#if HAVE_MMAP
+#include <sys/mman.h>
+#if defined(MAP_ANON) && !defined(MAP_ANONYMOUS)
+#define MAP_ANONYMOUS MAP_ANON
+#endif
+#endif
+
+#include "libavutil/avassert.h"
+#include "libavutil/bprint.h"
+#include "libavutil/cpu.h"
+#include "libavutil/intreadwrite.h"
+#include "libavutil/mem.h"
+#include "libavutil/thread.h"
+
+#include "../ops_internal.h"
+
+/**
+ * Runtime code generator for SwsOpList.
+ *
+ * Instead of chaining together precompiled kernels, the whole op list is
+ * translated into a single AVX2 loop over blocks of 8 pixels. Every component
+ * lives in its own ymm register as 8x 32-bit lanes for the entire loop body
+ * (integers zero-extended, floats as-is), all constants are embedded as
+ * RIP-relative memory operands, and swizzles are resolved at compile time by
+ * renaming registers. Components which are never written are not computed.
+ *
+ * The generated code must be bit-exact with the C reference backend, so the
+ * order of floating point operations follows ops_tmpl_float.c exactly.
+ *
+ * Generated kernels are cached globally, keyed on the parts of the op list
+ * that the code depends on, so all contexts converting between the same pair
+ * of formats share one mapping and only the first one generates it.
+ */
+
+#if HAVE_MMAP && HAVE_MPROTECT && defined(MAP_ANONYMOUS) && \
+    !defined(_WIN32) && !defined(__CYGWIN__)
+#  define JIT_SUPPORTED 1 /* generated code assumes the SysV calling convention */
+#else
+#  define JIT_SUPPORTED 0
+#endif
+
+#if JIT_SUPPORTED
+
+enum {
+    JIT_BLOCK_SIZE = 8,  /* one pixel per 32-bit lane of a ymm register */
+    JIT_COMP_REGS  = 11, /* ymm0 - ymm10 hold components */
+    JIT_TMP        = 11, /* ymm11 - ymm15 are scratch */
+    JIT_TMP_SHUF   = 15,
+    JIT_MAX_OPS    = 64,
+};
+
+enum { RAX, RCX, RDX, RBX, RSP, RBP, RSI, RDI,
+       R8,  R9,  R10, R11, R12, R13, R14, R15 };
+
+static const uint8_t reg_in[4]     = { R8,  R9,  R10, R11 };
+static const uint8_t reg_out[4]    = { R12, R13, R14, R15 };
+static const uint8_t reg_dither[4] = { RAX, RCX, RDX, RBX };
+#define REG_ARGS     RDI
+#define REG_COUNT    RSI
+#define REG_DITHER_X RBP
+
+/* Argument block passed to the generated kernel, once per line */
+typedef struct JitArgs {
+    uintptr_t in[4];
+    uintptr_t out[4];
+    uintptr_t dither[4]; /* current dither matrix row, per component */
+    uintptr_t dither_x;  /* byte offset into the dither rows */
+} JitArgs;
+
+typedef void (*JitFunc)(JitArgs *args, intptr_t num_blocks);
+
+typedef struct JitKernel {
+    struct JitKernel *next;
+    int refcount;
+    uint8_t *key;   /* see ops_key() */
+    size_t key_size;
+    size_t size;
+    uint8_t *image; /* code, followed by constants and the dither matrix */
+    int dither_offset;
+    int over_read;
+    int over_write;
+} JitKernel;
+
+typedef struct JitPriv {
+    JitKernel *kernel;
+    const float *dither;
+    int dither_mask;    /* matrix size - 1 */
+    int dither_stride;  /* row stride in floats */
+    int8_t y_offset[4]; /* row offset per component, or -1 if unused */
+} JitPriv;
+
+static AVMutex jit_lock = AV_MUTEX_INITIALIZER;
+static JitKernel *jit_cache;
+static int jit_denied;
+
+static JitKernel *kernel_find_locked(const uint8_t *key, size_t key_size)
+{
+    for (JitKernel *kernel = jit_cache; kernel; kernel = kernel->next) {
+        if (kernel->key_size == key_size && !memcmp(kernel->key, key, key_size)) {
+            kernel->refcount++;
+            return kernel;
+        }
+    }
+    return NULL;
+}
+
+/* Returns a cached kernel for `key` in *out, or NULL if there is none yet */
+static int kernel_find(const uint8_t *key, size_t key_size, JitKernel **out)
+{
+    int ret = 0;
+
+    ff_mutex_lock(&jit_lock);
+    if (jit_denied)
+        ret = AVERROR(ENOTSUP);
+    else
+        *out = kernel_find_locked(key, key_size);
+    ff_mutex_unlock(&jit_lock);
+    return ret;
+}
+
+/**
+ * Maps the image described by `tmpl` and adds it to the cache, unless another
+ * thread has added a kernel with the same key in the meantime.
+ */
+static int kernel_get(const JitKernel *tmpl, JitKernel **out)
+{
+    JitKernel *kernel;
+    int ret = 0;
+
+    ff_mutex_lock(&jit_lock);
+    if (jit_denied) {
+        ret = AVERROR(ENOTSUP);
+        goto done;
+    }
+
+    kernel = kernel_find_locked(tmpl->key, tmpl->key_size);
+    if (kernel) {
+        *out = kernel;
+        goto done;
+    }
+
+    kernel = av_mallocz(sizeof(*kernel));
+    if (kernel)
+        kernel->key = av_memdup(tmpl->key, tmpl->key_size);
+    if (!kernel || !kernel->key) {
+        av_freep(&kernel);
+        ret = AVERROR(ENOMEM);
+        goto done;
+    }
+
+    /* Failing to map executable memory is usually a W^X policy (SELinux,
+     * PaX, hardened runtimes) rather than memory exhaustion; remember it so
+     * that later graphs fall back to the other backends straight away. */
+    kernel->image = mmap(NULL, tmpl->size, PROT_READ | PROT_WRITE,
+                         MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (kernel->image == MAP_FAILED) {
+        av_free(kernel->key);
+        av_freep(&kernel);
+        ret = AVERROR(ENOTSUP);
+        goto done;
+    }
+
+    memcpy(kernel->image, tmpl->image, tmpl->size);
+    if (mprotect(kernel->image, tmpl->size, PROT_READ | PROT_EXEC) == -1) {
+        munmap(kernel->image, tmpl->size);
+        av_free(kernel->key);
+        av_freep(&kernel);
+        jit_denied = 1;
+        ret = AVERROR(ENOTSUP);
+        goto done;
+    }
+
+    kernel->key_size      = tmpl->key_size;
+    kernel->size          = tmpl->size;
+    kernel->dither_offset = tmpl->dither_offset;
+    kernel->over_read     = tmpl->over_read;
+    kernel->over_write    = tmpl->over_write;
+    kernel->refcount      = 1;
+    kernel->next          = jit_cache;
+    jit_cache             = kernel;
+    *out                  = kernel;
+
+done:
+    ff_mutex_unlock(&jit_lock);
+    return ret;
+}
+
+static void kernel_unref(JitKernel *kernel)
+{
+    bool last = false;
+
+    ff_mutex_lock(&jit_lock);
+    if (!--kernel->refcount) {
+        JitKernel **link = &jit_cache;
+        while (*link != kernel)
+            link = &(*link)->next;
+        *link = kernel->next;
+        last = true;
+    }
+    ff_mutex_unlock(&jit_lock);
+
+    if (last) {
+        munmap(kernel->image, kernel->size);
+        av_free(kernel->key);
+        av_free(kernel);
+    }
+}
+
+/* Code emission */
+
+typedef struct JitFixup {
+    int pos;   /* offset of the rel32 displacement */
+    int end;   /* offset of the end of the instruction */
+    int index; /* constant pool entry */
+} JitFixup;
+
+typedef struct JitContext {
+    uint8_t *code;
+    int code_size;
+    JitFixup *fixups;
+    int nb_fixups;
+    uint8_t (*consts)[32];
+    int nb_consts;
+    int err;
+
+    int map[4]; /* ymm register currently holding each component */
+    int over_read;
+    int over_write;
+
+    const SwsOp *dither; /* at most one dither op per list */
+    int dither_size;     /* matrix size, or 0 if using the constant 0.5 */
+} JitContext;
+
+/* Memory operand; either base + index + disp, or a constant pool entry */
+typedef struct JitMem {
+    int base;  /* GPR, or -1 for a constant */
+    int index; /* GPR, or -1 */
+    int disp;  /* displacement, or constant index */
+} JitMem;
+
+#define MEM(base, disp)    ((JitMem) { base, -1, disp })
+#define MEM_IDX(base, idx) ((JitMem) { base, idx, 0 })
+
+typedef struct VexOp {
+    uint8_t pp;  /* implied prefix: 0 = none, 1 = 66, 2 = F3, 3 = F2 */
+    uint8_t map; /* opcode map: 1 = 0F, 2 = 0F38, 3 = 0F3A */
+    uint8_t w;
+    uint8_t opcode;
+} VexOp;
+
+static const VexOp
+    VMOVDQU      = { 2, 1, 0, 0x6F },
+    VMOVDQU_ST   = { 2, 1, 0, 0x7F },
+    VMOVQ_ST     = { 1, 1, 0, 0xD6 },
+    VPMOVZXBD    = { 1, 2, 0, 0x31 },
+    VPMOVZXWD    = { 1, 2, 0, 0x33 },
+    VINSERTI128  = { 1, 3, 0, 0x38 },
+    VEXTRACTI128 = { 1, 3, 0, 0x39 },
+    VPERMQ       = { 1, 3, 1, 0x00 },
+    VPSHUFB      = { 1, 2, 0, 0x00 },
+    VPUNPCKLDQ   = { 1, 1, 0, 0x62 },
+    VPAND        = { 1, 1, 0, 0xDB },
+    VPOR         = { 1, 1, 0, 0xEB },
+    VPXOR        = { 1, 1, 0, 0xEF },
+    VPSHIFTD     = { 1, 1, 0, 0x72 }, /* /2 = vpsrld, /6 = vpslld */
+    VPMULLD      = { 1, 2, 0, 0x40 },
+    VPMINUD      = { 1, 2, 0, 0x3B },
+    VPMAXUD      = { 1, 2, 0, 0x3F },
+    VCVTDQ2PS    = { 0, 1, 0, 0x5B },
+    VCVTTPS2DQ   = { 2, 1, 0, 0x5B },
+    VANDPS       = { 0, 1, 0, 0x54 },
+    VADDPS       = { 0, 1, 0, 0x58 },
+    VMULPS       = { 0, 1, 0, 0x59 },
+    VSUBPS       = { 0, 1, 0, 0x5C },
+    VMINPS       = { 0, 1, 0, 0x5D },
+    VMAXPS       = { 0, 1, 0, 0x5F },
+    VCMPPS       = { 0, 1, 0, 0xC2 };
+
+enum { SHIFT_RIGHT = 2, SHIFT_LEFT = 6 };
+enum { ALU_ADD = 0, ALU_AND = 4, ALU_SUB = 5 };
+
+static void emit(JitContext *s, const uint8_t *data, int size)
+{
+    for (int i = 0; i < size && !s->err; i++) {
+        if (!av_dynarray2_add((void **) &s->code, &s->code_size, 1, &data[i]))
+            s->err = AVERROR(ENOMEM);
+    }
+}
+
+#define EMIT(s, ...) \
+    emit(s, (const uint8_t[]) { __VA_ARGS__ }, sizeof((const uint8_t[]) { __VA_ARGS__ }))
+
+static void emit_u32(JitContext *s, uint32_t x)
+{
+    EMIT(s, x & 0xFF, (x >> 8) & 0xFF, (x >> 16) & 0xFF, x >> 24);
+}
+
+static void emit_mem(JitContext *s, int reg, JitMem m, int imm_size)
+{
+    reg &= 7;
+    if (m.base < 0) {
+        const JitFixup fixup = {
+            .pos   = s->code_size + 1,
+            .end   = s->code_size + 5 + imm_size,
+            .index = m.disp,
+        };
+
+        EMIT(s, reg << 3 | 5);
+        emit_u32(s, 0);
+        if (!s->err && !av_dynarray2_add((void **) &s->fixups, &s->nb_fixups,
+                                         sizeof(fixup), (const void *) &fixup))
+            s->err = AVERROR(ENOMEM);
+        return;
+    }
+
+    const int base = m.base & 7;
+    const int mod  = !m.disp && base != RBP ? 0 : m.disp == (int8_t) m.disp ? 1 : 2;
+    if (m.index >= 0 || base == RSP) {
+        const int index = m.index >= 0 ? m.index & 7 : RSP;
+        EMIT(s, mod << 6 | reg << 3 | 4, index << 3 | base);
+    } else {
+        EMIT(s, mod << 6 | reg << 3 | base);
+    }
+
+    if (mod == 1)
+        EMIT(s, m.disp & 0xFF);
+    else if (mod == 2)
+        emit_u32(s, m.disp);
+}
+
+static void emit_vex(JitContext *s, VexOp op, int l, int reg, int vvvv,
+                     int index, int base)
+{
+    EMIT(s, 0xC4,
+         (~reg & 8) << 4 | (~index & 8) << 3 | (~base & 8) << 2 | op.map,
+         op.w << 7 | (~vvvv & 15) << 3 | l << 2 | op.pp,
+         op.opcode);
+}
+
+/* reg = op(vvvv, rm), 256-bit unless specified otherwise */
+static void vex_rr(JitContext *s, VexOp op, int l, int reg, int vvvv, int rm)
+{
+    emit_vex(s, op, l, reg, vvvv, 0, rm);
+    EMIT(s, 0xC0 | (reg & 7) << 3 | (rm & 7));
+}
+
+static void vex_rm(JitContext *s, VexOp op, int l, int reg, int vvvv, JitMem m,
+                   int imm_size)
+{
+    emit_vex(s, op, l, reg, vvvv, m.index >= 0 ? m.index : 0,
+             m.base >= 0 ? m.base : 0);
+    emit_mem(s, reg, m, imm_size);
+}
+
+#define vop_rr(s, op, dst, a, b) vex_rr(s, op, 1, dst, a, b)
+#define vop_rm(s, op, dst, a, m) vex_rm(s, op, 1, dst, a, m, 0)
+
+static void vshift(JitContext *s, int dir, int dst, int src, int amount)
+{
+    vex_rr(s, VPSHIFTD, 1, dir, dst, src);
+    EMIT(s, amount);
+}
+
+static void vmov(JitContext *s, int dst, int src)
+{
+    if (dst != src)
+        vex_rr(s, VMOVDQU, 1, dst, 0, src);
+}
+
+static void emit_rex(JitContext *s, int reg, int base)
+{
+    EMIT(s, 0x48 | (reg & 8) >> 1 | (base & 8) >> 3);
+}
+
+static void gpr_load(JitContext *s, int dst, JitMem m)
+{
+    emit_rex(s, dst, m.base);
+    EMIT(s, 0x8B);
+    emit_mem(s, dst, m, 0);
+}
+
+static void gpr_alu(JitContext *s, int alu, int reg, int32_t imm)
+{
+    emit_rex(s, 0, reg);
+    EMIT(s, 0x81, 0xC0 | alu << 3 | (reg & 7));
+    emit_u32(s, imm);
+}
+
+static void gpr_push(JitContext *s, int reg)
+{
+    if (reg & 8)
+        EMIT(s, 0x41);
+    EMIT(s, 0x50 | (reg & 7));
+}
+
+static void gpr_pop(JitContext *s, int reg)
+{
+    if (reg & 8)
+        EMIT(s, 0x41);
+    EMIT(s, 0x58 | (reg & 7));
+}
+
+/* Constant pool */
+
+static JitMem cst(JitContext *s, const uint8_t data[32])
+{
+    int idx;
+    for (idx = 0; idx < s->nb_consts; idx++) {
+        if (!memcmp(s->consts[idx], data, 32))
+            return MEM(-1, idx);
+    }
+
+    if (!av_dynarray2_add((void **) &s->consts, &s->nb_consts, 32, data))
+        s->err = AVERROR(ENOMEM);
+    return MEM(-1, idx);
+}
+
+static JitMem cst_u32(JitContext *s, uint32_t x)
+{
+    uint32_t data[8];
+    for (int i = 0; i < 8; i++)
+        data[i] = x;
+    return cst(s, (const uint8_t *) data);
+}
+
+static JitMem cst_f32(JitContext *s, float x)
+{
+    float data[8];
+    for (int i = 0; i < 8; i++)
+        data[i] = x;
+    return cst(s, (const uint8_t *) data);
+}
+
+/* Per-lane byte shuffle; the same 16 byte pattern is used for both lanes */
+static JitMem cst_shuf(JitContext *s, const uint8_t lane[16])
+{
+    uint8_t data[32];
+    memcpy(&data[0],  lane, 16);
+    memcpy(&data[16], lane, 16);
+    return cst(s, data);
+}
+
+static bool shuf_is_empty(const uint8_t lane[16])
+{
+    for (int i = 0; i < 16; i++) {
+        if (!(lane[i] & 0x80))
+            return false;
+    }
+    return true;
+}
+
+/* Matches q2pixel() for the pixel constants used by the reference backend */
+static uint32_t q2int(SwsPixelType type, AVRational q)
+{
+    if (!q.den)
+        return 0;
+
+    switch (type) {
+    case SWS_PIXEL_U8:  return (uint8_t)  ((uint8_t)  q.num / q.den);
+    case SWS_PIXEL_U16: return (uint16_t) ((uint16_t) q.num / q.den);
+    case SWS_PIXEL_U32: return (uint32_t) q.num / q.den;
+    default: av_unreachable("Invalid pixel type!");
+    }
+}
+
+static float q2float(AVRational q)
+{
+    return q.den ? (float) q.num / q.den : 0;
+}
+
+static JitMem cst_q(JitContext *s, SwsPixelType type, AVRational q)
+{
+    if (type == SWS_PIXEL_F32)
+        return cst_f32(s, q2float(q));
+    else
+        return cst_u32(s, q2int(type, q));
+}
+
+/* Truncate the lanes of `reg` to the range of `type` */
+static void wrap_type(JitContext *s, SwsPixelType type, int reg)
+{
+    switch (type) {
+    case SWS_PIXEL_U8:  vop_rm(s, VPAND, reg, reg, cst_u32(s, 0xFF));   break;
+    case SWS_PIXEL_U16: vop_rm(s, VPAND, reg, reg, cst_u32(s, 0xFFFF)); break;
+    default: break;
+    }
+}
+
+/* Register allocation */
+
+static int alloc_reg(const JitContext *s, unsigned reserved)
+{
+    for (int i = 0; i < 4; i++)
+        reserved |= 1u << s->map[i];
+    for (int r = 0; r < JIT_COMP_REGS; r++) {
+        if (!(reserved & (1u << r)))
+            return r;
+    }
+
+    av_unreachable("At most 8 component registers are ever in use");
+}
+
+/**
+ * Returns a register that component `c` can be written to without clobbering
+ * any other live component, and assigns it to `c`. Callers must look up the
+ * source register before calling this.
+ */
+static int dst_reg(JitContext *s, int c, unsigned live)
+{
+    for (int i = 0; i < 4; i++) {
+        if (i != c && (live & (1u << i)) && s->map[i] == s->map[c]) {
+            s->map[c] = alloc_reg(s, 0);
+            break;
+        }
+    }
+
+    return s->map[c];
+}
+
+/* Liveness; returns the set of components needed before `op` */
+static unsigned live_in(const SwsOp *op, unsigned live)
+{
+    unsigned res = 0;
+
+    switch (op->op) {
+    case SWS_OP_WRITE:
+        return (1u << op->rw.elems) - 1;
+    case SWS_OP_CLEAR:
+        for (int i = 0; i < 4; i++) {
+            if (op->c.q4[i].den)
+                live &= ~(1u << i);
+        }
+        return live;
+    case SWS_OP_SWIZZLE:
+        for (int i = 0; i < 4; i++) {
+            if (live & (1u << i))
+                res |= 1u << op->swizzle.in[i];
+        }
+        return res;
+    case SWS_OP_PACK:
+        res = live & ~1u;
+        if (live & 1) {
+            res |= 1;
+            for (int i = 1; i < 4; i++)
+                res |= !!op->pack.pattern[i] << i;
+        }
+        return res;
+    case SWS_OP_UNPACK:
+        for (int i = 0; i < 4; i++) {
+            if (!i || op->pack.pattern[i]) {
+                res  |= (live & (1u << i)) ? 1 : 0;
+                live &= ~(1u << i);
+            }
+        }
+        return res | live;
+    case SWS_OP_LINEAR:
+        for (int i = 0; i < 4; i++) {
+            if (!(live & (1u << i)))
+                continue;
+            res |= 1u << i;
+            for (int j = 0; j < 4; j++) {
+                if (op->lin.mask & SWS_MASK(i, j))
+                    res |= 1u << j;
+            }
+        }
+        return res;
+    default:
+        return live;
+    }
+}
+
+/* Op translation */
+
+/* Number of 16-byte chunks spanned by 4 packed pixels */
+static int packed_chunks(int pixel_bytes)
+{
+    return (4 * pixel_bytes + 15) >> 4;
+}
+
+static int jit_read(JitContext *s, const SwsOp *op, unsigned live)
+{
+    const int size = ff_sws_pixel_type_size(op->type);
+
+    if (!op->rw.packed || op->rw.elems == 1) {
+        for (int c = 0; c < op->rw.elems; c++) {
+            if (!(live & (1u << c)))
+                continue;
+            const JitMem in = MEM(reg_in[c], 0);
+            switch (size) {
+            case 1: vop_rm(s, VPMOVZXBD, s->map[c], 0, in); break;
+            case 2: vop_rm(s, VPMOVZXWD, s->map[c], 0, in); break;
+            case 4: vop_rm(s, VMOVDQU,   s->map[c], 0, in); break;
+            }
+        }
+        return 0;
+    }
+
+    /**
+     * Packed input: load each 16-byte chunk of the first four pixels into
+     * the low lane and of the last four pixels into the high lane, then
+     * gather the bytes of each component with one shuffle per chunk.
+     */
+    const int pixel_bytes = size * op->rw.elems;
+    const int lane_bytes  = 4 * pixel_bytes;
+    const int chunks      = packed_chunks(pixel_bytes);
+    for (int k = 0; k < chunks; k++) {
+        vex_rm(s, VMOVDQU, 0, JIT_TMP + k, 0, MEM(reg_in[0], 16 * k), 0);
+        vex_rm(s, VINSERTI128, 1, JIT_TMP + k, JIT_TMP + k,
+               MEM(reg_in[0], lane_bytes + 16 * k), 1);
+        EMIT(s, 1);
+    }
+
+    for (int c = 0; c < op->rw.elems; c++) {
+        const int dst = s->map[c];
+        bool first = true;
+        if (!(live & (1u << c)))
+            continue;
+
+        for (int k = 0; k < chunks; k++) {
+            uint8_t shuf[16];
+            for (int i = 0; i < 16; i++) {
+                const int pos = (i >> 2) * pixel_bytes + c * size + (i & 3) - 16 * k;
+                shuf[i] = (i & 3) < size && pos >= 0 && pos < 16 ? pos : 0x80;
+            }
+            if (shuf_is_empty(shuf))
+                continue;
+
+            if (first) {
+                vop_rm(s, VPSHUFB, dst, JIT_TMP + k, cst_shuf(s, shuf));
+                first = false;
+            } else {
+                vop_rm(s, VPSHUFB, JIT_TMP_SHUF, JIT_TMP + k, cst_shuf(s, shuf));
+                vop_rr(s, VPOR, dst, dst, JIT_TMP_SHUF);
+            }
+        }
+    }
+
+    s->over_read = FFMAX(s->over_read, 16 * chunks - lane_bytes);
+    return 0;
+}
+
+static int jit_write(JitContext *s, const SwsOp *op)
+{
+    const int size = ff_sws_pixel_type_size(op->type);
+
+    if (!op->rw.packed || op->rw.elems == 1) {
+        static const uint8_t pack_u8[16] = {
+            0, 4, 8, 12, 0x80, 0x80, 0x80, 0x80,
+            0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80,
+        };
+        static const uint8_t pack_u16[16] = {
+            0, 1, 4, 5, 8, 9, 12, 13,
+            0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80,
+        };
+
+        for (int c = 0; c < op->rw.elems; c++) {
+            const JitMem out = MEM(reg_out[c], 0);
+            const int src = s->map[c];
+            switch (size) {
+            case 1:
+                vop_rm(s, VPSHUFB, JIT_TMP, src, cst_shuf(s, pack_u8));
+                vex_rr(s, VEXTRACTI128, 1, JIT_TMP, 0, JIT_TMP + 1);
+                EMIT(s, 1);
+                vex_rr(s, VPUNPCKLDQ, 0, JIT_TMP, JIT_TMP, JIT_TMP + 1);
+                vex_rm(s, VMOVQ_ST, 0, JIT_TMP, 0, out, 0);
+                break;
+            case 2:
+                vop_rm(s, VPSHUFB, JIT_TMP, src, cst_shuf(s, pack_u16));
+                vex_rr(s, VPERMQ, 1, JIT_TMP, 0, JIT_TMP);
+                EMIT(s, 0x08);
+                vex_rm(s, VMOVDQU_ST, 0, JIT_TMP, 0, out, 0);
+                break;
+            case 4:
+                vex_rm(s, VMOVDQU_ST, 1, src, 0, out, 0);
+                break;
+            }
+        }
+        return 0;
+    }
+
+    /**
+     * Packed output: the inverse of the packed read. Each chunk is written
+     * in full; the garbage at the end of the last chunk of the low lane is
+     * overwritten again by the stores of the high lane.
+     */
+    const int pixel_bytes = size * op->rw.elems;
+    const int lane_bytes  = 4 * pixel_bytes;
+    const int chunks      = packed_chunks(pixel_bytes);
+    for (int k = 0; k < chunks; k++) {
+        const int acc = JIT_TMP + k;
+        bool first = true;
+
+        for (int c = 0; c < op->rw.elems; c++) {
+            uint8_t shuf[16];
+            for (int i = 0; i < 16; i++) {
+                const int pos = 16 * k + i;
+                const int px  = pos / pixel_bytes;
+                const int off = pos % pixel_bytes;
+                shuf[i] = pos < lane_bytes && off / size == c ? 4 * px + off % size : 0x80;
+            }
+            if (shuf_is_empty(shuf))
+                continue;
+
+            if (first) {
+                vop_rm(s, VPSHUFB, acc, s->map[c], cst_shuf(s, shuf));
+                first = false;
+            } else {
+                vop_rm(s, VPSHUFB, JIT_TMP_SHUF, s->map[c], cst_shuf(s, shuf));
+                vop_rr(s, VPOR, acc, acc, JIT_TMP_SHUF);
+            }
+        }
+    }
+
+    for (int k = 0; k < chunks; k++)
+        vex_rm(s, VMOVDQU_ST, 0, JIT_TMP + k, 0, MEM(reg_out[0], 16 * k), 0);
+    for (int k = 0; k < chunks; k++) {
+        vex_rm(s, VEXTRACTI128, 1, JIT_TMP + k, 0,
+               MEM(reg_out[0], lane_bytes + 16 * k), 1);
+        EMIT(s, 1);
+    }
+
+    s->over_write = FFMAX(s->over_write, 16 * chunks - lane_bytes);
+    return 0;
+}
+
+static void jit_convert(JitContext *s, const SwsOp *op, int dst, int src)
+{
+    const SwsPixelType from = op->type, to = op->convert.to;
+    const int from_size = ff_sws_pixel_type_size(from);
+    const int to_size   = ff_sws_pixel_type_size(to);
+    const int tmp = JIT_TMP, tmp2 = JIT_TMP + 1;
+
+    if (to == SWS_PIXEL_F32) {
+        if (from == SWS_PIXEL_U32) {
+            /* Split into two exactly representable halves, round once */
+            vshift(s, SHIFT_RIGHT, tmp, src, 16);
+            vop_rm(s, VPAND, dst, src, cst_u32(s, 0xFFFF));
+            vop_rr(s, VCVTDQ2PS, tmp, 0, tmp);
+            vop_rr(s, VCVTDQ2PS, dst, 0, dst);
+            vop_rm(s, VMULPS, tmp, tmp, cst_f32(s, 65536.0f));
+            vop_rr(s, VADDPS, dst, dst, tmp);
+        } else {
+            vop_rr(s, VCVTDQ2PS, dst, 0, src);
+        }
+    } else if (from == SWS_PIXEL_F32) {
+        if (to == SWS_PIXEL_U32) {
+            /* Bias values >= 2^31 into the signed range and flip the MSB */
+            const JitMem bias = cst_f32(s, 2147483648.0f);
+            vex_rm(s, VCMPPS, 1, tmp, src, bias, 1);
+            EMIT(s, 0x0D); /* GE_OS */
+            vop_rm(s, VANDPS, tmp2, tmp, bias);
+            vop_rr(s, VSUBPS, dst, src, tmp2);
+            vop_rr(s, VCVTTPS2DQ, dst, 0, dst);
+            vshift(s, SHIFT_LEFT, tmp, tmp, 31);
+            vop_rr(s, VPXOR, dst, dst, tmp);
+        } else {
+            vop_rr(s, VCVTTPS2DQ, dst, 0, src);
+            wrap_type(s, to, dst);
+        }
+    } else if (to_size < from_size) {
+        vmov(s, dst, src);
+        wrap_type(s, to, dst);
+    } else if (op->convert.expand) {
+        const AVRational scale = ff_sws_pixel_expand(from, to);
+        vop_rm(s, VPMULLD, dst, src, cst_u32(s, scale.num));
+    } else {
+        vmov(s, dst, src);
+    }
+}
+
+static int jit_linear(JitContext *s, const SwsOp *op, unsigned live)
+{
+    const uint32_t mask = op->lin.mask;
+    unsigned reserved = 0;
+    int res[4];
+
+    for (int i = 0; i < 4; i++) {
+        res[i] = -1;
+        if (!(live & (1u << i)) || !(mask & SWS_MASK_ROW(i)))
+            continue; /* unused or identity row */
+
+        /* Same order of operations as the C backend */
+        const int dst = res[i] = alloc_reg(s, reserved);
+        bool empty = true;
+        reserved |= 1u << dst;
+
+        if (mask & SWS_MASK_OFF(i)) {
+            vop_rm(s, VMOVDQU, dst, 0, cst_f32(s, q2float(op->lin.m[i][4])));
+            empty = false;
+        }
+
+        for (int j = 0; j < 4; j++) {
+            const int src = s->map[j];
+            if (mask & SWS_MASK(i, j)) {
+                const JitMem coef = cst_f32(s, q2float(op->lin.m[i][j]));
+                if (empty) {
+                    vop_rm(s, VMULPS, dst, src, coef);
+                } else {
+                    vop_rm(s, VMULPS, JIT_TMP, src, coef);
+                    vop_rr(s, VADDPS, dst, dst, JIT_TMP);
+                }
+            } else if (i == j) {
+                if (empty)
+                    vmov(s, dst, src);
+                else
+                    vop_rr(s, VADDPS, dst, dst, src);
+            } else {
+                continue;
+            }
+            empty = false;
+        }
+    }
+
+    for (int i = 0; i < 4; i++) {
+        if (res[i] >= 0)
+            s->map[i] = res[i];
+    }
+
+    return 0;
+}
+
+static int jit_pack(JitContext *s, const SwsOp *op, unsigned live)
+{
+    const uint8_t *pat = op->pack.pattern;
+    int shift = pat[1] + pat[2] + pat[3];
+    if (!(live & 1))
+        return 0;
+
+    /* Sources may share registers, so always pack into a fresh one */
+    const int src = s->map[0];
+    const int dst = s->map[0] = alloc_reg(s, 0);
+    if (shift)
+        vshift(s, SHIFT_LEFT, dst, src, shift);
+    else
+        vmov(s, dst, src);
+
+    for (int i = 1; i < 4; i++) {
+        if (!pat[i])
+            continue;
+        shift -= pat[i];
+        if (shift) {
+            vshift(s, SHIFT_LEFT, JIT_TMP, s->map[i], shift);
+            vop_rr(s, VPOR, dst, dst, JIT_TMP);
+        } else {
+            vop_rr(s, VPOR, dst, dst, s->map[i]);
+        }
+    }
+
+    wrap_type(s, op->type, dst);
+    return 0;
+}
+
+static int jit_unpack(JitContext *s, const SwsOp *op, unsigned live)
+{
+    const uint8_t *pat = op->pack.pattern;
+    const int val = s->map[0];
+    int shift = pat[1] + pat[2] + pat[3];
+
+    /* Extract y, z and w first, as x overwrites the packed value */
+    for (int i = 1; i < 4; i++) {
+        if (!pat[i])
+            continue;
+        shift -= pat[i];
+        if (!(live & (1u << i)))
+            continue;
+
+        s->map[i] = alloc_reg(s, 1u << val);
+        if (shift)
+            vshift(s, SHIFT_RIGHT, s->map[i], val, shift);
+        else
+            vmov(s, s->map[i], val);
+        vop_rm(s, VPAND, s->map[i], s->map[i], cst_u32(s, (1u << pat[i]) - 1));
+    }
+
+    if (live & 1) {
+        const int dst = dst_reg(s, 0, live);
+        vshift(s, SHIFT_RIGHT, dst, val, pat[1] + pat[2] + pat[3]);
+    }
+
+    return 0;
+}
+
+static int jit_dither(JitContext *s, const SwsOp *op, unsigned live)
+{
+    for (int c = 0; c < 4; c++) {
+        if (!(live & (1u << c)) || op->dither.y_offset[c] < 0)
+            continue;
+
+        JitMem matrix = cst_f32(s, 0.5f);
+        if (s->dither_size > JIT_BLOCK_SIZE)
+            matrix = MEM_IDX(reg_dither[c], REG_DITHER_X);
+        else if (s->dither_size)
+            matrix = MEM(reg_dither[c], 0);
+
+        const int src = s->map[c];
+        const int dst = dst_reg(s, c, live);
+        vop_rm(s, VADDPS, dst, src, matrix);
+    }
+
+    return 0;
+}
+
+/* Translate a single op, only computing the components in `live` */
+static int jit_op(JitContext *s, const SwsOp *op, unsigned live)
+{
+    const SwsPixelType type = op->type;
+    const bool is_float = type == SWS_PIXEL_F32;
+
+    switch (op->op) {
+    case SWS_OP_READ:
+        return jit_read(s, op, live);
+    case SWS_OP_WRITE:
+        return jit_write(s, op);
+    case SWS_OP_SWIZZLE: {
+        int map[4];
+        for (int i = 0; i < 4; i++)
+            map[i] = s->map[op->swizzle.in[i]];
+        memcpy(s->map, map, sizeof(map));
+        return 0;
+    }
+    case SWS_OP_LINEAR:
+        return is_float ? jit_linear(s, op, live) : AVERROR(ENOTSUP);
+    case SWS_OP_PACK:
+        return is_float ? AVERROR(ENOTSUP) : jit_pack(s, op, live);
+    case SWS_OP_UNPACK:
+        return is_float ? AVERROR(ENOTSUP) : jit_unpack(s, op, live);
+    case SWS_OP_DITHER:
+        return is_float ? jit_dither(s, op, live) : AVERROR(ENOTSUP);
+    default:
+        break;
+    }
+
+    /* Simple per-component ops */
+    for (int c = 0; c < 4; c++) {
+        if (!(live & (1u << c)))
+            continue;
+        if (op->op == SWS_OP_CLEAR && !op->c.q4[c].den)
+            continue;
+
+        const int src = s->map[c];
+        const int dst = dst_reg(s, c, live);
+        switch (op->op) {
+        case SWS_OP_SWAP_BYTES: {
+            static const uint8_t swap16[16] = { 1, 0, 0x80, 0x80, 5, 4, 0x80, 0x80,
+                                                9, 8, 0x80, 0x80, 13, 12, 0x80, 0x80 };
+            static const uint8_t swap32[16] = { 3, 2, 1, 0, 7, 6, 5, 4,
+                                                11, 10, 9, 8, 15, 14, 13, 12 };
+            switch (type) {
+            case SWS_PIXEL_U8:  vmov(s, dst, src); break;
+            case SWS_PIXEL_U16: vop_rm(s, VPSHUFB, dst, src, cst_shuf(s, swap16)); break;
+            case SWS_PIXEL_U32: vop_rm(s, VPSHUFB, dst, src, cst_shuf(s, swap32)); break;
+            default: return AVERROR(ENOTSUP);
+            }
+            break;
+        }
+        case SWS_OP_LSHIFT:
+        case SWS_OP_RSHIFT:
+            if (is_float || op->c.u >= 32)
+                return AVERROR(ENOTSUP);
+            vshift(s, op->op == SWS_OP_LSHIFT ? SHIFT_LEFT : SHIFT_RIGHT,
+                   dst, src, op->c.u);
+            wrap_type(s, type, dst);
+            break;
+        case SWS_OP_CLEAR:
+            vop_rm(s, VMOVDQU, dst, 0, cst_q(s, type, op->c.q4[c]));
+            break;
+        case SWS_OP_CONVERT:
+            jit_convert(s, op, dst, src);
+            break;
+        case SWS_OP_MIN:
+            if (is_float) {
+                /* FFMIN(x, c) == c < x ? c : x */
+                vop_rm(s, VMOVDQU, JIT_TMP, 0, cst_q(s, type, op->c.q4[c]));
+                vop_rr(s, VMINPS, dst, JIT_TMP, src);
+            } else {
+                vop_rm(s, VPMINUD, dst, src, cst_q(s, type, op->c.q4[c]));
+            }
+            break;
+        case SWS_OP_MAX:
+            vop_rm(s, is_float ? VMAXPS : VPMAXUD, dst, src,
+                   cst_q(s, type, op->c.q4[c]));
+            break;
+        case SWS_OP_SCALE:
+            if (is_float) {
+                vop_rm(s, VMULPS, dst, src, cst_q(s, type, op->c.q));
+            } else {
+                vop_rm(s, VPMULLD, dst, src, cst_q(s, type, op->c.q));
+                wrap_type(s, type, dst);
+            }
+            break;
+        default:
+            return AVERROR(ENOTSUP);
+        }
+    }
+
+    return 0;
+}
+
+static int check_ops(JitContext *s, const SwsOpList *ops)
+{
+    const SwsOp *read  = &ops->ops[0];
+    const SwsOp *write = &ops->ops[ops->num_ops - 1];
+    if (ops->num_ops < 2 || read->op != SWS_OP_READ || write->op != SWS_OP_WRITE)
+        return AVERROR(ENOTSUP);
+
+    for (int i = 0; i < ops->num_ops; i++) {
+        const SwsOp *op = &ops->ops[i];
+        switch (op->op) {
+        case SWS_OP_READ:
+        case SWS_OP_WRITE:
+            if (op->rw.frac || op->rw.filter || (op->op == SWS_OP_READ) != !i)
+                return AVERROR(ENOTSUP);
+            if (op->type == SWS_PIXEL_NONE)
+                return AVERROR(ENOTSUP);
+            break;
+        case SWS_OP_DITHER:
+            if (s->dither)
+                return AVERROR(ENOTSUP);
+            s->dither = op;
+            s->dither_size = op->dither.size_log2 ? 1 << op->dither.size_log2 : 0;
+            break;
+        case SWS_OP_FILTER_H:
+        case SWS_OP_FILTER_V:
+            return AVERROR(ENOTSUP);
+        default:
+            break;
+        }
+    }
+
+    return 0;
+}
+
+#define KEY_APPEND(bp, x) av_bprint_append_data(bp, (const char *) &(x), sizeof(x))
+
+/**
+ * Serializes everything of a checked op list that the generated code depends
+ * on, field by field, so that neither padding nor pointers end up in the key.
+ */
+static int ops_key(const SwsOpList *ops, AVBPrint *key)
+{
+    for (int i = 0; i < ops->num_ops; i++) {
+        const SwsOp *op = &ops->ops[i];
+        const int32_t hdr[2] = { op->op, op->type };
+        KEY_APPEND(key, hdr);
+
+        switch (op->op) {
+        case SWS_OP_READ:
+        case SWS_OP_WRITE: {
+            const uint8_t rw[2] = { op->rw.elems, op->rw.packed };
+            KEY_APPEND(key, rw);
+            break;
+        }
+        case SWS_OP_SWIZZLE:
+            KEY_APPEND(key, op->swizzle.in);
+            break;
+        case SWS_OP_PACK:
+        case SWS_OP_UNPACK:
+            KEY_APPEND(key, op->pack.pattern);
+            break;
+        case SWS_OP_CONVERT: {
+            const int32_t convert[2] = { op->convert.to, op->convert.expand };
+            KEY_APPEND(key, convert);
+            break;
+        }
+        case SWS_OP_LINEAR:
+            KEY_APPEND(key, op->lin.m);
+            KEY_APPEND(key, op->lin.mask);
+            break;
+        case SWS_OP_DITHER: {
+            const int size = op->dither.size_log2 ? 1 << op->dither.size_log2 : 0;
+            KEY_APPEND(key, op->dither.size_log2);
+            KEY_APPEND(key, op->dither.y_offset);
+            if (size)
+                av_bprint_append_data(key, (const char *) op->dither.matrix,
+                                      sizeof(*op->dither.matrix) * size * size);
+            break;
+        }
+        case SWS_OP_LSHIFT:
+        case SWS_OP_RSHIFT:
+            KEY_APPEND(key, op->c.u);
+            break;
+        case SWS_OP_CLEAR:
+        case SWS_OP_MIN:
+        case SWS_OP_MAX:
+        case SWS_OP_SCALE:
+            KEY_APPEND(key, op->c.q4);
+            break;
+        default:
+            break;
+        }
+    }
+
+    return av_bprint_is_complete(key) ? 0 : AVERROR(ENOMEM);
+}
+
+static int generate(JitContext *s, const SwsOpList *ops)
+{
+    const SwsOp *read  = &ops->ops[0];
+    const SwsOp *write = &ops->ops[ops->num_ops - 1];
+    const int planes_in  = read->rw.packed  ? 1 : read->rw.elems;
+    const int planes_out = write->rw.packed ? 1 : write->rw.elems;
+    unsigned live[JIT_MAX_OPS];
+    int ret;
+
+    if (ops->num_ops > FF_ARRAY_ELEMS(live))
+        return AVERROR(ENOTSUP);
+
+    live[ops->num_ops - 1] = 0;
+    for (int i = ops->num_ops - 1; i > 0; i--)
+        live[i - 1] = live_in(&ops->ops[i], live[i]);
+
+    for (int i = 0; i < 4; i++)
+        s->map[i] = i;
+
+    /* Prologue: save callee-saved registers and load the line pointers */
+    static const uint8_t saved[] = { RBX, RBP, R12, R13, R14, R15 };
+    for (int i = 0; i < FF_ARRAY_ELEMS(saved); i++)
+        gpr_push(s, saved[i]);
+    for (int i = 0; i < planes_in; i++)
+        gpr_load(s, reg_in[i], MEM(REG_ARGS, offsetof(JitArgs, in[i])));
+    for (int i = 0; i < planes_out; i++)
+        gpr_load(s, reg_out[i], MEM(REG_ARGS, offsetof(JitArgs, out[i])));
+    if (s->dither_size) {
+        for (int i = 0; i < 4; i++) {
+            if (s->dither->dither.y_offset[i] >= 0)
+                gpr_load(s, reg_dither[i], MEM(REG_ARGS, offsetof(JitArgs, dither[i])));
+        }
+        if (s->dither_size > JIT_BLOCK_SIZE)
+            gpr_load(s, REG_DITHER_X, MEM(REG_ARGS, offsetof(JitArgs, dither_x)));
+    }
+
+    const int loop = s->code_size;
+    for (int i = 0; i < ops->num_ops; i++) {
+        ret = jit_op(s, &ops->ops[i], live[i]);
+        if (ret < 0)
+            return ret;
+    }
+
+    const int size_in  = ff_sws_pixel_type_size(read->type);
+    const int size_out = ff_sws_pixel_type_size(write->type);
+    for (int i = 0; i < planes_in; i++)
+        gpr_alu(s, ALU_ADD, reg_in[i], JIT_BLOCK_SIZE * size_in * (read->rw.packed ? read->rw.elems : 1));
+    for (int i = 0; i < planes_out; i++)
+        gpr_alu(s, ALU_ADD, reg_out[i], JIT_BLOCK_SIZE * size_out * (write->rw.packed ? write->rw.elems : 1));
+    if (s->dither_size > JIT_BLOCK_SIZE) {
+        gpr_alu(s, ALU_ADD, REG_DITHER_X, JIT_BLOCK_SIZE * sizeof(float));
+        gpr_alu(s, ALU_AND, REG_DITHER_X, s->dither_size * sizeof(float) - 1);
+    }
+
+    gpr_alu(s, ALU_SUB, REG_COUNT, 1);
+    EMIT(s, 0x0F, 0x85); /* jnz loop */
+    emit_u32(s, loop - (s->code_size + 4));
+
+    /* Epilogue */
+    EMIT(s, 0xC5, 0xF8, 0x77); /* vzeroupper */
+    for (int i = FF_ARRAY_ELEMS(saved) - 1; i >= 0; i--)
+        gpr_pop(s, saved[i]);
+    EMIT(s, 0xC3);
+
+    return s->err;
+}
+
+/**
+ * Lays out the code, constant pool and dither matrix into a single buffer.
+ * Returns the offset of the dither matrix, or a negative error code.
+ */
+static int link_image(JitContext *s, uint8_t **out_image, size_t *out_size)
+{
+    const int consts_offset = FFALIGN(s->code_size, 32);
+    const int dither_offset = consts_offset + 32 * s->nb_consts;
+    const int size = s->dither_size;
+    const int stride = FFMAX(size, JIT_BLOCK_SIZE);
+    const size_t total = dither_offset + sizeof(float) * size * stride;
+
+    uint8_t *image = av_mallocz(total);
+    if (!image)
+        return AVERROR(ENOMEM);
+
+    memcpy(image, s->code, s->code_size);
+    for (int i = 0; i < s->nb_consts; i++)
+        memcpy(&image[consts_offset + 32 * i], s->consts[i], 32);
+
+    for (int i = 0; i < s->nb_fixups; i++) {
+        const JitFixup *f = &s->fixups[i];
+        const int32_t rel = consts_offset + 32 * f->index - f->end;
+        AV_WL32(&image[f->pos], rel);
+    }
+
+    /* Pad each row to the block size by repetition, as the C backend does */
+    float *matrix = (float *) &image[dither_offset];
+    for (int y = 0; y < size; y++) {
+        for (int x = 0; x < stride; x++)
+            matrix[y * stride + x] = q2float(s->dither->dither.matrix[y * size + x % size]);
+    }
+
+    *out_image = image;
+    *out_size  = total;
+    return dither_offset;
+}
+
+static void process(const SwsOpExec *exec, const void *priv,
+                    const int bx_start, const int y_start,
+                    const int bx_end, const int y_end)
+{
+    const JitPriv *p = priv;
+    const JitFunc func = (JitFunc) p->kernel->image;
+    const int num_blocks = bx_end - bx_start;
+    JitArgs args;
+
+    if (num_blocks <= 0)
+        return;
+
+    for (int i = 0; i < 4; i++) {
+        args.in[i]  = (uintptr_t) exec->in[i];
+        args.out[i] = (uintptr_t) exec->out[i];
+    }
+
+    args.dither_x = (bx_start * JIT_BLOCK_SIZE & p->dither_mask) * sizeof(float);
+    for (int y = y_start; y < y_end; y++) {
+        for (int i = 0; p->dither && i < 4; i++) {
+            const int row = (y + p->y_offset[i]) & p->dither_mask;
+            args.dither[i] = (uintptr_t) &p->dither[row * p->dither_stride];
+        }
+
+        func(&args, num_blocks);
+
+        const int y_bump = exec->in_bump_y ? exec->in_bump_y[y] : 0;
+        for (int i = 0; i < 4; i++) {
+            args.in[i]  += num_blocks * exec->block_size_in + exec->in_bump[i] +
+                           y_bump * exec->in_stride[i];
+            args.out[i] += num_blocks * exec->block_size_out + exec->out_bump[i];
+        }
+    }
+}
+
+static void free_priv(void *ptr)
+{
+    JitPriv *p = ptr;
+    if (p->kernel)
+        kernel_unref(p->kernel);
+    av_free(p);
+}
+
+static int compile(SwsContext *ctx, SwsOpList *ops, SwsCompiledOp *out)
+{
+    const int cpu_flags = av_get_cpu_flags();
+    JitContext s = {0};
+    JitKernel tmpl = {0};
+    JitPriv *p = NULL;
+    AVBPrint key;
+    int ret;
+
+    if (ctx->flags & SWS_NO_JIT)
+        return AVERROR(ENOTSUP);
+    if (!(cpu_flags & AV_CPU_FLAG_AVX2) || (cpu_flags & AV_CPU_FLAG_AVXSLOW))
+        return AVERROR(ENOTSUP);
+
+    ret = check_ops(&s, ops);
+    if (ret < 0)
+        return ret;
+
+    av_bprint_init(&key, 0, AV_BPRINT_SIZE_UNLIMITED);
+    p = av_mallocz(sizeof(*p));
+    if (!p) {
+        ret = AVERROR(ENOMEM);
+        goto fail;
+    }
+
+    ret = ops_key(ops, &key);
+    if (ret < 0)
+        goto fail;
+
+    ret = kernel_find((const uint8_t *) key.str, key.len, &p->kernel);
+    if (ret >= 0 && p->kernel) {
+        av_log(ctx, AV_LOG_DEBUG, "Reusing %zu bytes of generated code\n",
+               p->kernel->size);
+    } else if (ret >= 0) {
+        ret = generate(&s, ops);
+        if (ret < 0)
+            goto fail;
+
+        ret = tmpl.dither_offset = link_image(&s, &tmpl.image, &tmpl.size);
+        if (ret < 0)
+            goto fail;
+
+        tmpl.key        = (uint8_t *) key.str;
+        tmpl.key_size   = key.len;
+        tmpl.over_read  = s.over_read;
+        tmpl.over_write = s.over_write;
+        ret = kernel_get(&tmpl, &p->kernel);
+        if (ret >= 0)
+            av_log(ctx, AV_LOG_DEBUG, "Generated %d bytes of code with %d constants\n",
+                   s.code_size, s.nb_consts);
+    }
+
+    if (ret == AVERROR(ENOTSUP)) {
+        av_log(ctx, AV_LOG_VERBOSE, "Executable memory unavailable, "
+               "falling back to other backends\n");
+        goto fail;
+    } else if (ret < 0) {
+        goto fail;
+    }
+
+    if (s.dither_size) {
+        p->dither        = (const float *) &p->kernel->image[p->kernel->dither_offset];
+        p->dither_mask   = s.dither_size - 1;
+        p->dither_stride = FFMAX(s.dither_size, JIT_BLOCK_SIZE);
+        memcpy(p->y_offset, s.dither->dither.y_offset, sizeof(p->y_offset));
+    }
+
+    *out = (SwsCompiledOp) {
+        .func        = process,
+        .priv        = p,
+        .free        = free_priv,
+        .slice_align = 1,
+        .block_size  = JIT_BLOCK_SIZE,
+        .cpu_flags   = AV_CPU_FLAG_AVX2,
+        .over_read   = p->kernel->over_read,
+        .over_write  = p->kernel->over_write,
+    };
+    p = NULL;
+    ret = 0;
+
+fail:
+    av_free(p);
+    av_free(tmpl.image);
+    av_bprint_finalize(&key, NULL);
+    av_free(s.code);
+    av_free(s.fixups);
+    av_free(s.consts);
+    return ret;
+}
+
+#else /* !JIT_SUPPORTED */
+
+static int compile(SwsContext *ctx, SwsOpList *ops, SwsCompiledOp *out)
+{
+    return AVERROR(ENOTSUP);
+}
+
+#endif /* JIT_SUPPORTED */
+
+const SwsOpBackend backend_x86_jit = {
+    .name       = "x86_jit",
+    .compile    = compile,
+    .hw_format  = AV_PIX_FMT_NONE,
+};
@@ -0,0 +1,153 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/**
+ * AVBufferPool test and microbenchmark, measuring get/unref pairs per second
+ * with a pool shared by a varying number of threads.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "libavutil/avassert.h"
+#include "libavutil/buffer.h"
+#include "libavutil/error.h"
+#include "libavutil/intreadwrite.h"
+#include "libavutil/log.h"
+#include "libavutil/mem.h"
+#include "libavutil/thread.h" // not public
+#include "libavutil/time.h"
+
+#define BUF_SIZE   4096
+#define NB_HELD    4
+
+typedef struct WorkerData {
+    pthread_t     tid;
+    AVBufferPool *pool;
+    int           nb_iter;
+    int           ret;
+} WorkerData;
+
+static void *worker_thread(void *arg)
+{
+    WorkerData *wd = arg;
+    AVBufferRef *held[NB_HELD] = { NULL };
+
+    for (int i = 0; i < wd->nb_iter; i++) {
+        AVBufferRef **buf = &held[i % NB_HELD];
+
+        // a buffer must never be handed out twice, so nobody else may
+        // have touched it while we were holding it
+        if (*buf)
+            av_assert0(AV_RN32((*buf)->data) == i - NB_HELD);
+        av_buffer_unref(buf);
+
+        *buf = av_buffer_pool_get(wd->pool);
+        if (!*buf) {
+            wd->ret = AVERROR(ENOMEM);
+            break;
+        }
+        av_assert0((*buf)->size == BUF_SIZE);
+        AV_WN32((*buf)->data, i);
+    }
+
+    for (int i = 0; i < NB_HELD; i++)
+        av_buffer_unref(&held[i]);
+
+    return NULL;
+}
+
+static int run_test(int nb_threads, int nb_iter)
+{
+    WorkerData *workers;
+    AVBufferPool *pool;
+    int64_t start, elapsed;
+    int nb_started = 0;
+    int ret = 0;
+
+    workers = av_calloc(nb_threads, sizeof(*workers));
+    pool    = av_buffer_pool_init(BUF_SIZE, NULL);
+    if (!workers || !pool) {
+        ret = AVERROR(ENOMEM);
+        goto end;
+    }
+
+    start = av_gettime_relative();
+
+    for (; nb_started < nb_threads; nb_started++) {
+        WorkerData *wd = &workers[nb_started];
+
+        wd->pool    = pool;
+        wd->nb_iter = nb_iter;
+
+        ret = pthread_create(&wd->tid, NULL, worker_thread, wd);
+        if (ret) {
+            ret = AVERROR(ret);
+            break;
+        }
+    }
+
+end:
+    for (int i = 0; i < nb_started; i++) {
+        pthread_join(workers[i].tid, NULL);
+        if (workers[i].ret < 0 && ret >= 0)
+            ret = workers[i].ret;
+    }
+
+    if (ret >= 0) {
+        elapsed = av_gettime_relative() - start;
+        printf("threads:%d iterations:%d -> %.0f pairs/s\n",
+               nb_threads, nb_iter,
+               (double)nb_threads * nb_iter * 1000000 / FFMAX(elapsed, 1));
+    }
+
+    av_buffer_pool_uninit(&pool);
+    av_freep(&workers);
+
+    return ret;
+}
+
+int main(int argc, char **argv)
+{
+    int max_threads, nb_iter;
+    int ret = 0;
+
+    if (argc != 3) {
+        av_log(NULL, AV_LOG_ERROR, "%s <max_threads> <nb_iterations>\n",
+               argv[0]);
+        return 1;
+    }
+
+    max_threads = atoi(argv[1]);
+    nb_iter     = atoi(argv[2]);
+
+    if (max_threads <= 0 || nb_iter <= 0) {
+        av_log(NULL, AV_LOG_ERROR, "negative values not allowed\n");
+        return 1;
+    }
+
+    for (int nb_threads = 1; nb_threads <= max_threads && ret >= 0; nb_threads *= 2)
+        ret = run_test(nb_threads, nb_iter);
+
+    if (ret < 0) {
+        av_log(NULL, AV_LOG_ERROR, "Test failed: %s\n", av_err2str(ret));
+        return 1;
+    }
+
+    return 0;
+}
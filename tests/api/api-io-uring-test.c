@@ -0,0 +1,175 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/**
+ * Check that the io_uring path of the file protocol writes, reads and seeks
+ * the same data as plain file: I/O. When io_uring is not available, the
+ * protocol falls back to synchronous I/O and the test still passes.
+ */
+
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "libavutil/dict.h"
+#include "libavutil/error.h"
+#include "libavutil/lfg.h"
+#include "libavutil/log.h"
+#include "libavutil/macros.h"
+#include "libavutil/mem.h"
+#include "libavformat/avio.h"
+
+#define DATA_SIZE (3 * 65536 + 1234)
+
+static int open_file(AVIOContext **pb, const char *filename, int flags, int io_uring)
+{
+    AVDictionary *opts = NULL;
+    int ret;
+
+    av_dict_set_int(&opts, "io_uring", io_uring, 0);
+    /* small blocks, so that a few requests are in flight at once */
+    av_dict_set_int(&opts, "uring_block_size", 4096, 0);
+    av_dict_set_int(&opts, "uring_depth", 4, 0);
+
+    ret = avio_open2(pb, filename, flags, NULL, &opts);
+    av_dict_free(&opts);
+    if (ret < 0)
+        fprintf(stderr, "Failed to open %s: %s\n", filename, av_err2str(ret));
+    return ret;
+}
+
+static int write_file(const char *filename, const uint8_t *data, AVLFG *lfg)
+{
+    AVIOContext *pb;
+    int ret = open_file(&pb, filename, AVIO_FLAG_WRITE, 1);
+    if (ret < 0)
+        return ret;
+
+    for (int pos = 0; pos < DATA_SIZE; ) {
+        int size = FFMIN(av_lfg_get(lfg) % 20000 + 1, DATA_SIZE - pos);
+        avio_write(pb, data + pos, size);
+        pos += size;
+    }
+
+    return avio_closep(&pb);
+}
+
+static int check_read(AVIOContext *pb, const uint8_t *data, uint8_t *buf,
+                      int64_t pos, int size, const char *what)
+{
+    int expected = FFMAX(FFMIN(size, DATA_SIZE - pos), 0);
+    int ret = avio_read(pb, buf, size);
+
+    if (!expected && ret == AVERROR_EOF)
+        return 0;
+    if (ret != expected || memcmp(buf, data + pos, expected)) {
+        fprintf(stderr, "%s: read of %d bytes at %"PRId64" returned %d, "
+                "expected %d\n", what, size, pos, ret, expected);
+        return AVERROR_BUG;
+    }
+    return 0;
+}
+
+static int read_file(const char *filename, const uint8_t *data, AVLFG *lfg,
+                     int io_uring)
+{
+    const char *what = io_uring ? "io_uring" : "file";
+    AVIOContext *pb;
+    uint8_t *buf;
+    int64_t pos;
+    int ret;
+
+    buf = av_malloc(DATA_SIZE);
+    if (!buf)
+        return AVERROR(ENOMEM);
+
+    ret = open_file(&pb, filename, AVIO_FLAG_READ, io_uring);
+    if (ret < 0)
+        goto end;
+
+    if (avio_size(pb) != DATA_SIZE) {
+        fprintf(stderr, "%s: size %"PRId64", expected %d\n",
+                what, avio_size(pb), DATA_SIZE);
+        ret = AVERROR_BUG;
+        goto end;
+    }
+
+    /* sequential reads of varying size over the whole file */
+    for (pos = 0; pos < DATA_SIZE; ) {
+        int size = av_lfg_get(lfg) % 10000 + 1;
+        ret = check_read(pb, data, buf, pos, size, what);
+        if (ret < 0)
+            goto end;
+        pos += FFMIN(size, DATA_SIZE - pos);
+    }
+
+    /* random absolute and relative seeks, including past the end */
+    for (int i = 0; i < 200; i++) {
+        int size = av_lfg_get(lfg) % 70000 + 1;
+        int64_t target = av_lfg_get(lfg) % (DATA_SIZE + 100);
+        int whence = i & 1 ? SEEK_CUR : SEEK_SET;
+        int64_t offset = whence == SEEK_CUR ? target - avio_tell(pb) : target;
+
+        pos = avio_seek(pb, offset, whence);
+        if (pos != target) {
+            fprintf(stderr, "%s: seek to %"PRId64" returned %"PRId64"\n",
+                    what, target, pos);
+            ret = AVERROR_BUG;
+            goto end;
+        }
+        ret = check_read(pb, data, buf, pos, size, what);
+        if (ret < 0)
+            goto end;
+    }
+
+end:
+    avio_closep(&pb);
+    av_free(buf);
+    return ret;
+}
+
+int main(int argc, char **argv)
+{
+    uint8_t *data;
+    AVLFG lfg;
+    int ret;
+
+    if (argc < 2) {
+        fprintf(stderr, "Usage: %s <temporary file>\n", argv[0]);
+        return 1;
+    }
+
+    data = av_malloc(DATA_SIZE);
+    if (!data)
+        return 1;
+
+    av_lfg_init(&lfg, 0xdeadbeef);
+    for (int i = 0; i < DATA_SIZE; i++)
+        data[i] = av_lfg_get(&lfg);
+
+    ret = write_file(argv[1], data, &lfg);
+    if (ret >= 0)
+        ret = read_file(argv[1], data, &lfg, 0);
+    if (ret >= 0)
+        ret = read_file(argv[1], data, &lfg, 1);
+
+    remove(argv[1]);
+    av_free(data);
+    return ret < 0;
+}
@@ -0,0 +1,192 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/**
+ * fftools ThreadQueue test and microbenchmark, comparing the lock-free and
+ * the mutex-protected implementations.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "libavcodec/packet.h"
+
+#include "libavutil/avassert.h"
+#include "libavutil/log.h"
+#include "libavutil/mem.h"
+#include "libavutil/thread.h" // not public
+#include "libavutil/time.h"
+
+#include "fftools/thread_queue.h"
+
+typedef struct SenderData {
+    pthread_t    tid;
+    ThreadQueue *tq;
+    unsigned     stream_idx;
+    int          nb_packets;
+    int          ret;
+} SenderData;
+
+static void *sender_thread(void *arg)
+{
+    SenderData *sd = arg;
+    AVPacket  *pkt = av_packet_alloc();
+    int ret = 0;
+
+    if (!pkt) {
+        ret = AVERROR(ENOMEM);
+        goto finish;
+    }
+
+    for (int i = 0; i < sd->nb_packets; i++) {
+        pkt->pts  = i;
+        pkt->size = i & 0xff;
+
+        ret = tq_send(sd->tq, sd->stream_idx, pkt);
+        if (ret < 0)
+            break;
+    }
+
+finish:
+    tq_send_finish(sd->tq, sd->stream_idx);
+    av_packet_free(&pkt);
+    sd->ret = ret;
+    return NULL;
+}
+
+static int run_test(unsigned flags, int nb_senders, int nb_packets,
+                    int queue_size, int quiet)
+{
+    SenderData *senders = NULL;
+    int64_t    *next_pts = NULL;
+    ThreadQueue *tq = NULL;
+    AVPacket   *pkt = NULL;
+    int64_t start, elapsed;
+    int nb_started = 0, nb_eof = 0;
+    int ret = 0;
+
+    senders  = av_calloc(nb_senders, sizeof(*senders));
+    next_pts = av_calloc(nb_senders, sizeof(*next_pts));
+    pkt      = av_packet_alloc();
+    tq       = tq_alloc(nb_senders, queue_size, THREAD_QUEUE_PACKETS, flags);
+    if (!senders || !next_pts || !pkt || !tq) {
+        ret = AVERROR(ENOMEM);
+        goto end;
+    }
+
+    start = av_gettime_relative();
+
+    for (; nb_started < nb_senders; nb_started++) {
+        SenderData *sd = &senders[nb_started];
+
+        sd->tq         = tq;
+        sd->stream_idx = nb_started;
+        sd->nb_packets = nb_packets;
+
+        ret = pthread_create(&sd->tid, NULL, sender_thread, sd);
+        if (ret) {
+            ret = AVERROR(ret);
+            goto end;
+        }
+    }
+
+    while (1) {
+        int stream_idx;
+
+        ret = tq_receive(tq, &stream_idx, pkt);
+        if (ret == AVERROR_EOF && stream_idx < 0) {
+            ret = 0;
+            break;
+        } else if (ret == AVERROR_EOF) {
+            // every stream must be fully delivered before its EOF
+            av_assert0(next_pts[stream_idx] == nb_packets);
+            nb_eof++;
+            continue;
+        }
+        av_assert0(ret >= 0);
+
+        // packets from each sender must arrive in order
+        av_assert0(pkt->pts == next_pts[stream_idx]);
+        av_assert0(pkt->size == (pkt->pts & 0xff));
+        next_pts[stream_idx]++;
+
+        av_packet_unref(pkt);
+    }
+    av_assert0(nb_eof == nb_senders);
+
+    elapsed = av_gettime_relative() - start;
+
+    if (!quiet)
+        printf("%-9s senders:%d packets:%d queue:%d -> %.0f packets/s\n",
+               (flags & THREAD_QUEUE_FLAG_LOCKED) ? "locked" : "lock-free",
+               nb_senders, nb_packets, queue_size,
+               (double)nb_senders * nb_packets * 1000000 / FFMAX(elapsed, 1));
+
+end:
+    for (int i = 0; i < nb_started; i++) {
+        pthread_join(senders[i].tid, NULL);
+        if (senders[i].ret < 0 && ret >= 0)
+            ret = senders[i].ret;
+    }
+
+    tq_free(&tq);
+    av_packet_free(&pkt);
+    av_freep(&next_pts);
+    av_freep(&senders);
+
+    return ret;
+}
+
+int main(int argc, char **argv)
+{
+    int nb_senders, nb_packets, queue_size, nb_rounds = 1;
+    int ret = 0;
+
+    if (argc != 4 && argc != 5) {
+        av_log(NULL, AV_LOG_ERROR, "%s <nb_senders> <nb_packets> <queue_size> "
+               "[<nb_rounds>]\n", argv[0]);
+        return 1;
+    }
+
+    nb_senders = atoi(argv[1]);
+    nb_packets = atoi(argv[2]);
+    queue_size = atoi(argv[3]);
+    if (argc == 5)
+        nb_rounds = atoi(argv[4]);
+
+    if (nb_senders <= 0 || nb_packets <= 0 || queue_size <= 0 || nb_rounds <= 0) {
+        av_log(NULL, AV_LOG_ERROR, "negative values not allowed\n");
+        return 1;
+    }
+
+    /* With several rounds, this is a stress test of many senders sending and
+     * finishing their streams at the same time; only report failures. */
+    for (int i = 0; i < nb_rounds && ret >= 0; i++) {
+        ret = run_test(THREAD_QUEUE_FLAG_LOCKED, nb_senders, nb_packets,
+                       queue_size, nb_rounds > 1);
+        if (ret >= 0)
+            ret = run_test(0, nb_senders, nb_packets, queue_size, nb_rounds > 1);
+    }
+
+    if (ret < 0) {
+        av_log(NULL, AV_LOG_ERROR, "Test failed: %s\n", av_err2str(ret));
+        return 1;
+    }
+
+    return 0;
+}
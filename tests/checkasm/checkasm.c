@@ -299,6 +299,7 @@ static const struct {
     #endif
 #endif
 #if CONFIG_AVFILTER
+        { "drawutils", checkasm_check_drawutils },
     #if CONFIG_SCENE_SAD
         { "scene_sad", checkasm_check_scene_sad },
     #endif
@@ -323,6 +324,9 @@ static const struct {
     #if CONFIG_EQ_FILTER
         { "vf_eq", checkasm_check_vf_eq },
     #endif
+    #if CONFIG_FIELDMATCH_FILTER
+        { "vf_fieldmatch", checkasm_check_vf_fieldmatch },
+    #endif
     #if CONFIG_FSPP_FILTER
         { "vf_fspp", checkasm_check_vf_fspp },
     #endif
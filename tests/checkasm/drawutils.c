@@ -0,0 +1,71 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with FFmpeg; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include <string.h>
+#include "checkasm.h"
+#include "libavfilter/drawutils.h"
+#include "libavutil/mem_internal.h"
+
+#define WIDTH 96
+
+#define randomize_buffers(buf, size)      \
+    do {                                  \
+        for (int j = 0; j < size; j++)    \
+            buf[j] = rnd() & 0xFF;        \
+    } while (0)
+
+static void check_blend_mask_line(void)
+{
+    LOCAL_ALIGNED_32(uint8_t, mask,    [WIDTH]);
+    LOCAL_ALIGNED_32(uint8_t, dst_ref, [WIDTH]);
+    LOCAL_ALIGNED_32(uint8_t, dst_new, [WIDTH]);
+    FFDrawContext draw;
+
+    declare_func(void, uint8_t *dst, const uint8_t *mask, int w,
+                 unsigned src, unsigned alpha);
+
+    if (ff_draw_init(&draw, AV_PIX_FMT_GRAY8, 0) < 0)
+        return;
+
+    if (check_func(draw.blend_mask_line, "blend_mask_line")) {
+        for (int w = 1; w <= WIDTH - 8; w++) {
+            const int offset = w & 7; /* test various alignments */
+            const unsigned src = rnd() & 0xFF;
+            /* same range as in ff_blend_mask() */
+            const unsigned alpha = (0x10307 * (w & 1 ? 255 : rnd() & 0xFF) + 0x3) >> 8;
+
+            randomize_buffers(mask, WIDTH);
+            randomize_buffers(dst_ref, WIDTH);
+            mask[offset] = 0xFF;
+            mask[offset + w - 1] = 0;
+            memcpy(dst_new, dst_ref, WIDTH);
+
+            call_ref(dst_ref + offset, mask + offset, w, src, alpha);
+            call_new(dst_new + offset, mask + offset, w, src, alpha);
+            if (memcmp(dst_ref, dst_new, WIDTH))
+                fail();
+        }
+        bench_new(dst_new, mask, WIDTH, 0x80, 0x10203);
+    }
+}
+
+void checkasm_check_drawutils(void)
+{
+    check_blend_mask_line();
+    report("blend_mask_line");
+}
@@ -111,93 +111,22 @@ static void set_range(AVRational *rangeq, unsigned range, unsigned range_def)
         *rangeq = (AVRational) { range, 1 };
 }
 
-static void check_ops(const char *report, const unsigned ranges[NB_PLANES],
-                      const SwsOp *ops)
-{
-    SwsContext *ctx = sws_alloc_context();
-    SwsCompiledOp comp_ref = {0}, comp_new = {0};
-    const SwsOpBackend *backend_new = NULL;
-    SwsOpList oplist = { .ops = (SwsOp *) ops };
-    const SwsOp *read_op, *write_op;
-    static const unsigned def_ranges[4] = {0};
-    if (!ranges)
-        ranges = def_ranges;
+static DECLARE_ALIGNED_64(char, src0)[NB_PLANES][LINES][PIXELS * sizeof(uint32_t[4])];
+static DECLARE_ALIGNED_64(char, src1)[NB_PLANES][LINES][PIXELS * sizeof(uint32_t[4])];
 
+static void check_compiled(const char *report, const SwsOpBackend *backend_new,
+                           const SwsOp *read_op, const SwsOp *write_op,
+                           const SwsCompiledOp *comp_ref,
+                           const SwsCompiledOp *comp_new)
+{
     declare_func(void, const SwsOpExec *, const void *, int bx, int y, int bx_end, int y_end);
 
-    static DECLARE_ALIGNED_64(char, src0)[NB_PLANES][LINES][PIXELS * sizeof(uint32_t[4])];
-    static DECLARE_ALIGNED_64(char, src1)[NB_PLANES][LINES][PIXELS * sizeof(uint32_t[4])];
     static DECLARE_ALIGNED_64(char, dst0)[NB_PLANES][LINES][PIXELS * sizeof(uint32_t[4])];
     static DECLARE_ALIGNED_64(char, dst1)[NB_PLANES][LINES][PIXELS * sizeof(uint32_t[4])];
 
-    if (!ctx)
-        return;
-    ctx->flags = SWS_BITEXACT;
-
-    read_op = &ops[0];
-    for (oplist.num_ops = 0; ops[oplist.num_ops].op; oplist.num_ops++)
-        write_op = &ops[oplist.num_ops];
-
     const int read_size  = PIXELS * rw_pixel_bits(read_op)  >> 3;
     const int write_size = PIXELS * rw_pixel_bits(write_op) >> 3;
 
-    for (int p = 0; p < NB_PLANES; p++) {
-        void *plane = src0[p];
-        switch (read_op->type) {
-        case U8:
-            fill8(plane, sizeof(src0[p]) /  sizeof(uint8_t), ranges[p]);
-            set_range(&oplist.comps_src.max[p], ranges[p], UINT8_MAX);
-            oplist.comps_src.min[p] = (AVRational) { 0, 1 };
-            break;
-        case U16:
-            fill16(plane, sizeof(src0[p]) / sizeof(uint16_t), ranges[p]);
-            set_range(&oplist.comps_src.max[p], ranges[p], UINT16_MAX);
-            oplist.comps_src.min[p] = (AVRational) { 0, 1 };
-            break;
-        case U32:
-            fill32(plane, sizeof(src0[p]) / sizeof(uint32_t), ranges[p]);
-            set_range(&oplist.comps_src.max[p], ranges[p], UINT32_MAX);
-            oplist.comps_src.min[p] = (AVRational) { 0, 1 };
-            break;
-        case F32:
-            fill32f(plane, sizeof(src0[p]) / sizeof(uint32_t), ranges[p]);
-            if (ranges[p] && ranges[p] <= INT_MAX) {
-                oplist.comps_src.max[p] = (AVRational) { ranges[p], 1 };
-                oplist.comps_src.min[p] = (AVRational) { 0, 1 };
-            }
-            break;
-        }
-    }
-
-    memcpy(src1, src0, sizeof(src0));
-    memset(dst0, 0, sizeof(dst0));
-    memset(dst1, 0, sizeof(dst1));
-
-    /* Compile `ops` using both the asm and c backends */
-    for (int n = 0; ff_sws_op_backends[n]; n++) {
-        const SwsOpBackend *backend = ff_sws_op_backends[n];
-        const bool is_ref = !strcmp(backend->name, "c");
-        if (is_ref || !comp_new.func) {
-            SwsCompiledOp comp;
-            int ret = ff_sws_ops_compile_backend(ctx, backend, &oplist, &comp);
-            if (ret == AVERROR(ENOTSUP))
-                continue;
-            else if (ret < 0)
-                fail();
-            else if (PIXELS % comp.block_size != 0)
-                fail();
-
-            if (is_ref)
-                comp_ref = comp;
-            if (!comp_new.func) {
-                comp_new = comp;
-                backend_new = backend;
-            }
-        }
-    }
-
-    av_assert0(comp_ref.func && comp_new.func);
-
     SwsOpExec exec = {0};
     exec.width = PIXELS;
     exec.height = exec.slice_h = LINES;
@@ -232,24 +161,28 @@ static void check_ops(const char *report, const unsigned ranges[NB_PLANES],
      * the backend pointer and the active CPU flags.
      */
     uintptr_t id = (uintptr_t) backend_new;
-    id ^= (id << 6) + (id >> 2) + 0x9e3779b97f4a7c15 + comp_new.cpu_flags;
+    id ^= (id << 6) + (id >> 2) + 0x9e3779b97f4a7c15 + comp_new->cpu_flags;
 
     if (check_key((void*) id, "%s", report)) {
-        exec.block_size_in  = comp_ref.block_size * rw_pixel_bits(read_op)  >> 3;
-        exec.block_size_out = comp_ref.block_size * rw_pixel_bits(write_op) >> 3;
+        memcpy(src1, src0, sizeof(src0));
+        memset(dst0, 0, sizeof(dst0));
+        memset(dst1, 0, sizeof(dst1));
+
+        exec.block_size_in  = comp_ref->block_size * rw_pixel_bits(read_op)  >> 3;
+        exec.block_size_out = comp_ref->block_size * rw_pixel_bits(write_op) >> 3;
         for (int i = 0; i < NB_PLANES; i++) {
             exec.in[i]  = (void *) src0[i];
             exec.out[i] = (void *) dst0[i];
         }
-        checkasm_call(comp_ref.func, &exec, comp_ref.priv, 0, 0, PIXELS / comp_ref.block_size, LINES);
+        checkasm_call(comp_ref->func, &exec, comp_ref->priv, 0, 0, PIXELS / comp_ref->block_size, LINES);
 
-        exec.block_size_in  = comp_new.block_size * rw_pixel_bits(read_op)  >> 3;
-        exec.block_size_out = comp_new.block_size * rw_pixel_bits(write_op) >> 3;
+        exec.block_size_in  = comp_new->block_size * rw_pixel_bits(read_op)  >> 3;
+        exec.block_size_out = comp_new->block_size * rw_pixel_bits(write_op) >> 3;
         for (int i = 0; i < NB_PLANES; i++) {
             exec.in[i]  = (void *) src1[i];
             exec.out[i] = (void *) dst1[i];
         }
-        checkasm_call_checked(comp_new.func, &exec, comp_new.priv, 0, 0, PIXELS / comp_new.block_size, LINES);
+        checkasm_call_checked(comp_new->func, &exec, comp_new->priv, 0, 0, PIXELS / comp_new->block_size, LINES);
 
         for (int i = 0; i < NB_PLANES; i++) {
             const char *name = FMT("%s[%d]", report, i);
@@ -282,11 +215,103 @@ static void check_ops(const char *report, const unsigned ranges[NB_PLANES],
                 break;
         }
 
-        bench(comp_new.func, &exec, comp_new.priv, 0, 0, PIXELS / comp_new.block_size, LINES);
+        bench(comp_new->func, &exec, comp_new->priv, 0, 0, PIXELS / comp_new->block_size, LINES);
+    }
+}
+
+static void check_ops(const char *report, const unsigned ranges[NB_PLANES],
+                      const SwsOp *ops)
+{
+    SwsContext *ctx = sws_alloc_context();
+    SwsCompiledOp comp_ref = {0};
+    SwsOpList oplist = { .ops = (SwsOp *) ops };
+    const SwsOp *read_op, *write_op;
+    static const unsigned def_ranges[4] = {0};
+    int num_checked = 0;
+    if (!ranges)
+        ranges = def_ranges;
+
+    if (!ctx)
+        return;
+    ctx->flags = SWS_BITEXACT;
+
+    read_op = &ops[0];
+    for (oplist.num_ops = 0; ops[oplist.num_ops].op; oplist.num_ops++)
+        write_op = &ops[oplist.num_ops];
+
+    for (int p = 0; p < NB_PLANES; p++) {
+        void *plane = src0[p];
+        switch (read_op->type) {
+        case U8:
+            fill8(plane, sizeof(src0[p]) /  sizeof(uint8_t), ranges[p]);
+            set_range(&oplist.comps_src.max[p], ranges[p], UINT8_MAX);
+            oplist.comps_src.min[p] = (AVRational) { 0, 1 };
+            break;
+        case U16:
+            fill16(plane, sizeof(src0[p]) / sizeof(uint16_t), ranges[p]);
+            set_range(&oplist.comps_src.max[p], ranges[p], UINT16_MAX);
+            oplist.comps_src.min[p] = (AVRational) { 0, 1 };
+            break;
+        case U32:
+            fill32(plane, sizeof(src0[p]) / sizeof(uint32_t), ranges[p]);
+            set_range(&oplist.comps_src.max[p], ranges[p], UINT32_MAX);
+            oplist.comps_src.min[p] = (AVRational) { 0, 1 };
+            break;
+        case F32:
+            fill32f(plane, sizeof(src0[p]) / sizeof(uint32_t), ranges[p]);
+            if (ranges[p] && ranges[p] <= INT_MAX) {
+                oplist.comps_src.max[p] = (AVRational) { ranges[p], 1 };
+                oplist.comps_src.min[p] = (AVRational) { 0, 1 };
+            }
+            break;
+        }
+    }
+
+    /* Compile `ops` using the reference backend first */
+    for (int n = 0; ff_sws_op_backends[n]; n++) {
+        const SwsOpBackend *backend = ff_sws_op_backends[n];
+        if (strcmp(backend->name, "c"))
+            continue;
+        if (ff_sws_ops_compile_backend(ctx, backend, &oplist, &comp_ref) < 0) {
+            fail();
+            goto done;
+        }
+    }
+
+    av_assert0(comp_ref.func);
+
+    /* Check every other software backend which supports these ops */
+    for (int n = 0; ff_sws_op_backends[n]; n++) {
+        const SwsOpBackend *backend = ff_sws_op_backends[n];
+        SwsCompiledOp comp;
+        if (!strcmp(backend->name, "c") || backend->hw_format != AV_PIX_FMT_NONE)
+            continue;
+
+        int ret = ff_sws_ops_compile_backend(ctx, backend, &oplist, &comp);
+        if (ret == AVERROR(ENOTSUP))
+            continue;
+        else if (ret < 0)
+            fail();
+        else if (PIXELS % comp.block_size != 0)
+            fail();
+        else
+            check_compiled(report, backend, read_op, write_op, &comp_ref, &comp);
+
+        if (ret >= 0)
+            ff_sws_compiled_op_unref(&comp);
+        num_checked++;
+    }
+
+    /* Fall back to checking the reference against itself */
+    if (!num_checked) {
+        for (int n = 0; ff_sws_op_backends[n]; n++) {
+            if (!strcmp(ff_sws_op_backends[n]->name, "c"))
+                check_compiled(report, ff_sws_op_backends[n], read_op, write_op,
+                               &comp_ref, &comp_ref);
+        }
     }
 
-    if (comp_new.func != comp_ref.func)
-        ff_sws_compiled_op_unref(&comp_new);
+done:
     ff_sws_compiled_op_unref(&comp_ref);
     sws_free_context(&ctx);
 }
@@ -0,0 +1,98 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with FFmpeg; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include <string.h>
+#include "checkasm.h"
+
+#include "libavfilter/vf_fieldmatch.h"
+#include "libavutil/mem_internal.h"
+
+#define WIDTH 512
+#define LINES 5
+
+static void randomize_lines(uint8_t *buf)
+{
+    /* mix of flat and noisy areas, so that both outcomes of the tests occur */
+    for (int i = 0; i < LINES * WIDTH; i++)
+        buf[i] = (i / 64) & 1 ? rnd() & 0xFF : (rnd() & 0x0F) + 0x70;
+}
+
+static void check_comb_line(const FieldMatchDSPContext *dsp)
+{
+    LOCAL_ALIGNED_32(uint8_t, src, [LINES * WIDTH]);
+    LOCAL_ALIGNED_32(uint8_t, dst_ref, [WIDTH]);
+    LOCAL_ALIGNED_32(uint8_t, dst_new, [WIDTH]);
+    static const int cthreshs[] = { 0, 9, 40, 255 };
+
+    declare_func(void, uint8_t *dst, const uint8_t *srcpp, const uint8_t *srcp,
+                 const uint8_t *src, const uint8_t *srcn, const uint8_t *srcnn,
+                 ptrdiff_t width, int cthresh);
+
+    if (check_func(dsp->comb_line, "fieldmatch_comb_line")) {
+        for (int i = 0; i < FF_ARRAY_ELEMS(cthreshs); i++) {
+            /* odd width to cover the tail */
+            const int w = WIDTH - 7;
+            randomize_lines(src);
+            memset(dst_ref, 0x55, WIDTH);
+            memset(dst_new, 0x55, WIDTH);
+            call_ref(dst_ref, src, src + WIDTH, src + 2 * WIDTH,
+                     src + 3 * WIDTH, src + 4 * WIDTH, w, cthreshs[i]);
+            call_new(dst_new, src, src + WIDTH, src + 2 * WIDTH,
+                     src + 3 * WIDTH, src + 4 * WIDTH, w, cthreshs[i]);
+            if (memcmp(dst_ref, dst_new, WIDTH))
+                fail();
+        }
+        bench_new(dst_new, src, src + WIDTH, src + 2 * WIDTH,
+                  src + 3 * WIDTH, src + 4 * WIDTH, WIDTH, 9);
+    }
+}
+
+static void check_abs_diff_line(const FieldMatchDSPContext *dsp)
+{
+    LOCAL_ALIGNED_32(uint8_t, src, [LINES * WIDTH]);
+    LOCAL_ALIGNED_32(uint8_t, dst_ref, [WIDTH]);
+    LOCAL_ALIGNED_32(uint8_t, dst_new, [WIDTH]);
+
+    declare_func(void, uint8_t *dst, const uint8_t *a, const uint8_t *b,
+                 ptrdiff_t width);
+
+    if (check_func(dsp->abs_diff_line, "fieldmatch_abs_diff_line")) {
+        const int w = WIDTH - 3;
+        randomize_lines(src);
+        memset(dst_ref, 0x55, WIDTH);
+        memset(dst_new, 0x55, WIDTH);
+        call_ref(dst_ref, src, src + WIDTH, w);
+        call_new(dst_new, src, src + WIDTH, w);
+        if (memcmp(dst_ref, dst_new, WIDTH))
+            fail();
+        bench_new(dst_new, src, src + WIDTH, WIDTH);
+    }
+}
+
+void checkasm_check_vf_fieldmatch(void)
+{
+    FieldMatchDSPContext dsp;
+
+    ff_fieldmatch_dsp_init(&dsp);
+
+    check_comb_line(&dsp);
+    report("comb_line");
+
+    check_abs_diff_line(&dsp);
+    report("abs_diff_line");
+}
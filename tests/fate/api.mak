@@ -23,11 +23,31 @@ fate-lavf-flv: CMP =
 fate-api-seek: CMD = run $(APITESTSDIR)/api-seek-test$(EXESUF) $(TARGET_PATH)/tests/data/lavf/lavf.flv 0 720
 fate-api-seek: CMP = null
 
+FATE_API_LIBAVFORMAT-$(CONFIG_FILE_PROTOCOL) += fate-api-io-uring
+fate-api-io-uring: $(APITESTSDIR)/api-io-uring-test$(EXESUF)
+fate-api-io-uring: CMD = run $(APITESTSDIR)/api-io-uring-test$(EXESUF) $(TARGET_PATH)/tests/data/api-io-uring.bin
+fate-api-io-uring: CMP = null
+
 FATE_API-$(HAVE_THREADS) += fate-api-threadmessage
 fate-api-threadmessage: $(APITESTSDIR)/api-threadmessage-test$(EXESUF)
 fate-api-threadmessage: CMD = run $(APITESTSDIR)/api-threadmessage-test$(EXESUF) 3 10 30 50 2 20 40
 fate-api-threadmessage: CMP = null
 
+FATE_API-$(HAVE_THREADS) += fate-api-bufferpool
+fate-api-bufferpool: $(APITESTSDIR)/api-bufferpool-test$(EXESUF)
+fate-api-bufferpool: CMD = run $(APITESTSDIR)/api-bufferpool-test$(EXESUF) 4 1000
+fate-api-bufferpool: CMP = null
+
+FATE_API-$(HAVE_THREADS) += fate-api-threadqueue
+fate-api-threadqueue: $(APITESTSDIR)/api-threadqueue-test$(EXESUF)
+fate-api-threadqueue: CMD = run $(APITESTSDIR)/api-threadqueue-test$(EXESUF) 4 1000 8
+fate-api-threadqueue: CMP = null
+
+FATE_API-$(HAVE_THREADS) += fate-api-threadqueue-stress
+fate-api-threadqueue-stress: $(APITESTSDIR)/api-threadqueue-test$(EXESUF)
+fate-api-threadqueue-stress: CMD = run $(APITESTSDIR)/api-threadqueue-test$(EXESUF) 16 16 2 200
+fate-api-threadqueue-stress: CMP = null
+
 FATE_API_SAMPLES-$(CONFIG_AVFORMAT) += $(FATE_API_SAMPLES_LIBAVFORMAT-yes)
 
 ifdef SAMPLES
@@ -13,6 +13,7 @@ FATE_CHECKASM = fate-checkasm-aacencdsp                                 \
                 fate-checkasm-crc                                       \
                 fate-checkasm-dcadsp                                    \
                 fate-checkasm-diracdsp                                  \
+                fate-checkasm-drawutils                                 \
                 fate-checkasm-exrdsp                                    \
                 fate-checkasm-fdctdsp                                   \
                 fate-checkasm-fixed_dsp                                 \
@@ -76,6 +77,7 @@ FATE_CHECKASM = fate-checkasm-aacencdsp                                 \
                 fate-checkasm-vf_colordetect                            \
                 fate-checkasm-vf_colorspace                             \
                 fate-checkasm-vf_eq                                     \
+                fate-checkasm-vf_fieldmatch                             \
                 fate-checkasm-vf_fspp                                   \
                 fate-checkasm-vf_gblur                                  \
                 fate-checkasm-vf_hflip                                  \
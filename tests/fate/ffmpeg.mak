@@ -16,6 +16,21 @@ fate-ffmpeg-filter_colorkey: CMD = framecrc -auto_conversion_filters -idct simpl
 FATE_FFMPEG-$(call FILTERFRAMECRC, COLOR) += fate-ffmpeg-lavfi
 fate-ffmpeg-lavfi: CMD = framecrc -lavfi color=d=1:r=5 -fflags +bitexact
 
+# GOP-parallel encoding with a delayed (B-frame) encoder. Every chunk of
+# gop_size frames is encoded as a closed GOP, so the packets and their DTS
+# order differ from serial encoding (the -off reference), but they must not
+# depend on the number of threads.
+FATE_FFMPEG_GOP_THREADS-$(call FILTERFRAMECRC, TESTSRC2 FORMAT, MPEG4_ENCODER) += fate-ffmpeg-gop-threads-off \
+                                                                           fate-ffmpeg-gop-threads-2   \
+                                                                           fate-ffmpeg-gop-threads-4
+fate-ffmpeg-gop-threads-%: CMD = framecrc -lavfi testsrc2=s=176x144:r=25:d=2,format=yuv420p \
+    -c:v mpeg4 -bf 2 -g 12 -qscale:v 4 -flags +bitexact -fflags +bitexact $(GOPOPTS)
+fate-ffmpeg-gop-threads-off: GOPOPTS = -threads 1
+fate-ffmpeg-gop-threads-2:   GOPOPTS = -threads 2 -thread_type gop
+fate-ffmpeg-gop-threads-4:   GOPOPTS = -threads 4 -thread_type gop
+fate-ffmpeg-gop-threads-4:   REF = $(SRC_PATH)/tests/ref/fate/ffmpeg-gop-threads-2
+FATE_FFMPEG-$(HAVE_THREADS) += $(FATE_FFMPEG_GOP_THREADS-yes)
+
 FATE_FFMPEG-$(call ENCDEC2, MPEG4, RAWVIDEO, AVI, RAWVIDEO_DEMUXER FRAMECRC_MUXER) += fate-force_key_frames
 fate-force_key_frames: tests/data/vsynth1.yuv
 fate-force_key_frames: CMD = enc_dec \
@@ -81,6 +81,30 @@ FATE_FILTER_PALETTEUSE-$(call FILTERDEMDEC, PALETTEUSE SCALE, MATROSKA IMAGE2, H
 fate-filter-paletteuse: $(FATE_FILTER_PALETTEUSE-yes)
 FATE_FILTER_SAMPLES-yes += $(FATE_FILTER_PALETTEUSE-yes)
 
+FATE_FILTER-$(call FILTERFRAMECRC, TESTSRC2 FORMAT SPLIT PALETTEGEN PALETTEUSE) += fate-filter-paletteuse-threads
+fate-filter-paletteuse-threads: tests/data/filtergraphs/paletteuse
+fate-filter-paletteuse-threads: CMD = framecrc -filter_threads 4 -/filter_complex $(TARGET_PATH)/tests/data/filtergraphs/paletteuse
+
+FATE_FILTER_PIPELINE-$(call FILTERFRAMECRC, TESTSRC2 FORMAT BOXBLUR SPLIT HFLIP NEGATE VFLIP, LAVFI_INDEV) += fate-filter-pipeline-serial fate-filter-pipeline-threads
+fate-filter-pipeline-serial fate-filter-pipeline-threads: tests/data/filtergraphs/pipeline
+fate-filter-pipeline-serial: CMD = framecrc -f lavfi -i testsrc2=s=320x240:r=5:d=2 -/filter_complex $(TARGET_PATH)/tests/data/filtergraphs/pipeline
+# must match the serial output
+fate-filter-pipeline-threads: CMD = framecrc -filter_pipeline_threads 4 -f lavfi -i testsrc2=s=320x240:r=5:d=2 -/filter_complex $(TARGET_PATH)/tests/data/filtergraphs/pipeline
+fate-filter-pipeline-threads: REF = $(SRC_PATH)/tests/ref/fate/filter-pipeline-serial
+
+FATE_FILTER-yes += $(FATE_FILTER_PIPELINE-yes)
+fate-filter-pipeline: $(FATE_FILTER_PIPELINE-yes)
+
+FATE_FILTER_SCALE_SIZES-$(call FILTERFRAMECRC, TESTSRC2 FORMAT SCALE SPLIT, LAVFI_INDEV) += fate-filter-scale-sizes fate-filter-scale-sizes-separate
+fate-filter-scale-sizes: tests/data/filtergraphs/scale-sizes
+fate-filter-scale-sizes: CMD = framecrc -f lavfi -i testsrc2=s=320x240:r=5:d=1 -/filter_complex $(TARGET_PATH)/tests/data/filtergraphs/scale-sizes
+# each output must match a separate scale instance
+fate-filter-scale-sizes-separate: tests/data/filtergraphs/scale-sizes-separate
+fate-filter-scale-sizes-separate: CMD = framecrc -f lavfi -i testsrc2=s=320x240:r=5:d=1 -/filter_complex $(TARGET_PATH)/tests/data/filtergraphs/scale-sizes-separate
+fate-filter-scale-sizes-separate: REF = $(SRC_PATH)/tests/ref/fate/filter-scale-sizes
+
+FATE_FILTER-yes += $(FATE_FILTER_SCALE_SIZES-yes)
+
 FATE_FILTER-$(call FILTERFRAMECRC, LIFE, LAVFI_INDEV) += fate-filter-lavd-life
 fate-filter-lavd-life: CMD = framecrc -f lavfi -i life=s=40x40:r=5:seed=42:mold=64:ratio=0.1:death_color=red:life_color=green -t 2
 
@@ -0,0 +1,114 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/*
+ * Measure the decoding speed of a stream for a number of different thread
+ * counts, e.g. to evaluate how the VVC decoder scales:
+ *   decode_bench input.vvc 0 0 1,2,4,8,16,32
+ */
+
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "decode_simple.h"
+
+#include "libavutil/avstring.h"
+#include "libavutil/dict.h"
+#include "libavutil/error.h"
+#include "libavutil/time.h"
+
+static int process_frame(DecodeContext *dc, AVFrame *frame)
+{
+    int64_t *nb_frames = dc->opaque;
+
+    if (frame)
+        (*nb_frames)++;
+
+    return 0;
+}
+
+static int run_one(const char *filename, unsigned int stream_idx,
+                   unsigned int max_frames, const char *nb_threads,
+                   const char *thread_type)
+{
+    DecodeContext dc;
+    int64_t nb_frames = 0, start, elapsed;
+    int ret;
+
+    ret = ds_open(&dc, filename, stream_idx);
+    if (ret < 0)
+        goto finish;
+
+    dc.process_frame = process_frame;
+    dc.opaque        = &nb_frames;
+    dc.max_frames    = max_frames;
+
+    ret = av_dict_set(&dc.decoder_opts, "threads", nb_threads, 0);
+    if (ret >= 0 && thread_type)
+        ret = av_dict_set(&dc.decoder_opts, "thread_type", thread_type, 0);
+    if (ret < 0)
+        goto finish;
+
+    start   = av_gettime_relative();
+    ret     = ds_run(&dc);
+    elapsed = av_gettime_relative() - start;
+    if (ret < 0)
+        goto finish;
+
+    fprintf(stdout, "threads %-4s frames %-6"PRId64" time %8.3fs  %8.2f fps\n",
+            nb_threads, nb_frames, elapsed / 1e6,
+            nb_frames * 1e6 / FFMAX(elapsed, 1));
+
+finish:
+    ds_free(&dc);
+    return ret;
+}
+
+int main(int argc, char **argv)
+{
+    unsigned int stream_idx, max_frames;
+    const char *filename, *thread_type = NULL;
+    char *thread_counts, *nb_threads, *saveptr = NULL;
+    int ret = 0;
+
+    if (argc <= 4) {
+        fprintf(stderr, "Usage: %s <input file> <stream index> <max frame count> "
+                        "<comma-separated thread counts> [<thread type>]\n", argv[0]);
+        return 0;
+    }
+
+    filename      = argv[1];
+    stream_idx    = strtol(argv[2], NULL, 0);
+    max_frames    = strtol(argv[3], NULL, 0);
+    thread_counts = argv[4];
+    if (argc > 5)
+        thread_type = argv[5];
+
+    for (nb_threads = av_strtok(thread_counts, ",", &saveptr); nb_threads;
+         nb_threads = av_strtok(NULL, ",", &saveptr)) {
+        ret = run_one(filename, stream_idx, max_frames, nb_threads, thread_type);
+        if (ret < 0) {
+            fprintf(stderr, "Decoding with %s threads failed: %s\n",
+                    nb_threads, av_err2str(ret));
+            break;
+        }
+    }
+
+    return ret < 0;
+}